@@ -261,6 +261,8 @@ json build(const json& args) {
         : (modelTypeStr == "sbg") ? ModelType::sbg
         : (modelTypeStr == "cong") ? ModelType::cong
         : (modelTypeStr == "cong-global") ? ModelType::congGlobal
+        : (modelTypeStr == "cong-q4") ? ModelType::congQ4
+        : (modelTypeStr == "cong-global-q4") ? ModelType::congGlobalQ4
         : ModelType::none;
     
     BuildOption buildOptions = BuildOption::none;
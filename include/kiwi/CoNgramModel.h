@@ -1,6 +1,7 @@
 #pragma once
 
 #include <array>
+#include <atomic>
 #include <vector>
 #include <deque>
 #include <memory>
@@ -68,6 +69,7 @@ namespace kiwi
 			const size_t memorySize = 0;
 			CoNgramModelHeader header;
 			mutable std::vector<std::vector<uint32_t>> contextWordMapCache;
+			mutable std::atomic<size_t> similarityNumProbes{ 0 }, similarityNumLists{ 0 };
 
 			CoNgramModelBase(const utils::MemoryObject& mem) : memorySize{ mem.size() }, header{ *reinterpret_cast<const CoNgramModelHeader*>(mem.get()) }
 			{
@@ -88,6 +90,25 @@ namespace kiwi
 			virtual size_t predictWordsFromContext(uint32_t contextId, size_t topN, std::pair<uint32_t, float>* output) const = 0;
 			virtual size_t predictWordsFromContextDiff(uint32_t contextId, uint32_t bgContextId, float weight, size_t topN, std::pair<uint32_t, float>* output) const = 0;
 
+			/**
+			 * @brief 여러 단어에 대해 `mostSimilarWords()`를 한 번에 수행한다.
+			 * 출력 임베딩을 블록 단위로 한 번만 읽으며 모든 질의의 점수를 계산하고, 질의마다 크기가 topN인 힙으로 상위 항목을 고른다.
+			 * 
+			 * @param output 크기가 numQueries * topN인 배열. i번째 질의의 결과는 output[i * topN]부터 점수의 내림차순으로 기록된다.
+			 * @param outputSizes 크기가 numQueries인 배열. 각 질의에 대해 실제로 기록된 결과의 개수가 기록된다.
+			 */
+			virtual void mostSimilarWordsBatch(const uint32_t* vocabIds, size_t numQueries, size_t topN, std::pair<uint32_t, float>* output, size_t* outputSizes) const = 0;
+
+			/**
+			 * @brief 한 단어와 여러 후보 단어 사이의 유사도를 한 번에 계산한다. 올바르지 않은 후보에 대해서는 NaN이 기록된다.
+			 */
+			virtual void wordSimilarityBatch(uint32_t vocabId, const uint32_t* candVocabIds, size_t size, float* output) const = 0;
+
+			/**
+			 * @brief 여러 문맥에 대해 `predictWordsFromContext()`를 한 번에 수행한다. 출력 형식은 `mostSimilarWordsBatch()`와 같다.
+			 */
+			virtual void predictWordsFromContextBatch(const uint32_t* contextIds, size_t numQueries, size_t topN, std::pair<uint32_t, float>* output, size_t* outputSizes) const = 0;
+
 			virtual uint32_t toContextId(const uint32_t* vocabIds, size_t size) const = 0;
 			virtual float getContextFrequency(uint32_t contextId) const = 0;
 			virtual float getContextEntropy(uint32_t contextId) const = 0;
@@ -96,6 +117,30 @@ namespace kiwi
 			virtual std::vector<std::vector<uint32_t>> getContextWordMap() const = 0;
 			virtual float progressOneStep(int32_t& nodeIdx, uint32_t& contextIdx, uint32_t next) const = 0;
 
+			/**
+			 * @brief 임베딩이 4bit로 압축된 상태로 메모리에 유지되고 있는지 여부를 반환한다.
+			 */
+			virtual bool hasCompactEmbedding() const = 0;
+
+			/**
+			 * @brief `mostSimilarWords()`와 `mostSimilarContexts()`가 전체 임베딩 대신 근사 최근접 이웃 색인을 탐색하도록 설정한다.
+			 * 
+			 * 색인은 임베딩을 numLists개의 클러스터로 나눈 IVF 구조이며, 처음 사용될 때 생성된다.
+			 * 질의와 가장 가까운 numProbes개의 클러스터에 속한 항목만 평가하므로 numProbes가 클수록 정확도(recall)는 높아지고 속도는 느려진다.
+			 * 반환되는 유사도 값은 전체 탐색과 동일하다.
+			 * 
+			 * @param numProbes 질의마다 탐색할 클러스터의 개수. 0이면 색인을 사용하지 않고 전체를 탐색한다.
+			 * @param numLists 클러스터의 개수. 0이면 항목 개수의 제곱근을 사용한다. 값이 바뀌면 다음 질의 때 색인을 새로 생성한다.
+			 */
+			void setSimilarityIndex(size_t numProbes, size_t numLists = 0) const
+			{
+				similarityNumLists.store(numLists, std::memory_order_relaxed);
+				similarityNumProbes.store(numProbes, std::memory_order_relaxed);
+			}
+
+			size_t getSimilarityNumProbes() const { return similarityNumProbes.load(std::memory_order_relaxed); }
+			size_t getSimilarityNumLists() const { return similarityNumLists.load(std::memory_order_relaxed); }
+
 			const std::vector<std::vector<uint32_t>>& getContextWordMapCached() const
 			{
 				if (contextWordMapCache.empty())
@@ -114,10 +159,19 @@ namespace kiwi
 			static utils::MemoryObject buildChrModel(const std::string& contextDefinition, const std::string& embedding,
 				size_t maxContextLength = -1, bool reorderContextIdx = true, bool eraseRedundantContexts = false);
 
+			/**
+			 * @brief 모델 파일로부터 ConG 모델을 생성한다.
+			 * @param compactEmbedding 모델이 4bit로 양자화되어 있는 경우, 임베딩을 8bit로 풀지 않고 4bit 상태로 메모리에 유지한다.
+			 *        임베딩 외의 데이터는 그대로이므로 전체 메모리 사용량은 35~40% 정도 줄어든다.
+			 *        연산 시마다 필요한 행을 풀어야 하므로 속도는 다소 느려지며, 최근에 푼 행은 스레드별로 캐싱하여 재사용한다.
+			 *        quantized가 true이고 모델이 4bit로 양자화되어 있을 때에만 적용되며, 그렇지 않으면 8bit 임베딩을 그대로 사용한다.
+			 *        실제 적용 여부는 hasCompactEmbedding()으로 확인할 수 있다.
+			 */
 			static std::unique_ptr<CoNgramModelBase> create(utils::MemoryObject&& mem, 
 				ArchType archType = ArchType::none, 
 				bool useDistantTokens = false, 
-				bool quantized = true);
+				bool quantized = true,
+				bool compactEmbedding = false);
 		};
 	}
 }
@@ -24,10 +24,41 @@ namespace kiwi
 		}
 	};
 
+	/**
+	 * @brief HSDataset의 prefetch 결과가 기록될 호출자 소유의 버퍼.
+	 * 
+	 * 각 배열은 HSDataset::next에 넘기는 배열과 동일한 크기를 가져야 하며,
+	 * 등록된 뒤에는 HSDataset::stopPrefetch가 호출될 때까지 유효해야 한다.
+	 */
+	template<class IntTy, class NgramTy>
+	struct HSBatchBuffer
+	{
+		IntTy* in = nullptr;
+		IntTy* out = nullptr;
+		float* lmLProbs = nullptr;
+		NgramTy* outNgramNode = nullptr;
+		IntTy* unlikelihoodIn = nullptr;
+		IntTy* unlikelihoodOut = nullptr;
+	};
+
+	/**
+	 * @brief HSDataset::acquireBatch가 반환하는, 채워진 버퍼의 정보
+	 */
+	struct HSPrefetchedBatch
+	{
+		size_t slot = -1; /**< 채워진 버퍼의 순번. 더 이상 배치가 없으면 -1 */
+		size_t size = 0; /**< 배치에 포함된 토큰의 개수 */
+		float restLm = 0;
+		uint32_t restLmCnt = 0;
+		size_t unlikelihoodSize = 0;
+	};
+
 	class HSDataset
 	{
 		friend class KiwiBuilder;
 
+		struct Prefetcher;
+
 		struct ThreadLocal
 		{
 			std::mt19937_64 rng;
@@ -45,9 +76,32 @@ namespace kiwi
 			Deque<int32_t> unlikelihoodOutData;
 		};
 
+		/**
+		 * @brief Prefetcher의 소유 포인터. 이동될 때 원본의 prefetch 스레드를 먼저 멈춘다.
+		 */
+		struct PrefetcherPtr
+		{
+			std::unique_ptr<Prefetcher> ptr;
+
+			PrefetcherPtr();
+			PrefetcherPtr(PrefetcherPtr&& o) noexcept;
+			PrefetcherPtr& operator=(PrefetcherPtr&& o) noexcept;
+			~PrefetcherPtr();
+
+			Prefetcher* operator->() const { return ptr.get(); }
+			Prefetcher& operator*() const { return *ptr; }
+			explicit operator bool() const { return !!ptr; }
+		};
+
 		static constexpr int32_t nonVocab = -1;
 
+		// prefetch 스레드가 다른 멤버에 접근하므로, 다른 멤버들보다 먼저 이동되도록 가장 앞에 선언한다.
+		// 소멸 시에는 ~HSDataset()에서 스레드를 먼저 종료한다.
+		PrefetcherPtr prefetcher;
+
 		HiddenMember<RaggedVector<int32_t>, sizeof(Vector<size_t>) * 2> sents;
+		HiddenMember<RaggedVectorView<int32_t>, sizeof(Vector<size_t>) * 2> sentView;
+		std::vector<std::unique_ptr<utils::MMap>> mappedFiles;
 		std::shared_ptr<lm::ILangModel> langModel;
 		std::shared_ptr<Kiwi> kiwiInst;
 		std::shared_ptr<Vector<std::pair<std::u16string, POSTag>>> oovDict;
@@ -78,10 +132,16 @@ namespace kiwi
 		size_t totalTokens = 0;
 		size_t passedSents = 0;
 		size_t passedWorkItems = 0;
+		size_t shardRank = 0;
+		size_t shardWorldSize = 1;
 		std::array<size_t, static_cast<size_t>(Kiwi::SpecialMorph::max)> specialMorphIds = { { 0, } };
 
 		size_t numValidTokensInSent(size_t sentId) const;
 
+		void bindSents();
+
+		std::pair<size_t, size_t> shardRange() const;
+
 		template<class Token>
 		void prepareInOutData(Deque<int32_t>& inData, Deque<int32_t>& outData, const Vector<Token>& tokens, std::mt19937_64& rng) const;
 
@@ -89,6 +149,9 @@ namespace kiwi
 
 		void fillSbTokenIds();
 
+		template<class IntTy, class NgramTy>
+		void initPrefetcher(const std::vector<HSBatchBuffer<IntTy, NgramTy>>& buffers);
+
 		template<class InTy, class OutTy, class LmTy, class NgramTy, class UlInTy, class UlOutTy>
 		size_t _next(InTy in, OutTy out, LmTy lmLProbs, NgramTy outNgramNode, float& restLmOut, uint32_t& restLmCntOut, 
 			UlInTy unlikelihoodIn, UlOutTy unlikelihoodOut, size_t* unlikelihoodSize);
@@ -118,12 +181,56 @@ namespace kiwi
 		const Vector<uint8_t>& getWindowTokenValidness() const { return windowTokenValidness; }
 
 		void seed(size_t newSeed);
+
+		/**
+		 * @brief 분산 학습을 위해 이 데이터셋이 순회할 샤드를 지정한다.
+		 * 
+		 * reset() 시 전체 문장의 순서를 섞은 뒤 그 중 rank번째 구간만을 순회한다.
+		 * 모든 rank가 동일한 seed를 사용하면 각 rank는 매 epoch마다 서로 겹치지 않는 문장들을 순회하게 된다.
+		 * numSents()와 numTokens()는 샤드와 관계없이 전체 데이터셋의 값을 반환하며, numEstimBatches()는 샤드 하나에 대한 추정치를 반환한다.
+		 * @param rank 현재 프로세스의 순번. worldSize보다 작아야 한다.
+		 * @param worldSize 전체 프로세스의 개수.
+		 */
+		void setShard(size_t rank, size_t worldSize);
+		size_t getShardRank() const { return shardRank; }
+		size_t getShardWorldSize() const { return shardWorldSize; }
+
 		void reset();
 		size_t next(int32_t* in, int32_t* out, float* lmLProbs, uint32_t* outNgramNode, float& restLmOut, uint32_t& restLmCntOut, 
 			int32_t* unlikelihoodIn = nullptr, int32_t* unlikelihoodOut = nullptr, size_t* unlikelihoodSize = nullptr);
 		size_t next(int64_t* in, int64_t* out, float* lmLProbs, int64_t* outNgramNode, float& restLmOut, uint32_t& restLmCntOut,
 			int64_t* unlikelihoodIn = nullptr, int64_t* unlikelihoodOut = nullptr, size_t* unlikelihoodSize = nullptr);
 
+		/**
+		 * @brief 배치를 미리 생성해 둘 버퍼들을 등록하고 백그라운드 prefetch를 활성화한다.
+		 * 
+		 * 등록된 버퍼의 개수가 prefetch의 깊이가 된다. 별도의 스레드가 비어 있는 버퍼에 다음 배치를 직접 채워두므로,
+		 * 학습 루프는 acquireBatch로 채워진 버퍼를 받아 사용하고 releaseBatch로 돌려주기만 하면 된다.
+		 * prefetch가 활성화된 동안에는 next()를 사용할 수 없다. HSDataset을 이동하면 진행 중이던 prefetch는 멈추고,
+		 * 이동된 객체에서 acquireBatch()를 호출할 때 다시 시작된다.
+		 */
+		void setPrefetchBuffers(const std::vector<HSBatchBuffer<int32_t, uint32_t>>& buffers);
+		void setPrefetchBuffers(const std::vector<HSBatchBuffer<int64_t, int64_t>>& buffers);
+
+		/**
+		 * @brief 다음 배치가 채워진 버퍼를 반환한다. 배치가 준비될 때까지 대기하며, 현재 epoch이 끝나면 slot이 -1인 값을 반환한다.
+		 */
+		HSPrefetchedBatch acquireBatch();
+
+		/**
+		 * @brief 사용이 끝난 버퍼를 돌려주어 다음 배치를 채울 수 있게 한다.
+		 * 
+		 * acquireBatch()로 받지 않은 slot이나 이미 돌려준 slot을 넘기면 std::invalid_argument를 던진다.
+		 */
+		void releaseBatch(size_t slot);
+
+		/**
+		 * @brief prefetch 스레드를 종료하고 등록된 버퍼들을 해제한다.
+		 */
+		void stopPrefetch();
+
+		size_t getPrefetchDepth() const;
+
 		size_t vocabSize() const { return vocabToToken.size(); }
 		size_t getKnlmVocabSize() const;
 		size_t ngramNodeSize() const;
@@ -131,7 +238,7 @@ namespace kiwi
 		std::u16string vocabForm(uint32_t vocab) const;
 		std::vector<size_t> estimVocabFrequency() const;
 
-		Range<Vector<int32_t>::const_iterator> getSent(size_t idx) const;
+		Range<const int32_t*> getSent(size_t idx) const;
 		std::vector<uint32_t> getAugmentedSent(size_t idx);
 
 		std::vector<std::pair<std::vector<uint32_t>, size_t>> extractPrefixes(size_t minCnt, size_t maxLength, size_t numWorkers = 1, bool exclusiveCnt = false) const;
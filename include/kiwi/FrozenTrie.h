@@ -6,6 +6,7 @@
 #include <memory>
 #include <algorithm>
 #include <numeric>
+#include <iosfwd>
 #include <kiwi/ArchUtils.h>
 #include <kiwi/Trie.hpp>
 
@@ -131,6 +132,13 @@ namespace kiwi
 			FrozenTrie& operator=(const FrozenTrie& o);
 			FrozenTrie& operator=(FrozenTrie&& o) noexcept = default;
 
+			/**
+			 * @brief 노드 배열을 그대로 읽고 쓴다. 
+			 * 자식 노드의 배치는 생성 시의 ArchType에 따라 달라지므로, 같은 ArchType으로 생성된 경우에만 읽어들인 결과를 사용할 수 있다.
+			 */
+			void serializerRead(std::istream& istr);
+			void serializerWrite(std::ostream& ostr) const;
+
 			bool empty() const { return !numNodes; }
 			size_t size() const { return numNodes; }
 			const Node* root() const { return nodes.get(); }
@@ -20,20 +20,106 @@ namespace kiwi
 			insert_space = 2,
 		};
 
+		/**
+		 * @brief 형태소 결합 캐시의 사용 현황
+		 */
+		struct CombineCacheStats
+		{
+			size_t capacity = 0; /**< 캐시에 저장할 수 있는 최대 항목 수 */
+			size_t size = 0; /**< 현재 캐시에 저장된 항목 수 */
+			size_t hits = 0; /**< 캐시에서 결합 결과를 찾은 횟수 */
+			size_t misses = 0; /**< 캐시에서 결과를 찾지 못해 결합 규칙을 새로 적용한 횟수 */
+		};
+
+		/**
+		 * @brief 여러 Joiner가 공유하는 확정된 결합 결과를 저장하는 저장소.
+		 * 
+		 * 각 노드는 한 Joiner가 확정한 문자열 조각과 형태소 범위를 담고 부모 노드를 가리킨다. 
+		 * 후보를 복제하더라도 확정된 부분은 노드 번호만 복사되므로, 여러 후보가 앞부분을 공유하는 트리를 이룬다.
+		 * 노드는 번호로만 참조하므로 저장소를 통째로 복사하거나 이동하더라도 그대로 유효하다.
+		 * 같은 부모 아래에서 같은 내용을 확정한 후보들은 노드 하나를 함께 사용하며, 
+		 * 가지치기된 후보만 참조하던 노드가 절반을 넘어서면 compact()로 정리한다.
+		 */
+		class JoinerArena
+		{
+			friend class Joiner;
+			friend class AutoJoiner;
+
+			struct Node
+			{
+				uint32_t parent = 0; // 0이면 부모가 없음. 그 외에는 nodes의 인덱스 + 1
+				uint32_t offset = 0; // 전체 결합 결과에서 이 조각이 시작하는 위치
+				uint32_t chrBegin = 0, chrEnd = 0;
+				uint32_t rangeBegin = 0, rangeEnd = 0;
+			};
+
+			KString chrs;
+			std::vector<std::pair<uint32_t, uint32_t>> ranges;
+			std::vector<Node> nodes;
+			size_t shareBegin = 0; // 이 위치 이후의 노드는 새로 확정되는 부분과 공유할 수 있는지 확인한다.
+			size_t compactThreshold = 64; // 노드 수가 이 값에 도달하면 compact()를 시도한다.
+
+			/**
+			 * @brief roots에서 도달할 수 없는 노드를 제거하고 남은 노드의 번호를 다시 매긴다. roots도 새 번호로 갱신된다.
+			 * 살아있는 노드가 절반 이상이면 아무것도 하지 않는다.
+			 */
+			void compact(uint32_t* roots, size_t numRoots);
+		};
+
 		class Joiner
 		{
 			friend class CompiledRule;
 			friend class AutoJoiner;
 			template<class LmState> friend struct Candidate;
 			const CompiledRule* cr = nullptr;
-			KString stack;
-			std::vector<std::pair<uint32_t, uint32_t>> ranges;
+			KString stack; // committedSize 이후의 결합 결과
+			std::vector<std::pair<uint32_t, uint32_t>> ranges; // JoinerArena로 옮겨지지 않은 형태소 범위
 			size_t activeStart = 0;
+			size_t committedSize = 0;
+			uint32_t committedNode = 0;
+			char16_t lastCommittedChr = 0, lastValidCommittedChr = 0;
 			POSTag lastTag = POSTag::unknown, anteLastTag = POSTag::unknown;
 
 			explicit Joiner(const CompiledRule& _cr);			
 			void add(U16StringView form, POSTag tag, Space space);
 
+			size_t size() const { return committedSize + stack.size(); }
+
+			/**
+			 * @brief pos 바로 앞의 문자를 반환한다. pos는 committedSize 이상이어야 한다.
+			 */
+			char16_t chrBefore(size_t pos) const 
+			{ 
+				return pos > committedSize ? stack[pos - committedSize - 1] : lastCommittedChr; 
+			}
+
+			/**
+			 * @brief 결합 결과가 c로 끝나는 경우, 뒤에 오는 문자와 합쳐질 수 있는지 확인한다.
+			 */
+			static bool isOpenEnd(char16_t c);
+
+			/**
+			 * @brief 결합 결과의 앞부분 중 이후에 어떤 형태소가 추가되더라도 바뀌지 않는 부분의 길이를 반환한다.
+			 */
+			size_t stableSize() const;
+
+			/**
+			 * @brief activeStart 이전의 확정된 부분을 arena로 옮긴다.
+			 * arena.shareBegin 이후에 같은 부모와 같은 내용을 가진 노드가 있으면 새로 만들지 않고 그 노드를 사용한다.
+			 */
+			void commit(JoinerArena& arena);
+
+			/**
+			 * @brief arena에 옮겨진 부분을 포함하여, 결합 결과 중 from 이후 부분을 out에 복원한다.
+			 * rangesOut이 주어지면 from 이후에 걸쳐 있는 형태소 범위도 함께 복원한다.
+			 */
+			void materialize(const JoinerArena* arena, size_t from, KString& out, 
+				std::vector<std::pair<uint32_t, uint32_t>>* rangesOut = nullptr) const;
+
+			static std::u16string toU16(const KString& stack, const std::vector<std::pair<uint32_t, uint32_t>>& ranges, 
+				std::vector<std::pair<uint32_t, uint32_t>>* rangesOut);
+			static std::string toU8(const std::u16string& u16, std::vector<std::pair<uint32_t, uint32_t>>* rangesOut);
+
 		public:
 			~Joiner();
 
@@ -161,6 +247,27 @@ namespace kiwi
 			}
 		};
 
+		/**
+		 * @brief Kiwi::joinBatch의 결과. 
+		 * 
+		 * 모든 결합 결과를 하나의 문자열에, 모든 형태소 범위를 하나의 배열에 순서대로 이어 붙여 저장한다.
+		 * 위치는 모두 UTF-16 문자 단위이며, 형태소 범위는 각 결합 결과의 시작 위치를 기준으로 한다.
+		 */
+		struct JoinedBatch
+		{
+			std::u16string text; /**< 모든 결합 결과를 이어 붙인 문자열 */
+			std::vector<uint32_t> textOffsets; /**< i번째 결과는 text의 [textOffsets[i], textOffsets[i + 1]) 구간에 위치한다. */
+			std::vector<std::pair<uint32_t, uint32_t>> ranges; /**< 각 형태소가 결합 결과 내에서 차지하는 구간 */
+			std::vector<uint32_t> rangeOffsets; /**< i번째 결과의 형태소 범위는 ranges의 [rangeOffsets[i], rangeOffsets[i + 1]) 구간에 위치한다. */
+
+			size_t size() const { return textOffsets.empty() ? 0 : textOffsets.size() - 1; }
+
+			U16StringView get(size_t i) const
+			{
+				return U16StringView{ text.data() + textOffsets[i], textOffsets[i + 1] - textOffsets[i] };
+			}
+		};
+
 		class AutoJoiner
 		{
 			friend class kiwi::Kiwi;
@@ -183,16 +290,26 @@ namespace kiwi
 			template<ArchType arch>
 			void addWithoutSearchImpl2(U16StringView form, POSTag tag, bool inferRegularity, Space space, Vector<Candidate<lm::VoidState<arch>>>& candidates);
 
+			template<class LmState>
+			static size_t stableSizeImpl(const JoinerArena& arena, size_t from, const Vector<Candidate<LmState>>& candidates);
+
+			template<class LmState>
+			void commitAll(Vector<Candidate<LmState>>& candidates);
+
 			template<class LmState>
 			struct Dispatcher;
 
 			using FnAdd = void(*)(AutoJoiner*, size_t, Space, Vector<Candidate<lm::VoidState<ArchType::none>>>&);
 			using FnAdd2 = void(*)(AutoJoiner*, U16StringView, POSTag, bool, Space, Vector<Candidate<lm::VoidState<ArchType::none>>>&);
+			using FnStableSize = size_t(*)(const JoinerArena&, size_t, const Vector<Candidate<lm::VoidState<ArchType::none>>>&);
 
 			const Kiwi* kiwi = nullptr;
 			FnAdd dfAdd = nullptr;
 			FnAdd2 dfAdd2 = nullptr;
+			FnStableSize dfStableSize = nullptr;
 			ErasedVector candBuf;
+			JoinerArena arena;
+			size_t flushedSize = 0;
 		public:
 
 			~AutoJoiner();
@@ -208,6 +325,22 @@ namespace kiwi
 
 			std::u16string getU16(std::vector<std::pair<uint32_t, uint32_t>>* rangesOut = nullptr) const;
 			std::string getU8(std::vector<std::pair<uint32_t, uint32_t>>* rangesOut = nullptr) const;
+
+			/**
+			 * @brief 후보들이 공유하는 확정된 결합 결과 저장소에 보관된 문자의 수를 반환한다.
+			 */
+			size_t getArenaSize() const { return arena.chrs.size(); }
+
+			/**
+			 * @brief 결합 결과 중 이후에 어떤 형태소가 추가되더라도 바뀌지 않는 부분을 반환한다. 
+			 * 
+			 * 이전 호출에서 이미 반환한 부분은 제외하므로, 형태소를 하나씩 추가하면서 확정된 결과를 조금씩 내보내는 데에 사용할 수 있다.
+			 * 여러 후보를 탐색하는 경우에는 모든 후보가 공통으로 가지는 부분만 확정된 것으로 본다.
+			 * @param finish true이면 아직 확정되지 않은 부분까지 모두 반환한다. 
+			 * 이후에 형태소를 더 추가하면 결합 결과가 이미 반환된 부분과 일치하지 않을 수 있다.
+			 */
+			std::u16string flushU16(bool finish = false);
+			std::string flushU8(bool finish = false);
 		};
 	}
 }
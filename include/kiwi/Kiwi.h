@@ -28,6 +28,7 @@
 #include "SkipBigramModel.h"
 #include "CoNgramModel.h"
 #include "ThreadPool.h"
+#include "ScratchSpace.h"
 #include "WordDetector.h"
 #include "TagUtils.h"
 #include "LangModel.h"
@@ -59,6 +60,7 @@ namespace kiwi
 	}
 
 	template<class Ty> class RaggedVector;
+	template<class Ty> class RaggedVectorView;
 	////
 
 	inline uint32_t getDefaultMorphemeId(POSTag tag)
@@ -166,6 +168,39 @@ namespace kiwi
 		void validate() const;
 	};
 
+	/**
+	 * @brief 여러 입력을 한꺼번에 분석할 때 작업 단위와 결과 전달 방식을 설정한다.
+	 * 
+	 * @sa kiwi::Kiwi::analyzeBulk
+	 */
+	struct BulkAnalyzeOption
+	{
+		/**
+		* @brief 읽어들였지만 아직 결과가 전달되지 않은 입력의 최대 개수. 0이면 스레드 개수의 2배를 사용한다.
+		*/
+		size_t maxInFlight = 0;
+
+		/**
+		* @brief 하나의 작업으로 묶어서 처리할 최대 입력 개수. 1이면 입력마다 별도의 작업을 생성한다.
+		*/
+		size_t maxBatchSize = 1;
+
+		/**
+		* @brief 하나의 작업으로 묶을 입력들의 최대 글자 수 합계. 이보다 긴 입력은 항상 단독으로 처리된다.
+		*/
+		size_t maxBatchChars = 256;
+
+		/**
+		* @brief true이면 입력 순서대로 결과를 전달하고, false이면 분석이 끝나는 순서대로 전달한다.
+		*/
+		bool ordered = true;
+
+		BulkAnalyzeOption() = default;
+		BulkAnalyzeOption(size_t _maxInFlight, size_t _maxBatchSize = 1, size_t _maxBatchChars = 256, bool _ordered = true)
+			: maxInFlight{ _maxInFlight }, maxBatchSize{ _maxBatchSize }, maxBatchChars{ _maxBatchChars }, ordered{ _ordered }
+		{}
+	};
+
 	/**
 	 * @brief 실제 형태소 분석을 수행하는 클래스.
 	 * 
@@ -196,7 +231,7 @@ namespace kiwi
 		std::shared_ptr<lm::ILangModel> langMdl;
 		std::shared_ptr<lm::CoNgramModelBase> nounChrMdl;
 		std::shared_ptr<cmb::CompiledRule> combiningRule;
-		std::unique_ptr<utils::ThreadPool> pool;
+		std::shared_ptr<utils::ThreadPool> pool;
 		
 		const Morpheme* getDefaultMorpheme(POSTag tag) const;
 
@@ -404,55 +439,39 @@ namespace kiwi
 			AnalyzeOption option, const std::optional<KiwiConfig>& overrideConfig = {}
 		) const
 		{
-			if (pool)
+			analyzeBulk(topN, [&]() -> std::u16string
 			{
-				auto config = overrideConfig.value_or(globalConfig);
-				bool stop = false;
-				std::deque<std::future<std::vector<TokenResult>>> futures;
-				for (size_t i = 0; i < pool->size() * 2; ++i)
-				{
-					auto ustr = reader();
-					if (ustr.empty())
-					{
-						stop = true;
-						break;
-					}
-					futures.emplace_back(pool->enqueue([=, ustr = std::move(ustr), &config](size_t tid)
-					{
-						return analyze(ustr, topN, option, {}, config);
-					}));
-				}
-
-				while (!futures.empty())
-				{
-					resultCallback(futures.front().get());
-					futures.pop_front();
-					if (!stop)
-					{
-						auto ustr = reader();
-						if (ustr.empty())
-						{
-							stop = true;
-							continue;
-						}
-						futures.emplace_back(pool->enqueue([=, ustr = std::move(ustr), &config](size_t tid)
-						{
-							return analyze(ustr, topN, option, {}, config);
-						}));
-					}
-				}
-			}
-			else
+				return reader();
+			}, [&](size_t, std::vector<TokenResult>&& res)
 			{
-				while(1)
-				{
-					auto ustr = reader();
-					if (ustr.empty()) break;
-					resultCallback(analyze(ustr, topN, option, {}, overrideConfig));
-				}
-			}
+				resultCallback(std::move(res));
+			}, option, BulkAnalyzeOption{}, overrideConfig);
 		}
 
+		/**
+		 * @brief reader로부터 입력을 차례로 읽어들여 스레드풀에서 분석하고 결과를 resultCallback으로 전달한다.
+		 * 
+		 * @param topN 입력마다 반환할 분석 결과의 개수
+		 * @param reader 다음 입력을 반환하는 함수. 빈 문자열을 반환하면 입력이 끝난 것으로 간주한다.
+		 * @param resultCallback (입력 번호, 분석 결과)를 인자로 받는 함수. 
+		 * 입력 번호는 reader로 읽어들인 순서를 0부터 센 값이다.
+		 * @param option 분석 옵션
+		 * @param bulkOption 동시에 처리할 입력 수, 묶음 크기, 결과 전달 순서 등을 지정한다.
+		 * @param overrideConfig 
+		 * @return 읽어들인 입력의 개수
+		 * 
+		 * @note reader와 resultCallback은 항상 이 함수를 호출한 스레드에서 실행된다.
+		 * 짧은 입력 여러 개를 하나의 작업으로 묶으면 작업 분배 비용이 줄어들고,
+		 * `bulkOption.ordered = false`로 설정하면 오래 걸리는 입력 하나 때문에 다른 결과의 전달이 지연되지 않는다.
+		 */
+		size_t analyzeBulk(size_t topN, 
+			const std::function<std::u16string()>& reader, 
+			const std::function<void(size_t, std::vector<TokenResult>&&)>& resultCallback,
+			AnalyzeOption option, 
+			const BulkAnalyzeOption& bulkOption = {},
+			const std::optional<KiwiConfig>& overrideConfig = {}
+		) const;
+
 		/**
 		 * @brief
 		 *
@@ -485,15 +504,68 @@ namespace kiwi
 		template<class LmState>
 		cmb::AutoJoiner newJoinerImpl() const;
 
+		template<class AddFn>
+		cmb::JoinedBatch joinBatchImpl(size_t size, bool lmSearch, AddFn&& addSeq) const;
+
 		/**
 		 * @brief 형태소들을 결합하여 텍스트로 복원해주는 작업을 수행하는 AutoJoiner를 반환한다.
 		 * 
 		 * @param lmSearch 결합 전에 언어 모델을 이용하여 최적의 형태소를 탐색하여 사용한다.
+		 * @param warmUpCache true인 경우 결합 캐시가 아직 채워지지 않았다면 `warmUpJoinerCache()`로 먼저 채운다.
 		 * @return 새 AutoJoiner 인스턴스
 		 * 
 		 * @sa kiwi::cmb::AutoJoiner
 		 */
-		cmb::AutoJoiner newJoiner(bool lmSearch = true) const;
+		cmb::AutoJoiner newJoiner(bool lmSearch = true, bool warmUpCache = false) const;
+
+		/**
+		 * @brief 여러 형태소 열을 스레드 풀에서 병렬로 결합하여 텍스트로 복원한다.
+		 * 
+		 * 각 형태소 열은 `newJoiner(lmSearch)`로 생성한 AutoJoiner에 차례로 삽입한 것과 동일하게 결합된다.
+		 * @param morphSeqs (형태, 품사)로 이루어진 형태소 열의 목록
+		 * @param lmSearch 결합 전에 언어 모델을 이용하여 최적의 형태소를 탐색하여 사용한다.
+		 * @param inferRegularity 입력된 품사의 불규칙 활용 여부를 자동으로 탐색한다.
+		 * @return 모든 결합 결과와 형태소 범위를 담은 JoinedBatch
+		 */
+		cmb::JoinedBatch joinBatch(
+			const std::vector<std::vector<std::pair<std::u16string, POSTag>>>& morphSeqs, 
+			bool lmSearch = true, 
+			bool inferRegularity = true
+		) const;
+
+		/**
+		 * @brief 형태소 번호로 이루어진 형태소 열들을 병렬로 결합한다.
+		 */
+		cmb::JoinedBatch joinBatch(const std::vector<std::vector<size_t>>& morphIdSeqs, bool lmSearch = true) const;
+
+		/**
+		 * @brief 하나의 배열에 이어 붙인 형태소 번호 열들을 병렬로 결합한다.
+		 * 
+		 * @param morphIds 모든 형태소 열의 형태소 번호를 이어 붙인 배열
+		 * @param seqSizes 각 형태소 열의 길이. morphIds의 길이는 seqSizes의 합과 같아야 한다.
+		 * @param size 형태소 열의 개수(seqSizes의 길이)
+		 */
+		cmb::JoinedBatch joinBatch(const uint32_t* morphIds, const uint32_t* seqSizes, size_t size, bool lmSearch = true) const;
+
+		/**
+		 * @brief Joiner가 형태소 결합 결과를 저장하는 캐시의 최대 항목 수를 설정한다. 0이면 캐시를 사용하지 않는다.
+		 * 
+		 * 같은 어간과 어미의 결합이 반복되는 경우, 캐시를 사용하면 결합 규칙을 매번 다시 적용하지 않아도 된다.
+		 * 캐시는 이 Kiwi 인스턴스에서 생성된 모든 Joiner가 공유하며, 여러 스레드에서 동시에 사용해도 안전하다.
+		 * 다른 스레드에서 결합이 진행 중일 때 호출해도 되며, 이때 캐시에 저장된 항목과 통계는 모두 비워진다.
+		 */
+		void setJoinerCacheSize(size_t capacity);
+		size_t getJoinerCacheSize() const;
+		cmb::CombineCacheStats getJoinerCacheStats() const;
+		void clearJoinerCache();
+
+		/**
+		 * @brief 사전 내의 용언 어간과 어미를 결합하여 결합 캐시를 미리 채운다.
+		 * 
+		 * @param maxEntries 결합해볼 (어간, 어미) 쌍의 최대 개수. 0이면 캐시의 용량을 사용한다.
+		 * @return 캐시에 새로 추가된 항목 수
+		 */
+		size_t warmUpJoinerCache(size_t maxEntries = 0) const;
 
 		/**
 		 * @brief `TokenInfo::typoFormId`로부터 실제 오타 형태를 복원한다.
@@ -541,6 +613,35 @@ namespace kiwi
 			return pool.get();
 		}
 
+		/**
+		* @brief 분석 과정에서 각 스레드가 보유하게 된 임시 버퍼를 해제한다.
+		* 
+		* @param retainBytes 각 스레드가 해제 후에도 유지할 임시 버퍼 크기의 상한. 0이면 모두 해제한다.
+		* @return 호출한 스레드와 스레드 풀의 각 작업 스레드에서 해제된 바이트 수의 합
+		* @note 스레드 풀의 모든 작업 스레드가 해제 작업을 하나씩 수행하도록 대기하므로,
+		* 이 Kiwi 객체의 스레드 풀에서 실행 중인 작업 안에서 호출해서는 안 된다.
+		* 스레드 풀에 속하지 않는 다른 스레드들은 다음 분석을 마치는 시점에 임시 버퍼를 해제한다.
+		*/
+		size_t trimScratch(size_t retainBytes = 0) const;
+
+		/**
+		* @brief 현재 프로세스에서 분석용 임시 버퍼가 사용하고 있는 메모리의 현황을 반환한다.
+		*/
+		static utils::ScratchStats getScratchStats()
+		{
+			return utils::getScratchStats();
+		}
+
+		/**
+		* @brief 각 스레드가 분석을 마친 뒤 유지할 수 있는 임시 버퍼 크기의 상한을 설정한다.
+		* 
+		* 상한을 넘는 경우 큰 버퍼부터 해제된다. 이 설정은 프로세스 전체의 모든 Kiwi 객체에 공통으로 적용된다.
+		*/
+		static void setScratchRetainLimit(size_t bytes)
+		{
+			utils::setScratchRetainLimit(bytes);
+		}
+
 		const KiwiConfig& getGlobalConfig() const
 		{
 			return globalConfig;
@@ -594,6 +695,7 @@ namespace kiwi
 		std::shared_ptr<lm::CoNgramModelBase> nounChrMdl;
 		std::shared_ptr<cmb::CompiledRule> combiningRule;
 		WordDetector detector;
+		std::shared_ptr<utils::ThreadPool> threadPool;
 		Map<int, int> ruleProfilingCnt;
 
 		size_t numThreads = 0;
@@ -621,6 +723,8 @@ namespace kiwi
 			bool compressLm = true;
 			float dropoutSampling = 0.05f;
 			float dropoutProb = 0.15f;
+			size_t lmCountChunkSize = 0;
+			std::string lmCountTempDir;
 		};
 
 		/**
@@ -652,7 +756,8 @@ namespace kiwi
 		void _addCorpusTo(RaggedVector<VocabTy>& out, std::istream& is, MorphemeMap& morphMap, 
 			double splitRatio, RaggedVector<VocabTy>* splitOut,
 			UnorderedMap<std::pair<KString, POSTag>, size_t>* oovDict = nullptr,
-			const UnorderedMap<std::pair<KString, POSTag>, Vector<std::pair<KString, POSTag>>>* transform = nullptr) const;
+			const UnorderedMap<std::pair<KString, POSTag>, Vector<std::pair<KString, POSTag>>>* transform = nullptr,
+			size_t maxDataSize = -1) const;
 
 		void addCorpusTo(RaggedVector<uint8_t>& out, std::istream& is, MorphemeMap& morphMap, 
 			double splitRatio = 0, RaggedVector<uint8_t>* splitOut = nullptr,
@@ -670,6 +775,14 @@ namespace kiwi
 			double splitRatio = 0, RaggedVector<int32_t>* splitOut = nullptr,
 			UnorderedMap<std::pair<KString, POSTag>, size_t>* oovDict = nullptr,
 			const UnorderedMap<std::pair<KString, POSTag>, Vector<std::pair<KString, POSTag>>>* transform = nullptr) const;
+
+		const KiwiBuilder* prepareHSDataset(HSDataset& dataset, const HSDatasetOption& option, bool separateDefaultMorpheme,
+			const std::string& morphemeDefPath, size_t morphemeDefMinCnt, MorphemeMap& realMorph, size_t& maxTokenId) const;
+		void buildHSDatasetVocab(HSDataset& dataset, const KiwiBuilder* srcBuilder, size_t tokenSize, size_t maxTokenId,
+			const std::function<bool(const std::u16string&, POSTag)>& tokenFilter,
+			const std::function<bool(const std::u16string&, POSTag)>& windowFilter,
+			const std::vector<std::pair<size_t, std::vector<uint32_t>>>& contextualMapper) const;
+
 		void updateForms();
 		void updateMorphemes(size_t vocabSize = 0);
 
@@ -713,12 +826,26 @@ namespace kiwi
 			Map<int, int>* ruleProfilingCnt = nullptr
 		) const;
 
+		/**
+		 * @brief leftId, rightId 형태소를 ruleId 규칙으로 결합한 결과를 out에 추가한다.
+		 * 형태소 목록을 읽기만 하므로 여러 스레드에서 동시에 호출할 수 있다.
+		 */
+		void combineMorphemes(
+			Vector<cmb::Result>& out,
+			const Vector<FormRaw>& newForms,
+			const Vector<MorphemeRaw>& newMorphemes,
+			size_t leftId,
+			size_t rightId,
+			size_t ruleId
+		) const;
+
 		void buildCombinedMorphemes(
 			Vector<FormRaw>& newForms,
 			UnorderedMap<KString, size_t>& newFormMap,
 			Vector<MorphemeRaw>& newMorphemes,
 			UnorderedMap<size_t, Vector<uint32_t>>& newFormCands,
-			Map<int, int>* ruleProfilingCnt = nullptr
+			Map<int, int>* ruleProfilingCnt = nullptr,
+			utils::ThreadPool* pool = nullptr
 		) const;
 
 		void addAllomorphsToRule();
@@ -932,6 +1059,27 @@ namespace kiwi
 			size_t minCnt = 10, size_t maxWordLen = 10, float minScore = 0.25, float posThreshold = -3, bool lmFilter = true
 		);
 
+		/**
+		 * @brief 생성될 Kiwi 객체와 단어 추출이 함께 사용할 스레드풀을 지정한다.
+		 * 
+		 * @param pool nullptr이 아니면 numThreads 대신 이 스레드풀을 사용한다. 
+		 *             응용 프로그램의 다른 작업과 하나의 스레드풀을 공유하여 전체 스레드 개수를 제한할 때 사용한다.
+		 *             nullptr이면 build() 시마다 numThreads개의 스레드를 갖는 스레드풀을 새로 생성한다.
+		 */
+		void setThreadPool(std::shared_ptr<utils::ThreadPool> pool)
+		{
+			threadPool = pool;
+			detector.setThreadPool(std::move(pool));
+		}
+
+		/**
+		 * @brief 단어 추출에 사용되는 WordDetector를 반환한다. `StreamingWordDetector`를 생성할 때 사용할 수 있다.
+		 */
+		const WordDetector& getWordDetector() const
+		{
+			return detector;
+		}
+
 		/**
 		 * @brief 현재 단어 및 사전 설정을 기반으로 Kiwi 객체를 생성한다.
 		 *
@@ -971,6 +1119,28 @@ namespace kiwi
 			const std::vector<std::pair<std::pair<std::string, POSTag>, std::vector<std::pair<std::string, POSTag>>>>* transform = nullptr
 		) const;
 
+		/**
+		 * @brief convertHSData로 변환된 파일들을 메모리 맵으로 열어 HSDataset을 생성한다.
+		 * 
+		 * 말뭉치를 다시 읽거나 복사하지 않고 변환된 파일을 그대로 참조하므로,
+		 * 한 머신에서 여러 프로세스가 같은 파일을 열 경우 말뭉치가 차지하는 메모리를 공유할 수 있다.
+		 * HSDataset::setShard와 함께 사용하면 각 프로세스가 서로 겹치지 않는 문장들을 순회하도록 할 수 있다.
+		 * 변환 시 적용된 transform은 그대로 유지되며, 학습/검증 데이터 분할은 convertHSData 단계에서 별도 파일로 수행해야 한다.
+		 * 
+		 * @param convertedPathes convertHSData로 생성된 파일들의 경로. OOV 사전은 이 중 하나의 파일에만 포함될 수 있다.
+		 * @note 나머지 인자는 makeHSDataset과 동일하다.
+		 */
+		HSDataset makeMappedHSDataset(const std::vector<std::string>& convertedPathes,
+			size_t batchSize, size_t causalContextSize, size_t windowSize, size_t numWorkers,
+			HSDatasetOption option = {},
+			const TokenFilter& tokenFilter = {},
+			const TokenFilter& windowFilter = {},
+			bool separateDefaultMorpheme = false,
+			const std::string& morphemeDefPath = {},
+			size_t morphemeDefMinCnt = 0,
+			const std::vector<std::pair<size_t, std::vector<uint32_t>>>& contextualMapper = {}
+		) const;
+
 		BuildOption getOptions() const { return options; }
 		ModelType getModelType() const { return modelType; }
 
@@ -37,6 +37,8 @@ namespace kiwi
 			virtual std::vector<float> allNextLL(ptrdiff_t node_idx) const = 0;
 			virtual std::vector<float> allNextLL(ptrdiff_t node_idx, std::vector<ptrdiff_t>& next_node_idx) const = 0;
 			virtual void nextTopN(ptrdiff_t node_idx, size_t top_n, uint32_t* idx_out, float* ll_out) const = 0;
+			virtual void _evaluateBatch(const uint32_t* tokens, const size_t* seq_offsets, size_t num_seqs, 
+				float min_score, float* sent_ll_out, float* token_ll_out) const = 0;
 
 		public:
 
@@ -108,6 +110,25 @@ namespace kiwi
 				return ret;
 			}
 
+			/**
+			 * @brief 여러 개의 토큰 시퀀스를 한 번에 평가한다.
+			 * 
+			 * @param tokens 모든 시퀀스의 토큰을 이어 붙인 배열
+			 * @param seq_offsets 크기가 num_seqs + 1인 배열. i번째 시퀀스는 tokens[seq_offsets[i], seq_offsets[i + 1]) 구간이다.
+			 * @param num_seqs 시퀀스의 개수
+			 * @param sent_ll_out 크기가 num_seqs인 배열. 각 시퀀스의 로그 우도 합이 `sum()`과 동일하게 기록된다. nullptr일 수 있다.
+			 * @param token_ll_out tokens와 같은 위치에 각 토큰의 로그 우도가 `evaluate()`와 동일하게 기록된다. nullptr일 수 있다.
+			 * @param min_score 시퀀스 합을 구할 때 토큰별 점수의 하한
+			 * 
+			 * @note 서로 독립적인 여러 시퀀스의 탐색을 번갈아 진행하므로 
+			 * 시퀀스마다 `evaluate()`를 호출하는 것보다 메모리 지연을 더 잘 숨길 수 있다.
+			 */
+			void evaluateBatch(const uint32_t* tokens, const size_t* seq_offsets, size_t num_seqs, 
+				float* sent_ll_out, float* token_ll_out = nullptr, float min_score = -100) const
+			{
+				return _evaluateBatch(tokens, seq_offsets, num_seqs, min_score, sent_ll_out, token_ll_out);
+			}
+
 			template<class InTy>
 			std::vector<float> getNextLL(InTy in_first, InTy in_last) const
 			{
@@ -0,0 +1,178 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <algorithm>
+#include <atomic>
+#include <vector>
+#include <utility>
+#include <type_traits>
+
+namespace kiwi
+{
+	namespace utils
+	{
+		/**
+		 * @brief 스레드별 임시 버퍼(scratch)의 메모리 사용 현황
+		 */
+		struct ScratchStats
+		{
+			size_t retainedBytes = 0; /**< 각 스레드가 마지막 작업을 마친 뒤 보유하고 있는 임시 버퍼 크기의 합 */
+			size_t peakBytes = 0; /**< 한 스레드가 지금까지 보유했던 임시 버퍼 크기의 최댓값 */
+			size_t numThreads = 0; /**< 임시 버퍼를 보유하고 있는 스레드의 개수 */
+			size_t numTrims = 0; /**< 임시 버퍼가 해제된 횟수 */
+		};
+
+		namespace detail
+		{
+			template<class T, class = void>
+			struct HasScratchBytes : std::false_type {};
+
+			template<class T>
+			struct HasScratchBytes<T, std::void_t<decltype(std::declval<const T&>().scratchBytes())>> : std::true_type {};
+
+			template<class T, class = void>
+			struct HasBucketCount : std::false_type {};
+
+			template<class T>
+			struct HasBucketCount<T, std::void_t<decltype(std::declval<const T&>().bucket_count()), typename T::value_type>> : std::true_type {};
+
+			template<class T, class = void>
+			struct HasCapacity : std::false_type {};
+
+			template<class T>
+			struct HasCapacity<T, std::void_t<decltype(std::declval<const T&>().capacity()), typename T::value_type>> : std::true_type {};
+		}
+
+		/**
+		 * @brief 임시 버퍼가 점유하고 있는 메모리의 크기를 추정한다.
+		 * `scratchBytes()` 멤버가 있으면 이를 사용하고, 없으면 해시 컨테이너와 연속 컨테이너에 대해 근사값을 계산한다.
+		 */
+		template<class T>
+		size_t estimateScratchBytes(const T& obj)
+		{
+			if constexpr (detail::HasScratchBytes<T>::value)
+			{
+				return obj.scratchBytes();
+			}
+			else if constexpr (detail::HasBucketCount<T>::value)
+			{
+				// 기본 생성된 객체가 갖는 만큼은 해제할 수 없으므로 제외한다.
+				static const size_t baseBuckets = T{}.bucket_count();
+				return (obj.bucket_count() - std::min(obj.bucket_count(), baseBuckets)) * sizeof(void*) 
+					+ obj.size() * (sizeof(typename T::value_type) + sizeof(void*) * 2);
+			}
+			else if constexpr (detail::HasCapacity<T>::value)
+			{
+				static const size_t baseCapacity = T{}.capacity();
+				return (obj.capacity() - std::min(obj.capacity(), baseCapacity)) * sizeof(typename T::value_type);
+			}
+			else
+			{
+				return 0;
+			}
+		}
+
+		/**
+		 * @brief 현재 스레드에 속한 임시 버퍼들의 목록.
+		 *
+		 * 각 스레드는 최상위 작업(예: 문장 하나의 분석)이 끝날 때마다 `checkpoint()`를 호출한다.
+		 * 이 때 보유 중인 임시 버퍼의 크기가 상한(`setScratchRetainLimit`)을 넘거나,
+		 * 다른 스레드에서 `requestScratchTrim()`으로 해제를 요청한 경우 버퍼를 해제한다.
+		 * 버퍼는 사용 중이 아닐 때에만 해제되어야 하므로 `checkpoint()`와 `trim()`은 소유 스레드에서만 호출해야 한다.
+		 */
+		class ScratchRegistry
+		{
+			struct Entry
+			{
+				void* obj;
+				size_t(*bytes)(const void*);
+				void(*release)(void*);
+			};
+
+			std::vector<Entry> entries;
+			std::atomic<size_t> retainedBytes{ 0 }, peakBytes{ 0 };
+			size_t trimEpoch = 0;
+
+			ScratchRegistry();
+		public:
+			~ScratchRegistry();
+			ScratchRegistry(const ScratchRegistry&) = delete;
+			ScratchRegistry& operator=(const ScratchRegistry&) = delete;
+
+			static ScratchRegistry& local();
+
+			void add(void* obj, size_t(*bytes)(const void*), void(*release)(void*));
+			void remove(void* obj);
+
+			size_t bytes() const;
+
+			/**
+			 * @brief 보유 중인 임시 버퍼의 크기가 retainBytes 이하가 될 때까지 큰 버퍼부터 해제한다.
+			 * @return 해제된 바이트 수
+			 */
+			size_t trim(size_t retainBytes = 0);
+
+			/**
+			 * @brief 최상위 작업이 끝난 시점에 호출되어 해제 정책을 적용하고 사용 현황을 갱신한다.
+			 * @return 해제된 바이트 수
+			 */
+			size_t checkpoint();
+
+			friend ScratchStats getScratchStats();
+		};
+
+		/**
+		 * @brief 스레드별 임시 버퍼를 감싸 ScratchRegistry에 등록하는 래퍼.
+		 * `thread_local Scratch<Vector<float>> buf;`와 같이 기존 `thread_local` 버퍼를 대체하여 사용한다.
+		 */
+		template<class T>
+		class Scratch : public T
+		{
+			static size_t bytesOf(const void* p)
+			{
+				return estimateScratchBytes(*static_cast<const T*>(static_cast<const Scratch*>(p)));
+			}
+
+			static void releaseOf(void* p)
+			{
+				// 대입만으로는 std::basic_string 등이 기존 버퍼를 유지할 수 있으므로 교환 후 파괴한다.
+				T empty{};
+				std::swap(static_cast<T&>(*static_cast<Scratch*>(p)), empty);
+			}
+
+		public:
+			Scratch()
+			{
+				ScratchRegistry::local().add(this, &bytesOf, &releaseOf);
+			}
+
+			~Scratch()
+			{
+				ScratchRegistry::local().remove(this);
+			}
+
+			Scratch(const Scratch&) = delete;
+			Scratch& operator=(const Scratch&) = delete;
+
+			using T::operator=;
+		};
+
+		/**
+		 * @brief 각 스레드가 작업을 마친 뒤 보유할 수 있는 임시 버퍼 크기의 상한을 설정한다. 기본값은 무제한이다.
+		 */
+		void setScratchRetainLimit(size_t bytes);
+
+		size_t getScratchRetainLimit();
+
+		/**
+		 * @brief 모든 스레드에 임시 버퍼 해제를 요청한다. 각 스레드는 다음 `checkpoint()` 시점에 버퍼를 해제한다.
+		 */
+		void requestScratchTrim();
+
+		/**
+		 * @brief 현재 프로세스의 임시 버퍼 사용 현황을 반환한다.
+		 */
+		ScratchStats getScratchStats();
+	}
+}
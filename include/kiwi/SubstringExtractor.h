@@ -8,6 +8,11 @@
 
 namespace kiwi
 {
+	namespace utils
+	{
+		class ThreadPool;
+	}
+
 	std::vector<std::pair<std::u16string, size_t>> extractSubstrings(
 		const char16_t* first, 
 		const char16_t* last, 
@@ -15,7 +20,8 @@ namespace kiwi
 		size_t minLength = 2, 
 		size_t maxLength = 32,
 		bool longestOnly = true,
-		char16_t stopChr = 0);
+		char16_t stopChr = 0,
+		utils::ThreadPool* pool = nullptr);
 
 
 	class PrefixCounter
@@ -26,17 +32,26 @@ namespace kiwi
 		Vector<uint16_t> buf;
 		Vector<size_t> tokenClusters;
 		Vector<size_t> tokenCnts;
-		std::shared_ptr<void> threadPool;
+		std::shared_ptr<utils::ThreadPool> threadPool;
 
 		template<class It>
 		void _addArray(It first, It last);
 
+		void setClusters(const std::vector<std::vector<size_t>>& clusters);
+
 		Vector<std::pair<uint32_t, float>> computeClusterScore() const;
 
 	public:
 		PrefixCounter(size_t _prefixSize, size_t _minCf, size_t _numWorkers,
 			const std::vector<std::vector<size_t>>& clusters = {}
 			);
+
+		/**
+		 * @brief 스레드를 새로 생성하지 않고 주어진 스레드풀을 사용하는 PrefixCounter를 생성한다.
+		 */
+		PrefixCounter(size_t _prefixSize, size_t _minCf, std::shared_ptr<utils::ThreadPool> _pool,
+			const std::vector<std::vector<size_t>>& clusters = {}
+			);
 		void addArray(const uint16_t* first, const uint16_t* last);
 		void addArray(const uint32_t* first, const uint32_t* last);
 		void addArray(const int32_t* first, const int32_t* last);
@@ -79,6 +94,8 @@ namespace kiwi
 		Vector<std::u16string> rawDocs;
 
 		size_t addTokens(const std::vector<TokenInfo>& tokens);
+		void appendToken(size_t id, int16_t score, uint32_t position);
+		void endDocument(uint32_t endPosition);
 
 	public:
 		struct Candidate
@@ -104,8 +121,21 @@ namespace kiwi
 		~NgramExtractor();
 
 		size_t addText(const std::u16string& text);
+
+		/**
+		 * @brief reader가 빈 문자열을 반환할 때까지 입력을 읽어 분석한 뒤 추가한다.
+		 * Kiwi 인스턴스에 스레드풀이 있으면 분석과 토큰 변환을 입력 묶음별로 병렬 수행한 뒤 입력 순서대로 병합하므로,
+		 * 문서가 추가되는 순서는 스레드풀이 없을 때와 같다.
+		 * 
+		 * @return 추가된 토큰의 개수
+		 */
 		size_t addTexts(const U16Reader& reader);
 
-		std::vector<Candidate> extract(size_t maxCandidates = 1000, size_t minCnt = 10, size_t maxLength = 5, float minScore = 1e-3, size_t numWorkers = 1) const;
+		/**
+		 * @brief 추가된 문서들로부터 n-gram 후보를 추출한다.
+		 * 
+		 * @param numWorkers 접미사 배열, FM-index 생성 및 후보 점수 계산에 사용할 스레드 개수. 0이면 스레드를 새로 만들지 않고 Kiwi 인스턴스의 스레드풀을 함께 사용한다.
+		 */
+		std::vector<Candidate> extract(size_t maxCandidates = 1000, size_t minCnt = 10, size_t maxLength = 5, float minScore = 1e-3, size_t numWorkers = 0) const;
 	};
 }
@@ -16,6 +16,7 @@
 #include "FrozenTrie.h"
 #include "Utils.h"
 #include "Trie.hpp"
+#include "Joiner.h"
 
 namespace kiwi
 {
@@ -97,6 +98,35 @@ namespace kiwi
 		bool reduceStrict = false;
 		bool removeRepetitive = true;
 		bool preventMixedDigitTokens = true;
+		size_t maxWordMapSize = 0; /**< 수집하는 단어 종류의 상한. 이를 넘어서면 빈도가 낮은 단어부터 버려 상한의 절반으로 줄인다. 0이면 제한하지 않는다. */
+	};
+
+	/**
+	 * @brief SwTokenizer::encodeBatch가 결과를 [batch, maxLength] 모양의 버퍼에 기록하는 방식을 설정한다.
+	 */
+	struct SwBatchEncodeOption
+	{
+		size_t maxLength = 0; /**< 출력 버퍼에서 한 행의 길이 */
+		int64_t padId = -1; /**< 남는 칸을 채울 토큰 id. 음수이면 `[PAD]` 토큰의 id를 사용하고, `[PAD]` 토큰이 없으면 0을 사용한다. */
+		bool truncation = true; /**< true이면 maxLength보다 긴 결과를 잘라내고, false이면 예외를 발생시킨다. */
+		bool padLeft = false; /**< true이면 토큰을 행의 오른쪽에 붙이고 왼쪽을 패딩으로 채운다. */
+		bool offsetInChrLevel = false; /**< true이면 offset을 바이트 단위 대신 글자 단위로 기록한다. */
+
+		SwBatchEncodeOption(size_t _maxLength = 0, bool _truncation = true, bool _padLeft = false, int64_t _padId = -1)
+			: maxLength{ _maxLength }, padId{ _padId }, truncation{ _truncation }, padLeft{ _padLeft }
+		{
+		}
+	};
+
+	/**
+	 * @brief SwTokenizer의 subword 캐시 사용 현황
+	 */
+	struct SwSubwordCacheStats
+	{
+		size_t capacity = 0; /**< 캐시에 저장할 수 있는 최대 항목 수 */
+		size_t size = 0; /**< 현재 캐시에 저장된 항목 수 */
+		size_t hits = 0; /**< 캐시에서 결과를 찾은 횟수 */
+		size_t misses = 0; /**< 캐시에서 결과를 찾지 못해 새로 계산한 횟수 */
 	};
 
 	class SwTokenizer;
@@ -159,6 +189,24 @@ namespace kiwi
 			Vector<uint32_t> boundaries;
 		};
 
+		class SubwordCache;
+
+		/**
+		 * @brief SubwordCache를 소유하는 래퍼. 
+		 * SwTokenizer가 복사될 때 캐시의 내용은 복사하지 않고 용량 설정만 복사한다.
+		 */
+		struct SubwordCacheHolder
+		{
+			std::unique_ptr<SubwordCache> cache;
+
+			SubwordCacheHolder();
+			SubwordCacheHolder(const SubwordCacheHolder&);
+			SubwordCacheHolder(SubwordCacheHolder&&) noexcept;
+			~SubwordCacheHolder();
+			SubwordCacheHolder& operator=(const SubwordCacheHolder&);
+			SubwordCacheHolder& operator=(SubwordCacheHolder&&) noexcept;
+		};
+
 		friend class SwTokenizerBuilder;
 		void* dfTokenizeSubword = nullptr;
 		void* dfTokenizeSubwordWithOffset = nullptr;
@@ -174,6 +222,15 @@ namespace kiwi
 		Vector<uint32_t> byteFallbackChrs;
 		std::array<size_t, SwTokenizerConfig::glue + 1> specialTokenIds = { { 0, } };
 		UnorderedMap<uint32_t, SplittedWord> splitCands;
+		SubwordCacheHolder subwordCache;
+
+		bool tokenizeSubwordUncached(
+			U16StringView str,
+			bool spacePrefix,
+			std::vector<uint32_t>& out,
+			std::vector<std::pair<uint32_t, uint32_t>>* offset = nullptr,
+			uint32_t offsetBias = 0
+		) const;
 
 		bool tokenizeSubword(
 			U16StringView str,
@@ -186,10 +243,52 @@ namespace kiwi
 		template<class TokenIt>
 		void encode(std::vector<uint32_t>& out, TokenIt first, TokenIt last, std::vector<std::pair<uint32_t, uint32_t>>* offset = nullptr) const;
 
+		void addToJoiner(cmb::AutoJoiner& joiner, std::string& pendingBytes, uint32_t id, bool ignoreErrors) const;
+		void flushBytesToJoiner(cmb::AutoJoiner& joiner, std::string& pendingBytes, bool ignoreErrors) const;
+
 		template<class It>
 		std::string decode(It first, It last, bool ignoreErrors = true) const;
 
+		template<class IntTy>
+		size_t encodeBatchImpl(const std::string* strs, size_t size, const SwBatchEncodeOption& option,
+			IntTy* tokenIds, IntTy* attentionMask, IntTy* offsets, IntTy* lengths) const;
+
 	public:
+		/**
+		 * @brief 토큰 id를 하나씩 입력받아 결과가 확정된 부분만 조금씩 돌려주는 디코더.
+		 * 
+		 * 형태소가 결합된 형태는 뒤따르는 형태소에 따라 달라질 수 있으므로, 결합이 끝나지 않은 부분은 보류했다가 확정되는 시점에 반환한다.
+		 * 반환된 문자열을 모두 이어붙이면 같은 id 열에 대해 `SwTokenizer::decode`를 호출한 결과와 같다.
+		 * 토큰을 하나씩 생성하면서 출력하는 경우 매번 전체를 다시 디코딩하지 않아도 된다.
+		 */
+		class Decoder
+		{
+			friend class SwTokenizer;
+			const SwTokenizer* tokenizer = nullptr;
+			cmb::AutoJoiner joiner;
+			std::string pendingBytes;
+			bool ignoreErrors = true;
+
+			Decoder(const SwTokenizer& tokenizer, cmb::AutoJoiner&& joiner, bool ignoreErrors);
+		public:
+			Decoder(const Decoder&);
+			Decoder(Decoder&&);
+			~Decoder();
+			Decoder& operator=(const Decoder&);
+			Decoder& operator=(Decoder&&);
+
+			/**
+			 * @brief id를 추가하고 새로 확정된 부분을 UTF-8 문자열로 반환한다.
+			 */
+			std::string add(uint32_t id);
+			std::string add(const uint32_t* ids, size_t length);
+
+			/**
+			 * @brief 보류 중인 부분을 모두 반환하고 디코더를 처음 상태로 되돌린다.
+			 */
+			std::string finish();
+		};
+
 		SwTokenizer(ArchType arch = ArchType::default_);
 		SwTokenizer(const SwTokenizer&);
 		SwTokenizer(SwTokenizer&&);
@@ -204,7 +303,26 @@ namespace kiwi
 		const Kiwi* getKiwi() const { return kiwi; }
 		
 		bool getWholeWordUnk() const { return config.wholeWordUnk; }
-		void setWholeWordUnk(bool v) { config.wholeWordUnk = v; }
+		void setWholeWordUnk(bool v);
+
+		/**
+		 * @brief 어절 조각을 subword로 분할한 결과를 저장하는 캐시의 최대 항목 수를 설정한다. 0이면 캐시를 사용하지 않는다.
+		 * 
+		 * 실제 말뭉치에서 같은 어절 조각이 매우 자주 반복되므로, 캐시를 사용하면 매번 subword 분할을 다시 계산하지 않아도 된다.
+		 * 설정을 바꾸면 기존에 저장된 항목은 모두 삭제된다. 캐시는 여러 스레드에서 동시에 사용해도 안전하다.
+		 */
+		void setSubwordCacheSize(size_t capacity);
+		size_t getSubwordCacheSize() const;
+		SwSubwordCacheStats getSubwordCacheStats() const;
+		void clearSubwordCache();
+
+		/**
+		 * @brief 단어 빈도 목록을 이용해 캐시를 미리 채운다.
+		 * 
+		 * 빈도가 높은 단어부터 토큰화하여 캐시가 가득 찰 때까지 결과를 저장한다.
+		 * @return 캐시에 새로 추가된 항목 수
+		 */
+		size_t warmUpSubwordCache(const std::vector<std::pair<std::string, size_t>>& wordFreqs);
 
 		void encode(std::vector<uint32_t>& out, const std::string& str, std::vector<std::pair<uint32_t, uint32_t>>* offset = nullptr, bool offsetInChrLevel = false) const;
 		std::vector<uint32_t> encode(const std::string& str, std::vector<std::pair<uint32_t, uint32_t>>* offset = nullptr, bool offsetInChrLevel = false) const;
@@ -224,15 +342,66 @@ namespace kiwi
 		std::string decode(const std::vector<uint32_t>& ids, bool ignoreErrors = true) const;
 		std::string decode(const uint32_t* ids, size_t length, bool ignoreErrors = true) const;
 
+		/**
+		 * @brief 토큰 id를 하나씩 디코딩하는 Decoder를 생성한다. Decoder는 이 SwTokenizer보다 먼저 해제되어야 한다.
+		 */
+		Decoder newDecoder(bool ignoreErrors = true) const;
+
 		std::future<std::vector<uint32_t>> asyncEncode(const std::string& str) const;
 		std::future<std::pair<std::vector<uint32_t>, std::vector<std::pair<uint32_t, uint32_t>>>> asyncEncodeOffset(const std::string& str, bool offsetInChrLevel = false) const;
 
+		/**
+		 * @brief 여러 문자열을 Kiwi의 스레드 풀에서 병렬로 토큰화하여 호출자가 제공한 연속된 버퍼에 바로 기록한다.
+		 * 
+		 * @param strs 토큰화할 문자열의 배열
+		 * @param size strs의 길이(batch 크기)
+		 * @param option 행의 길이, 잘라내기 및 패딩 방식. SwBatchEncodeOption 참고.
+		 * @param tokenIds [size, option.maxLength] 크기의 버퍼. 토큰 id가 기록되고 남는 칸은 패딩 id로 채워진다.
+		 * @param attentionMask [size, option.maxLength] 크기의 버퍼. 토큰이 있는 칸은 1, 패딩 칸은 0으로 채워진다. 필요없는 경우 null.
+		 * @param offsets [size, option.maxLength, 2] 크기의 버퍼. 각 토큰의 시작 및 끝 위치가 기록된다. 필요없는 경우 null.
+		 * @param lengths [size] 크기의 버퍼. 각 행에 기록된 토큰의 개수가 기록된다. 필요없는 경우 null.
+		 * @return 잘라내기 전 가장 긴 행의 토큰 개수
+		 */
+		size_t encodeBatch(const std::string* strs, size_t size, const SwBatchEncodeOption& option,
+			int32_t* tokenIds, int32_t* attentionMask = nullptr, int32_t* offsets = nullptr, int32_t* lengths = nullptr) const;
+		size_t encodeBatch(const std::string* strs, size_t size, const SwBatchEncodeOption& option,
+			int64_t* tokenIds, int64_t* attentionMask = nullptr, int64_t* offsets = nullptr, int64_t* lengths = nullptr) const;
+
 		const SwTokenizerConfig& getConfig() const { return config; }
 		const std::string& getSpecialToken(SwTokenizerConfig::SpecialToken token) const { return config.specialTokens[token]; }
 		size_t getSpecialTokenId(SwTokenizerConfig::SpecialToken token) const { return specialTokenIds[token]; }
 
 		std::ostream& save(std::ostream& ostr) const;
 		static SwTokenizer load(const Kiwi& kiwi, std::istream& istr);
+
+		/**
+		 * @brief 토크나이저를 바이너리 형식으로 저장한다.
+		 * 
+		 * json 형식과 달리 trie와 형태소 대응표처럼 build 과정에서 계산되는 값들을 그대로 저장하므로 훨씬 빠르게 읽어들일 수 있다.
+		 * 저장된 파일은 형태소 목록이 동일한 Kiwi에서만 읽어들일 수 있으며, 다른 도구와 토크나이저를 주고받을 때에는 json 형식(save)을 사용해야 한다.
+		 */
+		std::ostream& saveBinary(std::ostream& ostr) const;
+
+		/**
+		 * @brief saveBinary로 저장된 토크나이저를 읽어들인다.
+		 * 
+		 * 저장 당시의 Kiwi와 형태소 목록이 다른 경우 SwTokenizerException을 발생시킨다.
+		 */
+		static SwTokenizer loadBinary(const Kiwi& kiwi, std::istream& istr);
+
+		/**
+		 * @brief saveBinary로 저장된 파일을 메모리에 매핑하여 읽어들인다.
+		 * 
+		 * 파일 스트림의 버퍼를 거치지 않고 매핑된 메모리에서 바로 복사하므로 큰 어휘 집합을 더 빠르게 읽어들일 수 있다.
+		 */
+		static SwTokenizer loadBinary(const Kiwi& kiwi, const std::string& path);
+
+		/**
+		 * @brief 스트림의 현재 위치에 saveBinary로 저장된 데이터가 있는지 확인한다. 스트림의 위치는 변경되지 않는다.
+		 * 
+		 * 되감을 수 없는 스트림에서도 첫 바이트만 엿보므로 사용할 수 있다.
+		 */
+		static bool isBinaryFormat(std::istream& istr);
 	};
 
 	class UnigramSwTrainer
@@ -266,7 +435,7 @@ namespace kiwi
 		Vector<size_t> wordCnts;
 		UnorderedMap<size_t, WordCand> wordSuffix;
 		UnorderedMap<std::pair<KString, POSTag>, const Morpheme*> reprMorphMap;
-		HiddenMember<RaggedVector<int32_t>, sizeof(Vector<size_t>) * 2> sents;
+		Vector<size_t> morphCnts;
 		Vector<size_t> tokenFreqs;
 
 		Vector<std::u16string> chrPrefix;
@@ -278,6 +447,8 @@ namespace kiwi
 		Vector<PrefixAvailability> prefixAvailable;
 
 		void addWord(const std::u16string& s, const Vector<const Morpheme*>& morphs, const Vector<size_t>& boundaries, bool spacePrefix);
+		void addMorph(size_t morphId);
+		size_t pruneWords();
 
 		template<class Feeder>
 		size_t _addSentences(Feeder&& feeder);
@@ -312,6 +483,11 @@ namespace kiwi
 
 		size_t getCurrentVocabSize() const { return currentVocabSize + config.numSpecialTokens(); }
 
+		/**
+		 * @brief 지금까지 수집한 단어의 종류 수를 반환한다. `maxWordMapSize`가 설정된 경우 이 값을 넘지 않는다.
+		 */
+		size_t getNumWords() const { return wordMap.size(); }
+
 		std::ostream& writeVocabs(std::ostream& os) const;
 		
 		SwTokenizer build() const;
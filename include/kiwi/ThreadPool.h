@@ -7,6 +7,7 @@ modified by bab2min to have additional parameter threadId
 
 #include <vector>
 #include <queue>
+#include <algorithm>
 #include <memory>
 #include <thread>
 #include <mutex>
@@ -19,6 +20,55 @@ namespace kiwi
 {
 	namespace utils
 	{
+		/**
+		 * @brief `ThreadPool::runParallel`로 함께 실행되는 작업들이 서로를 기다릴 때 사용하는 장벽
+		 */
+		class Barrier
+		{
+		public:
+			explicit Barrier(std::mutex* _mutex, std::condition_variable* _cond, size_t _count) :
+				mutex(_mutex),
+				cond(_cond),
+				threshold(_count),
+				count(_count),
+				generation(0)
+			{
+			}
+
+			void wait()
+			{
+				std::unique_lock<std::mutex> lLock{ *mutex };
+				auto gen = generation;
+				if (!--count)
+				{
+					generation++;
+					count = threshold;
+					cond->notify_all();
+				}
+				else
+				{
+					cond->wait(lLock, [this, gen] { return gen != generation; });
+				}
+			}
+
+		private:
+			std::mutex* mutex;
+			std::condition_variable* cond;
+			std::size_t threshold;
+			std::size_t count;
+			std::size_t generation;
+		};
+
+		/**
+		 * @brief 라이브러리 전체에서 공유하는 스레드풀.
+		 * 
+		 * `enqueue`로 넣은 작업은 공유 큐에서 쉬고 있는 아무 스레드가 가져가 실행하고,
+		 * `runParallel`로 넣은 작업들은 0번 스레드부터 하나씩 배정되어 동시에 실행되므로 Barrier로 서로 동기화할 수 있다.
+		 * 형태소 분석, 접미사 배열 및 FM-index 생성, 단어 추출 등은 모두 이 스레드풀을 인자로 받으므로
+		 * 응용 프로그램에서 하나의 인스턴스를 만들어 공유하면 전체 스레드 개수를 제어할 수 있다.
+		 * 
+		 * @note 이 스레드풀의 작업 안에서 다시 `runParallel`을 호출하면 현재 스레드에서 단일 작업으로 실행된다.
+		 */
 		class ThreadPool
 		{
 		public:
@@ -29,15 +79,36 @@ namespace kiwi
 			auto enqueue(F&& f, Args&&... args)
 				->std::future<typename std::invoke_result<F, size_t, Args...>::type>;
 
+			/**
+			 * @brief f(workerId, numWorkers, barrier)를 서로 다른 스레드 numWorkers개에서 동시에 실행한다.
+			 * numWorkers는 스레드 개수를 넘을 수 없으며, 반환된 future들은 workerId 순서로 정렬되어 있다.
+			 */
+			template<class F>
+			auto runParallel(size_t numWorkers, F&& f)
+				->std::vector<std::future<typename std::invoke_result<F, size_t, size_t, Barrier*>::type>>;
+
 			size_t size() const { return workers.size(); }
 			size_t numEnqueued() const { return tasks.size(); }
+
+			/**
+			 * @brief 현재 스레드가 이 스레드풀의 작업 스레드인지 확인한다.
+			 */
+			bool isWorkerThread() const { return currentPool() == this; }
+
 			void joinAll();
 		private:
+			static const ThreadPool*& currentPool()
+			{
+				thread_local const ThreadPool* pool = nullptr;
+				return pool;
+			}
+
 			std::vector<std::thread> workers;
 			std::queue<std::function<void(size_t)>> tasks;
+			std::vector<std::queue<std::function<void(size_t)>>> pinnedTasks;
 
-			std::mutex queue_mutex;
-			std::condition_variable condition, inputCnd;
+			std::mutex queue_mutex, barrier_mutex;
+			std::condition_variable condition, inputCnd, barrier_condition;
 			bool stop;
 			size_t maxQueued;
 		};
@@ -45,20 +116,31 @@ namespace kiwi
 		inline ThreadPool::ThreadPool(size_t threads, size_t _maxQueued)
 			: stop(false), maxQueued(_maxQueued)
 		{
+			pinnedTasks.resize(threads);
 			for (size_t i = 0; i < threads; ++i)
 				workers.emplace_back([this, i]
 			{
+				currentPool() = this;
 				for (;;)
 				{
 					std::function<void(size_t)> task;
 					{
 						std::unique_lock<std::mutex> lock(this->queue_mutex);
 						this->condition.wait(lock,
-							[this] { return this->stop || !this->tasks.empty(); });
-						if (this->stop && this->tasks.empty()) return;
-						task = std::move(this->tasks.front());
-						this->tasks.pop();
-						if (this->maxQueued) this->inputCnd.notify_all();
+							[this, i] { return this->stop || !this->pinnedTasks[i].empty() || !this->tasks.empty(); });
+						// runParallel로 배정된 작업은 다른 스레드가 대신 실행할 수 없으므로 먼저 처리한다.
+						if (!this->pinnedTasks[i].empty())
+						{
+							task = std::move(this->pinnedTasks[i].front());
+							this->pinnedTasks[i].pop();
+						}
+						else if (!this->tasks.empty())
+						{
+							task = std::move(this->tasks.front());
+							this->tasks.pop();
+							if (this->maxQueued) this->inputCnd.notify_all();
+						}
+						else return;
 					}
 					task(i);
 				}
@@ -90,6 +172,38 @@ namespace kiwi
 			return res;
 		}
 
+		template<class F>
+		auto ThreadPool::runParallel(size_t numWorkers, F&& f)
+			-> std::vector<std::future<typename std::invoke_result<F, size_t, size_t, Barrier*>::type>>
+		{
+			using return_type = typename std::invoke_result<F, size_t, size_t, Barrier*>::type;
+			std::vector<std::future<return_type>> ret;
+
+			// 작업 스레드 안에서 호출된 경우, 자기 차례를 영원히 기다리게 되므로 현재 스레드에서 바로 실행한다.
+			if (isWorkerThread() || workers.empty())
+			{
+				std::packaged_task<return_type(size_t, size_t, Barrier*)> task{ f };
+				ret.emplace_back(task.get_future());
+				task(0, 1, nullptr);
+				return ret;
+			}
+
+			numWorkers = std::max(std::min(numWorkers, workers.size()), (size_t)1);
+			{
+				auto b = std::make_shared<Barrier>(&barrier_mutex, &barrier_condition, numWorkers);
+				std::unique_lock<std::mutex> lock(queue_mutex);
+				if (stop) throw std::runtime_error("enqueue on stopped ThreadPool");
+				for (size_t i = 0; i < numWorkers; ++i)
+				{
+					auto task = std::make_shared< std::packaged_task<return_type(size_t, size_t, Barrier*)> >(f);
+					ret.emplace_back(task->get_future());
+					pinnedTasks[i].emplace([task, numWorkers, b](size_t id) { (*task)(id, numWorkers, b.get()); });
+				}
+			}
+			condition.notify_all();
+			return ret;
+		}
+
 		inline void ThreadPool::joinAll()
 		{
 			if (stop) return;
@@ -108,10 +222,40 @@ namespace kiwi
 			joinAll();
 		}
 
+		/**
+		 * @brief fn(workerId, numWorkers, barrier)를 pool의 스레드 최대 maxWorkers개에서 동시에 실행하고 모두 끝날 때까지 기다린다.
+		 * pool이 nullptr이면 현재 스레드에서 fn(0, 1, nullptr)을 실행하므로, fn은 barrier가 nullptr인 경우도 처리해야 한다.
+		 */
+		template<class Fn>
+		void runParallel(ThreadPool* pool, Fn&& fn, size_t maxWorkers = -1)
+		{
+			if (!pool || maxWorkers <= 1)
+			{
+				fn(0, 1, nullptr);
+				return;
+			}
+
+			auto futures = pool->runParallel(maxWorkers, fn);
+			// 예외가 발생하더라도 모든 작업이 끝날 때까지 기다린 뒤에 전파한다.
+			for (auto& f : futures)
+			{
+				f.wait();
+			}
+			for (auto& f : futures)
+			{
+				f.get();
+			}
+		}
+
+		/**
+		 * @brief [first, last)의 각 원소에 대해 fn(threadId, item)을 pool의 스레드들에서 나누어 실행한다.
+		 * pool이 nullptr이거나 현재 스레드가 pool의 작업 스레드이면 현재 스레드에서 threadId 0으로 모두 실행한다.
+		 */
 		template<class InputIt, class Fn>
 		void forEach(ThreadPool* pool, InputIt first, InputIt last, Fn fn)
 		{
-			if (!pool)
+			// 작업 스레드가 같은 풀의 작업을 기다리면 모든 스레드가 서로를 기다리며 멈출 수 있으므로 현재 스레드에서 실행한다.
+			if (!pool || pool->isWorkerThread())
 			{
 				for (; first != last; ++first)
 				{
@@ -151,5 +295,45 @@ namespace kiwi
 		{
 			forEach(pool, std::begin(cont), std::end(cont), fn);
 		}
+
+		/**
+		 * @brief [0, numItems) 구간을 numShards개의 연속된 구간으로 나누어 병렬로 처리한다.
+		 * fn은 (shardId, first, last)를 인자로 받으며, shardId는 스레드 번호가 아니라 구간의 순번이므로
+		 * 구간별 결과를 shardId 순서대로 병합하면 단일 스레드로 처리한 것과 동일한 순서를 얻을 수 있다.
+		 * pool의 작업 스레드 안에서 호출되면 모든 구간을 현재 스레드에서 순서대로 처리한다.
+		 */
+		template<class Fn>
+		void forEachShard(ThreadPool* pool, size_t numItems, size_t numShards, Fn fn)
+		{
+			numShards = std::max(std::min(numShards, numItems), (size_t)1);
+			if (!pool || numShards <= 1 || pool->isWorkerThread())
+			{
+				for (size_t i = 0; i < numShards; ++i)
+				{
+					fn(i, numItems * i / numShards, numItems * (i + 1) / numShards);
+				}
+				return;
+			}
+
+			std::vector<std::future<void>> futures;
+			futures.reserve(numShards);
+			for (size_t i = 0; i < numShards; ++i)
+			{
+				futures.emplace_back(pool->enqueue([&, i](size_t)
+				{
+					fn(i, numItems * i / numShards, numItems * (i + 1) / numShards);
+				}));
+			}
+
+			// 예외가 발생하더라도 모든 작업이 끝날 때까지 기다린 뒤에 전파한다.
+			for (auto& f : futures)
+			{
+				f.wait();
+			}
+			for (auto& f : futures)
+			{
+				f.get();
+			}
+		}
 	}
 }
@@ -61,8 +61,13 @@ namespace kiwi
 			uint32_t depth = 0;
 
 			TrieNode() {}
+			TrieNode(const TrieNode&) = default;
+			TrieNode(TrieNode&&) = default;
 			~TrieNode() {}
 
+			TrieNode& operator=(const TrieNode&) = default;
+			TrieNode& operator=(TrieNode&&) = default;
+
 			Node* getNext(_Key i) const
 			{
 				return next[i] ? (Node*)this + next[i] : nullptr;
@@ -469,6 +474,24 @@ namespace kiwi
 				return node;
 			}
 
+			/**
+			 * @brief 루트의 자식 키가 서로 겹치지 않는 다른 trie를 현재 trie의 뒤에 이어 붙인다.
+			 * 자식 노드는 상대 오프셋으로 연결되어 있으므로 루트를 제외한 노드는 그대로 복사하고
+			 * 루트의 자식 연결만 갱신한다. 부모 오프셋이나 fail 링크를 쓰는 노드에는 사용할 수 없다.
+			 */
+			void appendRootChildren(ContinuousTrie&& other)
+			{
+				if (other.nodes.size() <= 1) return;
+				const int32_t base = (int32_t)nodes.size() - 1;
+				reserveMore(other.nodes.size() - 1);
+				nodes.insert(nodes.end(), std::make_move_iterator(other.nodes.begin() + 1), std::make_move_iterator(other.nodes.end()));
+				for (auto& p : other.nodes[0].next)
+				{
+					if (p.second > 0) nodes[0].next[p.first] = p.second + base;
+				}
+				if (!nodes[0].val) nodes[0].val = other.nodes[0].val;
+			}
+
 			void fillFail(bool ignoreNegative = false)
 			{
 				return nodes[0].fillFail(ignoreNegative);
@@ -315,6 +315,8 @@ namespace kiwi
 		congFp32 = 6, /**< Contextual N-gram embedding Language Model (Only local context, non-quantized(slow) version) */
 		congGlobalFp32 = 7, /**< Contextual N-gram embedding Language Model (local and global context, non-quantized(slow) version) */
 		knlmTransposed,
+		congQ4, /**< Contextual N-gram embedding Language Model (Only local context, 4-bit embeddings are kept compressed in memory) */
+		congGlobalQ4, /**< Contextual N-gram embedding Language Model (local and global context, 4-bit embeddings are kept compressed in memory) */
 	};
 
 	enum class Dialect : uint16_t
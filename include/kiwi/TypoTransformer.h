@@ -71,6 +71,7 @@ namespace kiwi
 		Vector<size_t> digit;
 
 		bool increase();
+		void skipCostlyDigits();
 		bool valid() const;
 
 	public:
@@ -246,12 +247,18 @@ namespace kiwi
 		*/
 		TypoCandidates<true> generate(const std::u16string& orig, float costThreshold = 2.5f) const;
 
+		/**
+		* @brief 주어진 문자열에 대해 오타 그래프를 생성합니다.
+		* 
+		* @param costThreshold 이 값을 넘는 비용의 오타 노드는 그래프에 추가하지 않습니다.
+		*/
 		template<class Alloc>
 		size_t generateGraph(U16StringView normalizedStr, std::vector<TypoGraphNode, Alloc>& graphOut, 
 			Dialect allowedDialect = Dialect::standard,
 			const std::pair<uint32_t, uint32_t>* pretokenizedFirst = nullptr,
 			const std::pair<uint32_t, uint32_t>* pretokenizedLast = nullptr,
-			size_t* maxContinualTypoIdxOut = nullptr) const;
+			size_t* maxContinualTypoIdxOut = nullptr,
+			float costThreshold = INFINITY) const;
 	};
 
 	/**
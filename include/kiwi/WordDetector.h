@@ -1,9 +1,16 @@
 ﻿#pragma once
 
+#include <array>
+#include <mutex>
 #include <kiwi/Types.h>
 
 namespace kiwi
 {
+	namespace utils
+	{
+		class ThreadPool;
+	}
+
 	struct WordInfo
 	{
 		std::u16string form;
@@ -25,17 +32,20 @@ namespace kiwi
 		struct Counter;
 	protected:
 		size_t numThreads = 0;
+		std::shared_ptr<utils::ThreadPool> threadPool;
 		std::map<std::pair<POSTag, bool>, std::map<char16_t, float>> posScore;
 		std::map<std::u16string, float> nounTailScore;
 
 		void loadPOSModelFromTxt(std::istream& is);
 		void loadNounTailModelFromTxt(std::istream& is);
 
-		void countUnigram(Counter&, const U16Reader& reader, size_t minCnt) const;
-		void countBigram(Counter&, const U16Reader& reader, size_t minCnt) const;
-		void countNgram(Counter&, const U16Reader& reader, size_t minCnt, size_t maxWordLen) const;
-		float branchingEntropy(const std::map<std::u16string, uint32_t>& cnt, std::map<std::u16string, uint32_t>::iterator it, size_t minCnt, float defaultPerp = 1.f) const;
-		std::map<POSTag, float> getPosScore(Counter&, const std::map<std::u16string, uint32_t>& cnt, std::map<std::u16string, uint32_t>::iterator it, bool coda, const std::u16string& realForm) const;
+		std::shared_ptr<utils::ThreadPool> acquireThreadPool() const;
+		void countUnigram(Counter&, const U16Reader& reader, size_t minCnt, utils::ThreadPool* pool) const;
+		void buildSuffixArray(Counter&, const U16Reader& reader, size_t maxWordLen, utils::ThreadPool* pool) const;
+		float branchingEntropy(const std::vector<std::pair<uint16_t, uint32_t>>& nexts, uint32_t tot, size_t minCnt, float defaultPerp = 1.f) const;
+		std::map<POSTag, float> getPosScore(const std::vector<std::pair<char16_t, uint32_t>>& nexts, uint32_t tot, bool coda, const std::u16string& realForm) const;
+
+		friend class StreamingWordDetector;
 	public:
 
 		struct FromRawData {};
@@ -51,9 +61,120 @@ namespace kiwi
 			return !posScore.empty();
 		}
 
+		/**
+		 * @brief 단어 추출에 사용할 스레드풀을 지정한다.
+		 * nullptr이 아니면 numThreads 대신 주어진 스레드풀의 스레드를 사용하며, nullptr이면 추출 시마다 numThreads개의 스레드를 새로 생성한다.
+		 */
+		void setThreadPool(std::shared_ptr<utils::ThreadPool> pool)
+		{
+			threadPool = std::move(pool);
+		}
+
 		void saveModel(const std::string& modelPath) const;
 		std::vector<WordInfo> extractWords(const U16MultipleReader& reader, size_t minCnt = 10, size_t maxWordLen = 10, float minScore = 0.1f) const;
 	};
 
+	/**
+	 * @brief 끝없이 들어오는 텍스트에서 고정된 크기의 메모리만 사용하여 새로운 단어를 찾아내는 온라인 단어 추출기.
+	 *
+	 * `WordDetector::extractWords`는 입력을 여러 번 읽으며 모든 부분 문자열의 빈도를 정확히 세지만,
+	 * 이 클래스는 입력을 한 번만 보면서 부분 문자열의 빈도를 count-min sketch로 근사하고,
+	 * 빈도가 높은 부분 문자열만 골라 좌우 분기 문자의 분포를 추적한다.
+	 * 추출된 `WordInfo`의 form은 그대로 `KiwiBuilder::addWord`에 넣을 수 있다.
+	 * 모든 메소드는 여러 스레드에서 동시에 호출해도 안전하다.
+	 */
+	class StreamingWordDetector
+	{
+	public:
+		static constexpr size_t numBranchSlots = 8;
+		using Emitter = std::function<void(std::vector<WordInfo>&&)>;
+
+	private:
+		struct Entry
+		{
+			uint64_t key = 0;
+			uint32_t cnt = 0; // 추정 빈도. 추적을 시작하기 전의 빈도는 sketch에서 가져온다.
+			uint32_t observed = 0; // 추적을 시작한 뒤의 실제 출현 횟수. 분기 분포의 전체 합이 된다.
+			uint8_t len = 0;
+			bool emitted = false;
+			std::array<std::pair<char16_t, uint32_t>, numBranchSlots> lefts = {}, rights = {};
+		};
+
+		WordDetector detector;
+		size_t maxWordLen = 0;
+		size_t sketchDepth = 0, sketchWidthBits = 0;
+		Vector<uint32_t> sketch;
+		std::vector<uint32_t> cntUnigram;
+		Vector<Entry> entries;
+		Vector<char16_t> forms; // entries[i]의 형태는 forms[i * maxWordLen]부터 len글자
+		Vector<uint32_t> slots; // key -> entries의 인덱스 + 1, 0이면 빈 슬롯
+		std::u16string wordBuf;
+		size_t maxEntries = 0;
+		uint32_t admitThreshold = 2;
+		size_t numProcessed = 0, numPrunes = 0;
+
+		size_t emitInterval = 0, emitMinCnt = 0, nextEmit = 0;
+		float emitMinScore = 0;
+		Emitter emitter;
+
+		mutable std::mutex mtx;
+
+		uint32_t updateSketch(uint64_t key);
+		uint32_t querySketch(uint64_t key) const;
+		uint32_t countOf(const char16_t* first, const char16_t* last) const;
+		size_t findEntry(uint64_t key, const char16_t* form, size_t len) const;
+		void observe(uint64_t key, const char16_t* form, size_t len, uint32_t estimate, char16_t left, char16_t right);
+		void prune();
+		void rebuildSlots();
+		void processWord(std::u16string::const_iterator first, std::u16string::const_iterator last);
+		std::vector<WordInfo> extract(size_t minCnt, float minScore, bool onlyNew);
+
+	public:
+		/**
+		 * @param detector 품사 점수 계산에 사용할 `WordDetector`. 내부에 복사되어 저장된다.
+		 * @param memoryBudget sketch와 빈발 부분 문자열 목록이 사용할 메모리의 상한(바이트)
+		 * @param maxWordLen 추출할 단어의 최대 길이. `WordDetector::extractWords`와 마찬가지로 이보다 짧은 단어만 추출된다.
+		 * @param sketchDepth count-min sketch의 행 개수
+		 */
+		StreamingWordDetector(const WordDetector& detector, size_t memoryBudget = 64 * 1024 * 1024, size_t maxWordLen = 10, size_t sketchDepth = 4);
+
+		StreamingWordDetector(const StreamingWordDetector&) = delete;
+		StreamingWordDetector& operator=(const StreamingWordDetector&) = delete;
+
+		/**
+		 * @brief 텍스트를 추가로 입력한다. 이전에 입력된 텍스트의 통계에 누적된다.
+		 */
+		void add(const std::u16string& text);
+
+		/**
+		 * @brief 지금까지의 통계를 바탕으로 단어 후보를 추출한다.
+		 *
+		 * @param minCnt 추출할 단어의 최소 (추정) 빈도
+		 * @param minScore 추출할 단어의 최소 점수
+		 * @param onlyNew true이면 이전 호출에서 이미 추출된 단어는 제외한다.
+		 */
+		std::vector<WordInfo> extractWords(size_t minCnt = 10, float minScore = 0.1f, bool onlyNew = true);
+
+		/**
+		 * @brief `add`로 interval 글자 이상이 입력될 때마다 `extractWords(minCnt, minScore, true)`의 결과를 emitter로 전달한다.
+		 * 추출된 단어가 없으면 emitter를 호출하지 않는다. interval이 0이면 주기적인 추출을 중단한다.
+		 */
+		void setEmitter(size_t interval, size_t minCnt, float minScore, Emitter emitter);
+
+		/**
+		 * @brief 모든 빈도에 factor(0~1)를 곱하여 오래된 통계의 비중을 줄인다.
+		 * 입력의 분포가 시간에 따라 변하는 경우 주기적으로 호출하면 최근에 등장한 단어가 더 빨리 추출된다.
+		 */
+		void decay(float factor);
+
+		size_t numProcessedChars() const;
+		size_t numTrackedForms() const;
+
+		/**
+		 * @brief 실제로 할당된 sketch와 빈발 부분 문자열 목록의 크기(바이트)
+		 */
+		size_t memoryUsage() const;
+	};
+
 }
 
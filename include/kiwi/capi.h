@@ -17,6 +17,7 @@
 #define KIWIERR_FAIL -1
 #define KIWIERR_INVALID_HANDLE -2
 #define KIWIERR_INVALID_INDEX -3
+#define KIWIERR_CANCELLED -4
 
 #if !defined(DLL_EXPORT)
 #define DECL_DLL
@@ -32,10 +33,12 @@ typedef struct kiwi_res* kiwi_res_h;
 typedef struct kiwi_ws* kiwi_ws_h;
 typedef struct kiwi_ss* kiwi_ss_h;
 typedef struct kiwi_joiner* kiwi_joiner_h;
+typedef struct kiwi_joined* kiwi_joined_h;
 typedef struct kiwi_typo* kiwi_typo_h;
 typedef struct kiwi_morphset* kiwi_morphset_h;
 typedef struct kiwi_pretokenized* kiwi_pretokenized_h;
 typedef struct kiwi_prepared_typo* kiwi_prepared_typo_h;
+typedef struct kiwi_ticket* kiwi_ticket_h;
 typedef unsigned short kchar16_t;
 
 typedef struct kiwi_swtokenizer* kiwi_swtokenizer_h;
@@ -60,6 +63,24 @@ typedef struct {
 	uint16_t dialect; /**< 방언 정보 */
 } kiwi_token_info_t;
 
+/**
+ * @brief 분석 결과 하나에 포함된 형태소들의 정보를 필드별 배열로 담는 구조체.
+ * 
+ * 각 배열의 i번째 값은 i번째 형태소의 정보입니다. null인 필드는 채우지 않고 건너뜁니다.
+ * 형태는 UTF-8로 인코딩되어 하나의 문자열 버퍼에 구분자 없이 이어 붙여지며, 각 형태의 위치는 form_offsets로 알 수 있습니다.
+ */
+typedef struct {
+	uint32_t* chr_positions; /**< 시작 위치(UTF16 문자 기준) */
+	uint16_t* lengths; /**< 길이(UTF16 문자 기준) */
+	uint32_t* word_positions; /**< 어절 번호(공백 기준) */
+	uint32_t* sent_positions; /**< 문장 번호 */
+	uint8_t* tags; /**< 품사 태그. `kiwi_token_info_t::tag`와 같은 값 */
+	uint32_t* morph_ids; /**< 형태소 ID. `kiwi_res_morpheme_id`와 같은 값 */
+	float* scores; /**< 해당 형태소의 언어모델 점수 */
+	float* typo_costs; /**< 오타가 교정된 경우 오타 비용. 그렇지 않은 경우 0 */
+	uint32_t* form_offsets; /**< 문자열 버퍼 내 각 형태의 시작 위치(바이트 단위). 형태소 개수 + 1개의 값을 가지며, i번째 형태는 [form_offsets[i], form_offsets[i + 1]) 구간에 위치합니다. */
+} kiwi_token_flat_t;
+
 typedef struct {
 	uint8_t tag; /**< 품사 태그 */
 	uint8_t sense_id; /**< 의미 번호 */
@@ -143,6 +164,16 @@ typedef struct {
 
 typedef int(*kiwi_receiver_t)(int, kiwi_res_h, void*);
 
+/**
+ * @brief kiwi_analyze_async로 요청한 분석이 끝났을 때 호출되는 콜백 함수 타입
+ *
+ * @param kiwi_ticket_h kiwi_analyze_async가 반환한 티켓입니다.
+ * @param kiwi_res_h 분석 결과의 핸들입니다. 사용 후 kiwi_res_close로 해제되어야 합니다. 실패하거나 취소된 경우 null이 전달됩니다.
+ * @param int 성공 시 0, 취소된 경우 KIWIERR_CANCELLED, 실패 시 KIWIERR_FAIL입니다. 실패한 경우 콜백 안에서 kiwi_error로 오류 메세지를 확인할 수 있습니다.
+ * @param void* user data를 위한 인자입니다.
+ */
+typedef void(*kiwi_async_callback_t)(kiwi_ticket_h, kiwi_res_h, int, void*);
+
 /**
  * @brief 문자열의 변형결과를 Kiwi에 제공하기 위한 콜백 함수 타입
  *
@@ -168,6 +199,8 @@ enum
 	KIWI_BUILD_MODEL_TYPE_SBG = 0x0300,
 	KIWI_BUILD_MODEL_TYPE_CONG = 0x0400,
 	KIWI_BUILD_MODEL_TYPE_CONG_GLOBAL = 0x0500,
+	KIWI_BUILD_MODEL_TYPE_CONG_Q4 = 0x0600,
+	KIWI_BUILD_MODEL_TYPE_CONG_GLOBAL_Q4 = 0x0700,
 };
 
 enum
@@ -723,6 +756,88 @@ DECL_DLL int kiwi_analyze_mw(kiwi_h handle, kiwi_reader_w_t reader, kiwi_receive
  */
 DECL_DLL int kiwi_analyze_m(kiwi_h handle, kiwi_reader_t reader, kiwi_receiver_t receiver, void* user_data, int top_n, kiwi_analyze_option_t option);
 
+typedef struct {
+	int max_in_flight; /**< 읽어들였지만 아직 receiver로 전달되지 않은 입력의 최대 개수. 0이면 스레드 개수의 2배를 사용합니다. */
+	int max_batch_size; /**< 하나의 작업으로 묶어서 처리할 최대 입력 개수. 1 이하이면 입력마다 별도의 작업을 생성합니다. */
+	int max_batch_chars; /**< 하나의 작업으로 묶을 입력들의 최대 글자 수 합계. */
+	int ordered; /**< 0이 아니면 입력 순서대로, 0이면 분석이 끝나는 순서대로 receiver를 호출합니다. */
+} kiwi_bulk_option_t;
+
+/**
+ * @brief reader로부터 입력을 읽어들여 여러 스레드에서 분석하고 결과를 receiver로 전달합니다.
+ * 
+ * @param handle Kiwi.
+ * @param reader 입력을 제공하는 콜백 함수. kiwi_reader_t 참고.
+ * @param receiver 분석 결과를 전달받는 콜백 함수. 첫번째 인자로 해당 입력의 번호(reader가 받은 번호)가 전달됩니다.
+ * @param user_data reader와 receiver에 전달될 사용자 데이터.
+ * @param top_n 입력마다 반환할 결과물의 개수.
+ * @param option 분석 옵션. kiwi_analyze_option_t 참고.
+ * @param bulk_option 동시에 처리할 입력 개수, 묶음 크기, 결과 전달 순서. kiwi_bulk_option_t 참고.
+ * @return 읽어들인 입력의 개수. 실패 시 음수를 반환합니다.
+ * 
+ * @note reader와 receiver는 항상 이 함수를 호출한 스레드에서 실행됩니다. 
+ * receiver로 전달된 결과 핸들은 사용 후 kiwi_res_close로 해제되어야 합니다.
+ * 
+ * @see kiwi_analyze_bulk_w, kiwi_analyze_m
+ */
+DECL_DLL int kiwi_analyze_bulk(kiwi_h handle, kiwi_reader_t reader, kiwi_receiver_t receiver, void* user_data, int top_n, kiwi_analyze_option_t option, kiwi_bulk_option_t bulk_option);
+
+/**
+ * @brief reader로부터 입력을 읽어들여 여러 스레드에서 분석하고 결과를 receiver로 전달합니다. (utf-16)
+ * 
+ * @see kiwi_analyze_bulk
+ */
+DECL_DLL int kiwi_analyze_bulk_w(kiwi_h handle, kiwi_reader_w_t reader, kiwi_receiver_t receiver, void* user_data, int top_n, kiwi_analyze_option_t option, kiwi_bulk_option_t bulk_option);
+
+/**
+ * @brief 텍스트의 분석을 Kiwi의 스레드풀에 요청하고 결과를 기다리지 않고 바로 반환합니다.
+ *
+ * 분석이 끝나면 스레드풀의 작업 스레드에서 callback이 정확히 한 번 호출됩니다. 
+ * 호출 스레드를 막지 않으므로 이벤트 루프 기반의 서버에서 요청마다 별도의 스레드를 만들지 않고 사용할 수 있습니다.
+ * 
+ * @param handle Kiwi. 스레드 개수가 1 이상인 Kiwi여야 합니다.
+ * @param text 분석할 텍스트 (utf-8). 함수 내에서 복사되므로 반환 후에 해제해도 됩니다.
+ * @param top_n 반환할 결과물.
+ * @param option 분석 옵션. kiwi_analyze_option_t 참고. blocklist와 typo_transformer는 callback이 호출될 때까지 유효해야 합니다.
+ * @param pretokenized 입력 텍스트 중 특정 영역의 분석 방법을 강제로 지정합니다. 함수 내에서 복사됩니다. null 입력 시에는 pretokenization을 사용하지 않습니다.
+ * @param callback 분석이 끝나거나 취소되었을 때 호출될 콜백 함수. kiwi_async_callback_t 참고.
+ * @param user_data callback에 전달될 사용자 데이터.
+ * @return 요청의 티켓. kiwi_cancel로 요청을 취소할 때 사용합니다. 이 핸들은 더 이상 사용하지 않을 때 kiwi_ticket_close로 반드시 해제되어야 합니다. 실패 시 null을 반환합니다.
+ * 
+ * @note 모든 callback이 호출되기 전에 kiwi_close로 Kiwi를 해제해서는 안 됩니다.
+ * 
+ * @see kiwi_analyze_async_w, kiwi_cancel
+ */
+DECL_DLL kiwi_ticket_h kiwi_analyze_async(kiwi_h handle, const char* text, int top_n, kiwi_analyze_option_t option, kiwi_pretokenized_h pretokenized, kiwi_async_callback_t callback, void* user_data);
+
+/**
+ * @brief 텍스트의 분석을 Kiwi의 스레드풀에 요청하고 결과를 기다리지 않고 바로 반환합니다. (utf-16)
+ * 
+ * @see kiwi_analyze_async
+ */
+DECL_DLL kiwi_ticket_h kiwi_analyze_async_w(kiwi_h handle, const kchar16_t* text, int top_n, kiwi_analyze_option_t option, kiwi_pretokenized_h pretokenized, kiwi_async_callback_t callback, void* user_data);
+
+/**
+ * @brief kiwi_analyze_async로 요청한 분석을 취소합니다.
+ * 
+ * 아직 시작되지 않은 분석은 실행되지 않으며, 이미 진행 중인 분석은 끝난 뒤 그 결과가 버려집니다. 
+ * 취소된 경우에도 callback은 KIWIERR_CANCELLED와 함께 호출됩니다.
+ * 
+ * @param ticket 분석 요청의 티켓
+ * @return 취소된 경우 0, 이미 분석이 끝나 취소할 수 없는 경우 1을 반환합니다. 실패 시 음수를 반환합니다.
+ */
+DECL_DLL int kiwi_cancel(kiwi_ticket_h ticket);
+
+/**
+ * @brief 분석 요청의 티켓을 해제합니다.
+ *
+ * @param ticket 분석 요청의 티켓
+ * @return 성공시 0을 반환합니다. 실패시 0이 아닌 값을 반환합니다.
+ * 
+ * @note 분석이 끝나기 전에 해제하더라도 분석은 취소되지 않으며 callback도 그대로 호출됩니다. 
+ */
+DECL_DLL int kiwi_ticket_close(kiwi_ticket_h ticket);
+
 /**
  * @brief 텍스트를 문장 단위로 분할합니다.
  *
@@ -760,6 +875,18 @@ DECL_DLL kiwi_ss_h kiwi_split_into_sents(kiwi_h handle, const char* text, int ma
  */
 DECL_DLL kiwi_joiner_h kiwi_new_joiner(kiwi_h handle, int lm_search);
 
+/**
+ * @brief 여러 형태소 열을 병렬로 결합하여 텍스트로 복원합니다.
+ *
+ * @param handle Kiwi.
+ * @param morph_ids 모든 형태소 열의 형태소 ID를 이어 붙인 배열. 형태소 ID는 kiwi_res_morpheme_id 등으로 얻을 수 있습니다.
+ * @param seq_sizes 각 형태소 열의 길이. morph_ids의 길이는 seq_sizes의 합과 같아야 합니다.
+ * @param batch_size 형태소 열의 개수(seq_sizes의 길이)
+ * @param lm_search True일 경우 언어 모델 탐색을 사용하여 최적의 품사를 선택합니다.
+ * @return 결합 결과의 핸들. kiwi_joined_* 함수에 사용가능합니다. 이 핸들은 사용 후 kiwi_joined_close를 통해 반드시 해제되어야 합니다.
+ */
+DECL_DLL kiwi_joined_h kiwi_join_batch(kiwi_h handle, const int* morph_ids, const int* seq_sizes, int batch_size, int lm_search);
+
 /**
  * @brief 사용이 완료된 Kiwi객체를 해제합니다.
  * 
@@ -926,6 +1053,41 @@ DECL_DLL float kiwi_res_score(kiwi_res_h result, int index, int num);
  */
 DECL_DLL float kiwi_res_typo_cost(kiwi_res_h result, int index, int num);
 
+/**
+ * @brief index번째 분석 결과에 포함된 모든 형태소의 정보를 호출자가 할당한 배열에 한 번에 복사합니다.
+ *
+ * 형태소마다 kiwi_res_form, kiwi_res_tag, kiwi_res_position 등을 호출하는 대신 이 함수를 한 번 호출하여 모든 정보를 얻을 수 있습니다.
+ * out의 각 배열은 `kiwi_res_word_num(result, index)`개(form_offsets는 1개 더) 이상의 공간을 가져야 하며, null인 배열은 채우지 않습니다.
+ * 
+ * @param result 분석 결과의 핸들
+ * @param index `0` 이상 `kiwi_res_size(result)` 미만의 정수
+ * @param out 형태소 정보를 채울 배열들을 담은 구조체
+ * @param strbuf UTF-8로 인코딩된 형태들을 이어 붙여 쓸 버퍼. 마지막에는 null 문자가 추가됩니다. null일 경우 문자열은 쓰지 않습니다.
+ * @param strbuf_size strbuf의 크기(바이트 단위). 음수이면 KIWIERR_INVALID_INDEX를 반환합니다.
+ * @param kiwi_handle (선택사항) Kiwi 핸들. out->morph_ids를 채우려는 경우 반드시 필요합니다.
+ * @return 성공 시 strbuf에 필요한 크기(null 문자 포함)를 반환합니다. 실패 시 음수를 반환합니다.
+ *
+ * @note 반환값이 strbuf_size보다 크다면 strbuf에는 아무것도 쓰이지 않으므로, 반환된 크기만큼 버퍼를 할당하여 다시 호출하십시오.
+ * 문자열 버퍼를 제외한 배열들은 strbuf의 크기와 상관없이 항상 채워집니다.
+ */
+DECL_DLL int kiwi_res_export(kiwi_res_h result, int index, kiwi_token_flat_t* out, char* strbuf, int strbuf_size, kiwi_h kiwi_handle);
+
+/**
+ * @brief index번째 분석 결과에 포함된 모든 형태소의 정보를 복사 없이 필드별 배열로 반환합니다.
+ *
+ * kiwi_res_export와 같은 형식이지만, out의 각 배열과 strbuf는 분석 결과 핸들이 소유한 메모리를 가리킵니다.
+ * 
+ * @param result 분석 결과의 핸들
+ * @param index `0` 이상 `kiwi_res_size(result)` 미만의 정수
+ * @param out 각 배열의 포인터를 받을 구조체. kiwi_handle이 null이면 out->morph_ids는 null로 설정됩니다.
+ * @param strbuf (선택사항) UTF-8로 인코딩된 형태들을 이어 붙인 null로 끝나는 문자열의 포인터를 받을 주소
+ * @param kiwi_handle (선택사항) Kiwi 핸들. 형태소 ID가 필요한 경우 넘겨주세요.
+ * @return 성공 시 형태소의 개수를 반환합니다. 실패 시 음수를 반환합니다.
+ *
+ * @note 반환된 포인터들은 kiwi_res_close로 결과를 해제하기 전까지 유효하며, 그 내용을 수정해서는 안 됩니다.
+ */
+DECL_DLL int kiwi_res_export_view(kiwi_res_h result, int index, kiwi_token_flat_t* out, const char** strbuf, kiwi_h kiwi_handle);
+
 /**
  * @brief 사용이 완료된 형태소 분석 결과를 해제합니다.
  *
@@ -1020,6 +1182,31 @@ typedef struct {
 
 DECL_DLL int kiwi_cong_most_similar_words(kiwi_h handle, unsigned int morph_id, kiwi_similarity_pair_t* output, int top_n);
 
+/**
+ * @brief 여러 형태소에 대해 kiwi_cong_most_similar_words를 한 번에 수행합니다.
+ * 
+ * @param handle Kiwi.
+ * @param morph_ids 형태소 ID 배열의 시작 포인터.
+ * @param size morph_ids 배열의 크기.
+ * @param output 크기가 size * top_n인 배열의 시작 포인터. i번째 형태소의 결과는 output[i * top_n]부터 저장됩니다.
+ * @param top_n 형태소마다 반환할 유사한 단어의 최대 개수.
+ * @param output_sizes 크기가 size인 배열의 시작 포인터. 각 형태소에 대해 실제로 저장된 결과의 개수가 저장됩니다.
+ * @return 성공 시 0, 실패 시 음수를 반환합니다.
+ */
+DECL_DLL int kiwi_cong_most_similar_words_batch(kiwi_h handle, const unsigned int* morph_ids, int size, kiwi_similarity_pair_t* output, int top_n, int* output_sizes);
+
+/**
+ * @brief kiwi_cong_most_similar_words, kiwi_cong_most_similar_contexts가 근사 최근접 이웃 색인을 사용하도록 설정합니다.
+ * 
+ * 색인은 처음 사용될 때 생성됩니다. num_probes가 클수록 정확도는 높아지고 속도는 느려집니다.
+ * 
+ * @param handle Kiwi.
+ * @param num_probes 질의마다 탐색할 클러스터의 개수. 0이면 색인을 사용하지 않고 전체를 탐색합니다.
+ * @param num_lists 클러스터의 개수. 0이면 항목 개수의 제곱근을 사용합니다.
+ * @return 성공 시 0, 실패 시 음수를 반환합니다.
+ */
+DECL_DLL int kiwi_cong_set_similarity_index(kiwi_h handle, int num_probes, int num_lists);
+
 /**
  * @brief 두 형태소 간의 유사도를 반환합니다.
  * 
@@ -1062,6 +1249,19 @@ DECL_DLL float kiwi_cong_context_similarity(kiwi_h handle, unsigned int context_
  */
 DECL_DLL int kiwi_cong_predict_words_from_context(kiwi_h handle, unsigned int context_id, kiwi_similarity_pair_t* output, int top_n);
 
+/**
+ * @brief 여러 문맥에 대해 kiwi_cong_predict_words_from_context를 한 번에 수행합니다.
+ * 
+ * @param handle Kiwi.
+ * @param context_ids 문맥 ID 배열의 시작 포인터.
+ * @param size context_ids 배열의 크기.
+ * @param output 크기가 size * top_n인 배열의 시작 포인터. i번째 문맥의 결과는 output[i * top_n]부터 저장됩니다.
+ * @param top_n 문맥마다 반환할 단어의 최대 개수.
+ * @param output_sizes 크기가 size인 배열의 시작 포인터. 각 문맥에 대해 실제로 저장된 결과의 개수가 저장됩니다.
+ * @return 성공 시 0, 실패 시 음수를 반환합니다.
+ */
+DECL_DLL int kiwi_cong_predict_words_from_context_batch(kiwi_h handle, const unsigned int* context_ids, int size, kiwi_similarity_pair_t* output, int top_n, int* output_sizes);
+
 /**
  * @brief 두 문맥의 차이로부터 예측되는 다음 단어들을 반환합니다.
  * 
@@ -1232,6 +1432,61 @@ DECL_DLL const kchar16_t* kiwi_joiner_get_w(kiwi_joiner_h handle);
  */
 DECL_DLL int kiwi_joiner_close(kiwi_joiner_h handle);
 
+/**
+ * @brief 결합 결과의 개수를 반환합니다.
+ *
+ * @param handle 결합 결과의 핸들
+ * @return 성공시 결합 결과의 개수를 반환합니다. 실패시 음수를 반환합니다.
+ */
+DECL_DLL int kiwi_joined_size(kiwi_joined_h handle);
+
+/**
+ * @brief 모든 결합 결과를 이어 붙인 텍스트를 반환합니다.
+ *
+ * @param handle 결합 결과의 핸들
+ * @param text_size null이 아닌 경우 텍스트의 전체 길이(UTF-16 문자 기준)가 기록됩니다.
+ * @return 성공시 UTF-16로 인코딩된 텍스트의 포인터를 반환합니다. 실패시 null을 반환합니다.
+ * @note i번째 결합 결과는 kiwi_joined_offsets가 반환하는 배열의 i번째 값에서 시작하여 i + 1번째 값에서 끝납니다.
+ * 반환된 포인터는 kiwi_joined_close가 호출될 때까지 유효합니다.
+ */
+DECL_DLL const kchar16_t* kiwi_joined_text_w(kiwi_joined_h handle, int* text_size);
+
+/**
+ * @brief 각 결합 결과의 텍스트 내 위치를 반환합니다.
+ *
+ * @param handle 결합 결과의 핸들
+ * @return 성공시 (결합 결과의 개수 + 1) 크기의 배열을 반환합니다. 실패시 null을 반환합니다.
+ */
+DECL_DLL const uint32_t* kiwi_joined_offsets(kiwi_joined_h handle);
+
+/**
+ * @brief 모든 결합 결과의 형태소 범위를 이어 붙인 배열을 반환합니다.
+ *
+ * @param handle 결합 결과의 핸들
+ * @param num_ranges null이 아닌 경우 형태소 범위의 전체 개수가 기록됩니다.
+ * @return 성공시 (시작 위치, 끝 위치) 쌍이 num_ranges개 이어진 배열을 반환합니다. 위치는 각 결합 결과의 시작을 기준으로 한 UTF-16 문자 단위입니다. 실패시 null을 반환합니다.
+ * @note i번째 결합 결과의 형태소 범위는 kiwi_joined_range_offsets가 반환하는 배열의 i번째 값부터 i + 1번째 값 전까지입니다.
+ */
+DECL_DLL const uint32_t* kiwi_joined_ranges(kiwi_joined_h handle, int* num_ranges);
+
+/**
+ * @brief 각 결합 결과의 형태소 범위가 kiwi_joined_ranges 배열 내에서 시작하는 위치를 반환합니다.
+ *
+ * @param handle 결합 결과의 핸들
+ * @return 성공시 (결합 결과의 개수 + 1) 크기의 배열을 반환합니다. 실패시 null을 반환합니다.
+ */
+DECL_DLL const uint32_t* kiwi_joined_range_offsets(kiwi_joined_h handle);
+
+/**
+ * @brief 사용이 완료된 결합 결과를 해제합니다.
+ *
+ * @param handle 해제할 결합 결과의 핸들
+ * @return 성공시 0을 반환합니다. 실패시 0이 아닌 값을 반환합니다.
+ *
+ * @note kiwi_join_batch 함수에서 반환된 kiwi_joined_h는 반드시 이 함수로 해제되어야 합니다.
+ */
+DECL_DLL int kiwi_joined_close(kiwi_joined_h handle);
+
 /**
  * @brief 형태소 집합에 특정 형태소를 삽입합니다.
  * 
@@ -1265,15 +1520,28 @@ DECL_DLL int kiwi_morphset_close(kiwi_morphset_h handle);
 /**
  * @brief 새로운 SwTokenizer 객체를 생성합니다.
  * 
- * @param path 읽어들일 json 파일의 경로
+ * @param path 읽어들일 json 파일 혹은 kiwi_swt_save_binary로 저장한 바이너리 파일의 경로
  * @param kiwi SwTokenizer에서 사용할 Kiwi의 핸들
  * @return 성공 시 SwTokenizer의 핸들을 반환합니다. 실패 시 null를 반환합니다.
  * 
  * @note 인자로 주어진 kiwi는 해당 SwTokenizer가 사용 중일 때는 해제되면 안됩니다.
  * 이 함수로 생성된 핸들은 사용이 끝난 뒤 kiwi_swt_close로 해제되어야 합니다.
+ * 파일의 형식은 자동으로 판별됩니다. 바이너리 파일은 저장할 때와 형태소 목록이 같은 kiwi로만 읽어들일 수 있습니다.
  */
 DECL_DLL kiwi_swtokenizer_h kiwi_swt_init(const char* path, kiwi_h kiwi);
 
+/**
+ * @brief SwTokenizer를 바이너리 형식으로 저장합니다.
+ * 
+ * @param handle SwTokenizer의 핸들
+ * @param path 저장할 파일의 경로
+ * @return 성공 시 0, 실패 시 0이 아닌 값을 반환합니다.
+ * 
+ * @note 바이너리 형식은 json 형식보다 훨씬 빠르게 읽어들일 수 있지만, 저장할 때 사용한 것과 형태소 목록이 같은 Kiwi에서만 사용할 수 있습니다.
+ * 저장된 파일은 kiwi_swt_init으로 읽어들일 수 있습니다.
+ */
+DECL_DLL int kiwi_swt_save_binary(kiwi_swtokenizer_h handle, const char* path);
+
 /**
  * @brief 주어진 문자열을 token ids로 변환합니다.
  * 
@@ -1331,6 +1599,42 @@ DECL_DLL int kiwi_swt_encode(kiwi_swtokenizer_h handle, const char* text, int te
  */
 DECL_DLL int kiwi_swt_decode(kiwi_swtokenizer_h handle, const int* token_ids, int token_size, char* text, int text_buf_size);
 
+typedef struct {
+	int max_length; /**< 출력 버퍼에서 한 행의 길이 */
+	int pad_id; /**< 남는 칸을 채울 토큰 id. 음수이면 [PAD] 토큰의 id를 사용하고, [PAD] 토큰이 없으면 0을 사용합니다. */
+	int truncation; /**< 0이 아니면 max_length보다 긴 결과를 잘라내고, 0이면 실패로 처리합니다. */
+	int pad_left; /**< 0이 아니면 토큰을 행의 오른쪽에 붙이고 왼쪽을 패딩으로 채웁니다. */
+	int offset_in_chr_level; /**< 0이 아니면 offset을 바이트 단위 대신 글자 단위로 기록합니다. */
+} kiwi_swt_batch_option_t;
+
+/**
+ * @brief 여러 문자열을 병렬로 token ids로 변환하여 [batch_size, max_length] 모양의 버퍼에 기록합니다.
+ * 
+ * @param handle SwTokenizer의 핸들
+ * @param texts token ids로 변환할 UTF8 문자열들의 배열
+ * @param text_sizes 각 문자열의 길이를 담은 배열. null이거나 값이 음수인 경우 해당 문자열을 null-terminated string으로 간주합니다.
+ * @param batch_size texts의 길이
+ * @param option 행의 길이, 잘라내기 및 패딩 방식. kiwi_swt_batch_option_t 참고.
+ * @param token_ids batch_size * max_length 크기의 버퍼. 남는 칸은 pad_id로 채워집니다.
+ * @param attention_mask batch_size * max_length 크기의 버퍼. 토큰이 있는 칸은 1, 패딩 칸은 0으로 채워집니다. 필요없는 경우 null로 지정할 수 있습니다.
+ * @param offsets batch_size * max_length * 2 크기의 버퍼. 각 토큰의 시작 및 끝 위치가 기록됩니다. 필요없는 경우 null로 지정할 수 있습니다.
+ * @param lengths batch_size 크기의 버퍼. 각 행에 기록된 토큰의 개수가 기록됩니다. 필요없는 경우 null로 지정할 수 있습니다.
+ * @return 성공 시 잘라내기 전 가장 긴 행의 토큰 개수를 반환합니다. 실패 시 음수를 반환합니다.
+ * 
+ * @note 토큰화는 SwTokenizer가 사용하는 Kiwi의 스레드 풀에서 수행됩니다.
+ * numpy 배열이나 direct buffer의 포인터를 그대로 넘기면 추가적인 복사 없이 결과를 받을 수 있습니다.
+ * 
+ * @see kiwi_swt_encode_batch64
+ */
+DECL_DLL int kiwi_swt_encode_batch(kiwi_swtokenizer_h handle, const char** texts, const int* text_sizes, int batch_size, kiwi_swt_batch_option_t option, int32_t* token_ids, int32_t* attention_mask, int32_t* offsets, int32_t* lengths);
+
+/**
+ * @brief 여러 문자열을 병렬로 token ids로 변환하여 64bit 정수 버퍼에 기록합니다.
+ * 
+ * @see kiwi_swt_encode_batch
+ */
+DECL_DLL int kiwi_swt_encode_batch64(kiwi_swtokenizer_h handle, const char** texts, const int* text_sizes, int batch_size, kiwi_swt_batch_option_t option, int64_t* token_ids, int64_t* attention_mask, int64_t* offsets, int64_t* lengths);
+
 /**
  * @brief 사용이 끝난 SwTokenizer 객체를 해제합니다.
  * 
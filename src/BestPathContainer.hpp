@@ -2,6 +2,7 @@
 
 #include <kiwi/Types.h>
 #include <kiwi/BitUtils.h>
+#include <kiwi/ScratchSpace.h>
 
 namespace kiwi
 {
@@ -165,6 +166,11 @@ namespace kiwi
 			bestPathValues.clear();
 		}
 
+		size_t scratchBytes() const
+		{
+			return utils::estimateScratchBytes(bestPathIndex) + utils::estimateScratchBytes(bestPathValues);
+		}
+
 		inline void insert(size_t topN, uint8_t prevRootId, uint8_t rootId,
 			const Morpheme* morph, float accScore, float firstChunkScore, float accTypoCost, float accDialectCost,
 			const WordLL<LmState>* parent, LmState&& lmState, SpecialState spState)
@@ -237,6 +243,11 @@ namespace kiwi
 			bestPathes.clear();
 		}
 
+		size_t scratchBytes() const
+		{
+			return utils::estimateScratchBytes(bestPathes);
+		}
+
 		inline void insert(size_t topN, uint8_t prevRootId, uint8_t rootId,
 			const Morpheme* morph, float accScore, float firstChunkScore, float accTypoCost, float accDialectCost,
 			const WordLL<LmState>* parent, LmState&& lmState, SpecialState spState)
@@ -2,6 +2,7 @@
 #include <fstream>
 #include <cstring>
 #include <limits>
+#include <random>
 #include "PathEvaluator.hpp"
 #include "Joiner.hpp"
 #include "Kiwi.hpp"
@@ -39,13 +40,13 @@ namespace kiwi
 			const Vector<SpecialState>& prevSpStates
 		) const
 		{
-			thread_local BestPathConatiner<mode, LmState> bestPathCont;
-			thread_local Vector<pair<const KGraphNode*, const WordLL<LmState>*>> regularPrevPathes;
-			thread_local Vector<pair<const KGraphNode*, const WordLL<LmState>*>> combiningPrevPathes;
-			thread_local Vector<const Morpheme*> regularMorphs, regularDistantMorphs, combiningLMorphs, combiningRMorphs;
-			thread_local Vector<LmState> prevLmStates, nextLmStates;
-			thread_local Vector<VocabTy> nextWids, nextDistantWids;
-			thread_local Vector<float> scores;
+			thread_local utils::Scratch<BestPathConatiner<mode, LmState>> bestPathCont;
+			thread_local utils::Scratch<Vector<pair<const KGraphNode*, const WordLL<LmState>*>>> regularPrevPathes;
+			thread_local utils::Scratch<Vector<pair<const KGraphNode*, const WordLL<LmState>*>>> combiningPrevPathes;
+			thread_local utils::Scratch<Vector<const Morpheme*>> regularMorphs, regularDistantMorphs, combiningLMorphs, combiningRMorphs;
+			thread_local utils::Scratch<Vector<LmState>> prevLmStates, nextLmStates;
+			thread_local utils::Scratch<Vector<VocabTy>> nextWids, nextDistantWids;
+			thread_local utils::Scratch<Vector<float>> scores;
 
 			const auto* langMdl = static_cast<const lm::CoNgramModel<arch, VocabTy, VlVocabTy, windowSize, quantized>*>(kw->getLangModel());
 			const Morpheme* morphBase = kw->morphemes.data();
@@ -423,8 +424,22 @@ namespace kiwi
 		}
 
 		template<ArchType arch, class KeyType, class VlKeyType, size_t windowSize, bool quantized>
-		CoNgramModel<arch, KeyType, VlKeyType, windowSize, quantized>::CoNgramModel(utils::MemoryObject&& mem) : CoNgramModelBase{ mem }
+		CoNgramModel<arch, KeyType, VlKeyType, windowSize, quantized>::CoNgramModel(utils::MemoryObject&& mem, bool compactEmbedding) : CoNgramModelBase{ mem }
 		{
+			if (compactEmbedding && quantized)
+			{
+				// 4bit로 양자화된 모델이 아니면 압축 모드를 사용하지 않고 8bit 임베딩으로 대체한다. 적용 여부는 hasCompactEmbedding()으로 알 수 있다.
+				if (header.qbit == 4 && header.qgroup > 0)
+				{
+					// 행의 크기가 16의 배수가 되도록 맞춰야 문맥 테이블 바로 뒤에 원거리 테이블이 이어진다.
+					static constexpr size_t tailSize = 4 * sizeof(float);
+					static atomic<size_t> rowCacheIdCounter{ 0 };
+					compactEmb = true;
+					compactHeadSize = padMultipleOf(header.dim / 2 + sizeof(uint16_t) + header.dim / header.qgroup + tailSize, 16) - tailSize;
+					rowCacheId = ++rowCacheIdCounter;
+				}
+			}
+
 			auto* ptr = reinterpret_cast<const char*>(mem.get());
 			Vector<conditional_t<sizeof(VlKeyType) == 1, uint8_t, uint32_t>> nodeSizes(header.numNodes);
 			if constexpr (sizeof(VlKeyType) == 1)
@@ -623,14 +638,25 @@ namespace kiwi
 			
 			auto* eptr = ptr + header.embOffset;
 			auto* optr = const_cast<uint8_t*>(contextEmbPtr);
+			Vector<uint8_t> rowBuf(compactEmb ? header.dim : 0);
 			for (size_t i = 0; i < header.contextSize; ++i)
 			{
 				if constexpr (quantized)
 				{
 					float scale;
 					const bool toUint8 = arch != ArchType::neon;
-					eptr += requantizePackedInts<arch>(optr, scale, eptr, header.dim, header.qbit, header.qgroup, toUint8);
-					optr += header.dim;
+					if (compactEmb)
+					{
+						const size_t packedSize = requantizePackedInts<arch>(rowBuf.data(), scale, eptr, header.dim, header.qbit, header.qgroup, toUint8);
+						memcpy(optr, eptr, packedSize);
+						eptr += packedSize;
+						optr += compactHeadSize;
+					}
+					else
+					{
+						eptr += requantizePackedInts<arch>(optr, scale, eptr, header.dim, header.qbit, header.qgroup, toUint8);
+						optr += header.dim;
+					}
 					*reinterpret_cast<float*>(optr) = scale;
 					optr += sizeof(float);
 				}
@@ -664,9 +690,21 @@ namespace kiwi
 				if constexpr (quantized)
 				{
 					float scale;
-					eptr += requantizePackedInts<arch>(optr, scale, eptr, header.dim, header.qbit, header.qgroup, false);
-					auto* qvals = reinterpret_cast<const int8_t*>(optr);
-					optr += header.dim;
+					const int8_t* qvals;
+					if (compactEmb)
+					{
+						const size_t packedSize = requantizePackedInts<arch>(rowBuf.data(), scale, eptr, header.dim, header.qbit, header.qgroup, false);
+						memcpy(optr, eptr, packedSize);
+						qvals = reinterpret_cast<const int8_t*>(rowBuf.data());
+						eptr += packedSize;
+						optr += compactHeadSize;
+					}
+					else
+					{
+						eptr += requantizePackedInts<arch>(optr, scale, eptr, header.dim, header.qbit, header.qgroup, false);
+						qvals = reinterpret_cast<const int8_t*>(optr);
+						optr += header.dim;
+					}
 					*reinterpret_cast<float*>(optr) = scale;
 					optr += sizeof(float);
 					*reinterpret_cast<int32_t*>(optr) = accumulate(qvals, qvals + header.dim, 0) * 128;
@@ -681,27 +719,35 @@ namespace kiwi
 
 			if constexpr (quantized)
 			{
-				if constexpr (arch == ArchType::neon)
+				forEachUnpackedBlock(contextEmbPtr, contextEmbStride(), unpackedContextEmbStride(), arch != ArchType::neon, header.contextSize,
+					[&](const uint8_t* rows, size_t stride, size_t first, size_t size)
 				{
-					qgemm::invNormS8<arch>(
-						header.contextSize, header.dim,
-						getContextQuantEmbS8(0), contextEmbStride(),
-						const_cast<float*>(invNormContextPtr)
-					);
-				}
-				else
+					if constexpr (arch == ArchType::neon)
+					{
+						qgemm::invNormS8<arch>(
+							size, header.dim,
+							reinterpret_cast<const int8_t*>(rows), stride,
+							const_cast<float*>(invNormContextPtr) + first
+						);
+					}
+					else
+					{
+						qgemm::invNormU8<arch>(
+							size, header.dim,
+							rows, stride,
+							const_cast<float*>(invNormContextPtr) + first
+						);
+					}
+				});
+				forEachUnpackedBlock(outputEmbPtr, outputEmbStride(), unpackedOutputEmbStride(), false, header.vocabSize,
+					[&](const uint8_t* rows, size_t stride, size_t first, size_t size)
 				{
-					qgemm::invNormU8<arch>(
-						header.contextSize, header.dim,
-						getContextQuantEmb(0), contextEmbStride(),
-						const_cast<float*>(invNormContextPtr)
+					qgemm::invNormS8<arch>(
+						size, header.dim,
+						reinterpret_cast<const int8_t*>(rows), stride,
+						const_cast<float*>(invNormOutputPtr) + first
 					);
-				}
-				qgemm::invNormS8<arch>(
-					header.vocabSize, header.dim,
-					getOutputQuantEmb(0), outputEmbStride(),
-					const_cast<float*>(invNormOutputPtr)
-				);
+				});
 			}
 			else
 			{
@@ -726,8 +772,18 @@ namespace kiwi
 					{
 						float scale;
 						const bool toUint8 = arch != ArchType::neon;
-						eptr += requantizePackedInts<arch>(optr, scale, eptr, header.dim, header.qbit, header.qgroup, toUint8);
-						optr += header.dim;
+						if (compactEmb)
+						{
+							const size_t packedSize = requantizePackedInts<arch>(rowBuf.data(), scale, eptr, header.dim, header.qbit, header.qgroup, toUint8);
+							memcpy(optr, eptr, packedSize);
+							eptr += packedSize;
+							optr += compactHeadSize;
+						}
+						else
+						{
+							eptr += requantizePackedInts<arch>(optr, scale, eptr, header.dim, header.qbit, header.qgroup, toUint8);
+							optr += header.dim;
+						}
 						*reinterpret_cast<float*>(optr) = scale;
 						optr += sizeof(float);
 					}
@@ -789,6 +845,87 @@ namespace kiwi
 
 		}
 
+		template<ArchType arch, class KeyType, class VlKeyType, size_t windowSize, bool quantized>
+		void CoNgramModel<arch, KeyType, VlKeyType, windowSize, quantized>::unpackQuantRow(uint8_t* out, const uint8_t* row, size_t unpackedStride, bool toUint8) const
+		{
+			float scale;
+			requantizePackedInts<arch>(out, scale, row, header.dim, header.qbit, header.qgroup, toUint8);
+			// 스케일과 편향 등 나머지 값은 압축되지 않은 상태로 저장되어 있으므로 그대로 복사한다.
+			memcpy(out + header.dim, row + compactHeadSize, unpackedStride - header.dim);
+		}
+
+		template<ArchType arch, class KeyType, class VlKeyType, size_t windowSize, bool quantized>
+		const uint8_t* CoNgramModel<arch, KeyType, VlKeyType, windowSize, quantized>::cachedUnpackedRow(const uint8_t* table, size_t stride, size_t unpackedStride, bool toUint8, int32_t idx) const
+		{
+			// 한 행을 푸는 비용이 이미 풀린 행을 복사하는 비용의 10배 가까이 되므로,
+			// 탐색 중 반복해서 등장하는 문맥과 형태소의 행은 직접 사상(direct-mapped) 캐시에 보관해 둔다.
+			struct RowCache
+			{
+				size_t ownerId = 0;
+				Vector<int32_t> keys;
+				Vector<uint8_t> rows;
+			};
+			static constexpr size_t cacheBits = 10;
+			thread_local RowCache caches[2];
+
+			auto& cache = caches[table == outputEmbPtr ? 1 : 0];
+			if (cache.ownerId != rowCacheId)
+			{
+				cache.ownerId = rowCacheId;
+				cache.keys.assign((size_t)1 << cacheBits, -1);
+				cache.rows.resize(unpackedStride << cacheBits);
+			}
+
+			const size_t entry = (uint32_t)((uint32_t)idx * 2654435761u) >> (32 - cacheBits);
+			uint8_t* row = &cache.rows[entry * unpackedStride];
+			if (cache.keys[entry] != idx)
+			{
+				unpackQuantRow(row, table + idx * stride, unpackedStride, toUint8);
+				cache.keys[entry] = idx;
+			}
+			return row;
+		}
+
+		template<ArchType arch, class KeyType, class VlKeyType, size_t windowSize, bool quantized>
+		template<size_t slot>
+		auto CoNgramModel<arch, KeyType, VlKeyType, windowSize, quantized>::gatherRows(const uint8_t* table, size_t stride, size_t unpackedStride, bool toUint8, const int32_t* idcs, size_t n) const -> UnpackedRows
+		{
+			if (!compactEmb) return { table, idcs, stride };
+
+			thread_local utils::Scratch<Vector<uint8_t>> rowBuf;
+			thread_local utils::Scratch<Vector<int32_t>> idxBuf;
+			rowBuf.resize(n * unpackedStride);
+			idxBuf.resize(n);
+			for (size_t i = 0; i < n; ++i)
+			{
+				// 캐시의 행은 다른 slot의 호출에 의해 교체될 수 있으므로 slot별 버퍼로 복사해 둔다.
+				memcpy(&rowBuf[i * unpackedStride], cachedUnpackedRow(table, stride, unpackedStride, toUint8, idcs[i]), unpackedStride);
+				idxBuf[i] = (int32_t)i;
+			}
+			return { rowBuf.data(), idxBuf.data(), unpackedStride };
+		}
+
+		template<ArchType arch, class KeyType, class VlKeyType, size_t windowSize, bool quantized>
+		template<class Fn>
+		void CoNgramModel<arch, KeyType, VlKeyType, windowSize, quantized>::forEachUnpackedBlock(const uint8_t* table, size_t stride, size_t unpackedStride, bool toUint8, size_t numRows, Fn&& fn) const
+		{
+			if (!compactEmb) return fn(table, stride, (size_t)0, numRows);
+
+			// 커널이 4행 단위로 읽으므로 블록 크기는 4의 배수여야 하며, 버퍼는 항상 블록 크기만큼 확보한다.
+			static constexpr size_t blockSize = 1024;
+			thread_local utils::Scratch<Vector<uint8_t>> blockBuf;
+			blockBuf.resize(blockSize * unpackedStride);
+			for (size_t first = 0; first < numRows; first += blockSize)
+			{
+				const size_t size = min(blockSize, numRows - first);
+				for (size_t i = 0; i < size; ++i)
+				{
+					unpackQuantRow(&blockBuf[i * unpackedStride], table + (first + i) * stride, unpackedStride, toUint8);
+				}
+				fn((const uint8_t*)blockBuf.data(), unpackedStride, first, size);
+			}
+		}
+
 		template<ArchType arch, class KeyType, class VlKeyType, size_t windowSize, bool quantized>
 		float CoNgramModel<arch, KeyType, VlKeyType, windowSize, quantized>::progress(int32_t& nodeIdx,
 			uint32_t& contextIdx,
@@ -817,10 +954,12 @@ namespace kiwi
 						contextIdcs[i + 1] = (historyToken ? historyToken : 0) + header.contextSize;
 					}
 					logSoftmax<arch>(lls, windowSize + 1);
+					const auto contextRows = gatherContextRows<0>(contextIdcs, 1 + windowSize);
+					const auto outputRows = gatherOutputRows<1>(nextIdx, 1);
 					qgemm::scatteredGEMMOpt<arch>(
 						1 + windowSize, 1, header.dim,
-						getContextQuantEmb(0), contextIdcs, contextEmbStride(),
-						getOutputQuantEmb(0), nextIdx, outputEmbStride(),
+						contextRows.base, contextRows.idcs, contextRows.stride,
+						outputRows.baseS8(), outputRows.idcs, outputRows.stride,
 						&lls[1 + windowSize], 1);
 					for (size_t i = 0; i < 1 + windowSize; ++i)
 					{
@@ -870,12 +1009,12 @@ namespace kiwi
 			{
 				if constexpr (quantized)
 				{
-					const auto* contextPtr = getContextQuantEmb(unpackedContextId);
-					const auto* outputPtr = getOutputQuantEmb(next);
+					const auto* contextPtr = unpackedContextRow<0>(unpackedContextId);
+					const auto* outputPtr = unpackedOutputRow<1>(next);
 					float contextBias;
 					if constexpr (arch == ArchType::neon)
 					{
-						const auto* contextPtrS8 = getContextQuantEmbS8(unpackedContextId);
+						const auto* contextPtrS8 = reinterpret_cast<const int8_t*>(contextPtr);
 						const auto* contextRaw = reinterpret_cast<const uint8_t*>(contextPtrS8);
 						const float score = qgemm::dotS8S8<arch>(header.dim, contextPtrS8, outputPtr);
 						contextBias = *reinterpret_cast<const float*>(contextRaw + header.dim + sizeof(float));
@@ -969,6 +1108,18 @@ namespace kiwi
 			Vector<uint32_t> uniqHistoryTokens;
 			Vector<float> inputEmbBuf, outputEmbBuf; // only for non-quantized
 			Vector<int32_t> contextIdcs2, nextIdcs2; // only for quantized
+
+			size_t scratchBytes() const
+			{
+				using utils::estimateScratchBytes;
+				return estimateScratchBytes(contextCache)
+					+ estimateScratchBytes(contextIdcs) + estimateScratchBytes(historyIdcs) + estimateScratchBytes(nextIdcs)
+					+ estimateScratchBytes(inverseContextIdcs) + estimateScratchBytes(inverseHistoryIdcs) + estimateScratchBytes(inverseNextIdcs)
+					+ estimateScratchBytes(resultBuf) + estimateScratchBytes(confidenceBuf) + estimateScratchBytes(scoreBuf)
+					+ estimateScratchBytes(historyMap) + estimateScratchBytes(uniqHistoryTokens)
+					+ estimateScratchBytes(inputEmbBuf) + estimateScratchBytes(outputEmbBuf)
+					+ estimateScratchBytes(contextIdcs2) + estimateScratchBytes(nextIdcs2);
+			}
 		};
 
 		// specialization for windowSize > 0
@@ -1215,10 +1366,12 @@ namespace kiwi
 
 			if constexpr (quantized)
 			{
+				const auto contextRows = gatherContextRows<0>(tls.contextIdcs2.data(), uniqInputSize + uniqHistorySize);
+				const auto outputRows = gatherOutputRows<1>(tls.nextIdcs2.data(), uniqOutputSize);
 				qgemm::scatteredGEMMOpt<arch>(
 					uniqInputSize + uniqHistorySize, uniqOutputSize, header.dim,
-					getContextQuantEmb(0), tls.contextIdcs2.data(), contextEmbStride(),
-					getOutputQuantEmb(0), tls.nextIdcs2.data(), outputEmbStride(),
+					contextRows.base, contextRows.idcs, contextRows.stride,
+					outputRows.baseS8(), outputRows.idcs, outputRows.stride,
 					tls.resultBuf.data(), uniqOutputSize);
 			}
 			else
@@ -1382,10 +1535,12 @@ namespace kiwi
 
 			if constexpr (quantized)
 			{
+				const auto contextRows = gatherContextRows<0>(tls.contextIdcs2.data(), prevStateSize + uniqHistorySize);
+				const auto outputRows = gatherOutputRows<1>(tls.nextIdcs2.data(), nextIdSize);
 				qgemm::scatteredGEMMOpt<arch>(
 					prevStateSize + uniqHistorySize, nextIdSize, header.dim,
-					getContextQuantEmb(0), tls.contextIdcs2.data(), contextEmbStride(),
-					getOutputQuantEmb(0), tls.nextIdcs2.data(), outputEmbStride(),
+					contextRows.base, contextRows.idcs, contextRows.stride,
+					outputRows.baseS8(), outputRows.idcs, outputRows.stride,
 					tls.resultBuf.data(), nextIdSize);
 			}
 			else
@@ -1475,7 +1630,7 @@ namespace kiwi
 		{
 			if constexpr (windowSize > 0)
 			{
-				thread_local TLSForProgressMatrix tls;
+				thread_local utils::Scratch<TLSForProgressMatrix> tls;
 				if (prevStateSize <= (quantized ? 16 : 8) && nextIdSize <= 16)
 				{
 					return progressMatrixWOSort(tls, prevStates, nextIds, prevStateSize, nextIdSize, numValidDistantTokens, outStates, outScores);
@@ -1497,10 +1652,10 @@ namespace kiwi
 			size_t prevStateSize, size_t nextIdSize, size_t numValidDistantTokens,
 			LmStateType* outStates, float* outScores) const
 		{
-			thread_local Vector<uint64_t> contextIdcs, nextIdcs;
-			thread_local Vector<uint32_t> inverseContextIdcs, inverseNextIdcs;
-			thread_local Vector<float> inputEmbBuf, outputEmbBuf, resultBuf;
-			thread_local Vector<int32_t> contextIdcs2, nextIdcs2;
+			thread_local utils::Scratch<Vector<uint64_t>> contextIdcs, nextIdcs;
+			thread_local utils::Scratch<Vector<uint32_t>> inverseContextIdcs, inverseNextIdcs;
+			thread_local utils::Scratch<Vector<float>> inputEmbBuf, outputEmbBuf, resultBuf;
+			thread_local utils::Scratch<Vector<int32_t>> contextIdcs2, nextIdcs2;
 			
 			contextIdcs.resize(prevStateSize);
 			nextIdcs.resize(nextIdSize);
@@ -1572,10 +1727,12 @@ namespace kiwi
 			Eigen::Map<Eigen::MatrixXf> resultMap{ resultBuf.data(), (Eigen::Index)uniqOutputSize, (Eigen::Index)uniqInputSize };
 			if constexpr (quantized)
 			{
+				const auto contextRows = gatherContextRows<0>(contextIdcs2.data(), uniqInputSize);
+				const auto outputRows = gatherOutputRows<1>(nextIdcs2.data(), uniqOutputSize);
 				qgemm::scatteredGEMMOpt<arch>(
 					uniqInputSize, uniqOutputSize, header.dim,
-					getContextQuantEmb(0), contextIdcs2.data(), contextEmbStride(),
-					getOutputQuantEmb(0), nextIdcs2.data(), outputEmbStride(),
+					contextRows.base, contextRows.idcs, contextRows.stride,
+					outputRows.baseS8(), outputRows.idcs, outputRows.stride,
 					resultBuf.data(), uniqOutputSize);
 			}
 			else
@@ -2413,21 +2570,20 @@ namespace kiwi
 		}
 
 		template<ArchType arch, class KeyType, class VlKeyType, size_t windowSize, bool quantized>
-		size_t CoNgramModel<arch, KeyType, VlKeyType, windowSize, quantized>::mostSimilarWords(uint32_t vocabId, size_t topN, pair<uint32_t, float>* output) const
+		void CoNgramModel<arch, KeyType, VlKeyType, windowSize, quantized>::computeWordSimilarities(uint32_t vocabId, float* scores) const
 		{
-			if (vocabId >= header.vocabSize) return 0;
-
-			thread_local Vector<float> resultBuf;
-			resultBuf.resize(header.vocabSize * 2 + 8); // +8 for padding
-			float* scores = resultBuf.data() + header.vocabSize;
-
 			if constexpr (quantized)
 			{
-				qgemm::gemvS8S8<arch>(
-					header.vocabSize, header.dim,
-					getOutputQuantEmb(vocabId), 
-					getOutputQuantEmb(0), outputEmbStride(),
-					scores);
+				const auto* query = unpackedOutputRow<0>(vocabId);
+				forEachUnpackedBlock(outputEmbPtr, outputEmbStride(), unpackedOutputEmbStride(), false, header.vocabSize,
+					[&](const uint8_t* rows, size_t stride, size_t first, size_t size)
+				{
+					qgemm::gemvS8S8<arch>(
+						size, header.dim,
+						query,
+						reinterpret_cast<const int8_t*>(rows), stride,
+						scores + first);
+				});
 			}
 			else
 			{
@@ -2439,6 +2595,22 @@ namespace kiwi
 				);
 			}
 			gemm::mul<arch>(header.vocabSize, invNormOutputPtr[vocabId], invNormOutputPtr, scores);
+		}
+
+		template<ArchType arch, class KeyType, class VlKeyType, size_t windowSize, bool quantized>
+		size_t CoNgramModel<arch, KeyType, VlKeyType, windowSize, quantized>::mostSimilarWords(uint32_t vocabId, size_t topN, pair<uint32_t, float>* output) const
+		{
+			if (vocabId >= header.vocabSize) return 0;
+			if (similarityNumProbes.load(memory_order_relaxed))
+			{
+				return searchSimilarityIndex(false, vocabId, topN, output);
+			}
+
+			thread_local Vector<float> resultBuf;
+			resultBuf.resize(header.vocabSize * 2 + 8); // +8 for padding
+			float* scores = resultBuf.data() + header.vocabSize;
+
+			computeWordSimilarities(vocabId, scores);
 			scores[vocabId] = -99999.f; // remove self
 
 			pair<uint32_t, float>* resultPaired = reinterpret_cast<pair<uint32_t, float>*>(resultBuf.data());
@@ -2474,7 +2646,7 @@ namespace kiwi
 			{
 				result = qgemm::dotS8S8<arch>(
 					header.dim,
-					getOutputQuantEmb(vocabId1), getOutputQuantEmb(vocabId2)
+					unpackedOutputRow<0>(vocabId1), unpackedOutputRow<1>(vocabId2)
 				);
 			}
 			else
@@ -2491,35 +2663,33 @@ namespace kiwi
 		}
 
 		template<ArchType arch, class KeyType, class VlKeyType, size_t windowSize, bool quantized>
-		size_t CoNgramModel<arch, KeyType, VlKeyType, windowSize, quantized>::mostSimilarContexts(uint32_t contextId, size_t topN, std::pair<uint32_t, float>* output) const
+		void CoNgramModel<arch, KeyType, VlKeyType, windowSize, quantized>::computeContextSimilarities(uint32_t contextId, float* scores) const
 		{
-			contextId = unpackContextId(contextId);
-			if (contextId >= header.contextSize) return 0;
-
-			thread_local Vector<float> resultBuf;
-			resultBuf.resize(header.contextSize * 2 + 8); // +8 for padding
-			float* scores = resultBuf.data() + header.contextSize;
-
 			if constexpr (quantized)
 			{
-				if constexpr (arch == ArchType::neon)
-				{
-					qgemm::gemvS8S8<arch>(
-						header.contextSize, header.dim,
-						getContextQuantEmbS8(contextId),
-						getContextQuantEmbS8(0), contextEmbStride(),
-						scores
-					);
-				}
-				else
+				const auto* query = unpackedContextRow<0>(contextId);
+				forEachUnpackedBlock(contextEmbPtr, contextEmbStride(), unpackedContextEmbStride(), arch != ArchType::neon, header.contextSize,
+					[&](const uint8_t* rows, size_t stride, size_t first, size_t size)
 				{
-					qgemm::gemvU8U8<arch>(
-						header.contextSize, header.dim,
-						getContextQuantEmb(contextId),
-						getContextQuantEmb(0), contextEmbStride(),
-						scores
-					);
-				}
+					if constexpr (arch == ArchType::neon)
+					{
+						qgemm::gemvS8S8<arch>(
+							size, header.dim,
+							reinterpret_cast<const int8_t*>(query),
+							reinterpret_cast<const int8_t*>(rows), stride,
+							scores + first
+						);
+					}
+					else
+					{
+						qgemm::gemvU8U8<arch>(
+							size, header.dim,
+							query,
+							rows, stride,
+							scores + first
+						);
+					}
+				});
 			}
 			else
 			{
@@ -2531,25 +2701,42 @@ namespace kiwi
 				);
 			}
 			gemm::mul<arch>(header.contextSize, invNormContextPtr[contextId], invNormContextPtr, scores);
+		}
+
+		template<ArchType arch, class KeyType, class VlKeyType, size_t windowSize, bool quantized>
+		size_t CoNgramModel<arch, KeyType, VlKeyType, windowSize, quantized>::mostSimilarContexts(uint32_t contextId, size_t topN, std::pair<uint32_t, float>* output) const
+		{
+			contextId = unpackContextId(contextId);
+			if (contextId >= header.contextSize) return 0;
+			if (similarityNumProbes.load(memory_order_relaxed))
+			{
+				return searchSimilarityIndex(true, contextId, topN, output);
+			}
+
+			thread_local Vector<float> resultBuf;
+			resultBuf.resize(header.contextSize * 2 + 8); // +8 for padding
+			float* scores = resultBuf.data() + header.contextSize;
+
+			computeContextSimilarities(contextId, scores);
 			scores[contextId] = -99999.f; // remove self
 
 			pair<uint32_t, float>* resultPaired = reinterpret_cast<pair<uint32_t, float>*>(resultBuf.data());
-			for (size_t i = 0; i < header.vocabSize; ++i)
+			for (size_t i = 0; i < header.contextSize; ++i)
 			{
 				resultPaired[i] = make_pair((uint32_t)i, scores[i]);
 			}
 
-			topN = min(topN, (size_t)header.vocabSize);
+			topN = min(topN, (size_t)header.contextSize);
 
 			// if topN is small enough, use partial_sort
 			if (topN <= 256)
 			{
-				partial_sort_copy(resultPaired, resultPaired + header.vocabSize, output, output + topN,
+				partial_sort_copy(resultPaired, resultPaired + header.contextSize, output, output + topN,
 					[](const pair<uint32_t, float>& a, const pair<uint32_t, float>& b) { return a.second > b.second; });
 			}
 			else
 			{
-				sort(resultPaired, resultPaired + header.vocabSize,
+				sort(resultPaired, resultPaired + header.contextSize,
 					[](const pair<uint32_t, float>& a, const pair<uint32_t, float>& b) { return a.second > b.second; });
 				copy(resultPaired, resultPaired + topN, output);
 			}
@@ -2566,18 +2753,20 @@ namespace kiwi
 			float result = 0;
 			if constexpr (quantized)
 			{
+				const auto* contextPtr1 = unpackedContextRow<0>(contextId1);
+				const auto* contextPtr2 = unpackedContextRow<2>(contextId2);
 				if constexpr (arch == ArchType::neon)
 				{
 					result = qgemm::dotS8S8<arch>(
 						header.dim,
-						getContextQuantEmbS8(contextId1), getContextQuantEmbS8(contextId2)
+						reinterpret_cast<const int8_t*>(contextPtr1), reinterpret_cast<const int8_t*>(contextPtr2)
 					);
 				}
 				else
 				{
 					result = qgemm::dotU8U8<arch>(
 						header.dim,
-						getContextQuantEmb(contextId1), getContextQuantEmb(contextId2)
+						contextPtr1, contextPtr2
 					);
 				}
 			}
@@ -2594,6 +2783,115 @@ namespace kiwi
 			return result;
 		}
 
+		template<ArchType arch, class KeyType, class VlKeyType, size_t windowSize, bool quantized>
+		auto CoNgramModel<arch, KeyType, VlKeyType, windowSize, quantized>::getSimilarityIndex(bool context) const -> std::shared_ptr<const SimilarityIndex>
+		{
+			const size_t numItems = context ? header.contextSize : header.vocabSize;
+			size_t numLists = similarityNumLists.load(memory_order_relaxed);
+			if (!numLists) numLists = (size_t)sqrt((double)numItems);
+			numLists = max(min(numLists, numItems), (size_t)1);
+
+			auto& slot = context ? contextIndex : wordIndex;
+			auto index = atomic_load(&slot);
+			if (index && index->numLists == numLists) return index;
+
+			lock_guard<mutex> lock{ similarityIndexMutex };
+			index = atomic_load(&slot);
+			if (index && index->numLists == numLists) return index;
+
+			// 무작위로 고른 항목들을 클러스터의 대표로 삼고, 각 항목을 코사인 유사도가 가장 높은 대표에 배정한다.
+			// 대표 역시 임베딩의 한 행이므로 전체 탐색과 동일한 커널로 배정을 계산할 수 있다.
+			auto newIndex = make_shared<SimilarityIndex>();
+			newIndex->numLists = numLists;
+			{
+				Vector<uint32_t> ids(numItems);
+				iota(ids.begin(), ids.end(), 0);
+				mt19937_64 rng{ 42 };
+				for (size_t i = 0; i < numLists; ++i)
+				{
+					swap(ids[i], ids[i + rng() % (numItems - i)]);
+				}
+				newIndex->centroids.assign(ids.begin(), ids.begin() + numLists);
+				sort(newIndex->centroids.begin(), newIndex->centroids.end());
+			}
+
+			Vector<float> scores(numItems + 8), bestScores(numItems, -INFINITY);
+			Vector<uint32_t> assigned(numItems);
+			for (size_t c = 0; c < numLists; ++c)
+			{
+				if (context) computeContextSimilarities(newIndex->centroids[c], scores.data());
+				else computeWordSimilarities(newIndex->centroids[c], scores.data());
+				for (size_t i = 0; i < numItems; ++i)
+				{
+					if (scores[i] > bestScores[i])
+					{
+						bestScores[i] = scores[i];
+						assigned[i] = c;
+					}
+				}
+			}
+			for (size_t c = 0; c < numLists; ++c)
+			{
+				assigned[newIndex->centroids[c]] = c;
+			}
+
+			auto& offsets = newIndex->listOffsets;
+			offsets.resize(numLists + 1);
+			for (auto c : assigned) offsets[c + 1]++;
+			partial_sum(offsets.begin(), offsets.end(), offsets.begin());
+			newIndex->members.resize(numItems);
+			Vector<uint32_t> cursor(offsets.begin(), offsets.end() - 1);
+			for (size_t i = 0; i < numItems; ++i)
+			{
+				newIndex->members[cursor[assigned[i]]++] = i;
+			}
+
+			index = move(newIndex);
+			atomic_store(&slot, index);
+			return index;
+		}
+
+		template<ArchType arch, class KeyType, class VlKeyType, size_t windowSize, bool quantized>
+		size_t CoNgramModel<arch, KeyType, VlKeyType, windowSize, quantized>::searchSimilarityIndex(bool context, uint32_t queryId, size_t topN, std::pair<uint32_t, float>* output) const
+		{
+			const auto index = getSimilarityIndex(context);
+			const size_t numProbes = min(similarityNumProbes.load(memory_order_relaxed), index->numLists);
+			const auto similarity = [&](uint32_t a, uint32_t b)
+			{
+				return context ? contextSimilarity(a, b) : wordSimilarity(a, b);
+			};
+			const auto cmp = [](const pair<uint32_t, float>& a, const pair<uint32_t, float>& b) { return a.second > b.second; };
+
+			thread_local Vector<pair<uint32_t, float>> candidates;
+			thread_local Vector<uint32_t> probedLists;
+			candidates.clear();
+			for (size_t i = 0; i < index->numLists; ++i)
+			{
+				candidates.emplace_back((uint32_t)i, similarity(queryId, index->centroids[i]));
+			}
+			partial_sort(candidates.begin(), candidates.begin() + numProbes, candidates.end(), cmp);
+			probedLists.clear();
+			for (size_t i = 0; i < numProbes; ++i)
+			{
+				probedLists.emplace_back(candidates[i].first);
+			}
+
+			candidates.clear();
+			for (auto l : probedLists)
+			{
+				for (size_t i = index->listOffsets[l]; i < index->listOffsets[l + 1]; ++i)
+				{
+					const uint32_t id = index->members[i];
+					if (id == queryId) continue;
+					candidates.emplace_back(id, similarity(queryId, id));
+				}
+			}
+
+			topN = min(topN, candidates.size());
+			partial_sort_copy(candidates.begin(), candidates.end(), output, output + topN, cmp);
+			return topN;
+		}
+
 		template<ArchType arch, class KeyType, class VlKeyType, size_t windowSize, bool quantized>
 		size_t CoNgramModel<arch, KeyType, VlKeyType, windowSize, quantized>::predictWordsFromContext(uint32_t contextId, size_t topN, std::pair<uint32_t, float>* output) const
 		{
@@ -2605,24 +2903,29 @@ namespace kiwi
 			float* scores = resultBuf.data() + header.vocabSize;
 			if constexpr (quantized)
 			{
-				if constexpr (arch == ArchType::neon)
-				{
-					qgemm::gemvS8S8<arch>(
-						header.vocabSize, header.dim,
-						getContextQuantEmbS8(contextId),
-						getOutputQuantEmb(0), outputEmbStride(),
-						scores
-					);
-				}
-				else
+				const auto* query = unpackedContextRow<0>(contextId);
+				forEachUnpackedBlock(outputEmbPtr, outputEmbStride(), unpackedOutputEmbStride(), false, header.vocabSize,
+					[&](const uint8_t* rows, size_t stride, size_t first, size_t size)
 				{
-					qgemm::gemv<arch>(
-						header.vocabSize, header.dim,
-						getContextQuantEmb(contextId),
-						getOutputQuantEmb(0), outputEmbStride(),
-						scores
-					);
-				}
+					if constexpr (arch == ArchType::neon)
+					{
+						qgemm::gemvS8S8<arch>(
+							size, header.dim,
+							reinterpret_cast<const int8_t*>(query),
+							reinterpret_cast<const int8_t*>(rows), stride,
+							scores + first
+						);
+					}
+					else
+					{
+						qgemm::gemv<arch>(
+							size, header.dim,
+							query,
+							reinterpret_cast<const int8_t*>(rows), stride,
+							scores + first
+						);
+					}
+				});
 			}
 			else
 			{
@@ -2669,35 +2972,35 @@ namespace kiwi
 			float* scores = resultBuf.data() + header.vocabSize;
 			if constexpr (quantized)
 			{
-				if constexpr (arch == ArchType::neon)
+				const auto* bgQuery = unpackedContextRow<0>(bgContextId);
+				const auto* query = unpackedContextRow<2>(contextId);
+				// 행렬-벡터 곱은 결과를 4개 단위로 기록하므로, 앞쪽 결과가 scores 영역을 침범하지 않도록 두 번에 나누어 계산한다.
+				for (auto& job : { make_pair(bgQuery, resultBuf.data()), make_pair(query, scores) })
 				{
-					qgemm::gemvS8S8<arch>(
-						header.vocabSize, header.dim,
-						getContextQuantEmbS8(bgContextId),
-						getOutputQuantEmb(0), outputEmbStride(),
-						resultBuf.data()
-					);
-					qgemm::gemvS8S8<arch>(
-						header.vocabSize, header.dim,
-						getContextQuantEmbS8(contextId),
-						getOutputQuantEmb(0), outputEmbStride(),
-						scores
-					);
-				}
-				else
-				{
-					qgemm::gemv<arch>(
-						header.vocabSize, header.dim,
-						getContextQuantEmb(bgContextId),
-						getOutputQuantEmb(0), outputEmbStride(),
-						resultBuf.data()
-					);
-					qgemm::gemv<arch>(
-						header.vocabSize, header.dim,
-						getContextQuantEmb(contextId),
-						getOutputQuantEmb(0), outputEmbStride(),
-						scores
-					);
+					const auto* q = job.first;
+					float* out = job.second;
+					forEachUnpackedBlock(outputEmbPtr, outputEmbStride(), unpackedOutputEmbStride(), false, header.vocabSize,
+						[&](const uint8_t* rows, size_t stride, size_t first, size_t size)
+					{
+						if constexpr (arch == ArchType::neon)
+						{
+							qgemm::gemvS8S8<arch>(
+								size, header.dim,
+								reinterpret_cast<const int8_t*>(q),
+								reinterpret_cast<const int8_t*>(rows), stride,
+								out + first
+							);
+						}
+						else
+						{
+							qgemm::gemv<arch>(
+								size, header.dim,
+								q,
+								reinterpret_cast<const int8_t*>(rows), stride,
+								out + first
+							);
+						}
+					});
 				}
 			}
 			else
@@ -2743,6 +3046,263 @@ namespace kiwi
 			return topN;
 		}
 
+		template<ArchType arch, class KeyType, class VlKeyType, size_t windowSize, bool quantized>
+		template<class ScoreFn>
+		void CoNgramModel<arch, KeyType, VlKeyType, windowSize, quantized>::scanOutputTopN(size_t numQueries, const size_t* queryMap, const uint32_t* excludeIds,
+			size_t topN, std::pair<uint32_t, float>* output, size_t* outputSizes, ScoreFn&& scoreFn) const
+		{
+			// 블록 하나가 캐시에 머무르는 동안 질의 묶음 전체의 점수를 계산하므로, 출력 임베딩은 질의 묶음마다 한 번씩만 읽힌다.
+			static constexpr size_t scanBlockSize = 256;
+			static constexpr size_t ld = scanBlockSize + 8; // 커널이 결과를 4개 단위로 기록하므로 여유를 둔다
+			static constexpr size_t queryChunkSize = 64;
+			const auto cmp = [](const pair<uint32_t, float>& a, const pair<uint32_t, float>& b) { return a.second > b.second; };
+
+			for (size_t q = 0; q < numQueries; ++q)
+			{
+				outputSizes[queryMap[q]] = 0;
+			}
+			if (!numQueries || !topN) return;
+
+			thread_local Vector<float> scoreBuf;
+			scoreBuf.resize(min(numQueries, queryChunkSize) * ld);
+			for (size_t qBegin = 0; qBegin < numQueries; qBegin += queryChunkSize)
+			{
+				const size_t qSize = min(queryChunkSize, numQueries - qBegin);
+				forEachUnpackedBlock(outputEmbPtr, outputEmbStride(), unpackedOutputEmbStride(), false, header.vocabSize,
+					[&](const uint8_t* rows, size_t stride, size_t first, size_t size)
+				{
+					for (size_t b = 0; b < size; b += scanBlockSize)
+					{
+						const size_t blockSize = min(scanBlockSize, size - b);
+						scoreFn(rows + b * stride, stride, first + b, blockSize, qBegin, qSize, scoreBuf.data(), ld);
+						for (size_t q = 0; q < qSize; ++q)
+						{
+							auto* heap = output + queryMap[qBegin + q] * topN;
+							size_t& heapSize = outputSizes[queryMap[qBegin + q]];
+							const float* scores = &scoreBuf[q * ld];
+							for (size_t i = 0; i < blockSize; ++i)
+							{
+								const uint32_t id = (uint32_t)(first + b + i);
+								if (excludeIds && id == excludeIds[qBegin + q]) continue;
+								if (heapSize < topN)
+								{
+									heap[heapSize++] = make_pair(id, scores[i]);
+									push_heap(heap, heap + heapSize, cmp);
+								}
+								else if (scores[i] > heap[0].second)
+								{
+									pop_heap(heap, heap + heapSize, cmp);
+									heap[heapSize - 1] = make_pair(id, scores[i]);
+									push_heap(heap, heap + heapSize, cmp);
+								}
+							}
+						}
+					}
+				});
+			}
+
+			for (size_t q = 0; q < numQueries; ++q)
+			{
+				auto* heap = output + queryMap[q] * topN;
+				sort_heap(heap, heap + outputSizes[queryMap[q]], cmp);
+			}
+		}
+
+		template<ArchType arch, class KeyType, class VlKeyType, size_t windowSize, bool quantized>
+		void CoNgramModel<arch, KeyType, VlKeyType, windowSize, quantized>::mostSimilarWordsBatch(const uint32_t* vocabIds, size_t numQueries, size_t topN, 
+			std::pair<uint32_t, float>* output, size_t* outputSizes) const
+		{
+			if (similarityNumProbes.load(memory_order_relaxed))
+			{
+				for (size_t i = 0; i < numQueries; ++i)
+				{
+					outputSizes[i] = mostSimilarWords(vocabIds[i], topN, output + i * topN);
+				}
+				return;
+			}
+
+			thread_local Vector<size_t> queryMap;
+			thread_local Vector<uint32_t> queryIds;
+			queryMap.clear();
+			queryIds.clear();
+			for (size_t i = 0; i < numQueries; ++i)
+			{
+				if (vocabIds[i] < header.vocabSize)
+				{
+					queryMap.emplace_back(i);
+					queryIds.emplace_back(vocabIds[i]);
+				}
+				else
+				{
+					outputSizes[i] = 0;
+				}
+			}
+
+			if constexpr (quantized)
+			{
+				thread_local Vector<int32_t> queryIdcs;
+				queryIdcs.assign(queryIds.begin(), queryIds.end());
+				const auto queryRows = gatherOutputRows<0>(queryIdcs.data(), queryIdcs.size());
+				scanOutputTopN(queryMap.size(), queryMap.data(), queryIds.data(), topN, output, outputSizes,
+					[&](const uint8_t* rows, size_t stride, size_t first, size_t size, size_t qBegin, size_t qSize, float* scores, size_t ld)
+				{
+					for (size_t q = 0; q < qSize; ++q)
+					{
+						qgemm::gemvS8S8<arch>(
+							size, header.dim,
+							reinterpret_cast<const int8_t*>(queryRows.row(qBegin + q)),
+							reinterpret_cast<const int8_t*>(rows), stride,
+							scores + q * ld);
+						gemm::mul<arch>(size, invNormOutputPtr[queryIds[qBegin + q]], invNormOutputPtr + first, scores + q * ld);
+					}
+				});
+			}
+			else
+			{
+				thread_local Vector<float> queryEmbs;
+				queryEmbs.resize(queryIds.size() * header.dim);
+				for (size_t q = 0; q < queryIds.size(); ++q)
+				{
+					copy(getOutputEmb(queryIds[q]), getOutputEmb(queryIds[q]) + header.dim, &queryEmbs[q * header.dim]);
+				}
+				scanOutputTopN(queryMap.size(), queryMap.data(), queryIds.data(), topN, output, outputSizes,
+					[&](const uint8_t* rows, size_t stride, size_t first, size_t size, size_t qBegin, size_t qSize, float* scores, size_t ld)
+				{
+					gemm::template gemm<arch>(
+						size, qSize, header.dim,
+						reinterpret_cast<const float*>(rows), stride / sizeof(float),
+						&queryEmbs[qBegin * header.dim], header.dim,
+						scores, ld, true
+					);
+					for (size_t q = 0; q < qSize; ++q)
+					{
+						gemm::mul<arch>(size, invNormOutputPtr[queryIds[qBegin + q]], invNormOutputPtr + first, scores + q * ld);
+					}
+				});
+			}
+		}
+
+		template<ArchType arch, class KeyType, class VlKeyType, size_t windowSize, bool quantized>
+		void CoNgramModel<arch, KeyType, VlKeyType, windowSize, quantized>::wordSimilarityBatch(uint32_t vocabId, const uint32_t* candVocabIds, size_t size, float* output) const
+		{
+			if (vocabId >= header.vocabSize)
+			{
+				fill(output, output + size, NAN);
+				return;
+			}
+
+			if constexpr (quantized)
+			{
+				thread_local Vector<int32_t> candIdcs;
+				candIdcs.clear();
+				for (size_t i = 0; i < size; ++i)
+				{
+					if (candVocabIds[i] < header.vocabSize) candIdcs.emplace_back(candVocabIds[i]);
+				}
+
+				const auto* query = unpackedOutputRow<0>(vocabId);
+				const auto candRows = gatherOutputRows<1>(candIdcs.data(), candIdcs.size());
+				for (size_t i = 0, j = 0; i < size; ++i)
+				{
+					if (candVocabIds[i] >= header.vocabSize)
+					{
+						output[i] = NAN;
+						continue;
+					}
+					output[i] = qgemm::dotS8S8<arch>(header.dim, query, reinterpret_cast<const int8_t*>(candRows.row(j++)))
+						* invNormOutputPtr[vocabId] * invNormOutputPtr[candVocabIds[i]];
+				}
+			}
+			else
+			{
+				for (size_t i = 0; i < size; ++i)
+				{
+					output[i] = wordSimilarity(vocabId, candVocabIds[i]);
+				}
+			}
+		}
+
+		template<ArchType arch, class KeyType, class VlKeyType, size_t windowSize, bool quantized>
+		void CoNgramModel<arch, KeyType, VlKeyType, windowSize, quantized>::predictWordsFromContextBatch(const uint32_t* contextIds, size_t numQueries, size_t topN, 
+			std::pair<uint32_t, float>* output, size_t* outputSizes) const
+		{
+			thread_local Vector<size_t> queryMap;
+			thread_local Vector<uint32_t> queryIds;
+			queryMap.clear();
+			queryIds.clear();
+			for (size_t i = 0; i < numQueries; ++i)
+			{
+				const uint32_t contextId = unpackContextId(contextIds[i]);
+				if (contextId < header.contextSize)
+				{
+					queryMap.emplace_back(i);
+					queryIds.emplace_back(contextId);
+				}
+				else
+				{
+					outputSizes[i] = 0;
+				}
+			}
+
+			if constexpr (quantized)
+			{
+				thread_local Vector<int32_t> queryIdcs;
+				queryIdcs.assign(queryIds.begin(), queryIds.end());
+				const auto queryRows = gatherContextRows<0>(queryIdcs.data(), queryIdcs.size());
+				scanOutputTopN(queryMap.size(), queryMap.data(), nullptr, topN, output, outputSizes,
+					[&](const uint8_t* rows, size_t stride, size_t, size_t size, size_t qBegin, size_t qSize, float* scores, size_t ld)
+				{
+					for (size_t q = 0; q < qSize; ++q)
+					{
+						if constexpr (arch == ArchType::neon)
+						{
+							qgemm::gemvS8S8<arch>(
+								size, header.dim,
+								reinterpret_cast<const int8_t*>(queryRows.row(qBegin + q)),
+								reinterpret_cast<const int8_t*>(rows), stride,
+								scores + q * ld
+							);
+						}
+						else
+						{
+							qgemm::gemv<arch>(
+								size, header.dim,
+								queryRows.row(qBegin + q),
+								reinterpret_cast<const int8_t*>(rows), stride,
+								scores + q * ld
+							);
+						}
+						const float bias = getContextBias(queryIds[qBegin + q]);
+						for (size_t i = 0; i < size; ++i) scores[q * ld + i] += bias;
+					}
+				});
+			}
+			else
+			{
+				thread_local Vector<float> queryEmbs;
+				queryEmbs.resize(queryIds.size() * header.dim);
+				for (size_t q = 0; q < queryIds.size(); ++q)
+				{
+					copy(getContextEmb(queryIds[q]), getContextEmb(queryIds[q]) + header.dim, &queryEmbs[q * header.dim]);
+				}
+				scanOutputTopN(queryMap.size(), queryMap.data(), nullptr, topN, output, outputSizes,
+					[&](const uint8_t* rows, size_t stride, size_t, size_t size, size_t qBegin, size_t qSize, float* scores, size_t ld)
+				{
+					gemm::template gemm<arch>(
+						size, qSize, header.dim,
+						reinterpret_cast<const float*>(rows), stride / sizeof(float),
+						&queryEmbs[qBegin * header.dim], header.dim,
+						scores, ld, true
+					);
+					for (size_t q = 0; q < qSize; ++q)
+					{
+						const float bias = getContextBias(queryIds[qBegin + q]);
+						for (size_t i = 0; i < size; ++i) scores[q * ld + i] += bias;
+					}
+				});
+			}
+		}
+
 		template<ArchType arch, class KeyType, class VlKeyType, size_t windowSize, bool quantized>
 		uint32_t CoNgramModel<arch, KeyType, VlKeyType, windowSize, quantized>::toContextId(const uint32_t* vocabIds, size_t size) const
 		{
@@ -2881,37 +3441,37 @@ namespace kiwi
 		}
 
 		template<ArchType archType, class KeyTy, class VlKeyType, bool useDistantTokens, bool quantized>
-		inline unique_ptr<CoNgramModelBase> createOptimizedModelWithWindowSize(utils::MemoryObject&& mem)
+		inline unique_ptr<CoNgramModelBase> createOptimizedModelWithWindowSize(utils::MemoryObject&& mem, bool compactEmbedding)
 		{
 			auto& header = *reinterpret_cast<const CoNgramModelHeader*>(mem.get());
 			if (!useDistantTokens)
 			{
-				return make_unique<CoNgramModel<archType, KeyTy, VlKeyType, 0, quantized>>(std::move(mem));
+				return make_unique<CoNgramModel<archType, KeyTy, VlKeyType, 0, quantized>>(std::move(mem), compactEmbedding);
 			}
 
 			switch (header.windowSize)
 			{
 			case 7:
-				return make_unique<CoNgramModel<archType, KeyTy, VlKeyType, 7, quantized>>(std::move(mem));
+				return make_unique<CoNgramModel<archType, KeyTy, VlKeyType, 7, quantized>>(std::move(mem), compactEmbedding);
 			default:
 				throw runtime_error{ "Unsupported `window_size` : " + to_string((size_t)header.windowSize) };
 			};
 		}
 
 		template<ArchType archType, bool useDistantTokens, bool quantized>
-		unique_ptr<CoNgramModelBase> createOptimizedModel(utils::MemoryObject&& mem)
+		unique_ptr<CoNgramModelBase> createOptimizedModel(utils::MemoryObject&& mem, bool compactEmbedding)
 		{
 			auto& header = *reinterpret_cast<const CoNgramModelHeader*>(mem.get());
 			switch (header.keySize)
 			{
 			case 1: // only for ChrModel
-				return createOptimizedModelWithWindowSize<archType, uint16_t, uint8_t, false, quantized>(std::move(mem));
+				return createOptimizedModelWithWindowSize<archType, uint16_t, uint8_t, false, quantized>(std::move(mem), compactEmbedding);
 			case 2:
-				return createOptimizedModelWithWindowSize<archType, uint16_t, uint16_t, useDistantTokens, quantized>(std::move(mem));
+				return createOptimizedModelWithWindowSize<archType, uint16_t, uint16_t, useDistantTokens, quantized>(std::move(mem), compactEmbedding);
 			case 3:
-				return createOptimizedModelWithWindowSize<archType, uint32_t, uint16_t, useDistantTokens, quantized>(std::move(mem));
+				return createOptimizedModelWithWindowSize<archType, uint32_t, uint16_t, useDistantTokens, quantized>(std::move(mem), compactEmbedding);
 			case 4:
-				return createOptimizedModelWithWindowSize<archType, uint32_t, uint32_t, useDistantTokens, quantized>(std::move(mem));
+				return createOptimizedModelWithWindowSize<archType, uint32_t, uint32_t, useDistantTokens, quantized>(std::move(mem), compactEmbedding);
 			default:
 				throw runtime_error{ "Unsupported `key_size` : " + to_string((size_t)header.keySize) };
 			}
@@ -2929,7 +3489,7 @@ namespace kiwi
 			};
 		};
 
-		unique_ptr<CoNgramModelBase> CoNgramModelBase::create(utils::MemoryObject&& mem, ArchType archType, bool useDistantTokens, bool quantized)
+		unique_ptr<CoNgramModelBase> CoNgramModelBase::create(utils::MemoryObject&& mem, ArchType archType, bool useDistantTokens, bool quantized, bool compactEmbedding)
 		{
 			static tp::Table<FnCreateOptimizedModel, AvailableArch> tables[] = {
 				CreateOptimizedModelGetter<false, false>{},
@@ -2943,12 +3503,12 @@ namespace kiwi
 			if (quantized)
 			{
 				auto fn = quantTables[useDistantTokens ? 1 : 0][static_cast<ptrdiff_t>(archType)];
-				if (fn) return (*fn)(std::move(mem));
+				if (fn) return (*fn)(std::move(mem), compactEmbedding);
 				cerr << "Quantization is not supported for ArchType::" << archToStr(archType) << ". Fall back to non-quantized model." << endl;
 			}
 			auto fn = tables[useDistantTokens ? 1 : 0][static_cast<ptrdiff_t>(archType)];
 			if (!fn) throw runtime_error{ string{"Unsupported architecture : "} + archToStr(archType) };
-			return (*fn)(std::move(mem));
+			return (*fn)(std::move(mem), false);
 		}
 	}
 }
@@ -1,11 +1,13 @@
 #pragma once
 
+#include <mutex>
 #include <Eigen/Dense>
 
 #include <kiwi/Types.h>
 #include <kiwi/Utils.h>
 #include <kiwi/CoNgramModel.h>
 #include <kiwi/ArchUtils.h>
+#include <kiwi/ScratchSpace.h>
 #include "ArchAvailable.h"
 #include "search.h"
 #include "streamvbyte.h"
@@ -61,6 +63,19 @@ namespace kiwi
 			const float* invNormContextPtr = nullptr;
 			const float* invNormOutputPtr = nullptr;
 			const float* contextEmbEntropyPtr = nullptr;
+			bool compactEmb = false; // 4bit 임베딩을 압축된 상태 그대로 메모리에 유지하고, 연산에 필요한 행만 8bit로 풀어서 사용
+			size_t compactHeadSize = 0; // 압축 모드에서 한 행의 4bit 값과 스케일이 차지하는 크기
+			size_t rowCacheId = 0; // 스레드별 행 캐시가 어느 모델의 것인지 구분하기 위한 고유 번호
+
+			struct UnpackedRows
+			{
+				const uint8_t* base;
+				const int32_t* idcs;
+				size_t stride;
+
+				const int8_t* baseS8() const { return reinterpret_cast<const int8_t*>(base); }
+				const uint8_t* row(size_t i) const { return base + idcs[i] * stride; }
+			};
 
 			inline uint32_t unpackContextId(uint32_t v) const
 			{
@@ -86,24 +101,40 @@ namespace kiwi
 				}
 			}
 
+			inline size_t quantHeadSize() const
+			{
+				return compactEmb ? compactHeadSize : header.dim;
+			}
+
 			inline size_t contextEmbStride() const
 			{
-				if (quantized) return header.dim + (windowSize > 0 ? 4 : 2) * sizeof(float);
+				if (quantized) return quantHeadSize() + (windowSize > 0 ? 4 : 2) * sizeof(float);
 				else return (header.dim + (windowSize > 0 ? 3 : 1)) * sizeof(float);
 			}
 
 			inline size_t outputEmbStride() const
 			{
-				if (quantized) return header.dim + 2 * sizeof(float);
+				if (quantized) return quantHeadSize() + 2 * sizeof(float);
 				else return header.dim * sizeof(float);
 			}
 
 			inline size_t distantEmbStride() const
 			{
-				if (quantized) return header.dim + 4 * sizeof(float);
+				if (quantized) return quantHeadSize() + 4 * sizeof(float);
 				else return (header.dim + 2) * sizeof(float);
 			}
 
+			// 압축 모드에서 행을 풀었을 때의 크기. 연산 커널은 항상 이 형태의 행을 입력으로 받는다.
+			inline size_t unpackedContextEmbStride() const
+			{
+				return header.dim + (windowSize > 0 ? 4 : 2) * sizeof(float);
+			}
+
+			inline size_t unpackedOutputEmbStride() const
+			{
+				return header.dim + 2 * sizeof(float);
+			}
+
 			inline const float* getContextEmb(uint32_t idx) const
 			{
 				return reinterpret_cast<const float*>(contextEmbPtr + idx * contextEmbStride());
@@ -122,7 +153,7 @@ namespace kiwi
 			inline float getContextBias(uint32_t idx) const
 			{
 				const size_t offset = quantized ?
-					(header.dim + sizeof(float))
+					(quantHeadSize() + sizeof(float))
 					: (header.dim * sizeof(float));
 				return *reinterpret_cast<const float*>(contextEmbPtr + idx * contextEmbStride() + offset);
 			}
@@ -131,7 +162,7 @@ namespace kiwi
 			{
 				if (windowSize == 0) return 0;
 				const size_t offset = quantized ?
-					(header.dim + 2 * sizeof(float))
+					(quantHeadSize() + 2 * sizeof(float))
 					: (header.dim + 1) * sizeof(float);
 				return *reinterpret_cast<const float*>(contextEmbPtr + idx * contextEmbStride() + offset);
 			}
@@ -140,7 +171,7 @@ namespace kiwi
 			{
 				if (windowSize == 0) return 0;
 				const size_t offset = quantized ?
-					(header.dim + 3 * sizeof(float))
+					(quantHeadSize() + 3 * sizeof(float))
 					: (header.dim + 2) * sizeof(float);
 				return *reinterpret_cast<const float*>(contextEmbPtr + idx * contextEmbStride() + offset);
 			}
@@ -169,7 +200,7 @@ namespace kiwi
 			{
 				if (windowSize == 0) return 0;
 				const size_t offset = quantized ?
-					(header.dim + sizeof(float))
+					(quantHeadSize() + sizeof(float))
 					: (header.dim * sizeof(float));
 				return *reinterpret_cast<const float*>(distantEmbPtr + idx * distantEmbStride() + offset);
 			}
@@ -178,7 +209,7 @@ namespace kiwi
 			{
 				if (windowSize == 0) return 0;
 				const size_t offset = quantized ?
-					(header.dim + 2 * sizeof(float))
+					(quantHeadSize() + 2 * sizeof(float))
 					: (header.dim + 1) * sizeof(float);
 				return *reinterpret_cast<const float*>(distantEmbPtr + idx * distantEmbStride() + offset);
 			}
@@ -231,15 +262,96 @@ namespace kiwi
 			template<class Out>
 			void visitContextNode(MyNode* node, Vector<VlKeyType>& prefix, Out&& out) const;
 
+			/**
+			* @brief 유사 단어/문맥 검색용 IVF 색인.
+			*        centroids[i]를 대표로 하는 클러스터의 항목은 members[listOffsets[i], listOffsets[i + 1])이다.
+			*/
+			struct SimilarityIndex
+			{
+				size_t numLists = 0;
+				Vector<uint32_t> centroids, listOffsets, members;
+			};
+
+			mutable std::shared_ptr<const SimilarityIndex> wordIndex, contextIndex;
+			mutable std::mutex similarityIndexMutex;
+
+			void computeWordSimilarities(uint32_t vocabId, float* scores) const;
+			void computeContextSimilarities(uint32_t contextId, float* scores) const;
+
+			std::shared_ptr<const SimilarityIndex> getSimilarityIndex(bool context) const;
+			size_t searchSimilarityIndex(bool context, uint32_t queryId, size_t topN, std::pair<uint32_t, float>* output) const;
+
+			/**
+			* @brief 출력 임베딩 전체를 작은 블록으로 나누어 훑으면서 scoreFn(rows, stride, first, size, qBegin, qSize, scores, ld)으로
+			*        [qBegin, qBegin + qSize) 범위 질의의 점수를 계산하고, 질의마다 output[queryMap[q] * topN]을 힙으로 사용하여 상위 topN개를 고른다.
+			*        점수 버퍼가 질의 개수에 비례해 커지지 않도록 질의는 일정 개수씩 나누어 처리한다.
+			*/
+			template<class ScoreFn>
+			void scanOutputTopN(size_t numQueries, const size_t* queryMap, const uint32_t* excludeIds,
+				size_t topN, std::pair<uint32_t, float>* output, size_t* outputSizes, ScoreFn&& scoreFn) const;
+
+			void unpackQuantRow(uint8_t* out, const uint8_t* row, size_t unpackedStride, bool toUint8) const;
+
+			/**
+			* @brief 압축 모드에서 idx번째 행을 풀어서 반환한다. 최근에 푼 행은 테이블마다 스레드별 캐시에 보관하여 다시 풀지 않는다.
+			*        반환된 포인터는 같은 테이블에 대한 다음 호출 전까지만 유효하다.
+			*/
+			const uint8_t* cachedUnpackedRow(const uint8_t* table, size_t stride, size_t unpackedStride, bool toUint8, int32_t idx) const;
+
+			/**
+			* @brief 압축 모드에서 idcs가 가리키는 행들만 8bit로 풀어서 스레드별 버퍼에 모은 뒤 반환한다.
+			*        압축 모드가 아니면 원본 테이블을 그대로 반환한다. 동시에 사용하는 호출끼리는 서로 다른 slot을 지정해야 한다.
+			*/
+			template<size_t slot>
+			UnpackedRows gatherRows(const uint8_t* table, size_t stride, size_t unpackedStride, bool toUint8, const int32_t* idcs, size_t n) const;
+
+			template<size_t slot>
+			UnpackedRows gatherContextRows(const int32_t* idcs, size_t n) const
+			{
+				return gatherRows<slot>(contextEmbPtr, contextEmbStride(), unpackedContextEmbStride(), arch != ArchType::neon, idcs, n);
+			}
+
+			template<size_t slot>
+			UnpackedRows gatherOutputRows(const int32_t* idcs, size_t n) const
+			{
+				return gatherRows<slot>(outputEmbPtr, outputEmbStride(), unpackedOutputEmbStride(), false, idcs, n);
+			}
+
+			template<size_t slot>
+			const uint8_t* unpackedContextRow(size_t idx) const
+			{
+				const int32_t i = (int32_t)idx;
+				return gatherContextRows<slot>(&i, 1).row(0);
+			}
+
+			template<size_t slot>
+			const int8_t* unpackedOutputRow(size_t idx) const
+			{
+				const int32_t i = (int32_t)idx;
+				return reinterpret_cast<const int8_t*>(gatherOutputRows<slot>(&i, 1).row(0));
+			}
+
+			/**
+			* @brief 테이블 전체를 일정 크기의 블록 단위로 풀어서 fn(rows, stride, first, size)를 호출한다.
+			*        압축 모드가 아니면 테이블 전체에 대해 한 번만 호출한다.
+			*/
+			template<class Fn>
+			void forEachUnpackedBlock(const uint8_t* table, size_t stride, size_t unpackedStride, bool toUint8, size_t numRows, Fn&& fn) const;
+
 		public:
 			using VocabType = KeyType;
 			using LmStateType = CoNgramState<windowSize, arch, VocabType, VlKeyType, quantized>;
 
-			CoNgramModel(utils::MemoryObject&& mem);
+			CoNgramModel(utils::MemoryObject&& mem, bool compactEmbedding = false);
 
 			ModelType getType() const override 
 			{ 
-				if (quantized)
+				if (quantized && compactEmb)
+				{
+					if (windowSize > 0) return ModelType::congGlobalQ4;
+					else return ModelType::congQ4;
+				}
+				else if (quantized)
 				{
 					if (windowSize > 0) return ModelType::congGlobal;
 					else return ModelType::cong;
@@ -259,8 +371,13 @@ namespace kiwi
 			float contextSimilarity(uint32_t contextId1, uint32_t contextId2) const override;
 			size_t predictWordsFromContext(uint32_t contextId, size_t topN, std::pair<uint32_t, float>* output) const override;
 			size_t predictWordsFromContextDiff(uint32_t contextId, uint32_t bgContextId, float weight, size_t topN, std::pair<uint32_t, float>* output) const override;
+			void mostSimilarWordsBatch(const uint32_t* vocabIds, size_t numQueries, size_t topN, std::pair<uint32_t, float>* output, size_t* outputSizes) const override;
+			void wordSimilarityBatch(uint32_t vocabId, const uint32_t* candVocabIds, size_t size, float* output) const override;
+			void predictWordsFromContextBatch(const uint32_t* contextIds, size_t numQueries, size_t topN, std::pair<uint32_t, float>* output, size_t* outputSizes) const override;
 			
 			float progressOneStep(int32_t& nodeIdx, uint32_t& contextIdx, uint32_t next) const override;
+
+			bool hasCompactEmbedding() const override { return compactEmb; }
 			float getContextFrequency(uint32_t contextId) const override;
 			float getContextEntropy(uint32_t contextId) const override;
 			size_t getNodeDepth(uint32_t nodeId) const override;
@@ -3,9 +3,12 @@
 #include <unordered_set>
 #include <algorithm>
 #include <limits>
+#include <mutex>
+#include <atomic>
 
 #include <kiwi/Utils.h>
 #include <kiwi/TagUtils.h>
+#include <kiwi/ThreadPool.h>
 #include "Combiner.h"
 #include "FeatureTestor.h"
 #include "StrUtils.h"
@@ -29,6 +32,175 @@ Pattern::~Pattern() = default;
 Pattern& Pattern::operator=(const Pattern&) = default;
 Pattern& Pattern::operator=(Pattern&&) = default;
 
+class CompiledRule::CombineCache
+{
+	using Entry = tuple<KString, size_t, size_t>;
+
+	// 최근에 사용된 항목은 current에, 그 이전 세대의 항목은 previous에 둔다.
+	// current가 가득 차면 previous를 버리고 current를 previous로 넘기므로, 자주 쓰이는 항목은 계속 살아남는다.
+	struct Shard
+	{
+		mutable mutex mtx;
+		UnorderedMap<KString, Entry> current, previous;
+	};
+
+	static constexpr size_t numShards = 16;
+	std::array<Shard, numShards> shards;
+	// 결합 중인 다른 스레드가 캐시를 계속 참조할 수 있으므로, 용량은 객체를 교체하지 않고 setCapacity로 제자리에서 바꾼다.
+	atomic<size_t> capacity{ 0 };
+	size_t generationSize = 0; // 모든 shard의 mtx를 잡은 상태에서만 변경된다.
+	atomic<size_t> hits{ 0 }, misses{ 0 };
+	atomic<bool> warmedUp{ false };
+
+	Shard& getShard(const KString& key)
+	{
+		return shards[hash<KString>{}(key) % numShards];
+	}
+
+	void makeRoom(Shard& shard)
+	{
+		if (shard.current.size() < generationSize) return;
+		shard.previous = move(shard.current);
+		shard.current.clear();
+	}
+
+public:
+	static constexpr size_t defaultCapacity = 1 << 16;
+
+	// 활성 구간이 이보다 긴 경우는 반복될 가능성이 낮으므로 캐시하지 않는다.
+	static constexpr size_t maxKeyLength = 64;
+
+	CombineCache(size_t _capacity = defaultCapacity)
+		: capacity{ _capacity }, generationSize{ max(_capacity / numShards / 2, (size_t)1) }
+	{
+	}
+
+	size_t getCapacity() const { return capacity.load(memory_order_relaxed); }
+
+	/**
+	* @brief 용량을 바꾸고 저장된 항목과 통계를 모두 비운다.
+	*/
+	void setCapacity(size_t _capacity)
+	{
+		std::array<unique_lock<mutex>, numShards> locks;
+		for (size_t i = 0; i < numShards; ++i) locks[i] = unique_lock<mutex>{ shards[i].mtx };
+		for (auto& shard : shards)
+		{
+			shard.current = {};
+			shard.previous = {};
+		}
+		generationSize = max(_capacity / numShards / 2, (size_t)1);
+		capacity.store(_capacity);
+		hits.store(0);
+		misses.store(0);
+		warmedUp.store(false);
+	}
+
+	/**
+	* @brief 결합 입력을 하나의 문자열 키로 묶는다. 키로 만들 수 없을 정도로 긴 경우 false를 반환한다.
+	*/
+	static bool makeKey(KString& key,
+		U16StringView leftForm, POSTag leftTag,
+		U16StringView rightForm, POSTag rightTag,
+		CondVowel cv)
+	{
+		if (leftForm.size() + rightForm.size() > maxKeyLength) return false;
+		key.clear();
+		key.reserve(leftForm.size() + rightForm.size() + 4);
+		key.push_back((char16_t)leftForm.size());
+		key.append(leftForm.begin(), leftForm.end());
+		key.append(rightForm.begin(), rightForm.end());
+		key.push_back((char16_t)leftTag);
+		key.push_back((char16_t)rightTag);
+		key.push_back((char16_t)cv);
+		return true;
+	}
+
+	CombineCacheStats getStats() const
+	{
+		CombineCacheStats ret;
+		ret.capacity = getCapacity();
+		for (auto& shard : shards)
+		{
+			lock_guard<mutex> lock{ shard.mtx };
+			ret.size += shard.current.size() + shard.previous.size();
+		}
+		ret.hits = hits.load(memory_order_relaxed);
+		ret.misses = misses.load(memory_order_relaxed);
+		return ret;
+	}
+
+	bool find(const KString& key, Entry& out)
+	{
+		auto& shard = getShard(key);
+		lock_guard<mutex> lock{ shard.mtx };
+		auto it = shard.current.find(key);
+		if (it == shard.current.end())
+		{
+			auto pit = shard.previous.find(key);
+			if (pit == shard.previous.end())
+			{
+				misses.fetch_add(1, memory_order_relaxed);
+				return false;
+			}
+			Entry entry = move(pit->second);
+			shard.previous.erase(pit);
+			makeRoom(shard);
+			it = shard.current.emplace(key, move(entry)).first;
+		}
+		hits.fetch_add(1, memory_order_relaxed);
+		out = it->second;
+		return true;
+	}
+
+	bool insert(const KString& key, const Entry& entry)
+	{
+		auto& shard = getShard(key);
+		lock_guard<mutex> lock{ shard.mtx };
+		if (shard.current.count(key) || shard.previous.count(key)) return false;
+		makeRoom(shard);
+		shard.current.emplace(key, entry);
+		return true;
+	}
+
+	bool markWarmedUp()
+	{
+		return !warmedUp.exchange(true);
+	}
+
+	void clear()
+	{
+		for (auto& shard : shards)
+		{
+			lock_guard<mutex> lock{ shard.mtx };
+			shard.current = {};
+			shard.previous = {};
+		}
+		warmedUp.store(false);
+	}
+};
+
+CompiledRule::CombineCacheHolder::CombineCacheHolder()
+	: cache{ make_unique<CombineCache>() }
+{
+}
+
+CompiledRule::CombineCacheHolder::CombineCacheHolder(const CombineCacheHolder& o)
+	: cache{ make_unique<CombineCache>(o.cache ? o.cache->getCapacity() : CombineCache::defaultCapacity) }
+{
+}
+
+CompiledRule::CombineCacheHolder::CombineCacheHolder(CombineCacheHolder&&) noexcept = default;
+CompiledRule::CombineCacheHolder::~CombineCacheHolder() = default;
+
+CompiledRule::CombineCacheHolder& CompiledRule::CombineCacheHolder::operator=(const CombineCacheHolder& o)
+{
+	cache = make_unique<CombineCache>(o.cache ? o.cache->getCapacity() : CombineCache::defaultCapacity);
+	return *this;
+}
+
+CompiledRule::CombineCacheHolder& CompiledRule::CombineCacheHolder::operator=(CombineCacheHolder&&) noexcept = default;
+
 CompiledRule::CompiledRule() = default;
 CompiledRule::CompiledRule(const CompiledRule&) = default;
 CompiledRule::CompiledRule(CompiledRule&&) noexcept = default;
@@ -1324,6 +1496,87 @@ tuple<KString, size_t, size_t> CompiledRule::combineOneImpl(
 	return make_tuple(ret, leftForm.size(), leftForm.size());
 }
 
+tuple<KString, size_t, size_t> CompiledRule::combineOneCached(
+	U16StringView leftForm, POSTag leftTag,
+	U16StringView rightForm, POSTag rightTag,
+	CondVowel cv
+) const
+{
+	// 결합 규칙의 왼쪽 패턴은 길이 제한 없이 앞쪽을 참조할 수 있으므로, 활성 구간 전체를 키로 사용한다.
+	thread_local KString key;
+	auto* cache = combineCache.cache.get();
+	if (!cache || !cache->getCapacity()
+		|| !CombineCache::makeKey(key, leftForm, leftTag, rightForm, rightTag, cv))
+	{
+		return combineOneImpl(leftForm, leftTag, rightForm, rightTag, cv);
+	}
+
+	tuple<KString, size_t, size_t> ret;
+	if (cache->find(key, ret)) return ret;
+	ret = combineOneImpl(leftForm, leftTag, rightForm, rightTag, cv);
+	cache->insert(key, ret);
+	return ret;
+}
+
+void CompiledRule::setCombineCacheSize(size_t capacity)
+{
+	if (combineCache.cache) combineCache.cache->setCapacity(capacity);
+	else combineCache.cache = make_unique<CombineCache>(capacity);
+}
+
+size_t CompiledRule::getCombineCacheSize() const
+{
+	return combineCache.cache ? combineCache.cache->getCapacity() : 0;
+}
+
+CombineCacheStats CompiledRule::getCombineCacheStats() const
+{
+	return combineCache.cache ? combineCache.cache->getStats() : CombineCacheStats{};
+}
+
+void CompiledRule::clearCombineCache()
+{
+	if (combineCache.cache) combineCache.cache->clear();
+}
+
+size_t CompiledRule::warmUpCombineCache(
+	const vector<pair<KString, POSTag>>& leftMorphs,
+	const vector<pair<KString, POSTag>>& rightMorphs,
+	size_t maxEntries,
+	utils::ThreadPool* pool
+) const
+{
+	auto* cache = combineCache.cache.get();
+	if (!cache || !cache->getCapacity() || leftMorphs.empty() || rightMorphs.empty()) return 0;
+	if (!maxEntries) maxEntries = cache->getCapacity();
+
+	const size_t numLefts = min(leftMorphs.size(), (maxEntries + rightMorphs.size() - 1) / rightMorphs.size());
+	const size_t sizeBefore = cache->getStats().size;
+	// Joiner를 그대로 거치므로 이형태 선택 등 실제 결합 과정에서 만들어지는 것과 동일한 키가 저장된다.
+	utils::forEachShard(pool, numLefts, pool ? pool->size() * 4 : 1, [&](size_t, size_t first, size_t last)
+	{
+		for (size_t i = first; i < last; ++i)
+		{
+			auto& l = leftMorphs[i];
+			const size_t numRights = min(rightMorphs.size(), maxEntries - min(maxEntries, i * rightMorphs.size()));
+			for (size_t j = 0; j < numRights; ++j)
+			{
+				auto& r = rightMorphs[j];
+				Joiner joiner{ *this };
+				joiner.add(U16StringView{ l.first.data(), l.first.size() }, l.second, Space::none);
+				joiner.add(U16StringView{ r.first.data(), r.first.size() }, r.second, Space::no_space);
+			}
+		}
+	});
+	const size_t sizeAfter = cache->getStats().size;
+	return sizeAfter > sizeBefore ? sizeAfter - sizeBefore : 0;
+}
+
+bool CompiledRule::markCombineCacheWarmedUp() const
+{
+	return combineCache.cache && combineCache.cache->getCapacity() && combineCache.cache->markWarmedUp();
+}
+
 Vector<tuple<size_t, size_t, CondPolarity>> CompiledRule::testLeftPattern(U16StringView leftForm, size_t ruleId) const
 {
 	return visit(SearchLeftVisitor{ leftForm, true }, dfa[ruleId]);
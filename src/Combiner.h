@@ -1,6 +1,7 @@
 #pragma once
 
 #include <variant>
+#include <memory>
 #include <kiwi/Types.h>
 #include <kiwi/TemplateUtils.hpp>
 #include <kiwi/Joiner.h>
@@ -12,6 +13,11 @@ namespace kiwi
 
 	template<class Ty> class RaggedVector;
 
+	namespace utils
+	{
+		class ThreadPool;
+	}
+
 	namespace cmb
 	{
 		inline size_t additionalFeatureToMask(POSTag additionalFeature)
@@ -322,6 +328,35 @@ namespace kiwi
 
 			static uint8_t toFeature(CondVowel cv, CondPolarity cp);
 
+			class CombineCache;
+
+			/**
+			 * @brief CombineCache를 소유하는 래퍼.
+			 * CompiledRule이 복사될 때 캐시의 내용은 복사하지 않고 용량 설정만 복사한다.
+			 */
+			struct CombineCacheHolder
+			{
+				std::unique_ptr<CombineCache> cache;
+
+				CombineCacheHolder();
+				CombineCacheHolder(const CombineCacheHolder&);
+				CombineCacheHolder(CombineCacheHolder&&) noexcept;
+				~CombineCacheHolder();
+				CombineCacheHolder& operator=(const CombineCacheHolder&);
+				CombineCacheHolder& operator=(CombineCacheHolder&&) noexcept;
+			};
+
+			CombineCacheHolder combineCache;
+
+			/**
+			 * @brief combineOneImpl과 동일하되, 같은 입력에 대한 결과를 캐시에 저장하여 재사용한다.
+			 */
+			std::tuple<KString, size_t, size_t> combineOneCached(
+				U16StringView leftForm, POSTag leftTag,
+				U16StringView rightForm, POSTag rightTag,
+				CondVowel cv
+			) const;
+
 		public:
 
 			CompiledRule();
@@ -352,6 +387,36 @@ namespace kiwi
 
 			void addAllomorph(const std::vector<std::tuple<U16StringView, CondVowel, uint8_t>>& forms, POSTag tag);
 
+			/**
+			 * @brief Joiner가 사용하는 형태소 결합 캐시의 최대 항목 수를 설정한다. 0이면 캐시를 사용하지 않는다.
+			 * 
+			 * 캐시는 (왼쪽 형태, 왼쪽 품사, 오른쪽 형태, 오른쪽 품사, 모음 조건)을 키로 결합 결과를 저장하며,
+			 * 여러 스레드에서 동시에 사용해도 안전하다. 설정을 바꾸면 기존에 저장된 항목은 모두 삭제된다.
+			 */
+			void setCombineCacheSize(size_t capacity);
+			size_t getCombineCacheSize() const;
+			CombineCacheStats getCombineCacheStats() const;
+			void clearCombineCache();
+
+			/**
+			 * @brief 왼쪽 형태소와 오른쪽 형태소의 쌍을 결합하여 캐시를 미리 채운다.
+			 * 
+			 * 왼쪽 형태소 순서대로 모든 오른쪽 형태소와의 쌍을 만들되, 쌍의 개수가 maxEntries를 넘지 않도록 한다.
+			 * maxEntries가 0이면 캐시의 용량을 사용한다.
+			 * @return 캐시에 새로 추가된 항목 수
+			 */
+			size_t warmUpCombineCache(
+				const std::vector<std::pair<KString, POSTag>>& leftMorphs,
+				const std::vector<std::pair<KString, POSTag>>& rightMorphs,
+				size_t maxEntries = 0,
+				utils::ThreadPool* pool = nullptr
+			) const;
+
+			/**
+			 * @brief 캐시를 처음 미리 채우는 경우에만 true를 반환한다. clearCombineCache 이후에는 다시 true를 반환한다.
+			 */
+			bool markCombineCacheWarmedUp() const;
+
 			/**
 			 * @return vector of tuple(replaceGroupId, capturedStartPos, replaceGroupCondition)
 			 */
@@ -6,6 +6,88 @@
 
 using namespace kiwi;
 
+struct HSDataset::Prefetcher
+{
+	std::function<size_t(HSDataset&, size_t, HSPrefetchedBatch&)> fill;
+	Vector<HSPrefetchedBatch> batches;
+	Vector<uint8_t> acquired;
+	Deque<size_t> freeSlots, readySlots;
+	std::mutex mutex;
+	std::condition_variable cv;
+	std::thread thread;
+	std::exception_ptr error;
+	bool stopped = false;
+	bool exhausted = false;
+
+	~Prefetcher()
+	{
+		halt();
+	}
+
+	void halt()
+	{
+		{
+			std::lock_guard<std::mutex> lock{ mutex };
+			stopped = true;
+		}
+		cv.notify_all();
+		if (thread.joinable()) thread.join();
+		stopped = false;
+	}
+
+	void clear()
+	{
+		freeSlots.clear();
+		readySlots.clear();
+		acquired.assign(batches.size(), 0);
+		for (size_t i = 0; i < batches.size(); ++i) freeSlots.emplace_back(i);
+		error = nullptr;
+		exhausted = false;
+	}
+
+	void run(HSDataset& owner)
+	{
+		while (1)
+		{
+			size_t slot;
+			{
+				std::unique_lock<std::mutex> lock{ mutex };
+				cv.wait(lock, [&]() { return stopped || !freeSlots.empty(); });
+				if (stopped) return;
+				slot = freeSlots.front();
+				freeSlots.pop_front();
+			}
+
+			size_t size = 0;
+			std::exception_ptr e;
+			try
+			{
+				size = fill(owner, slot, batches[slot]);
+			}
+			catch (...)
+			{
+				e = std::current_exception();
+			}
+
+			{
+				std::lock_guard<std::mutex> lock{ mutex };
+				if (size)
+				{
+					readySlots.emplace_back(slot);
+				}
+				else
+				{
+					freeSlots.emplace_front(slot);
+					error = e;
+					exhausted = true;
+				}
+			}
+			cv.notify_all();
+			if (!size) return;
+		}
+	}
+};
+
 HSDataset::HSDataset(size_t _batchSize, 
 	size_t _causalContextSize, 
 	size_t _windowSize, 
@@ -44,7 +126,30 @@ HSDataset::HSDataset(size_t _batchSize,
 {
 }
 
-HSDataset::~HSDataset() = default;
+HSDataset::PrefetcherPtr::PrefetcherPtr() = default;
+
+HSDataset::PrefetcherPtr::PrefetcherPtr(PrefetcherPtr&& o) noexcept
+{
+	// 이동 대상의 다른 멤버들이 옮겨지기 전에 원본의 prefetch 스레드를 멈춘다.
+	if (o.ptr) o.ptr->halt();
+	ptr = std::move(o.ptr);
+}
+
+HSDataset::PrefetcherPtr& HSDataset::PrefetcherPtr::operator=(PrefetcherPtr&& o) noexcept
+{
+	if (this == &o) return *this;
+	if (ptr) ptr->halt();
+	if (o.ptr) o.ptr->halt();
+	ptr = std::move(o.ptr);
+	return *this;
+}
+
+HSDataset::PrefetcherPtr::~PrefetcherPtr() = default;
+
+HSDataset::~HSDataset()
+{
+	stopPrefetch();
+}
 
 HSDataset::HSDataset(HSDataset&& o) /*noexcept*/ = default;
 
@@ -54,7 +159,7 @@ constexpr int32_t HSDataset::nonVocab;
 
 size_t HSDataset::numSents() const
 {
-	return sents.get().size();
+	return sentView.get().size();
 }
 
 size_t HSDataset::numTokens() const
@@ -64,11 +169,40 @@ size_t HSDataset::numTokens() const
 
 size_t HSDataset::numEstimBatches() const
 {
-	return (numTokens() + batchSize - 1) / batchSize;
+	return (numTokens() / shardWorldSize + batchSize - 1) / batchSize;
+}
+
+void HSDataset::bindSents()
+{
+	auto& view = sentView.get();
+	view.clear();
+	view.append(sents.get());
+}
+
+void HSDataset::setShard(size_t rank, size_t worldSize)
+{
+	if (!worldSize || rank >= worldSize)
+	{
+		throw std::invalid_argument{ "`rank` must be less than `worldSize`" };
+	}
+	shardRank = rank;
+	shardWorldSize = worldSize;
+}
+
+std::pair<size_t, size_t> HSDataset::shardRange() const
+{
+	const size_t n = shuffledIdx.size();
+	return std::make_pair(n * shardRank / shardWorldSize, n * (shardRank + 1) / shardWorldSize);
 }
 
 void HSDataset::reset()
 {
+	if (prefetcher)
+	{
+		prefetcher->halt();
+		prefetcher->clear();
+	}
+
 	while (!futures.empty())
 	{
 		futures.front().get();
@@ -81,6 +215,7 @@ void HSDataset::reset()
 		shuffledIdx.resize(numSents());
 		std::iota(shuffledIdx.begin() + s, shuffledIdx.end(), s);
 	}
+	// 모든 rank가 같은 순서로 섞은 뒤 자신의 구간만 순회하므로, rng의 상태는 rank와 관계없이 동일하게 유지되어야 한다.
 	std::shuffle(shuffledIdx.begin(), shuffledIdx.end(), rng);
 	passedSents = 0;
 	passedWorkItems = 0;
@@ -92,14 +227,14 @@ void HSDataset::reset()
 		l.outNgramNodeData.clear();
 		l.restLmLProbsData.clear();
 		l.restLmLProbsCntData.clear();
-		l.rng.seed(rng());
+		l.rng.seed(rng() + shardRank);
 	}
 }
 
 size_t HSDataset::numValidTokensInSent(size_t sentId) const
 {
 	size_t c = 0;
-	for (auto t : sents.get()[sentId])
+	for (auto t : sentView.get()[sentId])
 	{
 		if (oovDict && t < 0)
 		{
@@ -340,10 +475,10 @@ size_t HSDataset::_next(InTy in, OutTy out, LmTy lmLProbs, NgramTy outNgramNode,
 		auto& local = locals[localId];
 		auto& tokens = local.tokenBuf;
 		const auto& morphs = *morphemes;
-		tokens.reserve(sents.get()[shuffledIdx[sentFirst]].size());
+		tokens.reserve(sentView.get()[shuffledIdx[sentFirst]].size());
 		for (size_t s = sentFirst; s < sentLast; ++s)
 		{
-			auto sent = sents.get()[shuffledIdx[s]];
+			auto sent = sentView.get()[shuffledIdx[s]];
 			tokens.clear();
 			tokens.emplace_back(sent[0]);
 			for (auto p = sent.begin() + 1; p != sent.end() - 1; ++p)
@@ -547,20 +682,22 @@ size_t HSDataset::_next(InTy in, OutTy out, LmTy lmLProbs, NgramTy outNgramNode,
 
 	fillSbTokenIds();
 
+	const auto shard = shardRange();
+	const size_t shardSize = shard.second - shard.first;
 	size_t localId;
 	if (workers)
 	{
-		while (passedSents < numSents() && futures.size() < workers->size())
+		while (passedSents < shardSize && futures.size() < workers->size())
 		{
 			size_t sentCount = 0, tokenCount = locals[passedWorkItems % workers->size()].outData.size();
-			while (tokenCount < batchSize && passedSents + sentCount < numSents())
+			while (tokenCount < batchSize && passedSents + sentCount < shardSize)
 			{
-				tokenCount += numValidTokensInSent(shuffledIdx[passedSents + sentCount++]) - 1;
+				tokenCount += numValidTokensInSent(shuffledIdx[shard.first + passedSents + sentCount++]) - 1;
 			}
 
 			if (sentCount > 0)
 			{
-				futures.emplace_back(workers->enqueue(prepareNext, passedWorkItems++ % workers->size(), passedSents, passedSents + sentCount));
+				futures.emplace_back(workers->enqueue(prepareNext, passedWorkItems++ % workers->size(), shard.first + passedSents, shard.first + passedSents + sentCount));
 				passedSents += sentCount;
 			}
 			else
@@ -589,17 +726,17 @@ size_t HSDataset::_next(InTy in, OutTy out, LmTy lmLProbs, NgramTy outNgramNode,
 	}
 	else
 	{
-		if (passedSents < numSents())
+		if (passedSents < shardSize)
 		{
 			size_t sentCount = 0, tokenCount = locals[0].outData.size();
-			while (tokenCount < batchSize && passedSents + sentCount < numSents())
+			while (tokenCount < batchSize && passedSents + sentCount < shardSize)
 			{
-				tokenCount += numValidTokensInSent(shuffledIdx[passedSents + sentCount++]) - 1;
+				tokenCount += numValidTokensInSent(shuffledIdx[shard.first + passedSents + sentCount++]) - 1;
 			}
 
 			if (sentCount > 0)
 			{
-				prepareNext(0, 0, passedSents, passedSents + sentCount);
+				prepareNext(0, 0, shard.first + passedSents, shard.first + passedSents + sentCount);
 				passedSents += sentCount;
 			}
 		}
@@ -642,15 +779,101 @@ size_t HSDataset::_next(InTy in, OutTy out, LmTy lmLProbs, NgramTy outNgramNode,
 size_t HSDataset::next(int32_t* in, int32_t* out, float* lmLProbs, uint32_t* outNgramNode, float& restLmOut, uint32_t& restLmCntOut,
 	int32_t* unlikelihoodIn, int32_t* unlikelihoodOut, size_t* unlikelihoodSize)
 {
+	if (prefetcher) throw std::runtime_error{ "`next()` cannot be used while prefetching. Use `acquireBatch()` instead." };
 	return _next(in, out, lmLProbs, outNgramNode, restLmOut, restLmCntOut, unlikelihoodIn, unlikelihoodOut, unlikelihoodSize);
 }
 
 size_t HSDataset::next(int64_t* in, int64_t* out, float* lmLProbs, int64_t* outNgramNode, float& restLmOut, uint32_t& restLmCntOut,
 	int64_t* unlikelihoodIn, int64_t* unlikelihoodOut, size_t* unlikelihoodSize)
 {
+	if (prefetcher) throw std::runtime_error{ "`next()` cannot be used while prefetching. Use `acquireBatch()` instead." };
 	return _next(in, out, lmLProbs, outNgramNode, restLmOut, restLmCntOut, unlikelihoodIn, unlikelihoodOut, unlikelihoodSize);
 }
 
+template<class IntTy, class NgramTy>
+void HSDataset::initPrefetcher(const std::vector<HSBatchBuffer<IntTy, NgramTy>>& buffers)
+{
+	if (buffers.empty()) throw std::invalid_argument{ "`buffers` must not be empty" };
+	stopPrefetch();
+
+	prefetcher.ptr = make_unique<Prefetcher>();
+	prefetcher->batches.resize(buffers.size());
+	// 이동 후에도 올바른 객체를 채우도록 this를 캡처하지 않고 실행 시점의 소유자를 넘겨받는다.
+	prefetcher->fill = [buffers](HSDataset& self, size_t slot, HSPrefetchedBatch& batch)
+	{
+		auto& b = buffers[slot];
+		batch = {};
+		batch.slot = slot;
+		batch.size = self._next(b.in, b.out, b.lmLProbs, b.outNgramNode, batch.restLm, batch.restLmCnt,
+			b.unlikelihoodIn, b.unlikelihoodOut, &batch.unlikelihoodSize);
+		return batch.size;
+	};
+	prefetcher->clear();
+}
+
+void HSDataset::setPrefetchBuffers(const std::vector<HSBatchBuffer<int32_t, uint32_t>>& buffers)
+{
+	initPrefetcher(buffers);
+}
+
+void HSDataset::setPrefetchBuffers(const std::vector<HSBatchBuffer<int64_t, int64_t>>& buffers)
+{
+	initPrefetcher(buffers);
+}
+
+HSPrefetchedBatch HSDataset::acquireBatch()
+{
+	if (!prefetcher) throw std::runtime_error{ "Prefetch buffers are not registered. Call `setPrefetchBuffers()` first." };
+	auto& p = *prefetcher;
+	std::unique_lock<std::mutex> lock{ p.mutex };
+	if (!p.thread.joinable() && !p.exhausted)
+	{
+		p.thread = std::thread{ [&p, this]() { p.run(*this); } };
+	}
+	p.cv.wait(lock, [&]() { return !p.readySlots.empty() || p.exhausted; });
+	if (!p.readySlots.empty())
+	{
+		const size_t slot = p.readySlots.front();
+		p.readySlots.pop_front();
+		p.acquired[slot] = 1;
+		return p.batches[slot];
+	}
+
+	if (p.error)
+	{
+		auto e = p.error;
+		p.error = nullptr;
+		std::rethrow_exception(e);
+	}
+	return {};
+}
+
+void HSDataset::releaseBatch(size_t slot)
+{
+	if (!prefetcher) throw std::runtime_error{ "Prefetch buffers are not registered. Call `setPrefetchBuffers()` first." };
+	auto& p = *prefetcher;
+	if (slot >= p.batches.size()) throw std::invalid_argument{ "invalid `slot`" };
+	{
+		std::lock_guard<std::mutex> lock{ p.mutex };
+		if (!p.acquired[slot]) throw std::invalid_argument{ "`slot` was not acquired by `acquireBatch()`" };
+		p.acquired[slot] = 0;
+		p.freeSlots.emplace_back(slot);
+	}
+	p.cv.notify_all();
+}
+
+void HSDataset::stopPrefetch()
+{
+	if (!prefetcher) return;
+	prefetcher->halt();
+	prefetcher.ptr.reset();
+}
+
+size_t HSDataset::getPrefetchDepth() const
+{
+	return prefetcher ? prefetcher->batches.size() : 0;
+}
+
 size_t HSDataset::ngramNodeSize() const
 {
 	auto knlm = std::dynamic_pointer_cast<lm::KnLangModelBase>(langModel);
@@ -675,14 +898,18 @@ size_t HSDataset::getKnlmVocabSize() const
 std::vector<size_t> kiwi::HSDataset::estimVocabFrequency() const
 {
 	std::vector<size_t> ret(vocabSize()), augs(getDefaultMorphemeId(POSTag::max));
-	for (auto t : sents.get().raw())
+	for (auto sent : sentView.get())
 	{
-		auto v = tokenToVocab[t];
-		auto fv = tokenToVocab[getDefaultMorphemeId((*morphemes)[t].tag)];
-		if (v == nonVocab) v = fv;
-		if (fv == nonVocab) continue;
-		ret[v]++;
-		augs[fv]++;
+		for (auto t : sent)
+		{
+			if (oovDict && t < 0) t = getDefaultMorphemeId((*oovDict)[-t - 1].second);
+			auto v = tokenToVocab[t];
+			auto fv = tokenToVocab[getDefaultMorphemeId((*morphemes)[t].tag)];
+			if (v == nonVocab) v = fv;
+			if (fv == nonVocab) continue;
+			ret[v]++;
+			augs[fv]++;
+		}
 	}
 
 	double augProbs = dropout.param().probabilities().back();
@@ -693,9 +920,9 @@ std::vector<size_t> kiwi::HSDataset::estimVocabFrequency() const
 	return ret;
 }
 
-Range<Vector<int32_t>::const_iterator> HSDataset::getSent(size_t idx) const
+Range<const int32_t*> HSDataset::getSent(size_t idx) const
 {
-	return sents.get()[idx];
+	return sentView.get()[idx];
 }
 
 void HSDataset::seed(size_t newSeed)
@@ -706,7 +933,7 @@ void HSDataset::seed(size_t newSeed)
 std::vector<uint32_t> HSDataset::getAugmentedSent(size_t idx)
 {
 	std::vector<uint32_t> ret;
-	auto sent = sents.get()[idx];
+	auto sent = sentView.get()[idx];
 	ret.emplace_back(*sent.begin());
 	for (auto p = sent.begin() + 1; p != sent.end() - 1; ++p)
 	{
@@ -737,9 +964,9 @@ std::vector<std::pair<std::vector<uint32_t>, size_t>> HSDataset::extractPrefixes
 	using Pair = std::pair<std::vector<uint32_t>, size_t>;
 	std::vector<Pair> ret;
 	PrefixCounter counter{ maxLength, minCnt, numWorkers };
-	for (auto sent : sents.get())
+	for (auto sent : sentView.get())
 	{
-		counter.addArray(&*sent.begin(), &*sent.end());
+		counter.addArray(sent.begin(), sent.end());
 	}
 	auto trie = counter.count();
 	if (exclusiveCnt)
@@ -3,6 +3,7 @@
 #include <kiwi/FrozenTrie.h>
 #include <kiwi/Utils.h>
 #include "search.h"
+#include "serializer.hpp"
 #include "ArchAvailable.h"
 
 namespace kiwi
@@ -90,6 +91,42 @@ namespace kiwi
 			return *this;
 		}
 
+		template<class _Key, class _Value, class _Diff, class _HasSubmatch>
+		void FrozenTrie<_Key, _Value, _Diff, _HasSubmatch>::serializerRead(std::istream& istr)
+		{
+			static_assert(std::is_trivially_copyable<Value>::value, "Value should be trivially copyable.");
+			numNodes = serializer::readFromStream<uint64_t>(istr);
+			numNexts = serializer::readFromStream<uint64_t>(istr);
+
+			nodes = make_unique<Node[]>(numNodes);
+			values = make_unique<Value[]>(numNodes);
+			nextKeys = make_unique<Key[]>(numNexts);
+			nextDiffs = make_unique<Diff[]>(numNexts);
+
+			if (!istr.read((char*)nodes.get(), sizeof(Node) * numNodes)
+				|| !istr.read((char*)values.get(), sizeof(Value) * numNodes)
+				|| !istr.read((char*)nextKeys.get(), sizeof(Key) * numNexts)
+				|| !istr.read((char*)nextDiffs.get(), sizeof(Diff) * numNexts))
+			{
+				throw SerializationException{ "reading FrozenTrie failed" };
+			}
+		}
+
+		template<class _Key, class _Value, class _Diff, class _HasSubmatch>
+		void FrozenTrie<_Key, _Value, _Diff, _HasSubmatch>::serializerWrite(std::ostream& ostr) const
+		{
+			static_assert(std::is_trivially_copyable<Value>::value, "Value should be trivially copyable.");
+			serializer::writeMany(ostr, (uint64_t)numNodes, (uint64_t)numNexts);
+
+			if (!ostr.write((const char*)nodes.get(), sizeof(Node) * numNodes)
+				|| !ostr.write((const char*)values.get(), sizeof(Value) * numNodes)
+				|| !ostr.write((const char*)nextKeys.get(), sizeof(Key) * numNexts)
+				|| !ostr.write((const char*)nextDiffs.get(), sizeof(Diff) * numNexts))
+			{
+				throw SerializationException{ "writing FrozenTrie failed" };
+			}
+		}
+
 		template<class _Key, class _Value, class _Diff, class _HasSubmatch>
 		template<class TrieNode, ArchType archType, class Xform>
 		FrozenTrie<_Key, _Value, _Diff, _HasSubmatch>::FrozenTrie(const ContinuousTrie<TrieNode>& trie, ArchTypeHolder<archType>, Xform xform)
@@ -61,9 +61,10 @@ namespace kiwi
 			return false;
 		}
 
-		inline char16_t getLastValidChr(const KString& str)
+		template<class It>
+		inline char16_t getLastValidChr(It first, It last)
 		{
-			for (auto it = str.rbegin(); it != str.rend(); ++it)
+			for (auto it = make_reverse_iterator(last); it != make_reverse_iterator(first); ++it)
 			{
 				switch (identifySpecialChr(*it))
 				{
@@ -82,9 +83,9 @@ namespace kiwi
 		void Joiner::add(U16StringView form, POSTag tag, Space space)
 		{
 			KString normForm = normalizeHangul(form);
-			if (stack.size() == activeStart)
+			if (size() == activeStart)
 			{
-				ranges.emplace_back(stack.size(), stack.size() + normForm.size());
+				ranges.emplace_back(size(), size() + normForm.size());
 				stack += normForm;
 				lastTag = tag;
 				return;
@@ -92,9 +93,9 @@ namespace kiwi
 
 			if (space == Space::insert_space || (space == Space::none && isSpaceInsertable(clearIrregular(lastTag), clearIrregular(tag), form)))
 			{
-				if (stack.empty() || !isSpace(stack.back())) stack.push_back(u' ');
-				activeStart = stack.size();
-				ranges.emplace_back(stack.size(), stack.size() + normForm.size());
+				if (!size() || !isSpace(chrBefore(size()))) stack.push_back(u' ');
+				activeStart = size();
+				ranges.emplace_back(size(), size() + normForm.size());
 				stack += normForm;
 			}
 			else
@@ -102,13 +103,14 @@ namespace kiwi
 				CondVowel cv = CondVowel::non_vowel;
 				if (activeStart > 0)
 				{
-					cv = isHangulSyllable(stack[activeStart - 1]) ? CondVowel::vowel : CondVowel::non_vowel;
+					cv = isHangulSyllable(chrBefore(activeStart)) ? CondVowel::vowel : CondVowel::non_vowel;
 				}
 
-				if (!stack.empty() && (isJClass(tag) || isEClass(tag)))
+				if (size() && (isJClass(tag) || isEClass(tag)))
 				{
 					if (isEClass(tag) && normForm[0] == u'아') normForm[0] = u'어';
-					char16_t c = getLastValidChr(stack);
+					char16_t c = getLastValidChr(stack.begin(), stack.end());
+					if (!c) c = lastValidCommittedChr;
 					CondVowel lastCv = isHangulCoda(c) ? CondVowel::non_vowel : CondVowel::vowel;
 					bool lastCvocalic = (lastCv == CondVowel::vowel || c == u'\u11AF');
 					auto it = cr->allomorphPtrMap.find(make_pair(normForm, tag));
@@ -149,8 +151,9 @@ namespace kiwi
 				{
 					cv = CondVowel::none;
 				}
-				auto r = cr->combineOneImpl({ stack.data() + activeStart, stack.size() - activeStart }, lastTag, normForm, tag, cv);
-				stack.erase(stack.begin() + activeStart, stack.end());
+				const size_t localStart = activeStart - committedSize;
+				auto r = cr->combineOneCached({ stack.data() + localStart, stack.size() - localStart }, lastTag, normForm, tag, cv);
+				stack.erase(stack.begin() + localStart, stack.end());
 				ranges.back().second = activeStart + get<1>(r);
 				ranges.emplace_back(activeStart + get<2>(r), activeStart + get<0>(r).size());
 				stack += get<0>(r);
@@ -160,6 +163,148 @@ namespace kiwi
 			lastTag = tag;
 		}
 
+		bool Joiner::isOpenEnd(char16_t c)
+		{
+			// 받침 없는 음절은 뒤따르는 종성과 합쳐질 수 있고, 
+			// 상위 대리 문자는 하위 대리 문자와 함께 변환되어야 하므로 보류한다.
+			return (isHangulSyllable(c) && (c - 0xAC00) % 28 == 0) || isHighSurrogate(c);
+		}
+
+		size_t Joiner::stableSize() const
+		{
+			// activeStart 이전 부분은 결합 규칙에 의해 바뀌지 않는다.
+			size_t ret = activeStart;
+			if (ret > 0 && isOpenEnd(chrBefore(ret))) --ret;
+			return ret;
+		}
+
+		void Joiner::commit(JoinerArena& arena)
+		{
+			const size_t localStart = activeStart - committedSize;
+			if (!localStart) return;
+
+			// 같은 부모에서 갈라진 후보들은 대개 같은 내용을 확정하므로, 이번에 만들어진 노드 중 일치하는 것이 있으면 공유한다.
+			const size_t numRanges = ranges.size() - 1;
+			uint32_t sharedNode = 0;
+			for (size_t i = arena.shareBegin; i < arena.nodes.size(); ++i)
+			{
+				auto& n = arena.nodes[i];
+				if (n.parent != committedNode
+					|| n.chrEnd - n.chrBegin != localStart
+					|| n.rangeEnd - n.rangeBegin != numRanges) continue;
+				if (!equal(stack.begin(), stack.begin() + localStart, arena.chrs.begin() + n.chrBegin)) continue;
+				if (!equal(ranges.begin(), ranges.begin() + numRanges, arena.ranges.begin() + n.rangeBegin)) continue;
+				sharedNode = (uint32_t)(i + 1);
+				break;
+			}
+
+			if (sharedNode)
+			{
+				committedNode = sharedNode;
+			}
+			else
+			{
+				JoinerArena::Node node;
+				node.parent = committedNode;
+				node.offset = (uint32_t)committedSize;
+				node.chrBegin = (uint32_t)arena.chrs.size();
+				arena.chrs.append(stack.begin(), stack.begin() + localStart);
+				node.chrEnd = (uint32_t)arena.chrs.size();
+				// 마지막 형태소의 범위는 다음 결합에서 바뀔 수 있으므로 남겨둔다.
+				node.rangeBegin = (uint32_t)arena.ranges.size();
+				arena.ranges.insert(arena.ranges.end(), ranges.begin(), ranges.begin() + numRanges);
+				node.rangeEnd = (uint32_t)arena.ranges.size();
+				arena.nodes.emplace_back(node);
+				committedNode = (uint32_t)arena.nodes.size();
+			}
+
+			if (auto c = getLastValidChr(stack.begin(), stack.begin() + localStart)) lastValidCommittedChr = c;
+			lastCommittedChr = stack[localStart - 1];
+			committedSize = activeStart;
+			stack.erase(stack.begin(), stack.begin() + localStart);
+			ranges.erase(ranges.begin(), ranges.end() - 1);
+		}
+
+		void JoinerArena::compact(uint32_t* roots, size_t numRoots)
+		{
+			// 노드는 항상 부모보다 뒤에 추가되므로, 앞에서부터 한 번만 훑어도 부모의 새 번호가 먼저 정해진다.
+			vector<uint32_t> newIds(nodes.size() + 1);
+			size_t numLive = 0;
+			for (size_t r = 0; r < numRoots; ++r)
+			{
+				for (auto id = roots[r]; id && !newIds[id]; id = nodes[id - 1].parent)
+				{
+					newIds[id] = 1;
+					++numLive;
+				}
+			}
+
+			if (numLive * 2 >= nodes.size())
+			{
+				compactThreshold = max(compactThreshold, nodes.size() * 2);
+				return;
+			}
+
+			KString newChrs;
+			vector<pair<uint32_t, uint32_t>> newRanges;
+			vector<Node> newNodes;
+			newNodes.reserve(numLive);
+			for (size_t i = 0; i < nodes.size(); ++i)
+			{
+				if (!newIds[i + 1]) continue;
+				Node n = nodes[i];
+				n.parent = newIds[n.parent];
+				const uint32_t chrBegin = (uint32_t)newChrs.size(), rangeBegin = (uint32_t)newRanges.size();
+				newChrs.append(chrs.begin() + n.chrBegin, chrs.begin() + n.chrEnd);
+				newRanges.insert(newRanges.end(), ranges.begin() + n.rangeBegin, ranges.begin() + n.rangeEnd);
+				n.chrBegin = chrBegin;
+				n.chrEnd = (uint32_t)newChrs.size();
+				n.rangeBegin = rangeBegin;
+				n.rangeEnd = (uint32_t)newRanges.size();
+				newNodes.emplace_back(n);
+				newIds[i + 1] = (uint32_t)newNodes.size();
+			}
+
+			for (size_t r = 0; r < numRoots; ++r)
+			{
+				roots[r] = newIds[roots[r]];
+			}
+			chrs = move(newChrs);
+			ranges = move(newRanges);
+			nodes = move(newNodes);
+			shareBegin = nodes.size();
+			compactThreshold = max((size_t)64, nodes.size() * 2);
+		}
+
+		void Joiner::materialize(const JoinerArena* arena, size_t from, KString& out, vector<pair<uint32_t, uint32_t>>* rangesOut) const
+		{
+			from = min(from, size());
+			out.resize(size() - from);
+			const size_t localFrom = from > committedSize ? from - committedSize : 0;
+			copy(stack.begin() + localFrom, stack.end(), out.end() - (stack.size() - localFrom));
+
+			// 노드는 뒤에서부터 거슬러 올라가며 방문하므로, 각 조각을 제 위치에 채워 넣는다.
+			size_t numNodes = 0, numRanges = ranges.size();
+			for (auto id = committedNode; arena && id; id = arena->nodes[id - 1].parent)
+			{
+				auto& n = arena->nodes[id - 1];
+				if (n.offset + (n.chrEnd - n.chrBegin) <= from) break;
+				const size_t skip = from > n.offset ? from - n.offset : 0;
+				copy(arena->chrs.begin() + n.chrBegin + skip, arena->chrs.begin() + n.chrEnd, out.begin() + (n.offset + skip - from));
+				numRanges += n.rangeEnd - n.rangeBegin;
+				++numNodes;
+			}
+
+			if (!rangesOut) return;
+			rangesOut->resize(numRanges);
+			auto it = copy_backward(ranges.begin(), ranges.end(), rangesOut->end());
+			for (auto id = committedNode; numNodes; id = arena->nodes[id - 1].parent, --numNodes)
+			{
+				auto& n = arena->nodes[id - 1];
+				it = copy_backward(arena->ranges.begin() + n.rangeBegin, arena->ranges.begin() + n.rangeEnd, it);
+			}
+		}
+
 		void Joiner::add(const u16string& form, POSTag tag, Space space)
 		{
 			return add(toStringView(form), tag, space);
@@ -171,6 +316,12 @@ namespace kiwi
 		}
 
 		u16string Joiner::getU16(vector<pair<uint32_t, uint32_t>>* rangesOut) const
+		{
+			// 단독으로 사용되는 Joiner는 JoinerArena로 옮겨진 부분이 없으므로 stack이 결합 결과 전체이다.
+			return toU16(stack, ranges, rangesOut);
+		}
+
+		u16string Joiner::toU16(const KString& stack, const vector<pair<uint32_t, uint32_t>>& ranges, vector<pair<uint32_t, uint32_t>>* rangesOut)
 		{
 			if (rangesOut)
 			{
@@ -194,7 +345,11 @@ namespace kiwi
 
 		string Joiner::getU8(vector<pair<uint32_t, uint32_t>>* rangesOut) const
 		{
-			auto u16 = getU16(rangesOut);
+			return toU8(getU16(rangesOut), rangesOut);
+		}
+
+		string Joiner::toU8(const u16string& u16, vector<pair<uint32_t, uint32_t>>* rangesOut)
+		{
 			if (rangesOut)
 			{
 				Vector<uint32_t> positions;
@@ -244,12 +399,34 @@ namespace kiwi
 
 		u16string AutoJoiner::getU16(vector<pair<uint32_t, uint32_t>>* rangesOut) const
 		{
-			return candBuf.get<Candidate<lm::VoidState<ArchType::none>>>()[0].joiner.getU16(rangesOut);
+			auto& first = candBuf.get<Candidate<lm::VoidState<ArchType::none>>>()[0].joiner;
+			KString stack;
+			vector<pair<uint32_t, uint32_t>> ranges;
+			first.materialize(&arena, 0, stack, rangesOut ? &ranges : nullptr);
+			return Joiner::toU16(stack, ranges, rangesOut);
 		}
 
 		string AutoJoiner::getU8(vector<pair<uint32_t, uint32_t>>* rangesOut) const
 		{
-			return candBuf.get<Candidate<lm::VoidState<ArchType::none>>>()[0].joiner.getU8(rangesOut);
+			return Joiner::toU8(getU16(rangesOut), rangesOut);
+		}
+
+		u16string AutoJoiner::flushU16(bool finish)
+		{
+			auto& candidates = candBuf.get<Candidate<lm::VoidState<ArchType::none>>>();
+			auto& first = candidates[0].joiner;
+			const size_t end = finish ? first.size() : (*dfStableSize)(arena, flushedSize, candidates);
+			if (end <= flushedSize) return {};
+			KString tail;
+			first.materialize(&arena, flushedSize, tail);
+			auto ret = joinHangul(tail.begin(), tail.begin() + (end - flushedSize));
+			flushedSize = end;
+			return ret;
+		}
+
+		string AutoJoiner::flushU8(bool finish)
+		{
+			return utf16To8(flushU16(finish));
 		}
 	}
 }
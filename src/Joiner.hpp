@@ -71,6 +71,7 @@ namespace kiwi
 					cand.joiner.add(morph.getForm(), morph.tag, space);
 				}
 			}
+			commitAll(candidates);
 
 			sort(candidates.begin(), candidates.end(), [](const cmb::Candidate<LmState>& a, const cmb::Candidate<LmState>& b)
 			{
@@ -78,6 +79,25 @@ namespace kiwi
 			});
 		}
 
+		template<class LmState>
+		void AutoJoiner::commitAll(Vector<Candidate<LmState>>& candidates)
+		{
+			// 확정된 부분을 arena로 옮겨두면 후보를 복제할 때 활성 구간만 복사된다.
+			arena.shareBegin = arena.nodes.size();
+			for (auto& cand : candidates)
+			{
+				cand.joiner.commit(arena);
+			}
+
+			// 가지치기된 후보만 참조하던 노드는 더 이상 쓰이지 않으므로, 노드가 충분히 쌓이면 정리한다.
+			if (arena.nodes.size() < arena.compactThreshold) return;
+			thread_local Vector<uint32_t> roots;
+			roots.clear();
+			for (auto& cand : candidates) roots.emplace_back(cand.joiner.committedNode);
+			arena.compact(roots.data(), roots.size());
+			for (size_t i = 0; i < candidates.size(); ++i) candidates[i].joiner.committedNode = roots[i];
+		}
+
 		template<class Func>
 		void AutoJoiner::foreachMorpheme(const Form* formHead, Func&& func) const
 		{
@@ -203,6 +223,7 @@ namespace kiwi
 					cand.joiner.add(form, tag, space);
 				}
 			}
+			commitAll(candidates);
 			sort(candidates.begin(), candidates.end(), [](const cmb::Candidate<LmState>& a, const cmb::Candidate<LmState>& b)
 			{
 				return a.score > b.score;
@@ -242,6 +263,7 @@ namespace kiwi
 				}
 			}
 			candidates[0].joiner.add(form, tag, space);
+			commitAll(candidates);
 		}
 
 		template<ArchType arch>
@@ -259,6 +281,32 @@ namespace kiwi
 					cand.joiner.add(morph.getForm(), morph.tag, space);
 				}
 			}
+			commitAll(candidates);
+		}
+
+		template<class LmState>
+		size_t AutoJoiner::stableSizeImpl(const JoinerArena& arena, size_t from, const Vector<Candidate<LmState>>& candidates)
+		{
+			auto& first = candidates[0].joiner;
+			size_t ret = first.stableSize();
+			for (size_t i = 1; i < candidates.size(); ++i)
+			{
+				ret = min(ret, candidates[i].joiner.stableSize());
+			}
+			if (candidates.size() <= 1 || ret <= from) return ret;
+
+			// from 이전 부분은 이미 모든 후보가 공유하는 것으로 확인되었으므로, 그 이후 부분만 비교한다.
+			thread_local KString firstTail, otherTail;
+			first.materialize(&arena, from, firstTail);
+			const size_t common = ret;
+			for (size_t i = 1; i < candidates.size() && ret > from; ++i)
+			{
+				candidates[i].joiner.materialize(&arena, from, otherTail);
+				ret = from + (mismatch(firstTail.begin(), firstTail.begin() + (ret - from), otherTail.begin()).first - firstTail.begin());
+			}
+			// 후보 간에 처음으로 달라지는 위치가 음절과 종성 사이일 수 있으므로 다시 한번 보정한다.
+			if (ret < common && ret > from && Joiner::isOpenEnd(firstTail[ret - from - 1])) --ret;
+			return ret;
 		}
 
 		template<class LmState>
@@ -273,6 +321,11 @@ namespace kiwi
 			{
 				return joiner->addImpl2(form, tag, inferRegularity, space, candidates);
 			}
+
+			static size_t stableSize(const JoinerArena& arena, size_t from, const Vector<Candidate<LmState>>& candidates)
+			{
+				return stableSizeImpl(arena, from, candidates);
+			}
 		};
 
 		template<ArchType arch>
@@ -287,6 +340,11 @@ namespace kiwi
 			{
 				return joiner->addWithoutSearchImpl2(form, tag, inferRegularity, space, candidates);
 			}
+
+			static size_t stableSize(const JoinerArena& arena, size_t from, const Vector<Candidate<lm::VoidState<arch>>>& candidates)
+			{
+				return stableSizeImpl(arena, from, candidates);
+			}
 		};
 
 		template<class LmState>
@@ -296,6 +354,7 @@ namespace kiwi
 			using Dp = Dispatcher<LmState>;
 			dfAdd = reinterpret_cast<FnAdd>(&Dp::add);
 			dfAdd2 = reinterpret_cast<FnAdd2>(&Dp::add2);
+			dfStableSize = reinterpret_cast<FnStableSize>(&Dp::stableSize);
 		}
 
 	}
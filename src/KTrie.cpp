@@ -2,6 +2,7 @@
 #include <kiwi/Types.h>
 #include <kiwi/TemplateUtils.hpp>
 #include <kiwi/Utils.h>
+#include <kiwi/ScratchSpace.h>
 #include "ArchAvailable.h"
 #include "KTrie.h"
 #include "FeatureTestor.h"
@@ -709,14 +710,34 @@ struct SearchState : public LengtheningTypoNodes<lengtheningTypoTolerant>
 class Splitter
 {
 public:
-	inline static thread_local Vector<pair<uint32_t, uint32_t>> endPosMap;
-	inline static thread_local Vector<pair<uint32_t, uint32_t>> pretokenizedSpans;
-	inline static thread_local Vector<tuple<size_t, uint32_t, POSTag>> matchedPatterns; // end, length, type
-	inline static thread_local Vector<uint32_t> nsToPos, posToNs;
-	inline static thread_local Vector<KGraphNode> out;
-	inline static thread_local Vector<TypoGraphNode> typoGraph;
-	inline static thread_local Vector<Vector<SearchState<false>>> _searchStates;
-	inline static thread_local Vector<FormCandidate2<false>> _candidates;
+	inline static thread_local utils::Scratch<Vector<pair<uint32_t, uint32_t>>> endPosMap;
+	inline static thread_local utils::Scratch<Vector<pair<uint32_t, uint32_t>>> pretokenizedSpans;
+	inline static thread_local utils::Scratch<Vector<tuple<size_t, uint32_t, POSTag>>> matchedPatterns; // end, length, type
+	inline static thread_local utils::Scratch<Vector<uint32_t>> nsToPos, posToNs;
+	inline static thread_local utils::Scratch<Vector<KGraphNode>> out;
+	inline static thread_local utils::Scratch<Vector<TypoGraphNode>> typoGraph;
+	inline static thread_local utils::Scratch<Vector<uint32_t>> lastConsumer;
+
+	template<bool lengtheningTypoTolerant>
+	static Vector<Vector<SearchState<lengtheningTypoTolerant>>>& getSearchStates()
+	{
+		thread_local utils::Scratch<Vector<Vector<SearchState<lengtheningTypoTolerant>>>> searchStates;
+		return searchStates;
+	}
+
+	template<bool lengtheningTypoTolerant>
+	static Vector<Vector<SearchState<lengtheningTypoTolerant>>>& getSpareSearchStates()
+	{
+		thread_local utils::Scratch<Vector<Vector<SearchState<lengtheningTypoTolerant>>>> spareStates;
+		return spareStates;
+	}
+
+	template<bool lengtheningTypoTolerant>
+	static Vector<FormCandidate2<lengtheningTypoTolerant>>& getCandidates()
+	{
+		thread_local utils::Scratch<Vector<FormCandidate2<lengtheningTypoTolerant>>> candidates;
+		return candidates;
+	}
 
 	const Form* formBase;
 	const size_t* typoPtrs;
@@ -879,7 +900,7 @@ public:
 		size_t maxContinualTypoIdx = 0;
 		if (typoTransformer)
 		{
-			typoTransformer->generateGraph(str, typoGraph, allowedDialect, pretokenizedSpans.data(), pretokenizedSpans.data() + pretokenizedSpans.size(), &maxContinualTypoIdx);
+			typoTransformer->generateGraph(str, typoGraph, allowedDialect, pretokenizedSpans.data(), pretokenizedSpans.data() + pretokenizedSpans.size(), &maxContinualTypoIdx, typoThreshold);
 		}
 		else
 		{
@@ -957,7 +978,7 @@ public:
 		size_t unkFormStartNsPos, size_t lastSpaceBoundaryNsPos, float typoCost,
 		uint8_t startContinualTypoIdx, uint8_t endContinualTypoIdx)
 	{
-		auto& candidates = reinterpret_cast<Vector<FormCandidate2<lengtheningTypoTolerant>>&>(_candidates);
+		auto& candidates = getCandidates<lengtheningTypoTolerant>();
 		for (const auto& cand : candidates)
 		{
 			const size_t nBegin = cand.getStartPos(endPosition) + startPosOffset;
@@ -1008,12 +1029,14 @@ public:
 		const Form* const fallbackFormBegin = trie.value((size_t)POSTag::nng);
 		const Form* const fallbackFormEnd = trie.value((size_t)POSTag::max);
 
+		// 경로를 따라 누적된 오타 비용이 임계값을 넘으면 이 상태는 더 이상 확장하지 않는다.
+		// 오타 그래프 자체는 입력 길이에 비례하여 커지므로, 실제 탐색량은 여기서 제한된다.
 		float typoCost = state.accumulatedCost + typoNode.typoCost;
 		if (typoCost > typoThreshold)
 		{
 			return;
 		}
-		auto& candidates = reinterpret_cast<Vector<FormCandidate2<lengtheningTypoTolerant>>&>(_candidates);
+		auto& candidates = getCandidates<lengtheningTypoTolerant>();
 		char32_t prevChr = state.lastChr;
 		POSTag lastChrType = prevChr ? identifySpecialChr(prevChr) : POSTag::unknown;
 		ScriptType lastScriptType = prevChr ? chr2ScriptType(prevChr) : ScriptType::unknown;
@@ -1415,13 +1438,33 @@ public:
 	void search(const utils::FrozenTrie<kchar_t, const Form*>& trie, size_t startOffset)
 	{
 		const size_t totEndPos = nsToPos.back() + 1;
-		auto& searchStates = reinterpret_cast<Vector<Vector<SearchState<lengtheningTypoTolerant>>>&>(_searchStates);
+		auto& searchStates = getSearchStates<lengtheningTypoTolerant>();
+		auto& spareStates = getSpareSearchStates<lengtheningTypoTolerant>();
+		
+		// 각 노드의 탐색 상태를 마지막으로 참조하는 노드의 번호를 미리 구해두고,
+		// 더 이상 참조되지 않는 상태 벡터는 즉시 회수하여 이후 노드에서 재사용한다.
+		// 이렇게 하면 그래프 전체가 아니라 탐색 경계에 걸친 상태들만 메모리에 유지된다.
+		lastConsumer.clear();
+		lastConsumer.resize(typoGraph.size());
+		for (size_t i = 1; i < typoGraph.size(); ++i)
+		{
+			for (auto* prev = typoGraph[i].getPrev(); prev; prev = prev->getSibling())
+			{
+				lastConsumer[prev - typoGraph.data()] = i;
+			}
+		}
+
 		searchStates.resize(typoGraph.size());
 		searchStates[0].emplace_back(trie.root());
 		for (size_t i = 1; i < typoGraph.size(); ++i)
 		{
 			const auto& typoNode = typoGraph[i];
 			auto& curStates = searchStates[i];
+			if (!spareStates.empty())
+			{
+				curStates = std::move(spareStates.back());
+				spareStates.pop_back();
+			}
 			for (auto* prev = typoNode.getPrev(); prev; prev = prev->getSibling())
 			{
 				const auto& prevStates = searchStates[prev - typoGraph.data()];
@@ -1430,6 +1473,14 @@ public:
 					progressNode<arch, lengtheningTypoTolerant>(trie, *prev, typoNode, state, curStates, startOffset);
 				}
 			}
+			for (auto* prev = typoNode.getPrev(); prev; prev = prev->getSibling())
+			{
+				const size_t prevIdx = prev - typoGraph.data();
+				if (lastConsumer[prevIdx] != i || searchStates[prevIdx].capacity() == 0) continue;
+				searchStates[prevIdx].clear();
+				spareStates.emplace_back(std::move(searchStates[prevIdx]));
+				searchStates[prevIdx] = {};
+			}
 
 			if (typoNode.typoCost == 0 && typoNode.endPos == totEndPos)
 			{
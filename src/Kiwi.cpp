@@ -1016,8 +1016,8 @@ namespace kiwi
 		const optional<KiwiConfig>& overrideConfig
 	) const
 	{
-		thread_local KString normalizedStr;
-		thread_local Vector<uint32_t> positionTable;
+		thread_local utils::Scratch<KString> normalizedStr;
+		thread_local utils::Scratch<Vector<uint32_t>> positionTable;
 		thread_local PretokenizedSpanGroup pretokenizedGroup;
 
 		KiwiConfig config = overrideConfig.value_or(globalConfig);
@@ -1051,14 +1051,14 @@ namespace kiwi
 		);
 
 		// 분석할 문장에 포함된 개별 문자에 대해 어절번호를 생성한다
-		thread_local Vector<uint16_t> wordPositions;
+		thread_local utils::Scratch<Vector<uint16_t>> wordPositions;
 		wordPositions.clear();
 		getWordPositions(wordPositions, str.begin(), str.end());
 		
 		SubstringCounter substringCounter;
 		if ((option.match & Match::oovMask) >= Match::oovChrFreqModel)
 		{
-			thread_local Vector<char16_t> filteredStr;
+			thread_local utils::Scratch<Vector<char16_t>> filteredStr;
 			filteredStr.clear();
 			filteredStr.reserve(normalizedStr.size());
 			for (size_t i = 0; i < normalizedStr.size(); ++i)
@@ -1087,8 +1087,8 @@ namespace kiwi
 
 		vector<TokenResult> ret;
 		Vector<SpecialState> spStatesByRet;
-		thread_local Vector<KGraphNode> nodes;
-		thread_local Vector<uint32_t> nodeInWhichPretokenized;
+		thread_local utils::Scratch<Vector<KGraphNode>> nodes;
+		thread_local utils::Scratch<Vector<uint32_t>> nodeInWhichPretokenized;
 		const auto* pretokenizedFirst = pretokenizedGroup.spans.data();
 		const auto* pretokenizedLast = pretokenizedFirst + pretokenizedGroup.spans.size();
 		size_t splitEnd = 0;
@@ -1154,6 +1154,7 @@ namespace kiwi
 		}
 
 		if (ret.empty()) ret.emplace_back();
+		utils::ScratchRegistry::local().checkpoint();
 		return ret;
 	}
 
@@ -1259,8 +1260,197 @@ namespace kiwi
 		return _asyncAnalyzeEcho(move(str), move(pretokenized), overrideConfig, option);
 	}
 
-	cmb::AutoJoiner Kiwi::newJoiner(bool lmSearch) const
+	size_t Kiwi::analyzeBulk(size_t topN,
+		const function<u16string()>& reader,
+		const function<void(size_t, vector<TokenResult>&&)>& resultCallback,
+		AnalyzeOption option,
+		const BulkAnalyzeOption& bulkOption,
+		const optional<KiwiConfig>& overrideConfig
+	) const
+	{
+		// 공유된 스레드풀의 작업 안에서 호출된 경우 자신이 속한 스레드풀을 기다리지 않도록 현재 스레드에서 처리한다.
+		if (!pool || pool->isWorkerThread())
+		{
+			size_t idx = 0;
+			while (1)
+			{
+				auto ustr = reader();
+				if (ustr.empty()) break;
+				resultCallback(idx++, analyze(ustr, topN, option, {}, overrideConfig));
+			}
+			return idx;
+		}
+
+		struct CompletedBatch
+		{
+			size_t first = 0;
+			vector<vector<TokenResult>> results;
+			exception_ptr error;
+		};
+
+		const KiwiConfig config = overrideConfig.value_or(globalConfig);
+		const size_t maxInFlight = max(bulkOption.maxInFlight ? bulkOption.maxInFlight : pool->size() * 2, (size_t)1);
+		const size_t maxBatchSize = max(bulkOption.maxBatchSize, (size_t)1);
+
+		mutex completedMtx;
+		condition_variable completedCnd;
+		deque<CompletedBatch> completed;
+		
+		size_t numRead = 0, numDelivered = 0, numRunningBatches = 0;
+		bool eof = false;
+		u16string lookahead;
+		exception_ptr error;
+		map<size_t, vector<TokenResult>> reorderBuf;
+
+		// 작업은 지역 변수를 참조하므로, 예외가 발생하더라도 모든 작업이 끝날 때까지 기다려야 한다.
+		const auto waitCompleted = [&](deque<CompletedBatch>& out)
+		{
+			unique_lock<mutex> lock{ completedMtx };
+			completedCnd.wait(lock, [&]() { return !completed.empty(); });
+			out.swap(completed);
+		};
+
+		const auto submitBatches = [&]()
+		{
+			while (!eof && !error && numRead - numDelivered < maxInFlight)
+			{
+				vector<u16string> batch;
+				size_t batchChars = 0;
+				const size_t first = numRead;
+				while (numRead - numDelivered < maxInFlight && batch.size() < maxBatchSize)
+				{
+					if (lookahead.empty())
+					{
+						lookahead = reader();
+						if (lookahead.empty())
+						{
+							eof = true;
+							break;
+						}
+					}
+					if (!batch.empty() && batchChars + lookahead.size() > bulkOption.maxBatchChars) break;
+					batchChars += lookahead.size();
+					batch.emplace_back(move(lookahead));
+					lookahead.clear();
+					++numRead;
+				}
+				if (batch.empty()) break;
+
+				pool->enqueue([&, first, batch = move(batch)](size_t)
+				{
+					CompletedBatch c;
+					c.first = first;
+					try
+					{
+						c.results.reserve(batch.size());
+						for (auto& str : batch)
+						{
+							c.results.emplace_back(analyze(str, topN, option, {}, config));
+						}
+					}
+					catch (...)
+					{
+						c.error = current_exception();
+					}
+
+					// 잠금을 쥔 채로 알려야 호출 스레드가 먼저 반환하면서 completedCnd를 해제하는 일을 막을 수 있다.
+					lock_guard<mutex> lock{ completedMtx };
+					completed.emplace_back(move(c));
+					completedCnd.notify_one();
+				});
+				++numRunningBatches;
+			}
+		};
+
+		deque<CompletedBatch> received;
+		try
+		{
+			submitBatches();
+			while (numRunningBatches)
+			{
+				waitCompleted(received);
+				while (!received.empty())
+				{
+					auto c = move(received.front());
+					received.pop_front();
+					--numRunningBatches;
+					if (c.error && !error) error = c.error;
+					if (error) continue;
+
+					if (bulkOption.ordered)
+					{
+						for (size_t i = 0; i < c.results.size(); ++i)
+						{
+							reorderBuf.emplace(c.first + i, move(c.results[i]));
+						}
+						
+						for (auto it = reorderBuf.begin(); it != reorderBuf.end() && it->first == numDelivered; it = reorderBuf.erase(it))
+						{
+							resultCallback(it->first, move(it->second));
+							++numDelivered;
+						}
+					}
+					else
+					{
+						for (size_t i = 0; i < c.results.size(); ++i)
+						{
+							resultCallback(c.first + i, move(c.results[i]));
+							++numDelivered;
+						}
+					}
+				}
+				submitBatches();
+			}
+		}
+		catch (...)
+		{
+			if (!error) error = current_exception();
+			numRunningBatches -= received.size();
+			received.clear();
+			while (numRunningBatches)
+			{
+				waitCompleted(received);
+				numRunningBatches -= received.size();
+				received.clear();
+			}
+		}
+
+		if (error) rethrow_exception(error);
+		return numRead;
+	}
+
+	size_t Kiwi::trimScratch(size_t retainBytes) const
+	{
+		// 스레드 풀에 속하지 않은 스레드들은 다음 분석을 마치는 시점에 해제하도록 요청해둔다.
+		if (!retainBytes) utils::requestScratchTrim();
+		const auto trimLocal = [retainBytes]()
+		{
+			auto& registry = utils::ScratchRegistry::local();
+			return retainBytes ? registry.trim(retainBytes) : registry.checkpoint();
+		};
+
+		size_t released = trimLocal();
+		if (!pool || pool->isWorkerThread()) return released;
+
+		// runParallel은 각 작업 스레드에 정확히 하나씩 작업을 배정하므로 모든 스레드의 버퍼를 해제할 수 있다.
+		auto futures = pool->runParallel(pool->size(), [&](size_t, size_t, utils::Barrier*)
+		{
+			return trimLocal();
+		});
+		for (auto& f : futures)
+		{
+			released += f.get();
+		}
+		return released;
+	}
+
+	cmb::AutoJoiner Kiwi::newJoiner(bool lmSearch, bool warmUpCache) const
 	{
+		if (warmUpCache && combiningRule->markCombineCacheWarmedUp())
+		{
+			warmUpJoinerCache();
+		}
+
 		if (lmSearch)
 		{
 			return (*reinterpret_cast<FnNewJoiner>(dfNewJoiner))(this);
@@ -1271,6 +1461,138 @@ namespace kiwi
 		}
 	}
 
+	template<class AddFn>
+	cmb::JoinedBatch Kiwi::joinBatchImpl(size_t size, bool lmSearch, AddFn&& addSeq) const
+	{
+		// 각 구간은 자신의 결과를 별도의 버퍼에 모은 뒤, 구간 순서대로 이어 붙인다.
+		utils::ThreadPool* shardPool = pool && !pool->isWorkerThread() ? pool.get() : nullptr;
+		const size_t numShards = shardPool ? shardPool->size() * 4 : 1;
+		vector<cmb::JoinedBatch> partials(max(min(numShards, size), (size_t)1));
+		utils::forEachShard(shardPool, size, numShards, [&](size_t shard, size_t first, size_t last)
+		{
+			auto& part = partials[shard];
+			vector<pair<uint32_t, uint32_t>> ranges;
+			for (size_t i = first; i < last; ++i)
+			{
+				auto joiner = newJoiner(lmSearch);
+				addSeq(joiner, i);
+				part.text += joiner.getU16(&ranges);
+				part.textOffsets.emplace_back(part.text.size());
+				part.ranges.insert(part.ranges.end(), ranges.begin(), ranges.end());
+				part.rangeOffsets.emplace_back(part.ranges.size());
+			}
+		});
+
+		cmb::JoinedBatch ret;
+		size_t textSize = 0, rangeSize = 0;
+		for (auto& part : partials)
+		{
+			textSize += part.text.size();
+			rangeSize += part.ranges.size();
+		}
+		ret.text.reserve(textSize);
+		ret.ranges.reserve(rangeSize);
+		ret.textOffsets.reserve(size + 1);
+		ret.rangeOffsets.reserve(size + 1);
+		ret.textOffsets.emplace_back(0);
+		ret.rangeOffsets.emplace_back(0);
+		for (auto& part : partials)
+		{
+			const uint32_t textBase = (uint32_t)ret.text.size(), rangeBase = (uint32_t)ret.ranges.size();
+			ret.text += part.text;
+			ret.ranges.insert(ret.ranges.end(), part.ranges.begin(), part.ranges.end());
+			for (auto o : part.textOffsets) ret.textOffsets.emplace_back(textBase + o);
+			for (auto o : part.rangeOffsets) ret.rangeOffsets.emplace_back(rangeBase + o);
+		}
+		return ret;
+	}
+
+	cmb::JoinedBatch Kiwi::joinBatch(const vector<vector<pair<u16string, POSTag>>>& morphSeqs, bool lmSearch, bool inferRegularity) const
+	{
+		return joinBatchImpl(morphSeqs.size(), lmSearch, [&](cmb::AutoJoiner& joiner, size_t i)
+		{
+			for (auto& m : morphSeqs[i])
+			{
+				joiner.add(m.first, m.second, inferRegularity);
+			}
+		});
+	}
+
+	cmb::JoinedBatch Kiwi::joinBatch(const vector<vector<size_t>>& morphIdSeqs, bool lmSearch) const
+	{
+		for (auto& seq : morphIdSeqs)
+		{
+			for (auto id : seq)
+			{
+				if (id >= morphemes.size()) throw invalid_argument{ "Invalid morpheme id: " + to_string(id) };
+			}
+		}
+
+		return joinBatchImpl(morphIdSeqs.size(), lmSearch, [&](cmb::AutoJoiner& joiner, size_t i)
+		{
+			for (auto id : morphIdSeqs[i])
+			{
+				joiner.add(id);
+			}
+		});
+	}
+
+	cmb::JoinedBatch Kiwi::joinBatch(const uint32_t* morphIds, const uint32_t* seqSizes, size_t size, bool lmSearch) const
+	{
+		vector<size_t> seqStarts(size + 1);
+		for (size_t i = 0; i < size; ++i)
+		{
+			seqStarts[i + 1] = seqStarts[i] + seqSizes[i];
+		}
+		for (size_t i = 0; i < seqStarts[size]; ++i)
+		{
+			if (morphIds[i] >= morphemes.size()) throw invalid_argument{ "Invalid morpheme id: " + to_string(morphIds[i]) };
+		}
+
+		return joinBatchImpl(size, lmSearch, [&](cmb::AutoJoiner& joiner, size_t i)
+		{
+			for (size_t j = seqStarts[i]; j < seqStarts[i + 1]; ++j)
+			{
+				joiner.add((size_t)morphIds[j]);
+			}
+		});
+	}
+
+	void Kiwi::setJoinerCacheSize(size_t capacity)
+	{
+		combiningRule->setCombineCacheSize(capacity);
+	}
+
+	size_t Kiwi::getJoinerCacheSize() const
+	{
+		return combiningRule->getCombineCacheSize();
+	}
+
+	cmb::CombineCacheStats Kiwi::getJoinerCacheStats() const
+	{
+		return combiningRule->getCombineCacheStats();
+	}
+
+	void Kiwi::clearJoinerCache()
+	{
+		combiningRule->clearCombineCache();
+	}
+
+	size_t Kiwi::warmUpJoinerCache(size_t maxEntries) const
+	{
+		vector<pair<KString, POSTag>> stems, endings;
+		UnorderedSet<pair<KString, POSTag>> seen;
+		for (auto& m : morphemes)
+		{
+			if (!m.kform || m.kform->empty() || m.complex || !m.chunks.empty() || m.combineSocket) continue;
+			const bool isStem = isVerbClass(m.tag);
+			if (!isStem && !isEClass(m.tag)) continue;
+			if (!seen.emplace(*m.kform, m.tag).second) continue;
+			(isStem ? stems : endings).emplace_back(*m.kform, m.tag);
+		}
+		return combiningRule->warmUpCombineCache(stems, endings, maxEntries, getThreadPool());
+	}
+
 	u16string Kiwi::getTypoForm(size_t typoFormId) const
 	{
 		if (typoFormId >= typoPtrs.size()) return {};
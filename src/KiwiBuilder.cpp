@@ -1,6 +1,7 @@
 ﻿#include <fstream>
 #include <random>
 #include <charconv>
+#include <numeric>
 
 #include <kiwi/Kiwi.h>
 #include <kiwi/Utils.h>
@@ -691,7 +692,8 @@ void KiwiBuilder::_addCorpusTo(
 	double splitRatio,
 	RaggedVector<VocabTy>* splitOut,
 	UnorderedMap<pair<KString, POSTag>, size_t>* oovDict,
-	const UnorderedMap<pair<KString, POSTag>, Vector<pair<KString, POSTag>>>* transform
+	const UnorderedMap<pair<KString, POSTag>, Vector<pair<KString, POSTag>>>* transform,
+	size_t maxDataSize
 ) const
 {
 	Vector<VocabTy> wids;
@@ -780,6 +782,8 @@ void KiwiBuilder::_addCorpusTo(
 			o.add_data(1);
 			wids.clear();
 			splitCnt = std::fmod(splitCnt, 1.);
+			// 문장 경계에서 멈추므로, 같은 스트림으로 다시 호출하면 이어서 읽을 수 있다.
+			if (out.dataSize() >= maxDataSize) return;
 			continue;
 		}
 		auto fields = split(wstr, u'\t');
@@ -1018,7 +1022,8 @@ KiwiBuilder::KiwiBuilder(StreamProvider streamProvider, size_t _numThreads, Buil
 			utils::createMemoryObjectFromStream(*sbgStream),
 			archType);
 	}
-	else if (ModelType::cong <= modelType && modelType <= ModelType::congGlobalFp32)
+	else if ((ModelType::cong <= modelType && modelType <= ModelType::congGlobalFp32)
+		|| modelType == ModelType::congQ4 || modelType == ModelType::congGlobalQ4)
 	{
 		auto stream = streamProvider("cong.mdl");
 		if (!stream) 
@@ -1028,8 +1033,9 @@ KiwiBuilder::KiwiBuilder(StreamProvider streamProvider, size_t _numThreads, Buil
 
 		langMdl = lm::CoNgramModelBase::create(utils::createMemoryObjectFromStream(*stream),
 			archType,
-			(modelType == ModelType::congGlobal || modelType == ModelType::congGlobalFp32),
-			(modelType == ModelType::cong || modelType == ModelType::congGlobal));
+			(modelType == ModelType::congGlobal || modelType == ModelType::congGlobalFp32 || modelType == ModelType::congGlobalQ4),
+			(modelType != ModelType::congFp32 && modelType != ModelType::congGlobalFp32),
+			(modelType == ModelType::congQ4 || modelType == ModelType::congGlobalQ4));
 	}
 
 	if (auto stream = streamProvider("dialect.dict"))
@@ -1096,7 +1102,7 @@ KiwiBuilder::KiwiBuilder(StreamProvider streamProvider, size_t _numThreads, Buil
 		nounChrMdl = lm::CoNgramModelBase::create(utils::createMemoryObjectFromStream(*stream),
 			archType,
 			false,
-			(modelType == ModelType::cong || modelType == ModelType::congGlobal));
+			(modelType == ModelType::cong || modelType == ModelType::congGlobal || modelType == ModelType::congQ4 || modelType == ModelType::congGlobalQ4));
 	}
 }
 
@@ -1134,17 +1140,8 @@ void KiwiBuilder::initMorphemes()
 template<class VocabTy>
 unique_ptr<lm::KnLangModelBase> KiwiBuilder::buildKnLM(const ModelBuildArgs& args, size_t lmVocabSize, MorphemeMap& realMorph) const
 {
-	RaggedVector<VocabTy> sents;
-	for (auto& path : args.corpora)
-	{
-		ifstream ifs;
-		cerr << "Loading corpus: " << path << endl;
-		addCorpusTo(sents, openFile(ifs, path), realMorph);
-	}
-
-	if (args.dropoutProb > 0 && args.dropoutSampling > 0)
+	const auto augmentWithDropout = [&](RaggedVector<VocabTy>& sents, mt19937_64& rng)
 	{
-		mt19937_64 rng{ 42 };
 		bernoulli_distribution sampler{ args.dropoutSampling }, drop{ args.dropoutProb };
 
 		size_t origSize = sents.size();
@@ -1162,7 +1159,8 @@ unique_ptr<lm::KnLangModelBase> KiwiBuilder::buildKnLM(const ModelBuildArgs& arg
 				sents.add_data(v);
 			}
 		}
-	}
+	};
+	const bool useDropout = args.dropoutProb > 0 && args.dropoutSampling > 0;
 
 	Vector<VocabTy> historyTx(lmVocabSize);
 	if (args.useLmTagHistory)
@@ -1192,29 +1190,105 @@ unique_ptr<lm::KnLangModelBase> KiwiBuilder::buildKnLM(const ModelBuildArgs& arg
 	}
 
 	vector<pair<VocabTy, VocabTy>> bigramList;
-	auto cntNodes = utils::count(sents.begin(), sents.end(), lmMinCnt, 1, args.lmOrder, (args.numWorkers > 1 ? &pool : nullptr), &bigramList, args.useLmTagHistory ? &historyTx : nullptr);
-	// discount for bos node cnt
-	if (args.useLmTagHistory)
+	const VocabTy bosKey = args.useLmTagHistory ? lmVocabSize : 0;
+	const auto buildModel = [&](auto&& cntNodes)
+	{
+		return lm::KnLangModelBase::create(lm::KnLangModelBase::build(
+			cntNodes,
+			args.lmOrder, minCnts,
+			2, 0, 1, 1e-5,
+			args.quantizeLm ? 8 : 0,
+			sizeof(VocabTy) == 2 ? args.compressLm : false,
+			&bigramList,
+			args.useLmTagHistory ? &historyTx : nullptr
+		), archType);
+	};
+
+	if (args.lmCountChunkSize)
 	{
-		cntNodes.root().getNext(lmVocabSize)->val /= 2;
+		// 말뭉치를 lmCountChunkSize개의 토큰 단위로 나누어 임시 파일에 기록한 뒤,
+		// 유니그램과 바이그램은 메모리에서 누적하고 n-gram은 조각별로 센 결과를 디스크에 내려두었다가 병합하며 모델을 생성한다.
+		utils::ThreadPool* poolPtr = args.numWorkers > 1 ? &pool : nullptr;
+		const auto* historyTxPtr = args.useLmTagHistory ? &historyTx : nullptr;
+		utils::TempFileSet chunkFiles{ args.lmCountTempDir, "kiwi_corpus" };
+		std::vector<size_t> unigramCf, unigramDf;
+		mt19937_64 rng{ 42 };
+		for (auto& path : args.corpora)
+		{
+			ifstream ifs;
+			cerr << "Loading corpus: " << path << endl;
+			openFile(ifs, path);
+			while (ifs)
+			{
+				RaggedVector<VocabTy> chunk;
+				_addCorpusTo<VocabTy>(chunk, ifs, realMorph, 0, nullptr, nullptr, nullptr, args.lmCountChunkSize);
+				if (!chunk.size()) continue;
+				if (useDropout) augmentWithDropout(chunk, rng);
+				utils::countUnigrams<VocabTy>(unigramCf, unigramDf, chunk.begin(), chunk.end(), poolPtr);
+				ofstream ofs;
+				chunk.write_to_memory(openFile(ofs, chunkFiles.newPath(), ios_base::binary));
+			}
+		}
+
+		const auto loadChunk = [&](size_t i)
+		{
+			ifstream ifs;
+			return RaggedVector<VocabTy>::from_memory(openFile(ifs, chunkFiles[i], ios_base::binary));
+		};
+
+		utils::map<pair<VocabTy, VocabTy>, size_t> bigramCf, bigramDf;
+		for (size_t i = 0; i < chunkFiles.size(); ++i)
+		{
+			auto chunk = loadChunk(i);
+			utils::countBigrams(bigramCf, bigramDf, chunk.begin(), chunk.end(), unigramCf, unigramDf, lmMinCnt, 1, poolPtr, historyTxPtr);
+		}
+		for (auto& p : bigramCf)
+		{
+			bigramList.emplace_back(p.first);
+		}
+
+		if (args.lmOrder <= 2)
+		{
+			auto cntNodes = utils::makeBigramTrie(unigramCf, unigramDf, bigramCf, lmMinCnt, 1, historyTxPtr);
+			cntNodes.root().getNext(bosKey)->val /= 2;
+			return buildModel(cntNodes);
+		}
+
+		const auto validPairs = utils::filterBigrams(bigramCf, bigramDf, lmMinCnt, 1);
+		bigramCf = {};
+		bigramDf = {};
+		utils::ExternalNgramCounts<VocabTy> cntRuns{ args.lmCountTempDir };
+		for (size_t i = 0; i < chunkFiles.size(); ++i)
+		{
+			auto chunk = loadChunk(i);
+			utils::ContinuousTrie<utils::CTrieNode<VocabTy>> cntNodes;
+			utils::countNgrams(cntNodes, chunk.begin(), chunk.end(), unigramCf, unigramDf, validPairs, lmMinCnt, 1, args.lmOrder, poolPtr, historyTxPtr);
+			cntRuns.addRun(cntNodes);
+		}
+		cntRuns.divideCount({ bosKey }, 2);
+		return buildModel(cntRuns);
 	}
-	else
+
+	RaggedVector<VocabTy> sents;
+	for (auto& path : args.corpora)
+	{
+		ifstream ifs;
+		cerr << "Loading corpus: " << path << endl;
+		addCorpusTo(sents, openFile(ifs, path), realMorph);
+	}
+
+	if (useDropout)
 	{
-		cntNodes.root().getNext(0)->val /= 2;
+		mt19937_64 rng{ 42 };
+		augmentWithDropout(sents, rng);
 	}
 
-	return lm::KnLangModelBase::create(lm::KnLangModelBase::build(
-		cntNodes,
-		args.lmOrder, minCnts,
-		2, 0, 1, 1e-5,
-		args.quantizeLm ? 8 : 0,
-		sizeof(VocabTy) == 2 ? args.compressLm : false,
-		&bigramList,
-		args.useLmTagHistory ? &historyTx : nullptr
-	), archType);
+	auto cntNodes = utils::count(sents.begin(), sents.end(), lmMinCnt, 1, args.lmOrder, (args.numWorkers > 1 ? &pool : nullptr), &bigramList, args.useLmTagHistory ? &historyTx : nullptr);
+	// discount for bos node cnt
+	cntNodes.root().getNext(bosKey)->val /= 2;
+	return buildModel(cntNodes);
 }
 
-
 KiwiBuilder::KiwiBuilder(const ModelBuildArgs& args)
 {
 	if (!(args.lmMinCnts.size() == 1 || args.lmMinCnts.size() == args.lmOrder))
@@ -1710,6 +1784,23 @@ void KiwiBuilder::addCombinedMorphemes(
 	size_t ruleId,
 	Map<int, int>* ruleProfilingCnt
 ) const
+{
+	Vector<cmb::Result> res;
+	combineMorphemes(res, newForms, newMorphemes, leftId, rightId, ruleId);
+	for (auto& r : res)
+	{
+		addCombinedMorpheme(newForms, newFormMap, newMorphemes, newFormCands, leftId, rightId, r, ruleProfilingCnt);
+	}
+}
+
+void KiwiBuilder::combineMorphemes(
+	Vector<cmb::Result>& out,
+	const Vector<FormRaw>& newForms,
+	const Vector<MorphemeRaw>& newMorphemes,
+	size_t leftId,
+	size_t rightId,
+	size_t ruleId
+) const
 {
 	const auto& getMorph = [&](size_t id) -> const MorphemeRaw&
 	{
@@ -1723,10 +1814,10 @@ void KiwiBuilder::addCombinedMorphemes(
 		else return newForms[id - forms.size()];
 	};
 
-	const auto leftMorph = getMorph(leftId);
+	const auto& leftMorph = getMorph(leftId);
 	auto leftForm = getForm(leftMorph.kform).form;
-	const auto rightMorph = getMorph(rightId);
-	const auto rightForm = getForm(rightMorph.kform).form;
+	const auto& rightMorph = getMorph(rightId);
+	const auto& rightForm = getForm(rightMorph.kform).form;
 
 	if ((leftMorph.tag == POSTag::unknown || leftMorph.tag == POSTag::unknown_feat_ha) && 
 		find(leftMorph.chunks.begin(), leftMorph.chunks.end(), rightId) != leftMorph.chunks.end())
@@ -1736,33 +1827,8 @@ void KiwiBuilder::addCombinedMorphemes(
 		return;
 	}
 
-	auto res = combiningRule->combine(leftForm, rightForm, ruleId);
-	for (auto& r : res)
+	const auto filterResults = [&](Vector<cmb::Result>&& res)
 	{
-		if (!r.ignoreRCond && !FeatureTestor::isMatched(&leftForm, rightMorph.vowel()))
-		{
-			continue;
-		}
-		if (!dialectHasIntersection(r.dialect, leftMorph.dialect) ||
-			!dialectHasIntersection(r.dialect, rightMorph.dialect))
-		{
-			continue;
-		}
-
-		// trim leading space
-		if (!r.str.empty() && r.str[0] == u' ')
-		{
-			r.str.erase(0, 1);
-		}
-
-		addCombinedMorpheme(newForms, newFormMap, newMorphemes, newFormCands, leftId, rightId, r, ruleProfilingCnt);
-	}
-
-	if (isEClass(leftMorph.tag) && leftForm[0] == u'어')
-	{
-		leftForm[0] = u'아';
-
-		auto res = combiningRule->combine(leftForm, rightForm, ruleId);
 		for (auto& r : res)
 		{
 			if (!r.ignoreRCond && !FeatureTestor::isMatched(&leftForm, rightMorph.vowel()))
@@ -1780,9 +1846,16 @@ void KiwiBuilder::addCombinedMorphemes(
 			{
 				r.str.erase(0, 1);
 			}
-
-			addCombinedMorpheme(newForms, newFormMap, newMorphemes, newFormCands, leftId, rightId, r, ruleProfilingCnt);
+			out.emplace_back(move(r));
 		}
+	};
+
+	filterResults(combiningRule->combine(leftForm, rightForm, ruleId));
+
+	if (isEClass(leftMorph.tag) && leftForm[0] == u'어')
+	{
+		leftForm[0] = u'아';
+		filterResults(combiningRule->combine(leftForm, rightForm, ruleId));
 	}
 }
 
@@ -1791,7 +1864,8 @@ void KiwiBuilder::buildCombinedMorphemes(
 	UnorderedMap<KString, size_t>& newFormMap,
 	Vector<MorphemeRaw>& newMorphemes, 
 	UnorderedMap<size_t, Vector<uint32_t>>& newFormCands,
-	Map<int, int>* ruleProfilingCnt
+	Map<int, int>* ruleProfilingCnt,
+	utils::ThreadPool* pool
 ) const
 {
 	const auto& getMorph = [&](size_t id) -> const MorphemeRaw&
@@ -1806,6 +1880,44 @@ void KiwiBuilder::buildCombinedMorphemes(
 		else return newForms[id - forms.size()];
 	};
 
+	/*
+	 * 결합 규칙 적용(combine)은 기존 형태소를 읽기만 하므로 병렬로 수행하고,
+	 * 새 형태소를 목록에 삽입하는 작업은 형태소 번호가 항상 같게 부여되도록 원래 순서대로 수행한다.
+	 * 후보 쌍이 많을 수 있으므로 일정 개수씩 끊어서 처리한다.
+	 */
+	static constexpr size_t combiningBlockSize = 1 << 14;
+	const size_t numShards = pool ? pool->size() * 4 : 1;
+	Vector<tuple<size_t, size_t, size_t>> combiningPairs;
+	Vector<Vector<cmb::Result>> combiningResults;
+	const auto flushCombiningPairs = [&]()
+	{
+		combiningResults.resize(combiningPairs.size());
+		utils::forEachShard(pool, combiningPairs.size(), numShards, [&](size_t, size_t first, size_t last)
+		{
+			for (size_t i = first; i < last; ++i)
+			{
+				combiningResults[i].clear();
+				combineMorphemes(combiningResults[i], newForms, newMorphemes, 
+					get<0>(combiningPairs[i]), get<1>(combiningPairs[i]), get<2>(combiningPairs[i]));
+			}
+		});
+
+		for (size_t i = 0; i < combiningPairs.size(); ++i)
+		{
+			for (auto& r : combiningResults[i])
+			{
+				addCombinedMorpheme(newForms, newFormMap, newMorphemes, newFormCands, 
+					get<0>(combiningPairs[i]), get<1>(combiningPairs[i]), r, ruleProfilingCnt);
+			}
+		}
+		combiningPairs.clear();
+	};
+	const auto addCombiningPair = [&](size_t leftId, size_t rightId, size_t ruleId)
+	{
+		combiningPairs.emplace_back(leftId, rightId, ruleId);
+		if (combiningPairs.size() >= combiningBlockSize) flushCombiningPairs();
+	};
+
 	Vector<Vector<size_t>> combiningLeftCands, combiningRightCands;
 	UnorderedMap<std::tuple<KString, POSTag, CondPolarity>, size_t> combiningSuffices;
 	size_t combiningUpdateIdx = defaultFormSize + 3;
@@ -1962,7 +2074,7 @@ void KiwiBuilder::buildCombinedMorphemes(
 			{
 				for (auto rit = rs.begin(); rit != rmid; ++rit)
 				{
-					addCombinedMorphemes(newForms, newFormMap, newMorphemes, newFormCands, *lit, *rit, ruleId, ruleProfilingCnt);
+					addCombiningPair(*lit, *rit, ruleId);
 				}
 			}
 
@@ -1970,10 +2082,11 @@ void KiwiBuilder::buildCombinedMorphemes(
 			{
 				for (auto rit = rmid; rit != rs.end(); ++rit)
 				{
-					addCombinedMorphemes(newForms, newFormMap, newMorphemes, newFormCands, *lit, *rit, ruleId, ruleProfilingCnt);
+					addCombiningPair(*lit, *rit, ruleId);
 				}
 			}
 		}
+		flushCombiningPairs();
 		combiningUpdateIdx = updated;
 	}
 
@@ -2382,6 +2495,112 @@ namespace kiwi
 	}
 }
 
+namespace kiwi
+{
+	/**
+	 * @brief 구간별로 나누어 병렬 정렬한 뒤 병합한다.
+	 */
+	template<class Vec, class Comp>
+	void parallelSort(utils::ThreadPool* pool, Vec& vec, Comp comp)
+	{
+		const size_t numShards = pool ? std::min(pool->size(), vec.size() / 4096) : 1;
+		if (numShards <= 1)
+		{
+			sort(vec.begin(), vec.end(), comp);
+			return;
+		}
+
+		Vector<size_t> bounds(numShards + 1);
+		for (size_t i = 0; i <= numShards; ++i) bounds[i] = vec.size() * i / numShards;
+		utils::forEachShard(pool, numShards, numShards, [&](size_t i, size_t, size_t)
+		{
+			sort(vec.begin() + bounds[i], vec.begin() + bounds[i + 1], comp);
+		});
+
+		for (size_t step = 1; step < numShards; step *= 2)
+		{
+			const size_t numMerges = (numShards + step * 2 - 1) / (step * 2);
+			utils::forEachShard(pool, numMerges, numMerges, [&](size_t m, size_t, size_t)
+			{
+				const size_t b = m * step * 2, mid = b + step, e = std::min(b + step * 2, numShards);
+				if (mid >= e) return;
+				inplace_merge(vec.begin() + bounds[b], vec.begin() + bounds[mid], vec.begin() + bounds[e], comp);
+			});
+		}
+	}
+
+	/**
+	 * @brief 사전순으로 정렬된 키 목록으로 formTrie를 생성한다.
+	 * 
+	 * 첫 글자가 서로 다른 구간으로 키를 나누어 구간마다 별도의 trie를 병렬로 생성하고 
+	 * 이를 순서대로 이어붙인다. 정렬된 순서로 삽입하면 노드가 깊이 우선 순서로 할당되므로
+	 * 이어붙인 결과는 단일 스레드로 생성한 것과 동일하다.
+	 */
+	template<class CacheCont, class Trie, class KeyFn, class ValueFn>
+	void buildSortedTrie(Trie& trie, size_t numKeys, KeyFn&& getKey, ValueFn&& getValue, utils::ThreadPool* pool)
+	{
+		const auto buildRange = [&](Trie& t, size_t first, size_t last)
+		{
+			size_t estimatedNodeSize = 0;
+			KString prevForm;
+			for (size_t i = first; i < last; ++i)
+			{
+				auto&& form = getKey(i);
+				size_t commonPrefix = 0;
+				while (commonPrefix < std::min(prevForm.size(), form.size())
+					&& prevForm[commonPrefix] == form[commonPrefix]) ++commonPrefix;
+				estimatedNodeSize += form.size() - commonPrefix;
+				prevForm = form;
+			}
+			t.reserveMore(estimatedNodeSize);
+
+			typename Trie::template CacheStore<CacheCont> cache;
+			for (size_t i = first; i < last; ++i)
+			{
+				t.buildWithCaching(getKey(i), getValue(i), cache);
+			}
+		};
+
+		Vector<size_t> bounds = { 0 };
+		const size_t numShards = pool ? pool->size() * 4 : 1;
+		for (size_t s = 1; s < numShards; ++s)
+		{
+			size_t b = std::max(numKeys * s / numShards, bounds.back() + 1);
+			for (; b < numKeys; ++b)
+			{
+				auto&& prev = getKey(b - 1);
+				auto&& cur = getKey(b);
+				if (!prev.empty() && !cur.empty() && prev[0] != cur[0]) break;
+			}
+			if (b >= numKeys) break;
+			bounds.emplace_back(b);
+		}
+		bounds.emplace_back(numKeys);
+
+		if (bounds.size() <= 2)
+		{
+			buildRange(trie, 0, numKeys);
+			return;
+		}
+
+		Vector<Trie> subTries(bounds.size() - 1);
+		utils::forEachShard(pool, subTries.size(), subTries.size(), [&](size_t i, size_t, size_t)
+		{
+			subTries[i] = Trie{ 1 };
+			buildRange(subTries[i], bounds[i], bounds[i + 1]);
+		});
+
+		size_t totalNodes = 0;
+		for (auto& t : subTries) totalNodes += t.size() - 1;
+		trie.reserveMore(totalNodes);
+		for (auto& t : subTries)
+		{
+			trie.appendRootChildren(move(t));
+			t = {};
+		}
+	}
+}
+
 Kiwi KiwiBuilder::build(const TypoTransformer& typos, float typoCostThreshold) const
 {
 	Kiwi ret{ archType, langMdl, !typos.empty(), typos.isContinualTypoEnabled(), typos.isLengtheningTypoEnabled() };
@@ -2393,8 +2612,20 @@ Kiwi KiwiBuilder::build(const TypoTransformer& typos, float typoCostThreshold) c
 	UnorderedMap<KString, size_t> newFormMap;
 	UnorderedMap<size_t, Vector<uint32_t>> newFormCands;
 
+	if (threadPool && threadPool->size())
+	{
+		ret.pool = threadPool;
+	}
+	else if (numThreads >= 1)
+	{
+		ret.pool = make_shared<utils::ThreadPool>(numThreads);
+	}
+	// 사전 구축 단계에서는 스레드가 2개 이상일 때만 병렬 처리를 수행한다.
+	utils::ThreadPool* buildPool = ret.pool && ret.pool->size() > 1 && !ret.pool->isWorkerThread() ? ret.pool.get() : nullptr;
+	const size_t numShards = buildPool ? buildPool->size() * 4 : 1;
+
 	Map<int, int> ruleProfilingCnt;
-	buildCombinedMorphemes(combinedForms, newFormMap, combinedMorphemes, newFormCands, &ruleProfilingCnt);
+	buildCombinedMorphemes(combinedForms, newFormMap, combinedMorphemes, newFormCands, &ruleProfilingCnt, buildPool);
 
 	Vector<pair<int, float>> ruleProfilingPercent;
 	int totalCnt = accumulate(ruleProfilingCnt.begin(), ruleProfilingCnt.end(), 0, [](int a, const pair<int, int>& b) { return a + b.second; });
@@ -2411,34 +2642,45 @@ Kiwi KiwiBuilder::build(const TypoTransformer& typos, float typoCostThreshold) c
 	ret.morphemes.reserve(morphemes.size() + combinedMorphemes.size());
 	ret.combiningRule = combiningRule;
 	ret.globalConfig.integrateAllomorph = !!(options & BuildOption::integrateAllomorph);
-	if (numThreads >= 1)
+
+	// bit 0: zCodaAppendable, bit 1: zSiotAppendable
+	Vector<uint8_t> formAppendable(forms.size() + combinedForms.size());
+	utils::forEachShard(buildPool, formAppendable.size(), numShards, [&](size_t, size_t first, size_t last)
 	{
-		ret.pool = make_unique<utils::ThreadPool>(numThreads);
-	}
+		for (size_t i = first; i < last; ++i)
+		{
+			const auto& f = i < forms.size() ? forms[i] : combinedForms[i - forms.size()];
+			bool zCodaAppendable = isZCodaAppendable(f.form, f.candidate, morphemes, combinedMorphemes);
+			bool zSiotAppendable = isZSiotAppendable(f.form, f.candidate, morphemes, combinedMorphemes);
+			auto it = newFormCands.find(i);
+			if (it != newFormCands.end())
+			{
+				zCodaAppendable = zCodaAppendable || isZCodaAppendable(f.form, it->second, morphemes, combinedMorphemes);
+				zSiotAppendable = zSiotAppendable || isZSiotAppendable(f.form, it->second, morphemes, combinedMorphemes);
+			}
+			formAppendable[i] = (zCodaAppendable ? 1 : 0) | (zSiotAppendable ? 2 : 0);
+		}
+	});
 
 	for (auto& f : forms)
 	{
 		auto it = newFormCands.find(ret.forms.size());
-		bool zCodaAppendable = isZCodaAppendable(f.form, f.candidate, morphemes, combinedMorphemes);
-		bool zSiotAppendable = isZSiotAppendable(f.form, f.candidate, morphemes, combinedMorphemes);
+		const bool zCodaAppendable = !!(formAppendable[ret.forms.size()] & 1);
+		const bool zSiotAppendable = !!(formAppendable[ret.forms.size()] & 2);
 		if (it == newFormCands.end())
 		{
 			ret.forms.emplace_back(bake(f, ret.morphemes.data(), zCodaAppendable, zSiotAppendable));
 		}
 		else
 		{
-			zCodaAppendable = zCodaAppendable || isZCodaAppendable(f.form, it->second, morphemes, combinedMorphemes);
-			zSiotAppendable = zSiotAppendable || isZSiotAppendable(f.form, it->second, morphemes, combinedMorphemes);
 			ret.forms.emplace_back(bake(f, ret.morphemes.data(), zCodaAppendable, zSiotAppendable, it->second));
 		}
 		
 	}
 	for (auto& f : combinedForms)
 	{
-		bool zCodaAppendable = isZCodaAppendable(f.form, f.candidate, morphemes, combinedMorphemes)
-			|| isZCodaAppendable(f.form, newFormCands[ret.forms.size()], morphemes, combinedMorphemes);
-		bool zSiotAppendable = isZSiotAppendable(f.form, f.candidate, morphemes, combinedMorphemes)
-			|| isZSiotAppendable(f.form, newFormCands[ret.forms.size()], morphemes, combinedMorphemes);
+		const bool zCodaAppendable = !!(formAppendable[ret.forms.size()] & 1);
+		const bool zSiotAppendable = !!(formAppendable[ret.forms.size()] & 2);
 		ret.forms.emplace_back(bake(f, ret.morphemes.data(), zCodaAppendable, zSiotAppendable, newFormCands[ret.forms.size()]));
 	}
 
@@ -2508,61 +2750,70 @@ Kiwi KiwiBuilder::build(const TypoTransformer& typos, float typoCostThreshold) c
 	// 오타 교정이 없는 경우 일반 Trie 생성
 	if (typos.empty())
 	{
-		sort(sortedForms.begin(), sortedForms.end(), [](const Form* a, const Form* b)
+		// 공백을 제외하면 같은 형태들 중 trie에 먼저 삽입되는 것이 남으므로,
+		// 스레드 개수와 관계없이 같은 결과가 나오도록 형태의 순번으로 순서를 완전히 정한다.
+		parallelSort(buildPool, sortedForms, [](const Form* a, const Form* b)
 		{
-			return ComparatorIgnoringSpace::less(a->form, b->form);
+			if (ComparatorIgnoringSpace::less(a->form, b->form)) return true;
+			if (ComparatorIgnoringSpace::less(b->form, a->form)) return false;
+			return a < b;
 		});
 
-		size_t estimatedNodeSize = 0;
-		const KString* prevForm = nullptr;
-		for (auto f : sortedForms)
-		{
-			if (!prevForm)
-			{
-				estimatedNodeSize += f->form.size() - count(f->form.begin(), f->form.end(), u' ');
-				prevForm = &f->form;
-				continue;
-			}
-			size_t commonPrefix = 0;
-			while (commonPrefix < std::min(prevForm->size(), f->form.size())
-				&& (*prevForm)[commonPrefix] == f->form[commonPrefix]) ++commonPrefix;
-			estimatedNodeSize += f->form.size() - commonPrefix;
-			prevForm = &f->form;
-		}
-		formTrie.reserveMore(estimatedNodeSize);
-
-		decltype(formTrie)::CacheStore<KString> cache;
-		for (auto f : sortedForms)
-		{
-			formTrie.buildWithCaching(removeSpace(f->form), f, cache);
-		}
+		buildSortedTrie<KString>(formTrie, sortedForms.size(), 
+			[&](size_t i) { return removeSpace(sortedForms[i]->form); },
+			[&](size_t i) { return sortedForms[i]; },
+			buildPool
+		);
 	}
 	// 오타 교정이 있는 경우 가능한 모든 오타에 대해 Trie 생성
 	else
 	{
 		using TypoInfo = tuple<uint32_t, float, uint16_t, CondVowel, Dialect>;
-		UnorderedMap<KString, Vector<TypoInfo>> typoGroup;
-		using TypoGroupPtr = decltype(typoGroup)::pointer;
+		using TypoGroup = UnorderedMap<KString, Vector<TypoInfo>>;
+		using TypoGroupPtr = TypoGroup::pointer;
 		auto ptypos = typos.prepare();
 		ret.continualTypoCost = ptypos.getContinualTypoCost();
 		ret.lengtheningTypoCost = ptypos.getLengtheningTypoCost();
-		for (auto f : sortedForms)
+
+		// 형태별 오타 생성은 구간별로 병렬 수행하고, 구간 순서대로 병합하여 단일 스레드와 같은 순서를 유지한다.
+		Vector<TypoGroup> shardTypoGroups(numShards);
+		utils::forEachShard(buildPool, sortedForms.size(), numShards, [&](size_t shard, size_t first, size_t last)
 		{
-			// 현재는 공백이 없는 단일 단어에 대해서만 오타 교정을 수행.
-			// 공백이 포함된 복합 명사류의 경우 오타 후보가 지나치게 많아져
-			// 메모리 요구량이 급격히 증가하기 때문.
-			if (f->numSpaces == 0)
+			auto& typoGroup = shardTypoGroups[shard];
+			for (size_t i = first; i < last; ++i)
 			{
-				for (auto t : ptypos._generate(f->form, typoCostThreshold))
+				auto f = sortedForms[i];
+				// 현재는 공백이 없는 단일 단어에 대해서만 오타 교정을 수행.
+				// 공백이 포함된 복합 명사류의 경우 오타 후보가 지나치게 많아져
+				// 메모리 요구량이 급격히 증가하기 때문.
+				if (f->numSpaces == 0)
+				{
+					for (auto t : ptypos._generate(f->form, typoCostThreshold))
+					{
+						if (t.leftCond != CondVowel::none && f->vowel != CondVowel::none && t.leftCond != f->vowel) continue;
+						typoGroup[removeSpace(t.str)].emplace_back(f - ret.forms.data(), t.cost, f->numSpaces, t.leftCond, t.dialect);
+					}
+				}
+				else
 				{
-					if (t.leftCond != CondVowel::none && f->vowel != CondVowel::none && t.leftCond != f->vowel) continue;
-					typoGroup[removeSpace(t.str)].emplace_back(f - ret.forms.data(), t.cost, f->numSpaces, t.leftCond, t.dialect);
+					typoGroup[removeSpace(f->form)].emplace_back(f - ret.forms.data(), 0, f->numSpaces, CondVowel::none, Dialect::standard);
 				}
 			}
-			else
+		});
+
+		TypoGroup typoGroup = move(shardTypoGroups[0]);
+		for (size_t shard = 1; shard < shardTypoGroups.size(); ++shard)
+		{
+			auto& g = shardTypoGroups[shard];
+			for (auto it = g.begin(); it != g.end();)
 			{
-				typoGroup[removeSpace(f->form)].emplace_back(f - ret.forms.data(), 0, f->numSpaces, CondVowel::none, Dialect::standard);
+				auto inserted = typoGroup.insert(g.extract(it++));
+				if (inserted.inserted) continue;
+				auto& dest = inserted.position->second;
+				auto& src = inserted.node.mapped();
+				dest.insert(dest.end(), src.begin(), src.end());
 			}
+			g = {};
 		}
 
 		Vector<TypoGroupPtr> typoGroupSorted;
@@ -2570,27 +2821,36 @@ Kiwi KiwiBuilder::build(const TypoTransformer& typos, float typoCostThreshold) c
 		for (auto& v : typoGroup)
 		{
 			typoGroupSorted.emplace_back(&v);
-			sort(v.second.begin(), v.second.end(), [](const TypoInfo& a, const TypoInfo& b)
-			{
-				if (get<1>(a) < get<1>(b)) return true;
-				if (get<1>(a) > get<1>(b)) return false;
-				return get<0>(a) < get<0>(b);
-			});
 			totTfSize += v.second.size();
 		}
 
-		sort(typoGroupSorted.begin(), typoGroupSorted.end(), [](TypoGroupPtr a, TypoGroupPtr b)
+		utils::forEachShard(buildPool, typoGroupSorted.size(), numShards, [&](size_t, size_t first, size_t last)
+		{
+			for (size_t i = first; i < last; ++i)
+			{
+				auto& v = typoGroupSorted[i]->second;
+				sort(v.begin(), v.end(), [](const TypoInfo& a, const TypoInfo& b)
+				{
+					if (get<1>(a) < get<1>(b)) return true;
+					if (get<1>(a) > get<1>(b)) return false;
+					return get<0>(a) < get<0>(b);
+				});
+			}
+		});
+
+		parallelSort(buildPool, typoGroupSorted, [](TypoGroupPtr a, TypoGroupPtr b)
 		{
 			return a->first < b->first;
 		});
 
 		ret.typoForms.reserve(totTfSize + 1);
 		
-		size_t estimatedNodeSize = 0;
-		const KString* prevForm = nullptr;
+		Vector<size_t> typoFormOffsets;
+		typoFormOffsets.reserve(typoGroupSorted.size());
 		bool hash = false;
 		for (auto f : typoGroupSorted)
 		{
+			typoFormOffsets.emplace_back(ret.typoForms.size());
 			ret.typoForms.insert(ret.typoForms.end(), f->second.begin(), f->second.end());
 			for (auto it = ret.typoForms.end() - f->second.size(); it != ret.typoForms.end(); ++it)
 			{
@@ -2608,29 +2868,15 @@ Kiwi KiwiBuilder::build(const TypoTransformer& typos, float typoCostThreshold) c
 			}
 
 			hash = !hash;
-			if (!prevForm)
-			{
-				estimatedNodeSize += f->first.size() - count(f->first.begin(), f->first.end(), u' ');
-				prevForm = &f->first;
-				continue;
-			}
-			size_t commonPrefix = 0;
-			while (commonPrefix < std::min(prevForm->size(), f->first.size())
-				&& (*prevForm)[commonPrefix] == f->first[commonPrefix]) ++commonPrefix;
-			estimatedNodeSize += f->first.size() - commonPrefix;
-			prevForm = &f->first;
 		}
 		ret.typoForms.emplace_back(0, 0, hash);
 		ret.typoPtrs.emplace_back(ret.typoPool.size());
-		formTrie.reserveMore(estimatedNodeSize);
 
-		decltype(formTrie)::CacheStore<const KString*> cache;
-		size_t cumulated = 0;
-		for (auto f : typoGroupSorted)
-		{
-			formTrie.buildWithCaching(f->first, reinterpret_cast<const Form*>(&ret.typoForms[cumulated]), cache);
-			cumulated += f->second.size();
-		}
+		buildSortedTrie<const KString*>(formTrie, typoGroupSorted.size(), 
+			[&](size_t i) -> const KString& { return typoGroupSorted[i]->first; },
+			[&](size_t i) { return reinterpret_cast<const Form*>(&ret.typoForms[typoFormOffsets[i]]); },
+			buildPool
+		);
 	}
 
 	ret.formTrie = freezeTrie(move(formTrie), archType);
@@ -2846,26 +3092,10 @@ void KiwiBuilder::convertHSData(
 	}
 }
 
-HSDataset KiwiBuilder::makeHSDataset(const vector<string>& inputPathes, 
-	size_t batchSize, size_t causalContextSize, size_t windowSize, size_t numWorkers, 
-	HSDatasetOption option,
-	const TokenFilter& tokenFilter,
-	const TokenFilter& windowFilter,
-	double splitRatio,
-	bool separateDefaultMorpheme,
-	const string& morphemeDefPath,
-	size_t morphemeDefMinCnt,
-	const vector<pair<size_t, vector<uint32_t>>>& contextualMapper,
-	HSDataset* splitDataset,
-	const vector<pair<pair<string, POSTag>, vector<pair<string, POSTag>>>>* transform
-) const
+const KiwiBuilder* KiwiBuilder::prepareHSDataset(HSDataset& dataset, const HSDatasetOption& option, bool separateDefaultMorpheme,
+	const string& morphemeDefPath, size_t morphemeDefMinCnt, MorphemeMap& realMorph, size_t& maxTokenId) const
 {
-	HSDataset dataset{ batchSize, causalContextSize, windowSize, true, numWorkers, option };
-	auto& sents = dataset.sents.get();
 	const KiwiBuilder* srcBuilder = this;
-	MorphemeMap realMorph;
-	size_t maxTokenId = 0;
-
 	const bool doesGenerateUnlikelihoods = option.generateUnlikelihoods != (size_t)-1;
 
 	if (morphemeDefPath.empty())
@@ -2905,6 +3135,91 @@ HSDataset KiwiBuilder::makeHSDataset(const vector<string>& inputPathes,
 	dataset.morphemes = &srcBuilder->morphemes;
 	dataset.forms = &srcBuilder->forms;
 	dataset.specialMorphIds = getSpecialMorphs();
+	return srcBuilder;
+}
+
+void KiwiBuilder::buildHSDatasetVocab(HSDataset& dataset, const KiwiBuilder* srcBuilder, size_t tokenSize, size_t maxTokenId,
+	const TokenFilter& tokenFilter,
+	const TokenFilter& windowFilter,
+	const vector<pair<size_t, vector<uint32_t>>>& contextualMapper) const
+{
+	const size_t knlmVocabSize = dataset.langModel ? dataset.langModel->vocabSize() : maxTokenId;
+	tokenSize = max(tokenSize, knlmVocabSize);
+	size_t filteredKnlmVocabSize = 0;
+	for (size_t i = 0; i < tokenSize; ++i)
+	{
+		if (i == knlmVocabSize)
+		{
+			filteredKnlmVocabSize = dataset.vocabToToken.size();
+		}
+		
+		if (windowFilter && !windowFilter(joinHangul(srcBuilder->forms[srcBuilder->morphemes[i].kform].form), srcBuilder->morphemes[i].tag))
+		{
+			dataset.windowTokenValidness.emplace_back(0);
+		}
+		else
+		{
+			dataset.windowTokenValidness.emplace_back(1);
+		}
+
+		if (tokenFilter && !tokenFilter(joinHangul(srcBuilder->forms[srcBuilder->morphemes[i].kform].form), srcBuilder->morphemes[i].tag))
+		{
+			dataset.tokenToVocab.emplace_back(HSDataset::nonVocab);
+			continue;
+		}
+		dataset.tokenToVocab.emplace_back(dataset.vocabToToken.size());
+		dataset.vocabToToken.emplace_back(i);
+	}
+	if (tokenSize == knlmVocabSize)
+	{
+		filteredKnlmVocabSize = dataset.vocabToToken.size();
+	}
+	dataset.knlmVocabSize = filteredKnlmVocabSize;
+
+	const size_t numSents = dataset.numSents();
+	Vector<size_t> shardTokens(dataset.workers ? dataset.workers->size() * 4 : 1);
+	utils::forEachShard(dataset.workers.get(), numSents, shardTokens.size(), [&](size_t shard, size_t first, size_t last)
+	{
+		for (size_t i = first; i < last; ++i)
+		{
+			shardTokens[shard] += dataset.numValidTokensInSent(i) - 1;
+		}
+	});
+	dataset.totalTokens = accumulate(shardTokens.begin(), shardTokens.end(), (size_t)0);
+	
+	if (!contextualMapper.empty())
+	{
+		utils::ContinuousTrie<utils::TrieNodeEx<uint32_t, uint32_t>> cmTrie(1);
+		for (auto& p : contextualMapper)
+		{
+			cmTrie.build(p.second.begin(), p.second.end(), p.first + 1);
+		}
+		cmTrie.fillFail();
+		dataset.contextualMapper = utils::FrozenTrie<uint32_t, uint32_t>{ cmTrie, ArchTypeHolder<ArchType::balanced>{} };
+	}
+}
+
+HSDataset KiwiBuilder::makeHSDataset(const vector<string>& inputPathes, 
+	size_t batchSize, size_t causalContextSize, size_t windowSize, size_t numWorkers, 
+	HSDatasetOption option,
+	const TokenFilter& tokenFilter,
+	const TokenFilter& windowFilter,
+	double splitRatio,
+	bool separateDefaultMorpheme,
+	const string& morphemeDefPath,
+	size_t morphemeDefMinCnt,
+	const vector<pair<size_t, vector<uint32_t>>>& contextualMapper,
+	HSDataset* splitDataset,
+	const vector<pair<pair<string, POSTag>, vector<pair<string, POSTag>>>>* transform
+) const
+{
+	HSDataset dataset{ batchSize, causalContextSize, windowSize, true, numWorkers, option };
+	auto& sents = dataset.sents.get();
+	MorphemeMap realMorph;
+	size_t maxTokenId = 0;
+	const KiwiBuilder* srcBuilder = prepareHSDataset(dataset, option, separateDefaultMorpheme, morphemeDefPath, morphemeDefMinCnt, realMorph, maxTokenId);
+
+	const bool doesGenerateUnlikelihoods = option.generateUnlikelihoods != (size_t)-1;
 
 	if (splitDataset)
 	{
@@ -3018,71 +3333,98 @@ HSDataset KiwiBuilder::makeHSDataset(const vector<string>& inputPathes,
 		if (splitDataset) splitDataset->oovDict = dataset.oovDict;
 	}
 
-	const size_t knlmVocabSize = dataset.langModel ? dataset.langModel->vocabSize() : maxTokenId;
-	tokenSize = max(tokenSize, knlmVocabSize);
-	size_t filteredKnlmVocabSize = 0;
-	for (size_t i = 0; i < tokenSize; ++i)
+	dataset.bindSents();
+	buildHSDatasetVocab(dataset, srcBuilder, tokenSize, maxTokenId, tokenFilter, windowFilter, contextualMapper);
+
+	if (splitDataset)
 	{
-		if (i == knlmVocabSize)
+		splitDataset->windowTokenValidness = dataset.windowTokenValidness;
+		splitDataset->tokenToVocab = dataset.tokenToVocab;
+		splitDataset->vocabToToken = dataset.vocabToToken;
+		splitDataset->knlmVocabSize = dataset.knlmVocabSize;
+		splitDataset->bindSents();
+		for (size_t i = 0; i < splitDataset->sents.get().size(); ++i)
 		{
-			filteredKnlmVocabSize = dataset.vocabToToken.size();
+			splitDataset->totalTokens += splitDataset->numValidTokensInSent(i) - 1;
 		}
 		
-		if (windowFilter && !windowFilter(joinHangul(srcBuilder->forms[srcBuilder->morphemes[i].kform].form), srcBuilder->morphemes[i].tag))
+		if (!contextualMapper.empty())
 		{
-			dataset.windowTokenValidness.emplace_back(0);
+			splitDataset->contextualMapper = dataset.contextualMapper;
 		}
-		else
+	}
+	return dataset;
+}
+
+HSDataset KiwiBuilder::makeMappedHSDataset(const vector<string>& convertedPathes,
+	size_t batchSize, size_t causalContextSize, size_t windowSize, size_t numWorkers,
+	HSDatasetOption option,
+	const TokenFilter& tokenFilter,
+	const TokenFilter& windowFilter,
+	bool separateDefaultMorpheme,
+	const string& morphemeDefPath,
+	size_t morphemeDefMinCnt,
+	const vector<pair<size_t, vector<uint32_t>>>& contextualMapper
+) const
+{
+	HSDataset dataset{ batchSize, causalContextSize, windowSize, true, numWorkers, option };
+	MorphemeMap realMorph;
+	size_t maxTokenId = 0;
+	const KiwiBuilder* srcBuilder = prepareHSDataset(dataset, option, separateDefaultMorpheme, morphemeDefPath, morphemeDefMinCnt, realMorph, maxTokenId);
+
+	auto& view = dataset.sentView.get();
+	for (auto& path : convertedPathes)
+	{
+		dataset.mappedFiles.emplace_back(std::make_unique<utils::MMap>(path));
+		auto& mm = *dataset.mappedFiles.back();
+		size_t pos = view.appendMemory(mm.get(), mm.size());
+
+		uint32_t oovDictSize = 0;
+		if (mm.size() - pos >= sizeof(uint32_t))
 		{
-			dataset.windowTokenValidness.emplace_back(1);
+			memcpy(&oovDictSize, mm.get() + pos, sizeof(uint32_t));
+			pos += sizeof(uint32_t);
 		}
+		if (!oovDictSize) continue;
 
-		if (tokenFilter && !tokenFilter(joinHangul(srcBuilder->forms[srcBuilder->morphemes[i].kform].form), srcBuilder->morphemes[i].tag))
+		// 음수 토큰은 파일별 OOV 사전의 인덱스이므로, 사전이 둘 이상이면 복사 없이는 이를 구분할 수 없다.
+		if (dataset.oovDict)
 		{
-			dataset.tokenToVocab.emplace_back(HSDataset::nonVocab);
-			continue;
+			throw invalid_argument{ "Only one of `convertedPathes` can have an OOV dictionary. Convert them together with `convertHSData`." };
 		}
-		dataset.tokenToVocab.emplace_back(dataset.vocabToToken.size());
-		dataset.vocabToToken.emplace_back(i);
-	}
-	if (tokenSize == knlmVocabSize)
-	{
-		filteredKnlmVocabSize = dataset.vocabToToken.size();
-	}
-	dataset.knlmVocabSize = filteredKnlmVocabSize;
 
-	for (size_t i = 0; i < sents.size(); ++i)
-	{
-		dataset.totalTokens += dataset.numValidTokensInSent(i) - 1;
-	}
-	
-	if (!contextualMapper.empty())
-	{
-		utils::ContinuousTrie<utils::TrieNodeEx<uint32_t, uint32_t>> cmTrie(1);
-		for (auto& p : contextualMapper)
+		dataset.oovDict = make_shared<Vector<pair<u16string, POSTag>>>();
+		dataset.oovDict->reserve(oovDictSize);
+		for (uint32_t i = 0; i < oovDictSize; ++i)
 		{
-			cmTrie.build(p.second.begin(), p.second.end(), p.first + 1);
+			uint32_t tagAndSize = 0;
+			if (mm.size() - pos < sizeof(uint32_t)) throw runtime_error{ "Invalid OOV dictionary in '" + path + "'" };
+			memcpy(&tagAndSize, mm.get() + pos, sizeof(uint32_t));
+			pos += sizeof(uint32_t);
+
+			u16string form(tagAndSize >> 8, 0);
+			if ((mm.size() - pos) / sizeof(char16_t) < form.size()) throw runtime_error{ "Invalid OOV dictionary in '" + path + "'" };
+			memcpy(&form[0], mm.get() + pos, form.size() * sizeof(char16_t));
+			pos += form.size() * sizeof(char16_t);
+			dataset.oovDict->emplace_back(move(form), (POSTag)(tagAndSize & 0xff));
 		}
-		cmTrie.fillFail();
-		dataset.contextualMapper = utils::FrozenTrie<uint32_t, uint32_t>{ cmTrie, ArchTypeHolder<ArchType::balanced>{} };
 	}
 
-	if (splitDataset)
+	// 말뭉치에 등장하는 최대 토큰 id는 makeHSDataset과 동일한 어휘 집합을 만들기 위해 필요하다.
+	// 파일은 읽기 전용으로 매핑되므로 이 과정에서 접근한 페이지는 다른 프로세스와 공유된다.
+	Vector<int32_t> shardMax(dataset.workers ? dataset.workers->size() * 4 : 1, -1);
+	utils::forEachShard(dataset.workers.get(), view.size(), shardMax.size(), [&](size_t shard, size_t first, size_t last)
 	{
-		splitDataset->windowTokenValidness = dataset.windowTokenValidness;
-		splitDataset->tokenToVocab = dataset.tokenToVocab;
-		splitDataset->vocabToToken = dataset.vocabToToken;
-		splitDataset->knlmVocabSize = dataset.knlmVocabSize;
-		for (size_t i = 0; i < splitDataset->sents.get().size(); ++i)
+		int32_t m = -1;
+		for (size_t i = first; i < last; ++i)
 		{
-			splitDataset->totalTokens += splitDataset->numValidTokensInSent(i) - 1;
+			for (auto t : view[i]) m = max(m, t);
 		}
-		
-		if (!contextualMapper.empty())
-		{
-			splitDataset->contextualMapper = dataset.contextualMapper;
-		}
-	}
+		shardMax[shard] = m;
+	});
+	const size_t tokenSize = (size_t)(*max_element(shardMax.begin(), shardMax.end()) + 1);
+
+	buildHSDatasetVocab(dataset, srcBuilder, tokenSize, maxTokenId, tokenFilter, windowFilter, contextualMapper);
 	return dataset;
 }
 
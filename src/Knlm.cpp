@@ -129,6 +129,87 @@ namespace kiwi
 			}
 		}
 
+		template<ArchType arch, class KeyType, bool transposed, class DiffType>
+		void KnLangModel<arch, KeyType, transposed, DiffType>::_evaluateBatch(const uint32_t* tokens, const size_t* seq_offsets, size_t num_seqs,
+			float min_score, float* sent_ll_out, float* token_ll_out) const
+		{
+			// 한 시퀀스의 탐색은 이전 토큰의 결과에 의존하므로, 
+			// 여러 시퀀스를 레인에 나누어 담고 한 토큰씩 번갈아 진행하여 각 레인의 메모리 접근이 서로 겹치도록 한다.
+			static constexpr size_t numLanes = 16;
+			struct Lane
+			{
+				size_t seq, pos, end;
+				ptrdiff_t node;
+				float acc;
+			};
+
+			Lane lanes[numLanes];
+			size_t numActive = 0, nextSeq = 0;
+			const auto fillLane = [&](Lane& lane)
+			{
+				while (nextSeq < num_seqs)
+				{
+					const size_t s = nextSeq++;
+					if (seq_offsets[s] == seq_offsets[s + 1])
+					{
+						if (sent_ll_out) sent_ll_out[s] = 0;
+						continue;
+					}
+					lane = Lane{ s, seq_offsets[s], seq_offsets[s + 1], 0, 0 };
+					return true;
+				}
+				return false;
+			};
+
+			while (numActive < numLanes && fillLane(lanes[numActive])) ++numActive;
+
+			while (numActive)
+			{
+				// 1단계: 각 레인이 이번에 탐색할 키/값 배열을 미리 불러온다.
+				// 노드 자체는 직전 단계에서 미리 불러왔으므로 next_offset을 읽는 비용은 크지 않다.
+				for (size_t i = 0; i < numActive; ++i)
+				{
+					auto& lane = lanes[i];
+					if (lane.node == 0)
+					{
+						PREFETCH_T0(&all_value_data[(KeyType)tokens[lane.pos]]);
+					}
+					else
+					{
+						auto& node = node_data[lane.node];
+						PREFETCH_T0(&key_data[node.next_offset]);
+						PREFETCH_T0(&value_data[node.next_offset]);
+					}
+				}
+
+				// 2단계: 각 레인을 한 토큰씩 진행하고, 다음 단계에서 사용할 노드를 미리 불러온다.
+				for (size_t i = 0; i < numActive;)
+				{
+					auto& lane = lanes[i];
+					const float ll = progress(lane.node, (KeyType)tokens[lane.pos]);
+					if (token_ll_out) token_ll_out[lane.pos] = ll;
+					lane.acc += std::max(ll, min_score);
+					PREFETCH_T0(&node_data[lane.node]);
+					if (++lane.pos < lane.end)
+					{
+						++i;
+						continue;
+					}
+
+					if (sent_ll_out) sent_ll_out[lane.seq] = lane.acc;
+					if (fillLane(lane))
+					{
+						++i;
+					}
+					else
+					{
+						// 마지막 레인을 빈 자리로 옮긴다. 옮겨진 레인은 이번 단계에서 아직 진행되지 않았으므로 i를 유지한다.
+						lane = lanes[--numActive];
+					}
+				}
+			}
+		}
+
 		template<ArchType arch, class KeyType, bool transposed, class DiffType>
 		void* KnLangModel<arch, KeyType, transposed, DiffType>::getFindBestPathFn() const
 		{
@@ -95,6 +95,9 @@ namespace kiwi
 				return progress(node_idx, (KeyType)next);
 			}
 
+			void _evaluateBatch(const uint32_t* tokens, const size_t* seq_offsets, size_t num_seqs,
+				float min_score, float* sent_ll_out, float* token_ll_out) const override;
+
 			ptrdiff_t getBosNodeIdx() const
 			{
 				return bos_node_idx;
@@ -812,7 +815,10 @@ namespace kiwi
 		}
 
 		template<class Trie>
-		struct GetNodeType;
+		struct GetNodeType
+		{
+			using type = typename Trie::Node;
+		};
 
 		template<class TrieNode>
 		struct GetNodeType<utils::ContinuousTrie<TrieNode>>
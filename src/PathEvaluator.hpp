@@ -472,7 +472,7 @@ namespace kiwi
 				if (!nCache.empty()) break;
 			}
 
-			thread_local Vector<float> maxScores;
+			thread_local utils::Scratch<Vector<float>> maxScores;
 			maxScores.clear();
 			maxScores.resize((1 + prevSpStates.size()) * topN, -INFINITY);
 
@@ -522,7 +522,7 @@ namespace kiwi
 			const float dialectCost
 		) const
 		{
-			thread_local BestPathConatiner<mode, LmState> bestPathCont;
+			thread_local utils::Scratch<BestPathConatiner<mode, LmState>> bestPathCont;
 			
 			const auto* langMdl = kw->getLangModel();
 			const Morpheme* morphBase = kw->morphemes.data();
@@ -656,9 +656,9 @@ namespace kiwi
 			const Vector<SpecialState>& prevSpStates
 		) const
 		{
-			thread_local BestPathConatiner<mode, LmState> bestPathCont;
-			thread_local Vector<LmEvalData<LmState>> evalMatrix;
-			thread_local Vector<Wid> nextWids;
+			thread_local utils::Scratch<BestPathConatiner<mode, LmState>> bestPathCont;
+			thread_local utils::Scratch<Vector<LmEvalData<LmState>>> evalMatrix;
+			thread_local utils::Scratch<Vector<Wid>> nextWids;
 
 			const auto* langMdl = kw->getLangModel();
 			const Morpheme* morphBase = kw->morphemes.data();
@@ -870,8 +870,8 @@ namespace kiwi
 			float dialectCost = 0.f
 			) const
 		{
-			thread_local Vector<float> maxScores;
-			thread_local Vector<const Morpheme*> validMorphCands;
+			thread_local utils::Scratch<Vector<float>> maxScores;
+			thread_local utils::Scratch<Vector<const Morpheme*>> validMorphCands;
 			const size_t langVocabSize = kw->langMdl->vocabSize();
 			auto* const node = startNode + nodeIdx;
 			auto& nCache = cache[nodeIdx];
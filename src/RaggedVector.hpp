@@ -1,5 +1,7 @@
 #pragma once
 #include <iterator>
+#include <algorithm>
+#include <cstring>
 #include <kiwi/Types.h>
 #include <kiwi/Mmap.h>
 #include <kiwi/Utils.h>
@@ -83,6 +85,8 @@ namespace kiwi
 
 		const Vector<ValueTy>& raw() const { return data; }
 
+		const Vector<size_t>& rawPtrs() const { return ptrs; }
+
 		void resize(size_t i) { data.resize(ptrs[i]); ptrs.resize(i); }
 
 		auto operator[](size_t idx) const -> Range<decltype(data.begin())>
@@ -219,4 +223,149 @@ namespace kiwi
 			return ret;
 		}
 	};
+
+	/**
+	 * @brief RaggedVector 또는 RaggedVector::write_to_memory로 기록된 메모리를 복사 없이 참조하는 읽기 전용 뷰.
+	 * 여러 조각을 이어붙여 하나의 RaggedVector처럼 다룰 수 있으며, 참조하는 메모리는 뷰보다 오래 유지되어야 한다.
+	 */
+	template<class ValueTy>
+	class RaggedVectorView
+	{
+		struct Segment
+		{
+			const ValueTy* data = nullptr;
+			const size_t* ptrs = nullptr;
+			const char* packedPtrs = nullptr; // 기록된 메모리의 ptrs는 8바이트 정렬이 보장되지 않으므로 memcpy로 읽는다.
+			size_t dataSize = 0;
+			size_t size = 0;
+
+			size_t ptr(size_t i) const
+			{
+				if (ptrs) return ptrs[i];
+				uint64_t p;
+				std::memcpy(&p, packedPtrs + i * sizeof(uint64_t), sizeof(uint64_t));
+				return (size_t)p;
+			}
+		};
+
+		Vector<Segment> segments;
+		Vector<size_t> offsets = { 0 };
+
+	public:
+		class ConstIterator
+		{
+			const RaggedVectorView& rv;
+			size_t i;
+		public:
+			ConstIterator(const RaggedVectorView& _rv, size_t _i = 0)
+				: rv(_rv), i{ _i }
+			{
+			}
+
+			bool operator==(const ConstIterator& o) const
+			{
+				return i == o.i;
+			}
+
+			bool operator!=(const ConstIterator& o) const
+			{
+				return i != o.i;
+			}
+
+			ConstIterator& operator++()
+			{
+				++i;
+				return *this;
+			}
+
+			Range<const ValueTy*> operator*() const
+			{
+				return rv[i];
+			}
+		};
+
+		size_t size() const { return offsets.back(); }
+
+		void clear()
+		{
+			segments.clear();
+			offsets.clear();
+			offsets.emplace_back(0);
+		}
+
+		void append(const RaggedVector<ValueTy>& rv)
+		{
+			if (!rv.size()) return;
+			Segment seg;
+			seg.data = rv.raw().data();
+			seg.ptrs = rv.rawPtrs().data();
+			seg.dataSize = rv.dataSize();
+			seg.size = rv.size();
+			segments.emplace_back(seg);
+			offsets.emplace_back(offsets.back() + seg.size);
+		}
+
+		/**
+		 * @brief RaggedVector::write_to_memory로 기록된 메모리를 뷰의 끝에 이어붙인다.
+		 * @return 읽어들인 RaggedVector가 차지하는 바이트 수. 그 뒤에 이어지는 데이터는 호출자가 해석한다.
+		 */
+		size_t appendMemory(const char* mem, size_t len)
+		{
+			static constexpr size_t headerSize = 4 + sizeof(uint64_t) * 2;
+			if (len < headerSize || memcmp(mem, "KIRV", 4) != 0)
+			{
+				throw std::runtime_error("Invalid RaggedVector memory object");
+			}
+
+			uint64_t dataSize, ptrsSize;
+			std::memcpy(&dataSize, mem + 4, sizeof(uint64_t));
+			std::memcpy(&ptrsSize, mem + 4 + sizeof(uint64_t), sizeof(uint64_t));
+			if ((len - headerSize) / sizeof(ValueTy) < dataSize
+				|| (len - headerSize - dataSize * sizeof(ValueTy)) / sizeof(uint64_t) < ptrsSize)
+			{
+				throw std::runtime_error("Invalid RaggedVector memory object");
+			}
+
+			Segment seg;
+			seg.data = reinterpret_cast<const ValueTy*>(mem + headerSize);
+			seg.packedPtrs = mem + headerSize + dataSize * sizeof(ValueTy);
+			seg.dataSize = dataSize;
+			seg.size = ptrsSize;
+			if (seg.size && seg.ptr(seg.size - 1) > seg.dataSize)
+			{
+				throw std::runtime_error("Invalid RaggedVector memory object");
+			}
+
+			if (seg.size)
+			{
+				segments.emplace_back(seg);
+				offsets.emplace_back(offsets.back() + seg.size);
+			}
+			return headerSize + dataSize * sizeof(ValueTy) + ptrsSize * sizeof(uint64_t);
+		}
+
+		Range<const ValueTy*> operator[](size_t idx) const
+		{
+			size_t s = 0;
+			if (segments.size() > 1)
+			{
+				s = std::upper_bound(offsets.begin(), offsets.end(), idx) - offsets.begin() - 1;
+			}
+			auto& seg = segments[s];
+			idx -= offsets[s];
+			const size_t b = seg.ptr(idx);
+			const size_t e = idx + 1 < seg.size ? seg.ptr(idx + 1) : seg.dataSize;
+			return { seg.data + b, seg.data + e };
+		}
+
+		ConstIterator begin() const
+		{
+			return { *this, 0 };
+		}
+
+		ConstIterator end() const
+		{
+			return { *this, size() };
+		}
+	};
 }
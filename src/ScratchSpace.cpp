@@ -0,0 +1,159 @@
+#include <algorithm>
+#include <functional>
+#include <mutex>
+#include <limits>
+#include <kiwi/ScratchSpace.h>
+
+namespace kiwi
+{
+	namespace utils
+	{
+		namespace
+		{
+			struct ScratchGlobalState
+			{
+				std::mutex mutex;
+				std::vector<ScratchRegistry*> registries;
+				std::atomic<size_t> retainLimit{ std::numeric_limits<size_t>::max() };
+				std::atomic<size_t> trimEpoch{ 0 };
+				std::atomic<size_t> numTrims{ 0 };
+				std::atomic<size_t> peakOfExitedThreads{ 0 };
+			};
+
+			ScratchGlobalState& globalState()
+			{
+				// 스레드 종료 시점의 소멸 순서와 무관하게 접근할 수 있도록 해제하지 않는다.
+				static ScratchGlobalState* state = new ScratchGlobalState;
+				return *state;
+			}
+
+			void updateMax(std::atomic<size_t>& target, size_t value)
+			{
+				size_t prev = target.load(std::memory_order_relaxed);
+				while (prev < value && !target.compare_exchange_weak(prev, value, std::memory_order_relaxed));
+			}
+		}
+
+		ScratchRegistry::ScratchRegistry()
+		{
+			auto& g = globalState();
+			trimEpoch = g.trimEpoch.load(std::memory_order_acquire);
+			std::lock_guard<std::mutex> lock{ g.mutex };
+			g.registries.emplace_back(this);
+		}
+
+		ScratchRegistry::~ScratchRegistry()
+		{
+			auto& g = globalState();
+			updateMax(g.peakOfExitedThreads, peakBytes.load(std::memory_order_relaxed));
+			std::lock_guard<std::mutex> lock{ g.mutex };
+			g.registries.erase(std::find(g.registries.begin(), g.registries.end(), this));
+		}
+
+		ScratchRegistry& ScratchRegistry::local()
+		{
+			thread_local ScratchRegistry registry;
+			return registry;
+		}
+
+		void ScratchRegistry::add(void* obj, size_t(*bytes)(const void*), void(*release)(void*))
+		{
+			entries.emplace_back(Entry{ obj, bytes, release });
+		}
+
+		void ScratchRegistry::remove(void* obj)
+		{
+			auto it = std::find_if(entries.begin(), entries.end(), [&](const Entry& e) { return e.obj == obj; });
+			if (it != entries.end()) entries.erase(it);
+		}
+
+		size_t ScratchRegistry::bytes() const
+		{
+			size_t ret = 0;
+			for (auto& e : entries)
+			{
+				ret += e.bytes(e.obj);
+			}
+			return ret;
+		}
+
+		size_t ScratchRegistry::trim(size_t retainBytes)
+		{
+			std::vector<std::pair<size_t, size_t>> sizes; // (bytes, index)
+			sizes.reserve(entries.size());
+			size_t total = 0;
+			for (size_t i = 0; i < entries.size(); ++i)
+			{
+				const size_t b = entries[i].bytes(entries[i].obj);
+				if (!b) continue;
+				sizes.emplace_back(b, i);
+				total += b;
+			}
+			updateMax(peakBytes, total);
+
+			std::sort(sizes.begin(), sizes.end(), std::greater<std::pair<size_t, size_t>>{});
+			size_t released = 0;
+			for (auto& p : sizes)
+			{
+				if (total - released <= retainBytes) break;
+				entries[p.second].release(entries[p.second].obj);
+				released += p.first;
+			}
+			if (released) globalState().numTrims.fetch_add(1, std::memory_order_relaxed);
+			retainedBytes.store(bytes(), std::memory_order_relaxed);
+			return released;
+		}
+
+		size_t ScratchRegistry::checkpoint()
+		{
+			auto& g = globalState();
+			const size_t epoch = g.trimEpoch.load(std::memory_order_acquire);
+			if (epoch != trimEpoch)
+			{
+				trimEpoch = epoch;
+				return trim(0);
+			}
+
+			const size_t total = bytes();
+			updateMax(peakBytes, total);
+			const size_t limit = g.retainLimit.load(std::memory_order_relaxed);
+			if (total > limit)
+			{
+				return trim(limit);
+			}
+			retainedBytes.store(total, std::memory_order_relaxed);
+			return 0;
+		}
+
+		void setScratchRetainLimit(size_t bytes)
+		{
+			globalState().retainLimit.store(bytes, std::memory_order_relaxed);
+		}
+
+		size_t getScratchRetainLimit()
+		{
+			return globalState().retainLimit.load(std::memory_order_relaxed);
+		}
+
+		void requestScratchTrim()
+		{
+			globalState().trimEpoch.fetch_add(1, std::memory_order_acq_rel);
+		}
+
+		ScratchStats getScratchStats()
+		{
+			auto& g = globalState();
+			ScratchStats ret;
+			ret.peakBytes = g.peakOfExitedThreads.load(std::memory_order_relaxed);
+			ret.numTrims = g.numTrims.load(std::memory_order_relaxed);
+			std::lock_guard<std::mutex> lock{ g.mutex };
+			for (auto* r : g.registries)
+			{
+				ret.retainedBytes += r->retainedBytes.load(std::memory_order_relaxed);
+				ret.peakBytes = std::max(ret.peakBytes, r->peakBytes.load(std::memory_order_relaxed));
+			}
+			ret.numThreads = g.registries.size();
+			return ret;
+		}
+	}
+}
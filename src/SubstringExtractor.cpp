@@ -56,14 +56,20 @@ namespace kiwi
 		size_t minLength,
 		size_t maxLength,
 		bool longestOnly,
-		char16_t stopChr
+		char16_t stopChr,
+		utils::ThreadPool* pool
 	)
 	{
 		Vector<char16_t> buf(last - first + 1);
 		copy(first, last, buf.begin() + 1);
-		sais::FmIndex<char16_t> fi{ buf.data(), buf.size() };
+		sais::FmIndex<char16_t> fi{ buf.data(), buf.size(), pool };
 		Vector<UnorderedMap<u16string, size_t>> candCnts;
 		vector<pair<u16string, size_t>> ret;
+		unique_ptr<mutex> mtx;
+		if (mp::getPoolSize(pool) > 1)
+		{
+			mtx = make_unique<mutex>();
+		}
 		fi.enumSuffices(minCnt, [&](const sais::FmIndex<char16_t>::SuffixTy& s, const sais::FmIndex<char16_t>::TraceTy& t)
 		{
 			auto u32size = s.size();
@@ -99,6 +105,7 @@ namespace kiwi
 				return true;
 			}
 
+			mp::OptionalLockGuard<mutex> lock{ mtx.get() };
 			if (longestOnly)
 			{
 				if (candCnts.size() <= ssLength - minLength) candCnts.resize(ssLength - minLength + 1);
@@ -109,7 +116,7 @@ namespace kiwi
 				ret.emplace_back(u16string{ s.rbegin(), s.rend() }, ssCnt);
 			}
 			return true;
-		});
+		}, pool);
 
 		if (longestOnly)
 		{
@@ -185,9 +192,24 @@ namespace kiwi
 		if (_numWorkers == (size_t)-1) _numWorkers = min(thread::hardware_concurrency(), 8u);
 		if (_numWorkers > 1)
 		{
-			threadPool = make_unique<mp::ThreadPool>(_numWorkers);
+			threadPool = make_shared<utils::ThreadPool>(_numWorkers);
 		}
+		setClusters(clusters);
+	}
+
+	PrefixCounter::PrefixCounter(
+		size_t _prefixSize,
+		size_t _minCf,
+		shared_ptr<utils::ThreadPool> _pool,
+		const std::vector<std::vector<size_t>>& clusters
+		)
+		: prefixSize(_prefixSize), minCf(_minCf), id2Token(2), buf(1), threadPool(move(_pool))
+	{
+		setClusters(clusters);
+	}
 
+	void PrefixCounter::setClusters(const std::vector<std::vector<size_t>>& clusters)
+	{
 		if (clusters.empty()) return;
 
 		unordered_set<size_t> alreadyAllocated;
@@ -278,12 +300,12 @@ namespace kiwi
 
 	utils::FrozenTrie<uint32_t, uint32_t> PrefixCounter::count() const
 	{
-		sais::FmIndex<char16_t> fi{ (const char16_t*)buf.data(), buf.size(), (mp::ThreadPool*)threadPool.get()};
+		sais::FmIndex<char16_t> fi{ (const char16_t*)buf.data(), buf.size(), threadPool.get()};
 		utils::ContinuousTrie<PrefixTrieNode<uint32_t>> trie{ 1 };
 		trie.root().val = buf.size() - 1 - numArrays;
 		
 		unique_ptr<mutex> mtx;
-		if (threadPool)
+		if (mp::getPoolSize(threadPool.get()) > 1)
 		{
 			mtx = make_unique<mutex>();
 		}
@@ -337,7 +359,7 @@ namespace kiwi
 			mp::OptionalLockGuard<mutex> lock{ mtx.get() };
 			trie.build(restoredBuf.begin(), restoredBuf.end(), suffixCnt);
 			return true;
-		}, (mp::ThreadPool*)threadPool.get());
+		}, threadPool.get());
 		return utils::freezeTrie(move(trie), ArchType::balanced);
 	}
 
@@ -466,6 +488,44 @@ namespace kiwi
 		return form;
 	}
 
+	inline int16_t quantizeTokenScore(float score)
+	{
+		return (int16_t)max(min((int)round(score * 1024), 32767), -32768);
+	}
+
+	void NgramExtractor::appendToken(size_t id, int16_t score, uint32_t position)
+	{
+		if (id < 0x4000)
+		{
+			buf.emplace_back(id);
+			if (gatherLmScore) scores.emplace_back(score);
+			positions.emplace_back(position);
+		}
+		else if (id < 0x10000000)
+		{
+			buf.emplace_back((id & 0x3FFF) | 0x4000);
+			buf.emplace_back((id >> 14) | 0x8000);
+			if (gatherLmScore)
+			{
+				scores.emplace_back(score);
+				scores.emplace_back(score);
+			}
+			positions.emplace_back(position);
+			positions.emplace_back(position);
+		}
+	}
+
+	void NgramExtractor::endDocument(uint32_t endPosition)
+	{
+		buf.emplace_back(1);
+		if (gatherLmScore)
+		{
+			scores.emplace_back(0);
+		}
+		positions.emplace_back(endPosition);
+		docBoundaries.emplace_back(buf.size());
+	}
+
 	size_t NgramExtractor::addTokens(const std::vector<TokenInfo>& tokens)
 	{
 		for (auto& t : tokens)
@@ -477,33 +537,9 @@ namespace kiwi
 			{
 				id2morph.push_back(inserted.first->first);
 			}
-			int16_t score = (int16_t)max(min((int)round(t.score * 1024), 32767), -32768);
-			if (id < 0x4000)
-			{
-				buf.emplace_back(id);
-				if (gatherLmScore) scores.emplace_back(score);
-				positions.emplace_back(t.position);
-			}
-			else if (id < 0x10000000)
-			{
-				buf.emplace_back((id & 0x3FFF) | 0x4000);
-				buf.emplace_back((id >> 14) | 0x8000);
-				if (gatherLmScore)
-				{
-					scores.emplace_back(score);
-					scores.emplace_back(score);
-				}
-				positions.emplace_back(t.position);
-				positions.emplace_back(t.position);
-			}
-		}
-		buf.emplace_back(1);
-		if (gatherLmScore)
-		{
-			scores.emplace_back(0);
+			appendToken(id, quantizeTokenScore(t.score), t.position);
 		}
-		positions.emplace_back(tokens.empty() ? 0 : (tokens.back().position + tokens.back().length));
-		docBoundaries.emplace_back(buf.size());
+		endDocument(tokens.empty() ? 0 : (tokens.back().position + tokens.back().length));
 		return tokens.size();
 	}
 
@@ -514,18 +550,158 @@ namespace kiwi
 		return addTokens(res[0].first);
 	}
 
+	namespace
+	{
+		/**
+		 * @brief 한 스레드가 사용하는 지역 형태소 번호 사전. 형태소 사전에 대한 잠금 없이 토큰을 기록할 수 있게 한다.
+		 */
+		struct NgramLocalDict
+		{
+			UnorderedMap<u16string, uint32_t> morph2id;
+			Vector<u16string> id2morph;
+
+			uint32_t getId(const TokenInfo& t)
+			{
+				auto inserted = morph2id.emplace(tokenToStr(t), (uint32_t)id2morph.size());
+				if (inserted.second)
+				{
+					id2morph.push_back(inserted.first->first);
+				}
+				return inserted.first->second;
+			}
+		};
+
+		/**
+		 * @brief 입력 묶음 하나를 분석한 결과. 토큰은 이 묶음을 처리한 스레드의 지역 형태소 번호로 저장된다.
+		 */
+		struct NgramBatchBuffer
+		{
+			size_t tid = 0;
+			Vector<uint32_t> ids;
+			Vector<int16_t> scores;
+			Vector<uint32_t> positions;
+			Vector<size_t> docEnds; // 각 문서의 마지막 토큰 다음 위치(ids 기준)
+			Vector<uint32_t> docEndPositions;
+			Vector<u16string> docs;
+
+			void add(NgramLocalDict& dict, u16string&& text, const std::vector<TokenInfo>& tokens)
+			{
+				for (auto& t : tokens)
+				{
+					ids.emplace_back(dict.getId(t));
+					scores.emplace_back(quantizeTokenScore(t.score));
+					positions.emplace_back(t.position);
+				}
+				docEnds.emplace_back(ids.size());
+				docEndPositions.emplace_back(tokens.empty() ? 0 : (tokens.back().position + tokens.back().length));
+				docs.emplace_back(move(text));
+			}
+		};
+	}
+
 	size_t NgramExtractor::addTexts(const U16Reader& reader)
 	{
+		auto* pool = kiwi->getThreadPool();
+		if (!pool || pool->isWorkerThread())
+		{
+			size_t ret = 0;
+			kiwi->analyze(1, [&]()
+			{
+				auto str = reader();
+				rawDocs.emplace_back(str);
+				return str;
+			}, [&](const std::vector<TokenResult>& res)
+			{
+				ret += addTokens(res[0].first);
+			}, Match::zCoda | Match::splitComplex);
+			rawDocs.pop_back(); // 입력의 끝을 나타내는 빈 문자열
+			return ret;
+		}
+
+		/*
+		형태소 사전에 대한 잠금 없이 병렬로 처리할 수 있도록, 각 스레드는 자신만의 사전으로 지역 형태소 번호를 매겨 묶음별 버퍼에 기록한다.
+		모든 입력을 처리한 뒤에 묶음들을 입력 순서대로 병합하며 지역 번호를 전역 번호로 바꾸므로,
+		문서의 순서와 형태소 번호는 단일 스레드로 처리한 결과와 같다.
+		*/
+		vector<NgramLocalDict> dicts(pool->size());
+		Deque<NgramBatchBuffer> batches; // 작업이 참조하는 원소가 옮겨지지 않도록 deque를 사용한다
+		vector<future<void>> futures;
+		const size_t maxBatchSize = 64, maxBatchChars = 16384;
+		bool eof = false;
+		while (!eof)
+		{
+			vector<u16string> batch;
+			size_t batchChars = 0;
+			while (batch.size() < maxBatchSize && batchChars < maxBatchChars)
+			{
+				auto str = reader();
+				if (str.empty())
+				{
+					eof = true;
+					break;
+				}
+				batchChars += str.size();
+				batch.emplace_back(move(str));
+			}
+			if (batch.empty()) break;
+
+			auto& out = batches.emplace_back();
+			futures.emplace_back(pool->enqueue([&, batch = move(batch)](size_t tid) mutable
+			{
+				out.tid = tid;
+				for (auto& str : batch)
+				{
+					auto res = kiwi->analyze(str, 1, Match::zCoda | Match::splitComplex);
+					out.add(dicts[tid], move(str), res[0].first);
+				}
+			}));
+		}
+
+		// 작업은 dicts와 batches를 참조하므로 예외가 발생하더라도 모든 작업이 끝날 때까지 기다린 뒤에 전파한다.
+		for (auto& f : futures)
+		{
+			f.wait();
+		}
+		for (auto& f : futures)
+		{
+			f.get();
+		}
+
+		static constexpr size_t unmapped = -1;
 		size_t ret = 0;
-		kiwi->analyze(1, [&]()
+		vector<Vector<size_t>> localToGlobal(dicts.size());
+		for (size_t i = 0; i < dicts.size(); ++i)
 		{
-			auto str = reader();
-			rawDocs.emplace_back(str);
-			return str;
-		}, [&](const std::vector<TokenResult>& res)
+			localToGlobal[i].resize(dicts[i].id2morph.size(), unmapped);
+		}
+
+		for (auto& batch : batches)
 		{
-			ret += addTokens(res[0].first);
-		}, Match::zCoda | Match::splitComplex);
+			auto& dict = dicts[batch.tid];
+			auto& mapping = localToGlobal[batch.tid];
+			size_t t = 0;
+			for (size_t d = 0; d < batch.docs.size(); ++d)
+			{
+				for (; t < batch.docEnds[d]; ++t)
+				{
+					auto& global = mapping[batch.ids[t]];
+					if (global == unmapped)
+					{
+						auto inserted = morph2id.emplace(move(dict.id2morph[batch.ids[t]]), id2morph.size());
+						if (inserted.second)
+						{
+							id2morph.push_back(inserted.first->first);
+						}
+						global = inserted.first->second;
+					}
+					appendToken(global, batch.scores[t], batch.positions[t]);
+				}
+				endDocument(batch.docEndPositions[d]);
+				rawDocs.emplace_back(move(batch.docs[d]));
+			}
+			ret += batch.ids.size();
+			batch = {};
+		}
 		return ret;
 	}
 
@@ -552,23 +728,34 @@ namespace kiwi
 
 	std::vector<NgramExtractor::Candidate> NgramExtractor::extract(size_t maxCandidates, size_t minCnt, size_t maxLength, float minScore, size_t numWorkers) const
 	{
-		unique_ptr<mp::ThreadPool> threadPool;
+		// 별도의 스레드 개수가 지정되지 않았다면 새 스레드를 만들지 않고 Kiwi의 스레드풀을 함께 사용한다.
+		unique_ptr<mp::ThreadPool> ownedPool;
+		mp::ThreadPool* threadPool = nullptr;
+		if (!numWorkers)
+		{
+			threadPool = kiwi ? kiwi->getThreadPool() : nullptr;
+		}
+		else if (numWorkers > 1)
+		{
+			ownedPool = make_unique<mp::ThreadPool>(numWorkers);
+			threadPool = ownedPool.get();
+		}
 		unique_ptr<mutex> mtx;
-		if (numWorkers > 1)
+		if (mp::getPoolSize(threadPool) > 1)
 		{
-			threadPool = make_unique<mp::ThreadPool>(numWorkers);
 			mtx = make_unique<mutex>();
 		}
 
 		Vector<int32_t> sa(buf.size());
-		sais::sais<char16_t, int32_t>((const char16_t*)buf.data(), sa.data(), buf.size(), 0, 0, nullptr, 0, nullptr, threadPool.get());
+		sais::sais<char16_t, int32_t>((const char16_t*)buf.data(), sa.data(), buf.size(), 0, 0, nullptr, 0, nullptr, threadPool);
 
 		Vector<uint16_t> revBuf;
 		revBuf.reserve(buf.size());
 		revBuf.emplace_back(0);
 		revBuf.insert(revBuf.end(), buf.rbegin(), buf.rend());
-		sais::FmIndex<char16_t> fi{ (const char16_t*)buf.data(), buf.size(), threadPool.get() };
-		sais::FmIndex<char16_t> revFi{ (const char16_t*)revBuf.data(), revBuf.size(), threadPool.get() };
+		// 정방향 인덱스는 위에서 구한 접미사 배열을 재사용한다.
+		sais::FmIndex<char16_t> fi{ (const char16_t*)buf.data(), sa.data(), buf.size(), threadPool };
+		sais::FmIndex<char16_t> revFi{ (const char16_t*)revBuf.data(), revBuf.size(), threadPool };
 		Vector<Candidate> ngrams;
 		Vector<size_t> unigramCnts(id2morph.size());
 
@@ -620,11 +807,11 @@ namespace kiwi
 			cand.cnt = suffixCnt;
 			ngrams.emplace_back(move(cand));
 			return true;
-		}, threadPool.get());
+		}, threadPool);
 		
 		const double allTokenCnt = (double)accumulate(unigramCnts.begin(), unigramCnts.end(), (size_t)0);
 
-		mp::runParallel(threadPool.get(), [&](const size_t start, const size_t numWorkers, mp::Barrier*)
+		mp::runParallel(threadPool, [&](const size_t start, const size_t numWorkers, mp::Barrier*)
 		{
 			for (size_t i = start; i < ngrams.size(); i += numWorkers)
 			{
@@ -764,7 +951,7 @@ namespace kiwi
 
 		maxCandidates = min(maxCandidates, numCandsGreaterThanMinScore);
 
-		mp::runParallel(threadPool.get(), [&](const size_t start, const size_t numWorkers, mp::Barrier*)
+		mp::runParallel(threadPool, [&](const size_t start, const size_t numWorkers, mp::Barrier*)
 		{
 			const size_t end = min(maxCandidates, ngrams.size());
 			for (size_t i = start; i < end; i += numWorkers)
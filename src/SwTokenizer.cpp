@@ -1,15 +1,19 @@
 ﻿#include <unordered_set>
 #include <set>
+#include <mutex>
+#include <atomic>
 
 #include <nlohmann/json.hpp>
 
 #include <kiwi/SwTokenizer.h>
 #include <kiwi/Kiwi.h>
+#include <kiwi/Mmap.h>
 
 #include "FrozenTrie.hpp"
 #include "StrUtils.h"
 #include "UnicodeCase.h"
 #include "RaggedVector.hpp"
+#include "serializer.hpp"
 
 #include "sais/fm_index.hpp"
 
@@ -275,6 +279,46 @@ namespace kiwi
 
 	static constexpr size_t numHangulOpenSyllable = 19 * 21;
 
+	inline bool isWordToken(SwTokenFlag flags)
+	{
+		return flags == SwTokenFlag::none || flags == SwTokenFlag::punct || flags == SwTokenFlag::chinese;
+	}
+
+	/**
+	* @brief 어휘 목록으로부터 토큰 분할에 사용하는 trie를 생성한다.
+	* 
+	* 단어 토큰은 앞에 공백을 붙인 형태로 먼저 넣고, 이후 공백 없는 형태로도 찾을 수 있도록 한번 더 넣는다.
+	* 공백 없는 형태가 이미 다른 토큰으로 등록되어 있다면 tokenFallbacks에 그 토큰 대신 사용할 단어 토큰을 기록한다.
+	*/
+	inline utils::ContinuousTrie<utils::TrieNode<kchar_t, uint32_t>> buildVocabTrie(const Vector<SwToken>& vocabs, Vector<uint32_t>* tokenFallbacks = nullptr)
+	{
+		utils::ContinuousTrie<utils::TrieNode<kchar_t, uint32_t>> trie{ 1 };
+		u16string form;
+		for (size_t i = 0; i < vocabs.size(); ++i)
+		{
+			auto& v = vocabs[i];
+			if (v.pos != POSTag::unknown || v.flags == SwTokenFlag::byte || v.flags == SwTokenFlag::glue) continue;
+			form.assign(v.form, v.form + v.length);
+			if (isWordToken(v.flags)) form.insert(form.begin(), u' ');
+			if (trie.build(form.begin(), form.end(), i + 1)->val != i + 1)
+			{
+				throw SwTokenizerException{ "duplicated token: " + utf16To8(U16StringView{ v.form, v.length }) };
+			}
+		}
+
+		for (size_t i = 0; i < vocabs.size(); ++i)
+		{
+			auto& v = vocabs[i];
+			if (v.pos != POSTag::unknown || !isWordToken(v.flags)) continue;
+			auto node = trie.build(v.form, v.form + v.length, i + 1);
+			if (tokenFallbacks && node->val != i + 1)
+			{
+				(*tokenFallbacks)[node->val - 1] = i;
+			}
+		}
+		return trie;
+	}
+
 	template<ArchType arch, bool generateOffset>
 	bool tokenizeSubword(
 		const SwTokenizerConfig& config,
@@ -713,7 +757,6 @@ SwTokenizer SwTokenizerBuilder::build() const
 	ret.config = config;
 	vector<const Morpheme*> matchedMorphs;
 
-	utils::ContinuousTrie<utils::TrieNode<kchar_t, uint32_t>> trie{ 1 };
 	size_t offset = 0;
 	ret.swToMorph.resize(tokens.size(), -1);
 	if (config.fallbackHangul)
@@ -785,15 +828,6 @@ SwTokenizer SwTokenizerBuilder::build() const
 				ret.specialTokenIds[SwTokenizerConfig::glue] = tokenId;
 				continue;
 			}
-			else if (t.flags == SwTokenFlag::none)
-			{
-				u16form.insert(u16form.begin(), u' ');
-			}
-
-			if (trie.build(u16form.begin(), u16form.end(), tokenId + 1)->val != tokenId + 1)
-			{
-				throw SwTokenizerException{ "duplicated token: " + t.form };
-			}
 		}
 		else
 		{
@@ -829,6 +863,7 @@ SwTokenizer SwTokenizerBuilder::build() const
 	}
 	
 	ret.tokenFallbacks.resize(tokens.size(), -1);
+	auto trie = buildVocabTrie(vocab.vocabs, &ret.tokenFallbacks);
 
 	for (size_t i = 0; i <= SwTokenizerConfig::eos; ++i)
 	{
@@ -844,23 +879,14 @@ SwTokenizer SwTokenizerBuilder::build() const
 			}
 			auto u16str = utf8To16(config.specialTokens[i]);
 			auto node = trie.find(u16str.begin(), u16str.end());
-			if (!node) throw SwTokenizerException{ "Token " + config.specialTokens[i] + " is not found in the vocabulary."};
+			// 공백 없이 다시 넣은 단어 토큰은 특수 토큰으로 취급하지 않는다.
+			if (!node || !node->val || isWordToken(vocab.vocabs[node->val - 1].flags))
+			{
+				throw SwTokenizerException{ "Token " + config.specialTokens[i] + " is not found in the vocabulary."};
+			}
 			ret.specialTokenIds[i] = node->val - 1;
 		}
 	}
-	
-	for (auto& t : tokens)
-	{
-		size_t tokenId = &t - tokens.data();
-		if (t.pos != POSTag::unknown) continue;
-		if (t.flags != SwTokenFlag::none) continue;
-		auto& v = vocab.vocabs[tokenId];
-		auto node = trie.build(v.form, v.form + v.length, tokenId + 1);
-		if (node->val != tokenId + 1)
-		{
-			ret.tokenFallbacks[node->val - 1] = tokenId;
-		}
-	}
 
 	ret.trie = utils::freezeTrie(move(trie), bestArch);
 
@@ -961,6 +987,166 @@ SwTokenizer::SwTokenizer(ArchType archType)
 	}
 }
 
+class SwTokenizer::SubwordCache
+{
+	struct Entry
+	{
+		Vector<uint32_t> ids;
+		Vector<pair<uint32_t, uint32_t>> offsets;
+		bool success = false;
+	};
+
+	// 최근에 사용된 항목은 current에, 그 이전 세대의 항목은 previous에 둔다.
+	// current가 가득 차면 previous를 버리고 current를 previous로 넘기므로, 자주 쓰이는 항목은 계속 살아남는다.
+	struct Shard
+	{
+		mutable mutex mtx;
+		UnorderedMap<u16string, Entry> current, previous;
+	};
+
+	static constexpr size_t numShards = 16;
+	std::array<Shard, numShards> shards;
+	size_t capacity = 0;
+	size_t numActiveShards = 1;
+	size_t generationSize = 0; // 0이면 샤드마다 항목을 하나만 유지한다
+	atomic<size_t> hits{ 0 }, misses{ 0 };
+
+	Shard& getShard(const u16string& key)
+	{
+		return shards[hash<u16string>{}(key) % numActiveShards];
+	}
+
+	void makeRoom(Shard& shard)
+	{
+		if (!generationSize)
+		{
+			shard.current.clear();
+			return;
+		}
+		if (shard.current.size() < generationSize) return;
+		shard.previous = move(shard.current);
+		shard.current.clear();
+	}
+
+public:
+	static constexpr size_t defaultCapacity = 1 << 16;
+
+	SubwordCache(size_t _capacity = defaultCapacity)
+		: capacity{ _capacity }
+	{
+		// 샤드마다 두 세대를 유지하므로, 용량이 작을 때는 사용하는 샤드 수를 줄여 전체 항목 수가 용량을 넘지 않게 한다.
+		numActiveShards = min(max(capacity / 2, (size_t)1), numShards);
+		generationSize = capacity / numActiveShards / 2;
+	}
+
+	size_t getCapacity() const { return capacity; }
+
+	/**
+	* @brief 다음 삽입 시 기존 항목이 버려질 수 있는 샤드가 있는지 확인한다.
+	*/
+	bool isSaturated() const
+	{
+		for (auto& shard : shards)
+		{
+			lock_guard<mutex> lock{ shard.mtx };
+			if (!generationSize && !shard.current.empty()) return true;
+			if (!shard.previous.empty() && shard.current.size() >= generationSize) return true;
+		}
+		return false;
+	}
+
+	SwSubwordCacheStats getStats() const
+	{
+		SwSubwordCacheStats ret;
+		ret.capacity = capacity;
+		for (auto& shard : shards)
+		{
+			lock_guard<mutex> lock{ shard.mtx };
+			ret.size += shard.current.size() + shard.previous.size();
+		}
+		ret.hits = hits.load(memory_order_relaxed);
+		ret.misses = misses.load(memory_order_relaxed);
+		return ret;
+	}
+
+	bool find(const u16string& key, vector<uint32_t>& out, vector<pair<uint32_t, uint32_t>>* offset, uint32_t offsetBias, bool& success)
+	{
+		auto& shard = getShard(key);
+		lock_guard<mutex> lock{ shard.mtx };
+		auto it = shard.current.find(key);
+		if (it == shard.current.end())
+		{
+			auto pit = shard.previous.find(key);
+			if (pit == shard.previous.end())
+			{
+				misses.fetch_add(1, memory_order_relaxed);
+				return false;
+			}
+			Entry entry = move(pit->second);
+			shard.previous.erase(pit);
+			makeRoom(shard);
+			it = shard.current.emplace(key, move(entry)).first;
+		}
+		hits.fetch_add(1, memory_order_relaxed);
+
+		auto& entry = it->second;
+		out.insert(out.end(), entry.ids.begin(), entry.ids.end());
+		if (offset)
+		{
+			for (auto& p : entry.offsets)
+			{
+				offset->emplace_back(p.first + offsetBias, p.second + offsetBias);
+			}
+		}
+		success = entry.success;
+		return true;
+	}
+
+	bool insert(const u16string& key, const vector<uint32_t>& ids, const vector<pair<uint32_t, uint32_t>>& offsets, bool success)
+	{
+		auto& shard = getShard(key);
+		lock_guard<mutex> lock{ shard.mtx };
+		if (shard.current.count(key) || shard.previous.count(key)) return false;
+		makeRoom(shard);
+		auto& entry = shard.current[key];
+		entry.ids.assign(ids.begin(), ids.end());
+		entry.offsets.assign(offsets.begin(), offsets.end());
+		entry.success = success;
+		return true;
+	}
+
+	void clear()
+	{
+		for (auto& shard : shards)
+		{
+			lock_guard<mutex> lock{ shard.mtx };
+			shard.current = {};
+			shard.previous = {};
+		}
+	}
+};
+
+SwTokenizer::SubwordCacheHolder::SubwordCacheHolder()
+	: cache{ make_unique<SubwordCache>() }
+{
+}
+
+SwTokenizer::SubwordCacheHolder::SubwordCacheHolder(const SubwordCacheHolder& o)
+	: cache{ make_unique<SubwordCache>(o.cache ? o.cache->getCapacity() : SubwordCache::defaultCapacity) }
+{
+}
+
+SwTokenizer::SubwordCacheHolder::SubwordCacheHolder(SubwordCacheHolder&&) noexcept = default;
+SwTokenizer::SubwordCacheHolder::~SubwordCacheHolder() = default;
+
+SwTokenizer::SubwordCacheHolder& SwTokenizer::SubwordCacheHolder::operator=(const SubwordCacheHolder& o)
+{
+	cache = make_unique<SubwordCache>(o.cache ? o.cache->getCapacity() : SubwordCache::defaultCapacity);
+	return *this;
+}
+
+SwTokenizer::SubwordCacheHolder& SwTokenizer::SubwordCacheHolder::operator=(SubwordCacheHolder&&) noexcept = default;
+
 SwTokenizer::SwTokenizer(const SwTokenizer& o) = default;
 SwTokenizer::SwTokenizer(SwTokenizer&&) = default;
 SwTokenizer::~SwTokenizer() = default;
@@ -1032,7 +1218,7 @@ vector<uint32_t> SwTokenizer::encode(const vector<tuple<u16string, POSTag, bool>
 	return ret;
 }
 
-bool SwTokenizer::tokenizeSubword(U16StringView str,
+bool SwTokenizer::tokenizeSubwordUncached(U16StringView str,
 	bool spacePrefix,
 	vector<uint32_t>& out,
 	vector<pair<uint32_t, uint32_t>>* offset,
@@ -1051,6 +1237,89 @@ bool SwTokenizer::tokenizeSubword(U16StringView str,
 	);
 }
 
+bool SwTokenizer::tokenizeSubword(U16StringView str,
+	bool spacePrefix,
+	vector<uint32_t>& out,
+	vector<pair<uint32_t, uint32_t>>* offset,
+	uint32_t offsetBias
+) const
+{
+	auto* cache = subwordCache.cache.get();
+	if (!cache || !cache->getCapacity()) return tokenizeSubwordUncached(str, spacePrefix, out, offset, offsetBias);
+
+	thread_local utils::Scratch<u16string> key;
+	key.assign(1, spacePrefix ? u'\1' : u'\0');
+	key.append(str.data(), str.size());
+	bool success;
+	if (cache->find(key, out, offset, offsetBias, success)) return success;
+
+	// offset 요청 여부와 관계없이 캐시에 저장할 수 있도록 항상 offset을 함께 계산한다.
+	thread_local utils::Scratch<vector<uint32_t>> ids;
+	thread_local utils::Scratch<vector<pair<uint32_t, uint32_t>>> offsets;
+	ids.clear();
+	offsets.clear();
+	success = tokenizeSubwordUncached(str, spacePrefix, ids, &offsets, 0);
+	out.insert(out.end(), ids.begin(), ids.end());
+	if (offset)
+	{
+		for (auto& p : offsets)
+		{
+			offset->emplace_back(p.first + offsetBias, p.second + offsetBias);
+		}
+	}
+	cache->insert(key, ids, offsets, success);
+	return success;
+}
+
+void SwTokenizer::setWholeWordUnk(bool v)
+{
+	if (config.wholeWordUnk == v) return;
+	config.wholeWordUnk = v;
+	clearSubwordCache();
+}
+
+void SwTokenizer::setSubwordCacheSize(size_t capacity)
+{
+	subwordCache.cache = make_unique<SubwordCache>(capacity);
+}
+
+size_t SwTokenizer::getSubwordCacheSize() const
+{
+	return subwordCache.cache ? subwordCache.cache->getCapacity() : 0;
+}
+
+SwSubwordCacheStats SwTokenizer::getSubwordCacheStats() const
+{
+	return subwordCache.cache ? subwordCache.cache->getStats() : SwSubwordCacheStats{};
+}
+
+void SwTokenizer::clearSubwordCache()
+{
+	if (subwordCache.cache) subwordCache.cache->clear();
+}
+
+size_t SwTokenizer::warmUpSubwordCache(const vector<pair<string, size_t>>& wordFreqs)
+{
+	auto* cache = subwordCache.cache.get();
+	if (!cache || !cache->getCapacity()) return 0;
+
+	Vector<size_t> order(wordFreqs.size());
+	iota(order.begin(), order.end(), 0);
+	sort(order.begin(), order.end(), [&](size_t a, size_t b) { return wordFreqs[a].second > wordFreqs[b].second; });
+
+	// 빈도가 높은 단어의 결과가 밀려나지 않도록, 기존 항목이 버려지기 직전에 멈춘다.
+	const size_t initSize = cache->getStats().size;
+	vector<uint32_t> ids;
+	for (auto i : order)
+	{
+		if (cache->isSaturated()) break;
+		ids.clear();
+		encode(ids, wordFreqs[i].first);
+	}
+	const size_t size = cache->getStats().size;
+	return size - min(size, initSize);
+}
+
 template<class TokenIt>
 void SwTokenizer::encode(vector<uint32_t>& ret, TokenIt first, TokenIt last, vector<pair<uint32_t, uint32_t>>* offset) const
 {
@@ -1416,6 +1685,37 @@ void SwTokenizer::encode(vector<uint32_t>& out, const vector<tuple<u16string, PO
 	}
 }
 
+void SwTokenizer::flushBytesToJoiner(cmb::AutoJoiner& joiner, string& pendingBytes, bool ignoreErrors) const
+{
+	if (pendingBytes.empty()) return;
+	joiner.add(ignoreErrors ? utf8To16IgnoringErrors(pendingBytes) : utf8To16(pendingBytes), POSTag::unknown);
+	pendingBytes.clear();
+}
+
+void SwTokenizer::addToJoiner(cmb::AutoJoiner& joiner, string& pendingBytes, uint32_t id, bool ignoreErrors) const
+{
+	auto& v = vocab.vocabs[id];
+	// byte
+	if (v.flags == SwTokenFlag::byte)
+	{
+		pendingBytes.push_back(v.byte);
+		return;
+	}
+	flushBytesToJoiner(joiner, pendingBytes, ignoreErrors);
+
+	// to do: detect the best tag from ambiguous tags in simpleTag mode
+	// morpheme
+	if (id < swToMorph.size() && swToMorph[id] != -1)
+	{
+		joiner.add(swToMorph[id]);
+		return;
+	}
+
+	// subword
+	bool insertSpace = v.flags == SwTokenFlag::none || v.flags == SwTokenFlag::special;
+	joiner.add(U16StringView{ v.form, v.length }, POSTag::unknown, insertSpace ? cmb::Space::insert_space : cmb::Space::none);
+}
+
 template<class It>
 string SwTokenizer::decode(It first, It last, bool ignoreErrors) const
 {
@@ -1423,43 +1723,10 @@ string SwTokenizer::decode(It first, It last, bool ignoreErrors) const
 	string u8bytes;
 	for (; first != last; ++first)
 	{
-		auto id = *first;
-		auto& v = vocab.vocabs[id];
-		// byte
-		if (v.flags == SwTokenFlag::byte)
-		{
-			u8bytes.push_back(v.byte);
-			continue;
-		}
-		else
-		{
-			if (!u8bytes.empty())
-			{
-				joiner.add(ignoreErrors? utf8To16IgnoringErrors(u8bytes) : utf8To16(u8bytes), POSTag::unknown);
-				u8bytes.clear();
-			}
-		}
-
-		// to do: detect the best tag from ambiguous tags in simpleTag mode
-		// morpheme
-		if (id < swToMorph.size() && swToMorph[id] != -1)
-		{
-			joiner.add(swToMorph[id]);
-			continue;
-		}
-		
-		// subword
-		bool insertSpace = v.flags == SwTokenFlag::none || v.flags == SwTokenFlag::special;
-		joiner.add(U16StringView{ v.form, v.length }, POSTag::unknown, insertSpace ? cmb::Space::insert_space : cmb::Space::none);
-	}
-
-	if (!u8bytes.empty())
-	{
-		joiner.add(ignoreErrors ? utf8To16IgnoringErrors(u8bytes) : utf8To16(u8bytes), POSTag::unknown);
-		u8bytes.clear();
+		addToJoiner(joiner, u8bytes, *first, ignoreErrors);
 	}
+	flushBytesToJoiner(joiner, u8bytes, ignoreErrors);
 	return joiner.getU8();
-	
 }
 
 string SwTokenizer::decode(const vector<uint32_t>& ids, bool ignoreErrors) const
@@ -1472,6 +1739,45 @@ string SwTokenizer::decode(const uint32_t* ids, size_t length, bool ignoreErrors
 	return decode(ids, ids + length, ignoreErrors);
 }
 
+SwTokenizer::Decoder SwTokenizer::newDecoder(bool ignoreErrors) const
+{
+	return Decoder{ *this, kiwi->newJoiner(false), ignoreErrors };
+}
+
+SwTokenizer::Decoder::Decoder(const SwTokenizer& _tokenizer, cmb::AutoJoiner&& _joiner, bool _ignoreErrors)
+	: tokenizer{ &_tokenizer }, joiner{ move(_joiner) }, ignoreErrors{ _ignoreErrors }
+{
+}
+
+SwTokenizer::Decoder::Decoder(const Decoder&) = default;
+SwTokenizer::Decoder::Decoder(Decoder&&) = default;
+SwTokenizer::Decoder::~Decoder() = default;
+SwTokenizer::Decoder& SwTokenizer::Decoder::operator=(const Decoder&) = default;
+SwTokenizer::Decoder& SwTokenizer::Decoder::operator=(Decoder&&) = default;
+
+string SwTokenizer::Decoder::add(uint32_t id)
+{
+	tokenizer->addToJoiner(joiner, pendingBytes, id, ignoreErrors);
+	return joiner.flushU8();
+}
+
+string SwTokenizer::Decoder::add(const uint32_t* ids, size_t length)
+{
+	for (size_t i = 0; i < length; ++i)
+	{
+		tokenizer->addToJoiner(joiner, pendingBytes, ids[i], ignoreErrors);
+	}
+	return joiner.flushU8();
+}
+
+string SwTokenizer::Decoder::finish()
+{
+	tokenizer->flushBytesToJoiner(joiner, pendingBytes, ignoreErrors);
+	auto ret = joiner.flushU8(true);
+	joiner = tokenizer->kiwi->newJoiner(false);
+	return ret;
+}
+
 future<vector<uint32_t>> SwTokenizer::asyncEncode(const string& str) const
 {
 	auto* pool = kiwi->getThreadPool();
@@ -1494,6 +1800,77 @@ future<pair<vector<uint32_t>, vector<pair<uint32_t, uint32_t>>>> SwTokenizer::as
 	}, str);
 }
 
+template<class IntTy>
+size_t SwTokenizer::encodeBatchImpl(const string* strs, size_t size, const SwBatchEncodeOption& option,
+	IntTy* tokenIds, IntTy* attentionMask, IntTy* offsets, IntTy* lengths) const
+{
+	if (!option.maxLength) throw SwTokenizerException{ "`maxLength` of `encodeBatch` should be greater than 0." };
+	const size_t maxLength = option.maxLength;
+	const IntTy padId = (IntTy)(option.padId >= 0 ? option.padId 
+		: (specialTokenIds[SwTokenizerConfig::pad] != (size_t)-1 ? specialTokenIds[SwTokenizerConfig::pad] : 0));
+
+	auto* pool = kiwi->getThreadPool();
+	const size_t numShards = pool ? pool->size() * 4 : 1;
+	Vector<size_t> longestPerShard(numShards);
+	utils::forEachShard(pool, size, numShards, [&](size_t shard, size_t first, size_t last)
+	{
+		// 버퍼는 같은 구간 내의 문자열끼리 재사용하며, 결과는 호출자의 버퍼에 바로 기록한다.
+		vector<uint32_t> ids;
+		vector<pair<uint32_t, uint32_t>> offset;
+		size_t longest = 0;
+		for (size_t i = first; i < last; ++i)
+		{
+			ids.clear();
+			offset.clear();
+			encode(ids, strs[i], offsets ? &offset : nullptr, option.offsetInChrLevel);
+			longest = max(longest, ids.size());
+			if (ids.size() > maxLength && !option.truncation)
+			{
+				throw SwTokenizerException{ "The length of tokens of strs[" + to_string(i) + "] (" + to_string(ids.size()) 
+					+ ") exceeds `maxLength` (" + to_string(maxLength) + ")." };
+			}
+
+			const size_t len = min(ids.size(), maxLength);
+			const size_t padSize = maxLength - len;
+			const size_t start = option.padLeft ? padSize : 0;
+			IntTy* rowIds = tokenIds + i * maxLength;
+			fill(rowIds, rowIds + maxLength, padId);
+			copy(ids.begin(), ids.begin() + len, rowIds + start);
+			if (attentionMask)
+			{
+				IntTy* rowMask = attentionMask + i * maxLength;
+				fill(rowMask, rowMask + maxLength, 0);
+				fill(rowMask + start, rowMask + start + len, 1);
+			}
+			if (offsets)
+			{
+				IntTy* rowOffsets = offsets + i * maxLength * 2;
+				fill(rowOffsets, rowOffsets + maxLength * 2, 0);
+				for (size_t j = 0; j < len; ++j)
+				{
+					rowOffsets[(start + j) * 2] = offset[j].first;
+					rowOffsets[(start + j) * 2 + 1] = offset[j].second;
+				}
+			}
+			if (lengths) lengths[i] = (IntTy)len;
+		}
+		longestPerShard[shard] = longest;
+	});
+	return size ? *max_element(longestPerShard.begin(), longestPerShard.end()) : 0;
+}
+
+size_t SwTokenizer::encodeBatch(const string* strs, size_t size, const SwBatchEncodeOption& option,
+	int32_t* tokenIds, int32_t* attentionMask, int32_t* offsets, int32_t* lengths) const
+{
+	return encodeBatchImpl(strs, size, option, tokenIds, attentionMask, offsets, lengths);
+}
+
+size_t SwTokenizer::encodeBatch(const string* strs, size_t size, const SwBatchEncodeOption& option,
+	int64_t* tokenIds, int64_t* attentionMask, int64_t* offsets, int64_t* lengths) const
+{
+	return encodeBatchImpl(strs, size, option, tokenIds, attentionMask, offsets, lengths);
+}
+
 namespace kiwi
 {
 	template<class Ty, class Key>
@@ -1526,6 +1903,40 @@ namespace kiwi
 		}
 	}
 
+	/**
+	 * @brief 형태소 목록의 해시값을 계산한다.
+	 * 바이너리로 저장된 토크나이저는 형태소 id를 그대로 담고 있으므로, 이 값이 같은 Kiwi에서만 읽어들일 수 있다.
+	 */
+	inline uint64_t hashMorphemeTable(const Kiwi& kiwi)
+	{
+		// FNV-1a
+		uint64_t h = 0xCBF29CE484222325ull;
+		const auto update = [&](const void* data, size_t size)
+		{
+			for (size_t i = 0; i < size; ++i)
+			{
+				h = (h ^ ((const uint8_t*)data)[i]) * 0x100000001B3ull;
+			}
+		};
+
+		const uint64_t numMorphs = kiwi.getMorphemeSize();
+		update(&numMorphs, sizeof(numMorphs));
+		for (size_t i = 0; i < numMorphs; ++i)
+		{
+			auto morph = kiwi.idToMorph(i);
+			const uint32_t meta[3] = {
+				(uint32_t)morph->tag,
+				morph->complex ? 1u : 0u,
+				morph->lmMorphemeId,
+			};
+			update(meta, sizeof(meta));
+			const uint32_t length = morph->kform ? (uint32_t)morph->kform->size() : (uint32_t)-1;
+			update(&length, sizeof(length));
+			if (morph->kform) update(morph->kform->data(), morph->kform->size() * sizeof(kchar_t));
+		}
+		return h;
+	}
+
 	static constexpr const char* spTokenNames[] = {
 		"unk_token", "cls_token", "sep_token", "pad_token", "mask_token", "bos_token", "eos_token",
 	};
@@ -1658,6 +2069,163 @@ SwTokenizer SwTokenizer::load(const Kiwi& kiwi, istream& istr)
 	return builder.build();
 }
 
+namespace kiwi
+{
+	static constexpr uint32_t swTokenizerBinaryVersion = 1;
+}
+
+ostream& SwTokenizer::saveBinary(ostream& ostr) const
+{
+	const uint64_t modelHash = hashMorphemeTable(*kiwi);
+	const uint8_t archType = (uint8_t)getSelectedArch(ArchType::default_);
+	serializer::writeMany(ostr, serializer::toKey("KSWT"), swTokenizerBinaryVersion, modelHash, archType);
+	serializer::writeMany(ostr, 
+		config.specialTokens, config.doLowercase, config.splitChinese, config.wholeWordUnk,
+		config.splitPunct, config.simpleTag, config.splitVerb, config.splitEomi, config.useGlueToken,
+		config.newlineToken, config.fallbackHangul, config.fallbackByte, config.additionalJson
+	);
+
+	Vector<uint32_t> lengths;
+	Vector<POSTag> tags;
+	Vector<SwTokenFlag> flags;
+	Vector<uint8_t> bytes;
+	for (auto& v : vocab.vocabs)
+	{
+		lengths.emplace_back(v.length);
+		tags.emplace_back(v.pos);
+		flags.emplace_back(v.flags);
+		bytes.emplace_back(v.byte);
+	}
+	serializer::writeMany(ostr, vocab.vocabStrPool, lengths, tags, flags, bytes, tokenLProbs);
+
+	std::array<uint64_t, SwTokenizerConfig::glue + 1> spIds;
+	copy(specialTokenIds.begin(), specialTokenIds.end(), spIds.begin());
+	serializer::writeMany(ostr, tokenFallbacks, morphToSw, swToMorph, hangulFallbackChrs, byteFallbackChrs, spIds);
+
+	// 저장할 때마다 같은 결과가 나오도록 형태소 id 순으로 정렬하여 기록한다.
+	Vector<uint32_t> splitKeys;
+	for (auto& p : splitCands) splitKeys.emplace_back(p.first);
+	sort(splitKeys.begin(), splitKeys.end());
+	serializer::writeMany(ostr, splitKeys);
+	for (auto k : splitKeys)
+	{
+		auto& w = splitCands.find(k)->second;
+		serializer::writeMany(ostr, w.tokenIds, w.boundaries);
+	}
+
+	serializer::writeMany(ostr, trie);
+	return ostr;
+}
+
+bool SwTokenizer::isBinaryFormat(istream& istr)
+{
+	// json은 'K'로 시작할 수 없으므로 첫 바이트만 보고도 두 형식을 구분할 수 있다.
+	if (istr.peek() != 'K')
+	{
+		istr.clear();
+		return false;
+	}
+
+	// 되감을 수 없는 스트림에서는 첫 바이트로만 판단하고, 나머지 매직 바이트는 loadBinary에서 확인한다.
+	const auto pos = istr.tellg();
+	if (pos == decltype(pos)(-1))
+	{
+		istr.clear();
+		return true;
+	}
+
+	char magic[4] = { 0, };
+	istr.read(magic, 4);
+	const bool ret = istr.gcount() == 4 && memcmp(magic, "KSWT", 4) == 0;
+	istr.clear();
+	istr.seekg(pos);
+	return ret;
+}
+
+SwTokenizer SwTokenizer::loadBinary(const Kiwi& kiwi, const string& path)
+{
+	utils::MMap mm{ path };
+	utils::imstream istr{ mm };
+	return loadBinary(kiwi, istr);
+}
+
+SwTokenizer SwTokenizer::loadBinary(const Kiwi& kiwi, istream& istr)
+{
+	uint32_t version;
+	uint64_t modelHash;
+	uint8_t archType;
+	try
+	{
+		serializer::readMany(istr, serializer::toKey("KSWT"), version, modelHash, archType);
+	}
+	catch (const SerializationException&)
+	{
+		throw SwTokenizerException{ "Not a binary tokenizer file." };
+	}
+	if (version != swTokenizerBinaryVersion) throw SwTokenizerException{ "Unsupported binary tokenizer version: " + to_string(version) };
+	if (modelHash != hashMorphemeTable(kiwi))
+	{
+		throw SwTokenizerException{ "The binary tokenizer was built with a different Kiwi model. Rebuild it from the json file." };
+	}
+
+	auto bestArch = getSelectedArch(ArchType::default_);
+	SwTokenizer ret{ bestArch };
+	ret.kiwi = &kiwi;
+	auto& config = ret.config;
+	serializer::readMany(istr,
+		config.specialTokens, config.doLowercase, config.splitChinese, config.wholeWordUnk,
+		config.splitPunct, config.simpleTag, config.splitVerb, config.splitEomi, config.useGlueToken,
+		config.newlineToken, config.fallbackHangul, config.fallbackByte, config.additionalJson
+	);
+
+	Vector<uint32_t> lengths;
+	Vector<POSTag> tags;
+	Vector<SwTokenFlag> flags;
+	Vector<uint8_t> bytes;
+	serializer::readMany(istr, ret.vocab.vocabStrPool, lengths, tags, flags, bytes, ret.tokenLProbs);
+	const size_t numTokens = lengths.size();
+	if (tags.size() != numTokens || flags.size() != numTokens || bytes.size() != numTokens || ret.tokenLProbs.size() != numTokens)
+	{
+		throw SwTokenizerException{ "Corrupted binary tokenizer: vocab size mismatch" };
+	}
+
+	size_t offset = 0;
+	for (size_t i = 0; i < numTokens; ++i)
+	{
+		if (offset + lengths[i] >= ret.vocab.vocabStrPool.size()) throw SwTokenizerException{ "Corrupted binary tokenizer: vocab string out of range" };
+		ret.vocab.vocabs.emplace_back(ret.vocab.vocabStrPool.data() + offset, lengths[i], tags[i], flags[i], bytes[i]);
+		offset += lengths[i] + 1;
+	}
+
+	std::array<uint64_t, SwTokenizerConfig::glue + 1> spIds;
+	serializer::readMany(istr, ret.tokenFallbacks, ret.morphToSw, ret.swToMorph, ret.hangulFallbackChrs, ret.byteFallbackChrs, spIds);
+	copy(spIds.begin(), spIds.end(), ret.specialTokenIds.begin());
+	if (ret.tokenFallbacks.size() != numTokens || ret.swToMorph.size() != numTokens)
+	{
+		throw SwTokenizerException{ "Corrupted binary tokenizer: token table size mismatch" };
+	}
+
+	Vector<uint32_t> splitKeys;
+	serializer::readMany(istr, splitKeys);
+	for (auto k : splitKeys)
+	{
+		SplittedWord w;
+		serializer::readMany(istr, w.tokenIds, w.boundaries);
+		ret.splitCands.emplace(k, move(w));
+	}
+
+	if (archType == (uint8_t)bestArch)
+	{
+		serializer::readMany(istr, ret.trie);
+	}
+	else
+	{
+		// 저장된 trie는 다른 ArchType에 맞춰 배치되어 있으므로 어휘 목록으로부터 다시 생성한다.
+		ret.trie = utils::freezeTrie(buildVocabTrie(ret.vocab.vocabs), bestArch);
+	}
+	return ret;
+}
+
 enum class UnigramSwTrainer::PrefixAvailability : uint8_t
 {
 	deleted = 0,
@@ -1677,8 +2245,6 @@ UnigramSwTrainer& UnigramSwTrainer::operator=(UnigramSwTrainer&&) = default;
 
 void UnigramSwTrainer::addWord(const u16string& str, const Vector<const Morpheme*>& morphs, const Vector<size_t>& boundaries, bool spacePrefix)
 {
-	auto& rsents = sents.get();
-	
 	const auto emplace = [&](size_t s, size_t e, bool spacePrefix, const Morpheme* morph = nullptr, const Vector<size_t>* bounds = nullptr)
 	{
 		u16string sstr;
@@ -1688,7 +2254,6 @@ void UnigramSwTrainer::addWord(const u16string& str, const Vector<const Morpheme
 		auto wid = wordMap.emplace(sstr, wordMap.size()).first->second;
 		wordCnts.resize(max(wordCnts.size(), wid + 1));
 		wordCnts[wid]++;
-		rsents.add_data(-(int32_t)wid - 1);
 		if (morph && !wordSuffix.count(wid))
 		{
 			WordCand wc{ nullptr };
@@ -1766,6 +2331,89 @@ void UnigramSwTrainer::addWord(const u16string& str, const Vector<const Morpheme
 	}
 }
 
+void UnigramSwTrainer::addMorph(size_t morphId)
+{
+	morphCnts.resize(max(morphCnts.size(), morphId + 1));
+	morphCnts[morphId]++;
+}
+
+size_t UnigramSwTrainer::pruneWords()
+{
+	// 상한을 넘을 때마다 상한의 절반까지 줄이므로, 정리 비용은 새로 추가된 단어 수에 비례하게 분산된다.
+	if (!trainConfig.maxWordMapSize || wordMap.size() <= trainConfig.maxWordMapSize) return 0;
+
+	// 다른 단어의 분할 결과에 등장하는 단어는 그 단어보다 먼저 버려지면 안 되므로,
+	// 참조하는 단어의 빈도를 물려받은 실효 빈도를 기준으로 버릴 단어를 고른다.
+	Vector<size_t> effCnts{ wordCnts.begin(), wordCnts.end() };
+	for (bool changed = true; changed;)
+	{
+		changed = false;
+		for (auto& p : wordSuffix)
+		{
+			if (p.second.hasBoundaries) continue;
+			const size_t cnt = effCnts[p.first];
+			for (auto v : p.second.tokenizations.get().raw())
+			{
+				if (v >= 0 || effCnts[-v - 1] >= cnt) continue;
+				effCnts[-v - 1] = cnt;
+				changed = true;
+			}
+		}
+	}
+
+	// 실효 빈도가 threshold 이하인 단어들을 모두 버려 단어 수가 상한의 절반 이하가 되도록 한다.
+	const size_t target = trainConfig.maxWordMapSize / 2;
+	const size_t numRemoved = wordMap.size() - target;
+	Vector<size_t> cnts = effCnts;
+	nth_element(cnts.begin(), cnts.begin() + numRemoved - 1, cnts.end());
+	const size_t threshold = cnts[numRemoved - 1];
+
+	Vector<uint32_t> newIds(wordMap.size(), -1);
+	size_t nextId = 0;
+	for (size_t i = 0; i < wordCnts.size(); ++i)
+	{
+		if (effCnts[i] <= threshold) continue;
+		newIds[i] = nextId;
+		wordCnts[nextId] = wordCnts[i];
+		++nextId;
+	}
+	const size_t removed = wordMap.size() - nextId;
+	wordCnts.resize(nextId);
+
+	for (auto it = wordMap.begin(); it != wordMap.end();)
+	{
+		if (newIds[it->second] == (uint32_t)-1)
+		{
+			it = wordMap.erase(it);
+		}
+		else
+		{
+			it->second = newIds[it->second];
+			++it;
+		}
+	}
+
+	UnorderedMap<size_t, WordCand> newWordSuffix;
+	for (auto& p : wordSuffix)
+	{
+		if (newIds[p.first] == (uint32_t)-1) continue;
+		auto& tokenizations = p.second.tokenizations.get();
+		if (!p.second.hasBoundaries)
+		{
+			for (size_t i = 0; i < tokenizations.size(); ++i)
+			{
+				for (auto& v : tokenizations[i])
+				{
+					if (v < 0) v = -(int32_t)newIds[-v - 1] - 1;
+				}
+			}
+		}
+		newWordSuffix.emplace(newIds[p.first], move(p.second));
+	}
+	wordSuffix = move(newWordSuffix);
+	return removed;
+}
+
 const Morpheme* UnigramSwTrainer::toReprMorph(const Morpheme* morph)
 {
 	auto key = make_pair(*morph->kform, config.simpleTag ? toReprTag(morph->tag) : morph->tag);
@@ -1776,7 +2424,6 @@ template<class Feeder>
 size_t UnigramSwTrainer::_addSentences(Feeder&& feeder)
 {
 	Deque<future<pair<TokenResult, u16string>>> futures;
-	auto& rsents = sents.get();
 	const auto* morphBase = kiwi->idToMorph(0);
 	Vector<const Morpheme*> verbalSuffices;
 	Vector<const Morpheme*> eomiSuffices;
@@ -1834,7 +2481,6 @@ size_t UnigramSwTrainer::_addSentences(Feeder&& feeder)
 		Vector<size_t> contBoundaries;
 		bool spacePrefix = false;
 		bool isPrevNumber = false;
-		rsents.emplace_back();
 		for (auto& token : res.first.first)
 		{
 			if ((isTagForPrefix(token.tag) || !token.morph->kform || token.morph->kform->empty()) 
@@ -1930,7 +2576,6 @@ size_t UnigramSwTrainer::_addSentences(Feeder&& feeder)
 						knownPrefixSize = std::max(knownPrefixSize, (size_t)kiwi->morphToId(wc.morph) + 1);
 						wordSuffix.emplace(wid, move(wc));
 					}
-					rsents.add_data(-(int32_t)wid - 1);
 				}
 				else if (config.splitVerb && (verbSuffix = findVerbalSuffix(token.morph, verbalSuffices)))
 				{
@@ -1943,7 +2588,6 @@ size_t UnigramSwTrainer::_addSentences(Feeder&& feeder)
 					knownPrefixSize = std::max(knownPrefixSize, (size_t)kiwi->morphToId(wc.suffix) + 1);
 					knownPrefixSize = std::max(knownPrefixSize, (size_t)kiwi->morphToId(wc.morph) + 1);
 					wordSuffix.emplace(wid, move(wc));
-					rsents.add_data(-(int32_t)wid - 1);
 				}
 				else if (config.splitEomi && eomiSuffix.first)
 				{
@@ -1957,11 +2601,10 @@ size_t UnigramSwTrainer::_addSentences(Feeder&& feeder)
 					knownPrefixSize = std::max(knownPrefixSize, (size_t)kiwi->morphToId(wc.morph) + 1);
 					knownPrefixSize = std::max(knownPrefixSize, (size_t)kiwi->morphToId(wc.baseEomi) + 1);
 					wordSuffix.emplace(wid, move(wc));
-					rsents.add_data(-(int32_t)wid - 1);
 				}
 				else
 				{
-					rsents.add_data(kiwi->morphToId(toReprMorph(token.morph)));
+					addMorph(kiwi->morphToId(toReprMorph(token.morph)));
 				}
 				lastTokenEnd = token.position + token.length;
 			}
@@ -1971,6 +2614,7 @@ size_t UnigramSwTrainer::_addSentences(Feeder&& feeder)
 		{
 			addWord(contToken, contMorphs, contBoundaries, spacePrefix);
 		}
+		pruneWords();
 		addedSentences++;
 	};
 
@@ -2005,20 +2649,14 @@ size_t UnigramSwTrainer::addSentences(const function<u16string()>& feeder)
 
 float UnigramSwTrainer::buildSubwordVocabs(const size_t minCnt, const size_t maxPrefixLength)
 {
-	auto& rawTokens = sents.get().raw();
-	int32_t minV = 0, maxV = 0;
-	for (auto v : rawTokens)
-	{
-		minV = min(v, minV);
-		maxV = max(v, maxV);
-	}
-
-	knownPrefixSize = std::max((size_t)maxV + 1, knownPrefixSize);
+	// tokenFreqs에는 형태소의 빈도가 id 순으로, 그 뒤에 단어의 빈도가 id의 역순으로 저장된다.
+	knownPrefixSize = std::max(morphCnts.size(), knownPrefixSize);
 	tokenFreqs.clear();
-	tokenFreqs.resize((int64_t)knownPrefixSize - minV);
-	for (auto i : rawTokens)
+	tokenFreqs.resize(knownPrefixSize + wordCnts.size());
+	copy(morphCnts.begin(), morphCnts.end(), tokenFreqs.begin());
+	for (size_t wid = 0; wid < wordCnts.size(); ++wid)
 	{
-		tokenFreqs[i >= 0 ? i : (i + tokenFreqs.size())]++;
+		tokenFreqs[tokenFreqs.size() - 1 - wid] = wordCnts[wid];
 	}
 
 	u16string allTexts;
@@ -2228,29 +2866,38 @@ float UnigramSwTrainer::buildSubwordVocabs(const size_t minCnt, const size_t max
 	invWordMap.resize(wordMap.size());
 	for (auto& p : wordMap)
 	{
-		auto wordSuffixIt = wordSuffix.find(p.second);
-		if (wordSuffixIt == wordSuffix.end())
-		{
-			wordBestTokenizations[p.second] = tokenizeShort(p.first);
-		}
-		else
+		invWordMap[p.second] = &p;
+	}
+
+	auto* pool = kiwi->getThreadPool();
+	utils::forEachShard(pool, invWordMap.size(), pool ? pool->size() * 4 : 1, [&](size_t, size_t first, size_t last)
+	{
+		for (size_t wid = first; wid < last; ++wid)
 		{
-			auto& m = wordSuffixIt->second;
-			if (m.morph)
+			auto& p = *invWordMap[wid];
+			auto wordSuffixIt = wordSuffix.find(p.second);
+			if (wordSuffixIt == wordSuffix.end())
 			{
-				wordBestTokenizations[p.second].emplace_back((uint32_t)kiwi->morphToId(m.morph));
+				wordBestTokenizations[p.second] = tokenizeShort(p.first);
 			}
-			/*else if (m.hasBoundaries)
-			{
-				wordBestTokenizations[p.second] = tokenizeShort(p.first, m.tokenizations.get().raw());
-			}*/
 			else
 			{
-				wordBestTokenizations[p.second] = tokenizeShort(p.first);
+				auto& m = wordSuffixIt->second;
+				if (m.morph)
+				{
+					wordBestTokenizations[p.second].emplace_back((uint32_t)kiwi->morphToId(m.morph));
+				}
+				/*else if (m.hasBoundaries)
+				{
+					wordBestTokenizations[p.second] = tokenizeShort(p.first, m.tokenizations.get().raw());
+				}*/
+				else
+				{
+					wordBestTokenizations[p.second] = tokenizeShort(p.first);
+				}
 			}
 		}
-		invWordMap[p.second] = &p;
-	}
+	});
 	return updateProb(true);
 }
 
@@ -2544,7 +3191,6 @@ pair<Vector<uint32_t>, float> UnigramSwTrainer::tokenizeBest(const WordCand& m)
 
 float UnigramSwTrainer::updateProb(bool init)
 {
-	auto& rawTokens = sents.get().raw();
 	prefixFreqs.clear();
 	prefixFreqs.resize(chrPrefix.size());
 	prefixLProbs.resize(chrPrefix.size());
@@ -2556,15 +3202,35 @@ float UnigramSwTrainer::updateProb(bool init)
 		totCnt += tokenFreqs[i];
 	}
 
-	for (size_t i = knownPrefixSize; i < tokenFreqs.size(); ++i)
+	// 각 구간별로 별도의 버퍼에 빈도를 누적한 뒤 합친다.
+	auto* pool = kiwi->getThreadPool();
+	const size_t numWords = tokenFreqs.size() - knownPrefixSize;
+	const size_t numShards = max(min(pool ? pool->size() : (size_t)1, numWords / 4096), (size_t)1);
+	Vector<Vector<uint32_t>> shardFreqs(numShards - 1);
+	Vector<size_t> shardTotCnts(numShards);
+	utils::forEachShard(pool, numWords, numShards, [&](size_t shard, size_t first, size_t last)
+	{
+		auto& freqs = shard ? shardFreqs[shard - 1] : prefixFreqs;
+		if (shard) freqs.resize(prefixFreqs.size());
+		for (size_t i = knownPrefixSize + first; i < knownPrefixSize + last; ++i)
+		{
+			auto wid = tokenFreqs.size() - 1 - i;
+			for (auto j : wordBestTokenizations[wid])
+			{
+				freqs[j] += tokenFreqs[i];
+			}
+			shardTotCnts[shard] += wordBestTokenizations[wid].size() * tokenFreqs[i];
+		}
+	});
+
+	for (auto& freqs : shardFreqs)
 	{
-		auto wid = tokenFreqs.size() - 1 - i;
-		for (auto j : wordBestTokenizations[wid])
+		for (size_t i = 0; i < freqs.size(); ++i)
 		{
-			prefixFreqs[j] += tokenFreqs[i];
+			prefixFreqs[i] += freqs[i];
 		}
-		totCnt += wordBestTokenizations[wid].size() * tokenFreqs[i];
 	}
+	for (auto c : shardTotCnts) totCnt += c;
 
 	const double discnt = init ? 0.999 : 0.999999, smoothing = (1 - discnt) / prefixFreqs.size();
 	double totCntF = totCnt;
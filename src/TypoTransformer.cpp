@@ -1,6 +1,7 @@
 ﻿#include <cmath>
 #include <kiwi/TypoTransformer.h>
 #include <kiwi/Utils.h>
+#include <kiwi/ScratchSpace.h>
 #include "StrUtils.h"
 #include "FrozenTrie.hpp"
 #include "FeatureTestor.h"
@@ -80,6 +81,7 @@ TypoIterator<u16wrap>::TypoIterator(const TypoCandidates<u16wrap>& _cand)
 {
 	while (!valid())
 	{
+		skipCostlyDigits();
 		if (increase()) break;
 	}
 }
@@ -157,6 +159,26 @@ bool TypoIterator<u16wrap>::increase()
 	return digit.back() >= cands->branchPtrs.end()[-1] - cands->branchPtrs.end()[-2] - 1;
 }
 
+template<bool u16wrap>
+void TypoIterator<u16wrap>::skipCostlyDigits()
+{
+	if (cands->branchPtrs.size() <= 1) return;
+	// 상위 자리들의 비용 합만으로 임계값을 넘으면, 하위 자리를 어떻게 바꾸더라도 유효한 후보가 나올 수 없으므로
+	// 하위 자리들을 모두 최댓값으로 옮겨 다음 increase()에서 곧바로 상위 자리가 올라가도록 한다.
+	float cost = 0;
+	for (size_t i = digit.size(); i-- > 0;)
+	{
+		size_t s = cands->branchPtrs[i] + digit[i];
+		cost += get<float>(cands->candidates[s - i]);
+		if (cost <= cands->costThreshold) continue;
+		for (size_t j = 0; j < i; ++j)
+		{
+			digit[j] = cands->branchPtrs[j + 1] - cands->branchPtrs[j] - 2;
+		}
+		return;
+	}
+}
+
 template<bool u16wrap>
 bool TypoIterator<u16wrap>::valid() const
 {
@@ -205,6 +227,7 @@ TypoIterator<u16wrap>& TypoIterator<u16wrap>::operator++()
 	if (digit.empty()) return *this;
 	do
 	{
+		skipCostlyDigits();
 		if (increase()) break;
 	} while (!valid());
 
@@ -813,17 +836,18 @@ size_t PreparedTypoTransformer::generateGraph(U16StringView str,
 	Dialect allowedDialect,
 	const pair<uint32_t, uint32_t>* pretokenizedFirst,
 	const pair<uint32_t, uint32_t>* pretokenizedLast,
-	size_t* maxContinualTypoIdxOut
+	size_t* maxContinualTypoIdxOut,
+	float costThreshold
 ) const
 {
 	const bool continualTypoEnabled = isfinite(continualTypoThreshold);
 	static constexpr size_t npos = -1;
 	using MatchInfo = tuple<size_t, PatInfo>; // (endPos, patternInfo)
-	thread_local Vector<TypoGraphNode> tempGraph;
-	thread_local Vector<MatchInfo> matches;
-	thread_local Vector<size_t> breakPoints;
-	thread_local Vector<pair<uint32_t, uint32_t>> endPosMap; // (first position, last position)
-	thread_local UnorderedMap<char16_t, pair<size_t, size_t>> continualTypoIdxMap;
+	thread_local utils::Scratch<Vector<TypoGraphNode>> tempGraph;
+	thread_local utils::Scratch<Vector<MatchInfo>> matches;
+	thread_local utils::Scratch<Vector<size_t>> breakPoints;
+	thread_local utils::Scratch<Vector<pair<uint32_t, uint32_t>>> endPosMap; // (first position, last position)
+	thread_local utils::Scratch<UnorderedMap<char16_t, pair<size_t, size_t>>> continualTypoIdxMap;
 	matches.clear();
 	endPosMap.clear();
 	endPosMap.emplace_back(0, 0);
@@ -894,6 +918,7 @@ size_t PreparedTypoTransformer::generateGraph(U16StringView str,
 					if (repl.leftCond == CondVowel::continual && (s == 0 || !isHangulSyllable(str[s - 1]))) continue;
 					if (repl.leftCond == CondVowel::continual && !isfinite(continualTypoThreshold)) continue;
 					const float scale = repl.leftCond == CondVowel::continual ? continualTypoThreshold : 1.f;
+					if (repl.cost * scale / 2 > costThreshold) continue;
 					const auto [it, inserted] = continualTypoIdxMap.emplace(*repl.str, make_pair(continualTypoIdxMap.size() + 1, 0));
 					auto& [continualTypoIdx, continualTypoNodeIdx] = it->second;
 					if (inserted)
@@ -929,6 +954,8 @@ size_t PreparedTypoTransformer::generateGraph(U16StringView str,
 				{
 					if (!FeatureTestor::isMatched(str.data(), str.data() + s, repl.leftCond)) continue;
 				}
+				// 비용 상한을 넘는 후보는 탐색 단계에서 어차피 버려지므로 그래프에 추가하지 않는다.
+				if (repl.cost > costThreshold) continue;
 				if (appendNewNode(tempGraph, endPosMap, last, U16StringView{ repl.str, repl.length }, s, e, repl.cost))
 				{
 					tempGraph.back().dialect = repl.dialect;
@@ -1049,10 +1076,10 @@ namespace kiwi
 	template TypoCandidates<false> PreparedTypoTransformer::_generate<false>(const KString&, float) const;
 
 	template size_t PreparedTypoTransformer::generateGraph<allocator<TypoGraphNode>>(
-		U16StringView, vector<TypoGraphNode, allocator<TypoGraphNode>>&, Dialect, const pair<uint32_t, uint32_t>*, const pair<uint32_t, uint32_t>*, size_t*) const;
+		U16StringView, vector<TypoGraphNode, allocator<TypoGraphNode>>&, Dialect, const pair<uint32_t, uint32_t>*, const pair<uint32_t, uint32_t>*, size_t*, float) const;
 #ifdef KIWI_USE_MIMALLOC
 	template size_t PreparedTypoTransformer::generateGraph<mi_stl_allocator<TypoGraphNode>>(
-		U16StringView, vector<TypoGraphNode, mi_stl_allocator<TypoGraphNode>>&, Dialect, const pair<uint32_t, uint32_t>*, const pair<uint32_t, uint32_t>*, size_t*) const;
+		U16StringView, vector<TypoGraphNode, mi_stl_allocator<TypoGraphNode>>&, Dialect, const pair<uint32_t, uint32_t>*, const pair<uint32_t, uint32_t>*, size_t*, float) const;
 #endif
 
 	const TypoTransformer& getDefaultTypoSet(DefaultTypoSet set)
@@ -531,6 +531,8 @@ namespace kiwi
 		case ModelType::congGlobal: return "cong-global";
 		case ModelType::congFp32: return "cong-fp32";
 		case ModelType::congGlobalFp32: return "cong-global-fp32";
+		case ModelType::congQ4: return "cong-q4";
+		case ModelType::congGlobalQ4: return "cong-global-q4";
 		}
 		return "unknown";
 	}
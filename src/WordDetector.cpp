@@ -3,8 +3,8 @@
 #include <iostream>
 #include <numeric>
 #include <mutex>
-#include <unordered_set>
 #include <algorithm>
+#include <deque>
 
 #include <kiwi/Types.h>
 #include <kiwi/WordDetector.h>
@@ -13,27 +13,13 @@
 #include <kiwi/Utils.h>
 #include "StrUtils.h"
 #include "serializer.hpp"
+#include "sais/sais.hpp"
 
 using namespace std;
 using namespace kiwi;
 
 namespace kiwi
 {
-	struct puhash
-	{
-		size_t operator()(const pair<uint16_t, uint16_t>& o) const
-		{
-			return hash<uint16_t>{}(o.first) | (hash<uint16_t>{}(o.second) << 16);
-		}
-	};
-
-	template<class ChrTy>
-	bool startsWith(const std::basic_string<ChrTy>& s, const std::basic_string<ChrTy>& pf)
-	{
-		if (s.size() < pf.size()) return false;
-		return std::equal(pf.begin(), pf.end(), s.begin());
-	}
-
 	template<class KeyType = char16_t, class ValueType = uint32_t>
 	class WordDictionary
 	{
@@ -123,31 +109,121 @@ namespace kiwi
 	}
 
 	template<class LocalData, class FuncReader, class FuncProc>
-	std::vector<LocalData> readProc(size_t numWorkers, const FuncReader& reader, const FuncProc& processor, LocalData&& ld = {})
+	std::vector<LocalData> readProc(utils::ThreadPool* pool, const FuncReader& reader, const FuncProc& processor, LocalData&& ld = {})
 	{
-		utils::ThreadPool workers{ numWorkers, numWorkers * 2 };
-		std::vector<LocalData> ldByTid(workers.size(), ld);
-		while (1)
+		if (!pool)
 		{
-			auto ustr = reader();
-			if (ustr.empty()) break;
-			workers.enqueue([&, ustr](size_t tid)
+			std::vector<LocalData> ret(1, ld);
+			while (1)
 			{
-				auto& ld = ldByTid[tid];
-			processor(ustr, ld);
-			});
+				auto ustr = reader();
+				if (ustr.empty()) break;
+				processor(ustr, ret[0]);
+			}
+			return ret;
+		}
+
+		// 공유 스레드풀의 큐를 독점하지 않도록 동시에 대기하는 작업의 개수를 제한한다.
+		const size_t maxInFlight = pool->size() * 2;
+		std::vector<LocalData> ldByTid(pool->size(), ld);
+		std::deque<std::future<void>> futures;
+		try
+		{
+			while (1)
+			{
+				auto ustr = reader();
+				if (ustr.empty()) break;
+				if (futures.size() >= maxInFlight)
+				{
+					futures.front().get();
+					futures.pop_front();
+				}
+				futures.emplace_back(pool->enqueue([&, ustr](size_t tid)
+				{
+					processor(ustr, ldByTid[tid]);
+				}));
+			}
+		}
+		catch (...)
+		{
+			for (auto& f : futures) f.wait();
+			throw;
 		}
-		workers.joinAll();
+		for (auto& f : futures) f.wait();
+		for (auto& f : futures) f.get();
 		return ldByTid;
 	}
+
+	inline bool hasCoda(char16_t c)
+	{
+		return 0xAC00 <= c && c <= 0xD7A4 && (c - 0xAC00) % 28;
+	}
+
+	/**
+	 * @brief 길이가 len인 문자열 w의 앞쪽/뒤쪽 응집도를 계산한다.
+	 * unigram(c)은 문자 c의 빈도를, count(first, last)는 부분 문자열 [first, last)의 빈도를 반환해야 한다.
+	 */
+	template<class Chr, class UnigramFn, class CountFn>
+	std::pair<float, float> computeCohesion(const Chr* w, size_t len, uint32_t cnt, UnigramFn&& unigram, CountFn&& count)
+	{
+		float forwardCohesion = cnt / (float)unigram(w[0]);
+		float backwardCohesion = cnt / (float)unigram(w[len - 1]);
+		if (len == 3)
+		{
+			forwardCohesion *= cnt / (float)count(w, w + 2);
+			backwardCohesion *= cnt / (float)count(w + len - 2, w + len);
+			forwardCohesion = std::pow(forwardCohesion, 1.f / (len * 2 - 3));
+			backwardCohesion = std::pow(backwardCohesion, 1.f / (len * 2 - 3));
+		}
+		else if (len > 3)
+		{
+			forwardCohesion *= cnt / (float)count(w, w + 2);
+			backwardCohesion *= cnt / (float)count(w + len - 2, w + len);
+			forwardCohesion *= cnt / (float)count(w, w + 3);
+			backwardCohesion *= cnt / (float)count(w + len - 3, w + len);
+			forwardCohesion = std::pow(forwardCohesion, 1.f / (len * 3 - 6));
+			backwardCohesion = std::pow(backwardCohesion, 1.f / (len * 3 - 6));
+		}
+		return std::make_pair(forwardCohesion, backwardCohesion);
+	}
+
+	std::vector<WordInfo> filterCandidates(std::vector<WordInfo>& cands, const std::map<std::u16string, float>& rPartEntropy);
 }
 
 struct WordDetector::Counter
 {
 	WordDictionary<char16_t, uint16_t> chrDict;
 	std::vector<uint32_t> cntUnigram;
-	std::unordered_set<std::pair<uint16_t, uint16_t>, puhash> candBigram;
-	std::map<std::u16string, uint32_t> forwardCnt, backwardCnt;
+	Vector<uint16_t> text; // 모든 어절을 [1(시작), 문자 ID..., 2(끝)] 형태로 이어 붙인 문자열. 사전에 없는 문자는 0
+	Vector<int32_t> sa; // text의 접미사 배열
+	Vector<uint8_t> lcp; // lcp[i]: sa[i - 1]과 sa[i]가 가리키는 두 접미사의 공통 접두사 길이. maxWordLen에서 잘린다.
+
+	/**
+	 * @brief 문자열 [first, last)로 시작하는 접미사들의 구간 [l, r)을 sa에서 찾는다.
+	 */
+	std::pair<size_t, size_t> find(const uint16_t* first, const uint16_t* last) const
+	{
+		const size_t len = last - first;
+		const auto cmp = [&](int32_t pos, const uint16_t* s, size_t slen)
+		{
+			// 접미사의 앞 slen글자를 s와 비교한다.
+			const size_t n = min(slen, text.size() - pos);
+			for (size_t i = 0; i < n; ++i)
+			{
+				if (text[pos + i] != s[i]) return text[pos + i] < s[i] ? -1 : 1;
+			}
+			return n < slen ? -1 : 0;
+		};
+		auto l = lower_bound(sa.begin(), sa.end(), first, [&](int32_t pos, const uint16_t* s) { return cmp(pos, s, len) < 0; });
+		auto r = upper_bound(l, sa.end(), first, [&](const uint16_t* s, int32_t pos) { return cmp(pos, s, len) > 0; });
+		return make_pair((size_t)(l - sa.begin()), (size_t)(r - sa.begin()));
+	}
+
+	uint32_t count(const uint16_t* first, const uint16_t* last) const
+	{
+		auto r = find(first, last);
+		return (uint32_t)(r.second - r.first);
+	}
 };
 
 WordDetector::WordDetector(const std::string& modelPath, size_t _numThreads)
@@ -191,9 +267,21 @@ void WordDetector::saveModel(const std::string& modelPath) const
 	}
 }
 
-void WordDetector::countUnigram(Counter& cdata, const U16Reader& reader, size_t minCnt) const
+shared_ptr<utils::ThreadPool> WordDetector::acquireThreadPool() const
+{
+	if (threadPool)
+	{
+		// 스레드풀의 작업 안에서 호출된 경우 같은 스레드풀에 작업을 넣고 기다리면 교착될 수 있으므로 현재 스레드에서 처리한다.
+		if (threadPool->size() <= 1 || threadPool->isWorkerThread()) return nullptr;
+		return threadPool;
+	}
+	if (numThreads > 1) return make_shared<utils::ThreadPool>(numThreads);
+	return nullptr;
+}
+
+void WordDetector::countUnigram(Counter& cdata, const U16Reader& reader, size_t minCnt, utils::ThreadPool* pool) const
 {
-	auto ldUnigram = readProc<vector<uint32_t>>(numThreads, reader, [this, &cdata](u16string ustr, vector<uint32_t>& ld)
+	auto ldUnigram = readProc<vector<uint32_t>>(pool, reader, [this, &cdata](u16string ustr, vector<uint32_t>& ld)
 	{
 		SpaceSplitIterator begin{ ustr.begin(), ustr.end() }, end;
 		vector<uint16_t> ids;
@@ -240,189 +328,99 @@ void WordDetector::countUnigram(Counter& cdata, const U16Reader& reader, size_t
 	cdata.chrDict = move(chrDictShrink);
 }
 
-void WordDetector::countBigram(Counter& cdata, const U16Reader& reader, size_t minCnt) const
+void WordDetector::buildSuffixArray(Counter& cdata, const U16Reader& reader, size_t maxWordLen, utils::ThreadPool* pool) const
 {
-	auto ldBigram = readProc<vector<uint32_t>>(numThreads, reader, [this, &cdata](u16string ustr, vector<uint32_t>& ld)
+	auto& text = cdata.text;
+	text.clear();
+	while (1)
 	{
+		auto ustr = reader();
+		if (ustr.empty()) break;
 		SpaceSplitIterator begin{ ustr.begin(), ustr.end() }, end;
 		for (; begin != end; ++begin)
 		{
-			uint16_t a = 1;
+			text.emplace_back(1); // Begin Chr
 			for (auto c : *begin)
 			{
-				uint16_t wid = cdata.chrDict.get(c);
-				if (wid == cdata.chrDict.npos) wid = 0;
-				if (a && wid) ++ld[a * cdata.chrDict.size() + wid];
-				a = wid;
+				uint16_t id = cdata.chrDict.get(c);
+				if (id == cdata.chrDict.npos) id = 0;
+				text.emplace_back(id);
 			}
-			if (a) ++ld[a * cdata.chrDict.size() + 2];
+			text.emplace_back(2); // End Chr
 		}
-	}, vector<uint32_t>(cdata.chrDict.size() * cdata.chrDict.size()));
-
-	auto& bigramMerged = ldBigram[0];
-	for (size_t i = 1; i < ldBigram.size(); ++i)
-	{
-		for (size_t n = 0; n < ldBigram[i].size(); ++n) bigramMerged[n] += ldBigram[i][n];
 	}
-
-	for (size_t i = 0; i < bigramMerged.size(); ++i)
+	if (text.size() >= (size_t)numeric_limits<int32_t>::max())
 	{
-		if (bigramMerged[i] < minCnt) continue;
-		cdata.candBigram.emplace(i / cdata.chrDict.size(), i % cdata.chrDict.size());
+		throw Exception{ "The input corpus is too large to build a suffix array (" + to_string(text.size()) + " characters)." };
 	}
-}
 
-void WordDetector::countNgram(Counter& cdata, const U16Reader& reader, size_t minCnt, size_t maxWordLen) const
-{
+	cdata.sa.resize(text.size());
+	sais::sais<char16_t, int32_t>((const char16_t*)text.data(), cdata.sa.data(), (int32_t)text.size(), 0, 0, nullptr, 0, nullptr, pool);
+
+	// 단어 길이가 maxWordLen을 넘지 않으므로 공통 접두사는 그 이상 비교할 필요가 없다.
+	// 따라서 순위 배열 없이 인접한 접미사끼리 직접 비교하여 각 구간을 독립적으로 계산할 수 있다.
+	const size_t maxLcp = min(maxWordLen, (size_t)numeric_limits<uint8_t>::max());
+	cdata.lcp.resize(text.size());
+	const size_t numShards = pool ? pool->size() * 4 : 1;
+	utils::forEachShard(pool, text.size(), numShards, [&](size_t, size_t first, size_t last)
 	{
-		utils::ThreadPool rtForward{ 1, 2 }, rtBackward{ 1, 2 };
-		vector<future<void>> futures;
-		while (1)
+		for (size_t i = first; i < last; ++i)
 		{
-			auto ustr = reader();
-			if (ustr.empty()) break;
-			SpaceSplitIterator begin{ ustr.begin(), ustr.end() }, end;
-			auto idss = make_shared<vector<vector<int16_t>>>();
-			for (; begin != end; ++begin)
+			if (i == 0)
 			{
-				vector<int16_t> ids;
-				ids.reserve(begin.strSize() + 2);
-				ids.emplace_back(1); // Begin Chr
-				for (auto c : *begin)
-				{
-					uint16_t id = cdata.chrDict.get(c);
-					if (id == cdata.chrDict.npos) id = 0;
-					ids.emplace_back(id);
-				}
-				ids.emplace_back(2); // End Chr
-				idss->emplace_back(move(ids));
+				cdata.lcp[i] = 0;
+				continue;
 			}
-
-			rtForward.enqueue([&, idss](size_t threadId)
-			{
-				for (auto& ids : *idss)
-				{
-					for (size_t i = 1; i < ids.size(); ++i)
-					{
-						if (!ids[i]) continue; // skip unknown chr
-						for (size_t j = i + 1; j < min(i + 1 + maxWordLen, ids.size() + 1); ++j)
-						{
-							if (!ids[j - 1]) break;
-							++cdata.forwardCnt[{ids.begin() + i, ids.begin() + j}];
-							if (!cdata.candBigram.count(make_pair(ids[j - 2], ids[j - 1]))) break;
-						}
-					}
-				}
-			});
-
-			rtBackward.enqueue([&, idss](size_t threadId)
-			{
-				for (auto& ids : *idss)
-				{
-					for (size_t i = 1; i < ids.size(); ++i)
-					{
-						if (!ids.rbegin()[i]) continue; // skip unknown chr
-						for (size_t j = i + 1; j < min(i + 1 + maxWordLen, ids.size() + 1); ++j)
-						{
-							if (!ids.rbegin()[j - 1]) break;
-							++cdata.backwardCnt[{ids.rbegin() + i, ids.rbegin() + j}];
-							if (!cdata.candBigram.count(make_pair(ids.rbegin()[j - 1], ids.rbegin()[j - 2]))) break;
-						}
-					}
-				}
-			});
-		}
-
-	}
-	
-	u16string prefixToErase = {};
-	for (auto it  = cdata.forwardCnt.cbegin(); it != cdata.forwardCnt.cend();)
-	{
-		auto& p = *it;
-		if (prefixToErase.empty() || !startsWith(p.first, prefixToErase))
-		{
-			if (p.second < minCnt) prefixToErase = p.first;
-			else prefixToErase = {};
-			++it;
-		}
-		else
-		{
-			it = cdata.forwardCnt.erase(it);
+			const size_t a = cdata.sa[i - 1], b = cdata.sa[i];
+			const size_t n = min(maxLcp, text.size() - max(a, b));
+			size_t l = 0;
+			while (l < n && text[a + l] == text[b + l]) ++l;
+			cdata.lcp[i] = (uint8_t)l;
 		}
-	}
-
-	prefixToErase = {};
-	for (auto it = cdata.backwardCnt.cbegin(); it != cdata.backwardCnt.cend();)
-	{
-		auto& p = *it;
-		if (prefixToErase.empty() || !startsWith(p.first, prefixToErase))
-		{
-			if (p.second < minCnt) prefixToErase = p.first;
-			else prefixToErase = {};
-			++it;
-		}
-		else
-		{
-			it = cdata.backwardCnt.erase(it);
-		}
-	}
+	});
 }
 
-float WordDetector::branchingEntropy(const map<u16string, uint32_t>& cnt, map<u16string, uint32_t>::iterator it, size_t minCnt, float defaultPerp) const
+float WordDetector::branchingEntropy(const vector<pair<uint16_t, uint32_t>>& nexts, uint32_t cnt, size_t minCnt, float defaultPerp) const
 {
-	u16string endKey = it->first;
-	float tot = it->second;
-	size_t len = endKey.size();
-	endKey.back()++;
-	++it;
-	auto eit = cnt.lower_bound(endKey);
+	const float tot = cnt;
 	size_t sum = 0;
 	float entropy = 0;
-	for (; it != eit; ++it)
+	for (auto& p : nexts)
 	{
-		if (it->first.size() != len + 1) continue;
-		sum += it->second;
-		float p = it->second / tot;
+		sum += p.second;
+		float prob = p.second / tot;
 		// for begin, end, unknown
-		if (it->first.back() < 3)
+		if (p.first < 3)
 		{
-			entropy -= p * std::log(p / defaultPerp);
+			entropy -= prob * std::log(prob / defaultPerp);
 		}
 		else
 		{
-			entropy -= p * std::log(p);
+			entropy -= prob * std::log(prob);
 		}
 	}
 
 	if (sum < tot)
 	{
-		float p = (tot - sum) / tot;
-		entropy -= p * std::log(p / ((tot - sum) / minCnt));
+		float prob = (tot - sum) / tot;
+		entropy -= prob * std::log(prob / ((tot - sum) / minCnt));
 	}
 
 	return entropy;
 }
 
-map<POSTag, float> WordDetector::getPosScore(Counter & cdata, 
-	const std::map<u16string, uint32_t>& cnt, 
-	std::map<u16string, uint32_t>::iterator it, 
+map<POSTag, float> WordDetector::getPosScore(const vector<pair<char16_t, uint32_t>>& nexts,
+	uint32_t cnt,
 	bool coda, 
 	const u16string& realForm
 ) const
 {
 	map<POSTag, float> ret;
-	u16string endKey = it->first;
-	float tot = it->second;
-	size_t len = endKey.size();
-	endKey.back()++;
-	++it;
-	auto eit = cnt.lower_bound(endKey);
+	const float tot = cnt;
 	map<char16_t, float> rParts;
-	float sum = 0;
-	for (; it != eit; ++it)
+	for (auto& p : nexts)
 	{
-		if (it->first.size() != len + 1) continue;
-		sum += (rParts[it->first.back() > 2 ? cdata.chrDict.getStr(it->first.back()) : u'$'] = it->second);
+		rParts[p.first > 2 ? p.first : u'$'] = p.second;
 	}
 
 	for (auto& posd : posScore)
@@ -477,73 +475,149 @@ void WordDetector::loadNounTailModelFromTxt(std::istream & is)
 
 vector<WordInfo> WordDetector::extractWords(const U16MultipleReader& reader, size_t minCnt, size_t maxWordLen, float minScore) const
 {
+	auto pool = acquireThreadPool();
 	Counter cdata;
-	countUnigram(cdata, reader(), minCnt);
-	countBigram(cdata, reader(), minCnt);
-	countNgram(cdata, reader(), minCnt, maxWordLen);
-
-	vector<WordInfo> cands, ret;
-	for (auto it = cdata.forwardCnt.begin(); it != cdata.forwardCnt.end(); ++it)
-	{
-		auto& p = *it;
-		if (p.second < minCnt) continue;
-		if (p.first.size() >= maxWordLen || p.first.size() <= 1) continue;
-		auto bit = cdata.backwardCnt.find({ p.first.rbegin(), p.first.rend() });
-		if (bit == cdata.backwardCnt.end()) continue;
-		
-		float forwardCohesion = p.second / (float)cdata.cntUnigram[p.first.front()];
-		float backwardCohesion = p.second / (float)cdata.cntUnigram[p.first.back()];
-		if (p.first.size() == 3)
-		{
-			forwardCohesion *= p.second / (float)cdata.forwardCnt.find({p.first.begin(), p.first.begin() + 2})->second;
-			backwardCohesion *= p.second / (float)cdata.backwardCnt.find({ p.first.rbegin(), p.first.rbegin() + 2 })->second;
-			forwardCohesion = std::pow(forwardCohesion, 1.f / (p.first.size() * 2 - 3));
-			backwardCohesion = std::pow(backwardCohesion, 1.f / (p.first.size() * 2 - 3));
-		}
-		else if (p.first.size() > 3)
-		{
-			forwardCohesion *= p.second / (float)cdata.forwardCnt.find({ p.first.begin(), p.first.begin() + 2 })->second;
-			backwardCohesion *= p.second / (float)cdata.backwardCnt.find({ p.first.rbegin(), p.first.rbegin() + 2 })->second;
-			forwardCohesion *= p.second / (float)cdata.forwardCnt.find({ p.first.begin(), p.first.begin() + 3 })->second;
-			backwardCohesion *= p.second / (float)cdata.backwardCnt.find({ p.first.rbegin(), p.first.rbegin() + 3 })->second;
-			forwardCohesion = std::pow(forwardCohesion, 1.f / (p.first.size() * 3 - 6));
-			backwardCohesion = std::pow(backwardCohesion, 1.f / (p.first.size() * 3 - 6));
-		}
-		
-		float forwardBranch = branchingEntropy(cdata.forwardCnt, it, 6);
-		float backwardBranch = branchingEntropy(cdata.backwardCnt, bit, 6);
+	countUnigram(cdata, reader(), minCnt, pool.get());
+	buildSuffixArray(cdata, reader(), maxWordLen, pool.get());
 
-		float score = forwardCohesion * backwardCohesion * forwardBranch * backwardBranch;
-		if (score < minScore) continue;
+	const auto& text = cdata.text;
+	const auto& sa = cdata.sa;
+	const auto& lcp = cdata.lcp;
+	const auto toForm = [&](const uint16_t* first, const uint16_t* last)
+	{
 		u16string form;
-		form.reserve(p.first.size());
-		transform(p.first.begin(), p.first.end(), back_inserter(form), [this, &cdata](char16_t c) { return cdata.chrDict.getStr(c); });
+		form.reserve(last - first);
+		transform(first, last, back_inserter(form), [&](uint16_t c) { return cdata.chrDict.getStr(c); });
+		return form;
+	};
 
-		bool hasCoda = 0xAC00 <= p.first.back() && p.first.back() <= 0xD7A4 && (p.first.back() - 0xAC00) % 28;
-		cands.emplace_back(form, score, backwardBranch, forwardBranch, backwardCohesion, forwardCohesion,
-			p.second, getPosScore(cdata, cdata.forwardCnt, it, hasCoda, form));
-	}
+	struct ShardResult
+	{
+		vector<WordInfo> cands;
+		map<u16string, float> rPartEntropy;
+	};
 
-	map<u16string, float> rPartEntropy;
-	for (auto bit = cdata.backwardCnt.begin(); bit != cdata.backwardCnt.end(); ++bit)
+	/*
+	길이가 len인 모든 부분 문자열은 sa에서 lcp[i] >= len으로 이어진 구간 하나에 대응한다.
+	구간의 크기가 곧 빈도이고, 구간 안에서 각 접미사의 len번째 문자는 정렬되어 있으므로 오른쪽 분기를,
+	각 접미사의 바로 앞 문자는 왼쪽 분기를 나타낸다.
+	sa를 여러 조각으로 나누어 각 조각에서 시작하는 구간을 병렬로 처리한다.
+	*/
+	const size_t numShards = pool ? pool->size() * 4 : 1;
+	vector<ShardResult> shardResults(numShards);
+	utils::forEachShard(pool.get(), sa.size(), numShards, [&](size_t shard, size_t first, size_t last)
 	{
-		auto& p = *bit;
-		if (p.second < minCnt) continue;
-		if (p.first.size() > 3 || p.first.size() < 1) continue;
-		float r = branchingEntropy(cdata.backwardCnt, bit, minCnt);
-		if (r >= 1)
+		auto& result = shardResults[shard];
+		vector<pair<uint16_t, uint32_t>> lNexts, rNexts;
+		vector<pair<char16_t, uint32_t>> rChrs;
+		vector<uint16_t> lChrs;
+
+		const auto collectRight = [&](size_t l, size_t r, size_t len)
+		{
+			rNexts.clear();
+			for (size_t i = l; i < r; ++i)
+			{
+				const uint16_t c = text[sa[i] + len];
+				if (!c) continue; // skip unknown chr
+				if (!rNexts.empty() && rNexts.back().first == c) rNexts.back().second++;
+				else rNexts.emplace_back(c, 1);
+			}
+		};
+
+		const auto collectLeft = [&](size_t l, size_t r)
+		{
+			lChrs.clear();
+			for (size_t i = l; i < r; ++i)
+			{
+				const uint16_t c = text[sa[i] - 1];
+				if (c) lChrs.emplace_back(c);
+			}
+			sort(lChrs.begin(), lChrs.end());
+			lNexts.clear();
+			for (auto c : lChrs)
+			{
+				if (!lNexts.empty() && lNexts.back().first == c) lNexts.back().second++;
+				else lNexts.emplace_back(c, 1);
+			}
+		};
+
+		// 후보 단어는 maxWordLen보다 짧고, 오른쪽 부분의 분기 엔트로피는 3글자까지 계산한다.
+		const size_t maxLen = max(min(maxWordLen, (size_t)3), maxWordLen - 1);
+		for (size_t len = 1; len <= maxLen; ++len)
 		{
-			u16string form;
-			form.reserve(p.first.size());
-			transform(p.first.begin(), p.first.end(), back_inserter(form), [this, &cdata](char16_t c) { return cdata.chrDict.getStr(c); });
-			if (any_of(form.begin(), form.end(), isalnum16)) continue;
-			rPartEntropy[form] = r;
+			size_t l = first;
+			while (l < last && l > 0 && lcp[l] >= len) ++l;
+			while (l < last)
+			{
+				size_t r = l + 1;
+				while (r < sa.size() && lcp[r] >= len) ++r;
+				const uint32_t cnt = (uint32_t)(r - l);
+				const uint16_t* w = &text[sa[l]];
+				const size_t cur = l;
+				l = r;
+
+				if (cnt < minCnt) continue;
+				if (sa[cur] + len > text.size() || any_of(w, w + len, [](uint16_t c) { return c < 3; })) continue;
+
+				collectLeft(cur, r);
+				if (len <= 3)
+				{
+					float e = branchingEntropy(lNexts, cnt, minCnt);
+					if (e >= 1)
+					{
+						auto form = toForm(w, w + len);
+						if (none_of(form.begin(), form.end(), isalnum16))
+						{
+							result.rPartEntropy[u16string{ form.rbegin(), form.rend() }] = e;
+						}
+					}
+				}
+				if (len <= 1 || len >= maxWordLen) continue;
+
+				float forwardCohesion, backwardCohesion;
+				tie(forwardCohesion, backwardCohesion) = computeCohesion(w, len, cnt,
+					[&](uint16_t c) { return cdata.cntUnigram[c]; },
+					[&](const uint16_t* f, const uint16_t* l) { return cdata.count(f, l); }
+				);
+
+				collectRight(cur, r, len);
+				float forwardBranch = branchingEntropy(rNexts, cnt, 6);
+				float backwardBranch = branchingEntropy(lNexts, cnt, 6);
+
+				float score = forwardCohesion * backwardCohesion * forwardBranch * backwardBranch;
+				if (score < minScore) continue;
+				auto form = toForm(w, w + len);
+				rChrs.clear();
+				for (auto& p : rNexts)
+				{
+					rChrs.emplace_back(p.first > 2 ? cdata.chrDict.getStr(p.first) : (char16_t)p.first, p.second);
+				}
+				auto posScore = getPosScore(rChrs, cnt, hasCoda(form.back()), form);
+				result.cands.emplace_back(move(form), score, backwardBranch, forwardBranch, backwardCohesion, forwardCohesion,
+					cnt, move(posScore));
+			}
 		}
+	});
+
+	vector<WordInfo> cands;
+	map<u16string, float> rPartEntropy;
+	for (auto& r : shardResults)
+	{
+		cands.insert(cands.end(), make_move_iterator(r.cands.begin()), make_move_iterator(r.cands.end()));
+		rPartEntropy.insert(r.rPartEntropy.begin(), r.rPartEntropy.end());
 	}
+	shardResults.clear();
+	return filterCandidates(cands, rPartEntropy);
+}
 
+vector<WordInfo> kiwi::filterCandidates(vector<WordInfo>& cands, const map<u16string, float>& rPartEntropy)
+{
+	vector<WordInfo> ret;
+	// 점수가 같은 후보들의 순서가 샤드 병합 순서에 따라 바뀌지 않도록 형태로 순서를 정한다.
 	sort(cands.begin(), cands.end(), [](const WordInfo& a, const WordInfo& b)
 	{
-		return a.score > b.score;
+		if (a.score != b.score) return a.score > b.score;
+		return a.form < b.form;
 	});
 
 	vector<utils::TrieNode<char16_t, uint32_t, utils::ConstAccess<map<char16_t, int32_t>>>> trieNodes(1), trieBackNodes(1);
@@ -663,3 +737,408 @@ vector<WordInfo> WordDetector::extractWords(const U16MultipleReader& reader, siz
 
 	return ret;
 }
+
+namespace kiwi
+{
+	namespace
+	{
+		constexpr uint64_t fnvBasis = 0xcbf29ce484222325ull;
+
+		inline uint64_t fnvStep(uint64_t h, char16_t c)
+		{
+			return (h ^ c) * 0x100000001b3ull;
+		}
+
+		inline uint64_t hashForm(const char16_t* first, const char16_t* last)
+		{
+			uint64_t h = fnvBasis;
+			for (; first != last; ++first) h = fnvStep(h, *first);
+			return h;
+		}
+
+		// FNV의 하위 비트는 고르게 분포하지 않으므로 splitmix64로 한 번 더 섞어서 사용한다.
+		inline uint64_t mixHash(uint64_t h, size_t row)
+		{
+			h += (row + 1) * 0x9e3779b97f4a7c15ull;
+			h = (h ^ (h >> 30)) * 0xbf58476d1ce4e5b9ull;
+			h = (h ^ (h >> 27)) * 0x94d049bb133111ebull;
+			return h ^ (h >> 31);
+		}
+
+		/**
+		 * @brief Misra-Gries 요약으로 분기 문자의 빈도를 센다.
+		 * 
+		 * 슬롯이 모두 차 있을 때 새 문자가 나오면 모든 슬롯의 빈도를 1씩 줄이고 0이 된 슬롯을 비운다.
+		 * 따라서 전체의 1/(n+1)보다 자주 나오는 문자는 늦게 나타나더라도 항상 슬롯에 남으며,
+		 * 줄어든 빈도는 branchingEntropy에서 나머지 항으로 계산된다.
+		 */
+		template<size_t n>
+		void addBranch(std::array<std::pair<char16_t, uint32_t>, n>& branches, char16_t c)
+		{
+			std::pair<char16_t, uint32_t>* empty = nullptr;
+			for (auto& p : branches)
+			{
+				if (!p.second)
+				{
+					if (!empty) empty = &p;
+				}
+				else if (p.first == c)
+				{
+					++p.second;
+					return;
+				}
+			}
+			if (empty)
+			{
+				*empty = std::make_pair(c, 1u);
+				return;
+			}
+			for (auto& p : branches) --p.second;
+		}
+
+		template<size_t n, class Ty>
+		void collectBranches(const std::array<std::pair<char16_t, uint32_t>, n>& branches, std::vector<std::pair<Ty, uint32_t>>& out)
+		{
+			out.clear();
+			for (auto& p : branches)
+			{
+				if (p.second) out.emplace_back(p.first, p.second);
+			}
+		}
+	}
+}
+
+StreamingWordDetector::StreamingWordDetector(const WordDetector& _detector, size_t memoryBudget, size_t _maxWordLen, size_t _sketchDepth)
+	: detector{ _detector }, maxWordLen{ _maxWordLen }, sketchDepth{ _sketchDepth }, cntUnigram(0x10000)
+{
+	if (maxWordLen < 2 || maxWordLen > 255)
+	{
+		throw invalid_argument{ "`maxWordLen` must be in range [2, 255]." };
+	}
+	if (sketchDepth < 1 || sketchDepth > 16)
+	{
+		throw invalid_argument{ "`sketchDepth` must be in range [1, 16]." };
+	}
+
+	// 슬롯 배열은 항목 수의 2배 이상인 2의 거듭제곱이므로 항목당 최대 4개의 슬롯을 차지할 수 있다.
+	const size_t fixedBytes = cntUnigram.size() * sizeof(uint32_t);
+	const size_t entryBytes = sizeof(Entry) + maxWordLen * sizeof(char16_t) + 4 * sizeof(uint32_t);
+	const size_t minSketchBits = 10, minEntries = 256;
+	const size_t minBudget = fixedBytes + (sketchDepth << minSketchBits) * sizeof(uint32_t) + minEntries * entryBytes;
+	if (memoryBudget < minBudget)
+	{
+		throw invalid_argument{ "`memoryBudget` is too small. It should be at least " + to_string(minBudget) + " bytes." };
+	}
+
+	// 남은 메모리의 절반 가량을 sketch에, 나머지를 빈발 부분 문자열 목록에 할당한다.
+	const size_t halfBudget = (memoryBudget - fixedBytes) / 2;
+	sketchWidthBits = minSketchBits;
+	while ((sketchDepth << (sketchWidthBits + 1)) * sizeof(uint32_t) <= halfBudget) ++sketchWidthBits;
+	sketch.resize(sketchDepth << sketchWidthBits);
+
+	maxEntries = (memoryBudget - fixedBytes - sketch.size() * sizeof(uint32_t)) / entryBytes;
+	entries.reserve(maxEntries);
+	forms.resize(maxEntries * maxWordLen);
+	size_t numSlots = 1;
+	while (numSlots < maxEntries * 2) numSlots *= 2;
+	slots.resize(numSlots);
+}
+
+uint32_t StreamingWordDetector::updateSketch(uint64_t key)
+{
+	// conservative update: 최솟값을 갖는 칸만 증가시켜 과대 추정을 줄인다.
+	const size_t shift = 64 - sketchWidthBits;
+	uint32_t est = numeric_limits<uint32_t>::max();
+	for (size_t r = 0; r < sketchDepth; ++r)
+	{
+		est = min(est, sketch[(r << sketchWidthBits) + (mixHash(key, r) >> shift)]);
+	}
+	if (est == numeric_limits<uint32_t>::max()) return est;
+	++est;
+	for (size_t r = 0; r < sketchDepth; ++r)
+	{
+		auto& v = sketch[(r << sketchWidthBits) + (mixHash(key, r) >> shift)];
+		if (v < est) v = est;
+	}
+	return est;
+}
+
+uint32_t StreamingWordDetector::querySketch(uint64_t key) const
+{
+	const size_t shift = 64 - sketchWidthBits;
+	uint32_t est = numeric_limits<uint32_t>::max();
+	for (size_t r = 0; r < sketchDepth; ++r)
+	{
+		est = min(est, sketch[(r << sketchWidthBits) + (mixHash(key, r) >> shift)]);
+	}
+	return est;
+}
+
+uint32_t StreamingWordDetector::countOf(const char16_t* first, const char16_t* last) const
+{
+	if (last - first == 1) return cntUnigram[*first];
+	return querySketch(hashForm(first, last));
+}
+
+size_t StreamingWordDetector::findEntry(uint64_t key, const char16_t* form, size_t len) const
+{
+	const size_t mask = slots.size() - 1;
+	for (size_t pos = mixHash(key, sketchDepth) & mask; ; pos = (pos + 1) & mask)
+	{
+		const uint32_t s = slots[pos];
+		if (!s) return -1;
+		auto& e = entries[s - 1];
+		if (e.key == key && e.len == len && equal(form, form + len, &forms[(s - 1) * maxWordLen])) return s - 1;
+	}
+}
+
+void StreamingWordDetector::rebuildSlots()
+{
+	fill(slots.begin(), slots.end(), 0);
+	const size_t mask = slots.size() - 1;
+	for (size_t i = 0; i < entries.size(); ++i)
+	{
+		size_t pos = mixHash(entries[i].key, sketchDepth) & mask;
+		while (slots[pos]) pos = (pos + 1) & mask;
+		slots[pos] = (uint32_t)(i + 1);
+	}
+}
+
+void StreamingWordDetector::prune()
+{
+	// 빈도가 높은 절반만 남기고, 이후에는 버려진 항목보다 빈도가 높은 부분 문자열만 새로 추적한다.
+	const size_t keep = maxEntries / 2;
+	if (entries.size() <= keep) return;
+	vector<uint32_t> order(entries.size());
+	iota(order.begin(), order.end(), 0);
+	nth_element(order.begin(), order.begin() + keep, order.end(), [&](uint32_t a, uint32_t b)
+	{
+		return entries[a].cnt > entries[b].cnt;
+	});
+	admitThreshold = max(admitThreshold, entries[order[keep]].cnt + 1);
+	order.resize(keep);
+	sort(order.begin(), order.end());
+	for (size_t i = 0; i < keep; ++i)
+	{
+		if (order[i] == i) continue;
+		entries[i] = entries[order[i]];
+		copy_n(&forms[order[i] * maxWordLen], entries[i].len, &forms[i * maxWordLen]);
+	}
+	entries.resize(keep);
+	rebuildSlots();
+	++numPrunes;
+}
+
+void StreamingWordDetector::observe(uint64_t key, const char16_t* form, size_t len, uint32_t estimate, char16_t left, char16_t right)
+{
+	size_t idx = findEntry(key, form, len);
+	if (idx == (size_t)-1)
+	{
+		if (estimate < admitThreshold) return;
+		if (entries.size() >= maxEntries)
+		{
+			prune();
+			if (estimate < admitThreshold) return;
+		}
+		idx = entries.size();
+		entries.emplace_back();
+		auto& e = entries.back();
+		e.key = key;
+		e.len = (uint8_t)len;
+		e.cnt = estimate - 1;
+		copy_n(form, len, &forms[idx * maxWordLen]);
+
+		const size_t mask = slots.size() - 1;
+		size_t pos = mixHash(key, sketchDepth) & mask;
+		while (slots[pos]) pos = (pos + 1) & mask;
+		slots[pos] = (uint32_t)(idx + 1);
+	}
+
+	auto& e = entries[idx];
+	if (e.cnt < numeric_limits<uint32_t>::max()) ++e.cnt;
+	++e.observed;
+	// 사전에 없는 문자(0)는 batch 모드와 마찬가지로 분기에서 제외한다.
+	if (left) addBranch(e.lefts, left);
+	if (right) addBranch(e.rights, right);
+}
+
+void StreamingWordDetector::processWord(u16string::const_iterator first, u16string::const_iterator last)
+{
+	auto& buf = wordBuf;
+	buf.clear();
+	buf.push_back(1); // Begin Chr
+	for (; first != last; ++first)
+	{
+		const char16_t c = *first;
+		if (cntUnigram[c] < numeric_limits<uint32_t>::max()) ++cntUnigram[c];
+		buf.push_back(c < 3 ? 0 : c);
+	}
+	buf.push_back(2); // End Chr
+
+	const size_t maxLen = max(min(maxWordLen, (size_t)3), maxWordLen - 1);
+	for (size_t i = 1; i + 1 < buf.size(); ++i)
+	{
+		uint64_t h = fnvBasis;
+		for (size_t j = i; j + 1 < buf.size() && j - i < maxLen; ++j)
+		{
+			const char16_t c = buf[j];
+			if (c < 3) break;
+			h = fnvStep(h, c);
+			const size_t len = j - i + 1;
+			const uint32_t est = len == 1 ? cntUnigram[c] : updateSketch(h);
+			observe(h, &buf[i], len, est, buf[i - 1], buf[j + 1]);
+		}
+	}
+}
+
+vector<WordInfo> StreamingWordDetector::extract(size_t minCnt, float minScore, bool onlyNew)
+{
+	vector<WordInfo> cands;
+	map<u16string, float> rPartEntropy;
+	vector<pair<uint16_t, uint32_t>> lNexts, rNexts;
+	vector<pair<char16_t, uint32_t>> rChrs;
+	for (size_t i = 0; i < entries.size(); ++i)
+	{
+		auto& e = entries[i];
+		if (e.cnt < minCnt || !e.observed) continue;
+		const char16_t* w = &forms[i * maxWordLen];
+		const size_t len = e.len;
+
+		// 분기 분포는 추적을 시작한 뒤의 출현만을 대상으로 하므로 전체 합으로 observed를 사용한다.
+		collectBranches(e.lefts, lNexts);
+		if (len <= 3)
+		{
+			float en = detector.branchingEntropy(lNexts, e.observed, minCnt);
+			if (en >= 1 && none_of(w, w + len, isalnum16))
+			{
+				rPartEntropy[u16string{ make_reverse_iterator(w + len), make_reverse_iterator(w) }] = en;
+			}
+		}
+		if (len <= 1 || len >= maxWordLen) continue;
+
+		// sketch는 과대 추정만 하므로 부분 문자열의 빈도가 단어 자신의 빈도보다 작아지지 않도록 한다.
+		const uint32_t cnt = e.cnt;
+		float forwardCohesion, backwardCohesion;
+		tie(forwardCohesion, backwardCohesion) = computeCohesion(w, len, cnt,
+			[&](char16_t c) { return max(cntUnigram[c], cnt); },
+			[&](const char16_t* f, const char16_t* l) { return max(countOf(f, l), cnt); }
+		);
+
+		collectBranches(e.rights, rNexts);
+		float forwardBranch = detector.branchingEntropy(rNexts, e.observed, 6);
+		float backwardBranch = detector.branchingEntropy(lNexts, e.observed, 6);
+
+		float score = forwardCohesion * backwardCohesion * forwardBranch * backwardBranch;
+		if (score < minScore) continue;
+		u16string form{ w, w + len };
+		collectBranches(e.rights, rChrs);
+		auto posScore = detector.getPosScore(rChrs, e.observed, hasCoda(form.back()), form);
+		cands.emplace_back(move(form), score, backwardBranch, forwardBranch, backwardCohesion, forwardCohesion,
+			cnt, move(posScore));
+	}
+
+	auto ret = filterCandidates(cands, rPartEntropy);
+	if (!onlyNew) return ret;
+
+	ret.erase(remove_if(ret.begin(), ret.end(), [&](const WordInfo& r)
+	{
+		const size_t idx = findEntry(hashForm(r.form.data(), r.form.data() + r.form.size()), r.form.data(), r.form.size());
+		if (idx == (size_t)-1) return false;
+		if (entries[idx].emitted) return true;
+		entries[idx].emitted = true;
+		return false;
+	}), ret.end());
+	return ret;
+}
+
+void StreamingWordDetector::add(const u16string& text)
+{
+	vector<WordInfo> emitted;
+	Emitter fn;
+	{
+		lock_guard<mutex> lock{ mtx };
+		SpaceSplitIterator begin{ text.begin(), text.end() }, end;
+		for (; begin != end; ++begin)
+		{
+			processWord(begin.strBegin(), begin.strEnd());
+		}
+		numProcessed += text.size();
+
+		if (emitInterval && numProcessed >= nextEmit)
+		{
+			nextEmit = numProcessed + emitInterval;
+			emitted = extract(emitMinCnt, emitMinScore, true);
+			if (!emitted.empty()) fn = emitter;
+		}
+	}
+	// emitter 안에서 다시 이 객체를 호출할 수 있도록 잠금을 푼 뒤에 호출한다.
+	if (fn) fn(move(emitted));
+}
+
+vector<WordInfo> StreamingWordDetector::extractWords(size_t minCnt, float minScore, bool onlyNew)
+{
+	lock_guard<mutex> lock{ mtx };
+	return extract(minCnt, minScore, onlyNew);
+}
+
+void StreamingWordDetector::setEmitter(size_t interval, size_t minCnt, float minScore, Emitter _emitter)
+{
+	lock_guard<mutex> lock{ mtx };
+	emitInterval = interval;
+	emitMinCnt = minCnt;
+	emitMinScore = minScore;
+	emitter = move(_emitter);
+	nextEmit = numProcessed + interval;
+}
+
+void StreamingWordDetector::decay(float factor)
+{
+	if (!(factor > 0 && factor <= 1))
+	{
+		throw invalid_argument{ "`factor` must be in range (0, 1]." };
+	}
+	if (factor == 1) return;
+
+	lock_guard<mutex> lock{ mtx };
+	const auto scale = [&](uint32_t& v) { v = (uint32_t)(v * factor); };
+	for_each(sketch.begin(), sketch.end(), scale);
+	for_each(cntUnigram.begin(), cntUnigram.end(), scale);
+	admitThreshold = max((uint32_t)(admitThreshold * factor), (uint32_t)2);
+
+	size_t n = 0;
+	for (size_t i = 0; i < entries.size(); ++i)
+	{
+		auto e = entries[i];
+		scale(e.cnt);
+		if (!e.cnt) continue;
+		scale(e.observed);
+		for (auto& p : e.lefts) scale(p.second);
+		for (auto& p : e.rights) scale(p.second);
+		if (n != i) copy_n(&forms[i * maxWordLen], e.len, &forms[n * maxWordLen]);
+		entries[n++] = e;
+	}
+	entries.resize(n);
+	rebuildSlots();
+}
+
+size_t StreamingWordDetector::numProcessedChars() const
+{
+	lock_guard<mutex> lock{ mtx };
+	return numProcessed;
+}
+
+size_t StreamingWordDetector::numTrackedForms() const
+{
+	lock_guard<mutex> lock{ mtx };
+	return entries.size();
+}
+
+size_t StreamingWordDetector::memoryUsage() const
+{
+	lock_guard<mutex> lock{ mtx };
+	return sketch.size() * sizeof(uint32_t)
+		+ cntUnigram.size() * sizeof(uint32_t)
+		+ entries.capacity() * sizeof(Entry)
+		+ forms.size() * sizeof(char16_t)
+		+ slots.size() * sizeof(uint32_t);
+}
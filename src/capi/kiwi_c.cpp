@@ -1,4 +1,7 @@
 #include <cmath>
+#include <atomic>
+#include <cstring>
+#include <limits>
 #include <memory>
 #include <fstream>
 #include <sstream>
@@ -17,9 +20,20 @@ const char* kiwi_version()
 	return KIWI_VERSION_STRING;
 }
 
+struct FlatTokens
+{
+	vector<uint32_t> chrPositions, wordPositions, sentPositions, morphIds, formOffsets;
+	vector<uint16_t> lengths;
+	vector<uint8_t> tags;
+	vector<float> scores, typoCosts;
+	string forms;
+	bool built = false;
+};
+
 struct ResultBuffer
 {
 	vector<string> stringBuf;
+	vector<FlatTokens> flatBuf;
 };
 
 struct kiwi_res : public pair<vector<TokenResult>, ResultBuffer>
@@ -44,10 +58,31 @@ struct kiwi_joiner : public tuple<cmb::AutoJoiner, string, u16string>
 	using tuple<cmb::AutoJoiner, string, u16string>::tuple;
 };
 
+struct kiwi_joined : public cmb::JoinedBatch
+{
+	kiwi_joined(cmb::JoinedBatch&& o) : cmb::JoinedBatch{ std::move(o) }
+	{
+	}
+};
+
 struct kiwi_typo : public TypoTransformer
 {
 };
 
+struct kiwi_ticket
+{
+	enum { pending, running, cancelled, done };
+
+	atomic<int> state{ pending };
+	// kiwi_analyze_async의 호출자와 스레드풀의 작업이 함께 소유하며, 둘 다 놓으면 해제된다.
+	atomic<int> refCount{ 2 };
+
+	void release()
+	{
+		if (--refCount == 0) delete this;
+	}
+};
+
 struct kiwi_prepared_typo : public PreparedTypoTransformer
 {
 };
@@ -124,6 +159,8 @@ kiwi_builder_h kiwi_builder_init(const char* model_path, int num_threads, int op
 			: (mtMask == KIWI_BUILD_MODEL_TYPE_SBG) ? ModelType::sbg
 			: (mtMask == KIWI_BUILD_MODEL_TYPE_CONG) ? ModelType::cong
 			: (mtMask == KIWI_BUILD_MODEL_TYPE_CONG_GLOBAL) ? ModelType::congGlobal
+			: (mtMask == KIWI_BUILD_MODEL_TYPE_CONG_Q4) ? ModelType::congQ4
+			: (mtMask == KIWI_BUILD_MODEL_TYPE_CONG_GLOBAL_Q4) ? ModelType::congGlobalQ4
 			: ModelType::none;
 		return (kiwi_builder_h)new KiwiBuilder{ model_path, (size_t)num_threads, buildOption, modelType, (Dialect)enabled_dialects };
 	}
@@ -218,6 +255,8 @@ kiwi_builder_h kiwi_builder_init_stream(kiwi_stream_object_t (*stream_object_fac
 			: (mtMask == KIWI_BUILD_MODEL_TYPE_SBG) ? ModelType::sbg
 			: (mtMask == KIWI_BUILD_MODEL_TYPE_CONG) ? ModelType::cong
 			: (mtMask == KIWI_BUILD_MODEL_TYPE_CONG_GLOBAL) ? ModelType::congGlobal
+			: (mtMask == KIWI_BUILD_MODEL_TYPE_CONG_Q4) ? ModelType::congQ4
+			: (mtMask == KIWI_BUILD_MODEL_TYPE_CONG_GLOBAL_Q4) ? ModelType::congGlobalQ4
 			: ModelType::none;
 		
 		// Create C++ StreamProvider that uses the stream object factory
@@ -725,6 +764,8 @@ kiwi_h kiwi_init(const char * modelPath, int num_threads, int options, int enabl
 			: (mtMask == KIWI_BUILD_MODEL_TYPE_SBG) ? ModelType::sbg
 			: (mtMask == KIWI_BUILD_MODEL_TYPE_CONG) ? ModelType::cong
 			: (mtMask == KIWI_BUILD_MODEL_TYPE_CONG_GLOBAL) ? ModelType::congGlobal
+			: (mtMask == KIWI_BUILD_MODEL_TYPE_CONG_Q4) ? ModelType::congQ4
+			: (mtMask == KIWI_BUILD_MODEL_TYPE_CONG_GLOBAL_Q4) ? ModelType::congGlobalQ4
 			: ModelType::none;
 		return (kiwi_h)new Kiwi{ KiwiBuilder{ modelPath, (size_t)num_threads, buildOption, modelType, (Dialect)enabled_dialects }.build() };
 	}
@@ -970,6 +1011,172 @@ int kiwi_analyze_m(kiwi_h handle, kiwi_reader_t reader, kiwi_receiver_t receiver
 	}
 }
 
+inline BulkAnalyzeOption toBulkAnalyzeOption(kiwi_bulk_option_t option)
+{
+	return BulkAnalyzeOption{
+		(size_t)max(option.max_in_flight, 0),
+		(size_t)max(option.max_batch_size, 1),
+		(size_t)max(option.max_batch_chars, 0),
+		!!option.ordered
+	};
+}
+
+int kiwi_analyze_bulk_w(kiwi_h handle, kiwi_reader_w_t reader, kiwi_receiver_t receiver, void* userData, int top_n, kiwi_analyze_option_t option, kiwi_bulk_option_t bulk_option)
+{
+	if (!handle) return KIWIERR_INVALID_HANDLE;
+	Kiwi* kiwi = (Kiwi*)handle;
+	try
+	{
+		int reader_idx = 0;
+		kiwi->analyzeBulk(top_n, [&]() -> u16string
+		{
+			u16string buf;
+			buf.resize((*reader)(reader_idx, nullptr, userData));
+			if (buf.empty()) return {};
+			(*reader)(reader_idx++, (kchar16_t*)&buf[0], userData);
+			return buf;
+		}, [&](size_t idx, vector<TokenResult>&& res)
+		{
+			auto result = new kiwi_res{ std::move(res), {} };
+			(*receiver)((int)idx, result, userData);
+		}, toAnalyzeOption(option), toBulkAnalyzeOption(bulk_option));
+		return reader_idx;
+	}
+	catch (...)
+	{
+		currentError = current_exception();
+		return KIWIERR_FAIL;
+	}
+}
+
+int kiwi_analyze_bulk(kiwi_h handle, kiwi_reader_t reader, kiwi_receiver_t receiver, void* userData, int top_n, kiwi_analyze_option_t option, kiwi_bulk_option_t bulk_option)
+{
+	if (!handle) return KIWIERR_INVALID_HANDLE;
+	Kiwi* kiwi = (Kiwi*)handle;
+	try
+	{
+		int reader_idx = 0;
+		kiwi->analyzeBulk(top_n, [&]() -> u16string
+		{
+			string buf;
+			buf.resize((*reader)(reader_idx, nullptr, userData));
+			if (buf.empty()) return {};
+			(*reader)(reader_idx++, &buf[0], userData);
+			return utf8To16(buf);
+		}, [&](size_t idx, vector<TokenResult>&& res)
+		{
+			auto result = new kiwi_res{ std::move(res), {} };
+			(*receiver)((int)idx, result, userData);
+		}, toAnalyzeOption(option), toBulkAnalyzeOption(bulk_option));
+		return reader_idx;
+	}
+	catch (...)
+	{
+		currentError = current_exception();
+		return KIWIERR_FAIL;
+	}
+}
+
+template<class Str>
+inline kiwi_ticket_h analyzeAsync(kiwi_h handle, Str&& text, int top_n, kiwi_analyze_option_t option, kiwi_pretokenized_h pretokenized, kiwi_async_callback_t callback, void* userData)
+{
+	Kiwi* kiwi = (Kiwi*)handle;
+	auto* pool = kiwi->getThreadPool();
+	if (!pool) throw Exception{ "`kiwi_analyze_async` doesn't work at single thread mode." };
+
+	auto* ticket = new kiwi_ticket;
+	try
+	{
+		pool->enqueue([=, 
+			text = forward<Str>(text), 
+			pt = pretokenized ? *pretokenized : vector<PretokenizedSpan>{}](size_t)
+		{
+			kiwi_res_h result = nullptr;
+			int status = 0;
+			int expected = kiwi_ticket::pending;
+			if (ticket->state.compare_exchange_strong(expected, kiwi_ticket::running))
+			{
+				try
+				{
+					result = new kiwi_res{ kiwi->analyze(text, top_n, toAnalyzeOption(option), pt), {} };
+				}
+				catch (...)
+				{
+					currentError = current_exception();
+					status = KIWIERR_FAIL;
+				}
+
+				// 분석 도중에 취소된 경우 결과를 버린다.
+				expected = kiwi_ticket::running;
+				if (!ticket->state.compare_exchange_strong(expected, kiwi_ticket::done))
+				{
+					delete result;
+					result = nullptr;
+					status = KIWIERR_CANCELLED;
+				}
+			}
+			else
+			{
+				status = KIWIERR_CANCELLED;
+			}
+			(*callback)(ticket, result, status, userData);
+			ticket->release();
+		});
+	}
+	catch (...)
+	{
+		delete ticket;
+		throw;
+	}
+	return ticket;
+}
+
+kiwi_ticket_h kiwi_analyze_async_w(kiwi_h handle, const kchar16_t* text, int top_n, kiwi_analyze_option_t option, kiwi_pretokenized_h pretokenized, kiwi_async_callback_t callback, void* userData)
+{
+	if (!handle || !callback) return nullptr;
+	try
+	{
+		return analyzeAsync(handle, u16string{ (const char16_t*)text }, top_n, option, pretokenized, callback, userData);
+	}
+	catch (...)
+	{
+		currentError = current_exception();
+		return nullptr;
+	}
+}
+
+kiwi_ticket_h kiwi_analyze_async(kiwi_h handle, const char* text, int top_n, kiwi_analyze_option_t option, kiwi_pretokenized_h pretokenized, kiwi_async_callback_t callback, void* userData)
+{
+	if (!handle || !callback) return nullptr;
+	try
+	{
+		return analyzeAsync(handle, string{ text }, top_n, option, pretokenized, callback, userData);
+	}
+	catch (...)
+	{
+		currentError = current_exception();
+		return nullptr;
+	}
+}
+
+int kiwi_cancel(kiwi_ticket_h ticket)
+{
+	if (!ticket) return KIWIERR_INVALID_HANDLE;
+	int expected = ticket->state.load();
+	while (expected == kiwi_ticket::pending || expected == kiwi_ticket::running)
+	{
+		if (ticket->state.compare_exchange_weak(expected, kiwi_ticket::cancelled)) return 0;
+	}
+	return expected == kiwi_ticket::cancelled ? 0 : 1;
+}
+
+int kiwi_ticket_close(kiwi_ticket_h ticket)
+{
+	if (!ticket) return KIWIERR_INVALID_HANDLE;
+	ticket->release();
+	return 0;
+}
+
 kiwi_ss_h kiwi_split_into_sents_w(kiwi_h handle, const kchar16_t* text, int matchOptions, kiwi_res_h* tokenized_res)
 {
 	if (!handle) return nullptr;
@@ -1023,6 +1230,27 @@ DECL_DLL kiwi_joiner_h kiwi_new_joiner(kiwi_h handle, int lm_search)
 	}
 }
 
+kiwi_joined_h kiwi_join_batch(kiwi_h handle, const int* morph_ids, const int* seq_sizes, int batch_size, int lm_search)
+{
+	if (!handle) return nullptr;
+	Kiwi* kiwi = (Kiwi*)handle;
+	try
+	{
+		if (batch_size < 0) throw invalid_argument{ "`batch_size` should be >= 0." };
+		for (int i = 0; i < batch_size; ++i)
+		{
+			if (seq_sizes[i] < 0) throw invalid_argument{ "`seq_sizes` should be >= 0." };
+		}
+		// 음수인 형태소 ID는 부호 없는 값으로 변환되어 범위 검사에서 걸러진다.
+		return new kiwi_joined{ kiwi->joinBatch((const uint32_t*)morph_ids, (const uint32_t*)seq_sizes, batch_size, !!lm_search) };
+	}
+	catch (...)
+	{
+		currentError = current_exception();
+		return nullptr;
+	}
+}
+
 int kiwi_close(kiwi_h handle)
 {
 	if (!handle) return KIWIERR_INVALID_HANDLE;
@@ -1269,6 +1497,122 @@ float kiwi_res_typo_cost(kiwi_res_h result, int index, int num)
 	}
 }
 
+// tokens의 정보를 out의 배열들에 채우고, 형태들을 UTF-8로 변환하여 이어 붙인 문자열을 forms에 저장한다.
+inline void flattenTokens(const vector<TokenInfo>& tokens, const Kiwi* kiwi, const kiwi_token_flat_t& out, string& forms)
+{
+	// 형태소마다 따로 변환하지 않도록 모든 형태를 이어 붙인 뒤 한 번에 변환한다.
+	thread_local u16string joined;
+	joined.clear();
+	uint32_t offset = 0;
+	for (size_t i = 0; i < tokens.size(); ++i)
+	{
+		auto& t = tokens[i];
+		if (out.chr_positions) out.chr_positions[i] = t.position;
+		if (out.lengths) out.lengths[i] = t.length;
+		if (out.word_positions) out.word_positions[i] = t.wordPosition;
+		if (out.sent_positions) out.sent_positions[i] = t.sentPosition;
+		if (out.tags) out.tags[i] = (uint8_t)t.tag;
+		if (out.morph_ids) out.morph_ids[i] = kiwi->morphToId(t.morph);
+		if (out.scores) out.scores[i] = t.score;
+		if (out.typo_costs) out.typo_costs[i] = t.typoCost;
+		if (out.form_offsets)
+		{
+			out.form_offsets[i] = offset;
+			for (auto c : t.str)
+			{
+				// 서로게이트 쌍은 각각 2바이트씩, 합쳐서 4바이트로 인코딩된다.
+				offset += c < 0x80 ? 1 : (c < 0x800 || (0xD800 <= c && c < 0xE000)) ? 2 : 3;
+			}
+		}
+		joined += t.str;
+	}
+	forms = utf16To8(joined);
+	if (out.form_offsets) out.form_offsets[tokens.size()] = forms.size();
+}
+
+int kiwi_res_export(kiwi_res_h result, int index, kiwi_token_flat_t* out, char* strbuf, int strbuf_size, kiwi_h kiwi_handle)
+{
+	if (!result || !out) return KIWIERR_INVALID_HANDLE;
+	if (out->morph_ids && !kiwi_handle) return KIWIERR_INVALID_HANDLE;
+	try
+	{
+		if (index < 0 || index >= result->first.size()) return KIWIERR_INVALID_INDEX;
+		if (strbuf_size < 0) return KIWIERR_INVALID_INDEX;
+		thread_local string forms;
+		flattenTokens(result->first[index].first, (const Kiwi*)kiwi_handle, *out, forms);
+		const size_t required = forms.size() + 1;
+		if (required > (size_t)numeric_limits<int>::max()) throw runtime_error{ "The exported forms are too long." };
+		if (strbuf && required <= (size_t)strbuf_size)
+		{
+			memcpy(strbuf, forms.c_str(), required);
+		}
+		return (int)required;
+	}
+	catch (...)
+	{
+		currentError = current_exception();
+		return KIWIERR_FAIL;
+	}
+}
+
+int kiwi_res_export_view(kiwi_res_h result, int index, kiwi_token_flat_t* out, const char** strbuf, kiwi_h kiwi_handle)
+{
+	if (!result || !out) return KIWIERR_INVALID_HANDLE;
+	try
+	{
+		if (index < 0 || index >= result->first.size()) return KIWIERR_INVALID_INDEX;
+		auto& tokens = result->first[index].first;
+		auto& flatBuf = result->second.flatBuf;
+		if (flatBuf.size() < result->first.size()) flatBuf.resize(result->first.size());
+		auto& flat = flatBuf[index];
+		const size_t n = tokens.size();
+		if (!flat.built)
+		{
+			flat.chrPositions.resize(n);
+			flat.lengths.resize(n);
+			flat.wordPositions.resize(n);
+			flat.sentPositions.resize(n);
+			flat.tags.resize(n);
+			flat.scores.resize(n);
+			flat.typoCosts.resize(n);
+			flat.formOffsets.resize(n + 1);
+			kiwi_token_flat_t filled{
+				flat.chrPositions.data(), flat.lengths.data(), flat.wordPositions.data(), flat.sentPositions.data(),
+				flat.tags.data(), nullptr, flat.scores.data(), flat.typoCosts.data(),
+				flat.formOffsets.data(),
+			};
+			flattenTokens(tokens, nullptr, filled, flat.forms);
+			flat.built = true;
+		}
+		// 형태소 ID는 Kiwi 핸들이 있어야 구할 수 있으므로 처음 요청될 때 따로 채운다. 이미 반환된 다른 포인터들은 그대로 유효하다.
+		if (kiwi_handle && flat.morphIds.size() < n)
+		{
+			flat.morphIds.resize(n);
+			for (size_t i = 0; i < n; ++i)
+			{
+				flat.morphIds[i] = ((const Kiwi*)kiwi_handle)->morphToId(tokens[i].morph);
+			}
+		}
+
+		out->chr_positions = flat.chrPositions.data();
+		out->lengths = flat.lengths.data();
+		out->word_positions = flat.wordPositions.data();
+		out->sent_positions = flat.sentPositions.data();
+		out->tags = flat.tags.data();
+		out->morph_ids = kiwi_handle ? flat.morphIds.data() : nullptr;
+		out->scores = flat.scores.data();
+		out->typo_costs = flat.typoCosts.data();
+		out->form_offsets = flat.formOffsets.data();
+		if (strbuf) *strbuf = flat.forms.c_str();
+		return (int)tokens.size();
+	}
+	catch (...)
+	{
+		currentError = current_exception();
+		return KIWIERR_FAIL;
+	}
+}
+
 int kiwi_res_close(kiwi_res_h result)
 {
 	if (!result) return KIWIERR_INVALID_HANDLE;
@@ -1419,6 +1763,46 @@ int kiwi_cong_most_similar_words(kiwi_h handle, unsigned int morph_id, kiwi_simi
 	}
 }
 
+int kiwi_cong_most_similar_words_batch(kiwi_h handle, const unsigned int* morph_ids, int size, kiwi_similarity_pair_t* output, int top_n, int* output_sizes)
+{
+	if (!handle) return KIWIERR_INVALID_HANDLE;
+	try
+	{
+		if (size < 0 || top_n < 0) throw invalid_argument{ "`size` and `top_n` must not be negative." };
+		Kiwi* kiwi = (Kiwi*)handle;
+		auto cong = dynamic_cast<const lm::CoNgramModelBase*>(kiwi->getLangModel());
+		if (!cong) throw invalid_argument{ "The given kiwi object does not have CoNgram language model." };
+		vector<size_t> sizes(size);
+		cong->mostSimilarWordsBatch(morph_ids, size, top_n, (pair<uint32_t, float>*)output, sizes.data());
+		copy(sizes.begin(), sizes.end(), output_sizes);
+		return 0;
+	}
+	catch (...)
+	{
+		currentError = current_exception();
+		return KIWIERR_FAIL;
+	}
+}
+
+int kiwi_cong_set_similarity_index(kiwi_h handle, int num_probes, int num_lists)
+{
+	if (!handle) return KIWIERR_INVALID_HANDLE;
+	try
+	{
+		if (num_probes < 0 || num_lists < 0) throw invalid_argument{ "`num_probes` and `num_lists` must not be negative." };
+		Kiwi* kiwi = (Kiwi*)handle;
+		auto cong = dynamic_cast<const lm::CoNgramModelBase*>(kiwi->getLangModel());
+		if (!cong) throw invalid_argument{ "The given kiwi object does not have CoNgram language model." };
+		cong->setSimilarityIndex(num_probes, num_lists);
+		return 0;
+	}
+	catch (...)
+	{
+		currentError = current_exception();
+		return KIWIERR_FAIL;
+	}
+}
+
 float kiwi_cong_similarity(kiwi_h handle, unsigned int morph_id1, unsigned int morph_id2)
 {
 	if (!handle) return NAN;
@@ -1489,6 +1873,27 @@ int kiwi_cong_predict_words_from_context(kiwi_h handle, unsigned int context_id,
 	}
 }
 
+int kiwi_cong_predict_words_from_context_batch(kiwi_h handle, const unsigned int* context_ids, int size, kiwi_similarity_pair_t* output, int top_n, int* output_sizes)
+{
+	if (!handle) return KIWIERR_INVALID_HANDLE;
+	try
+	{
+		if (size < 0 || top_n < 0) throw invalid_argument{ "`size` and `top_n` must not be negative." };
+		Kiwi* kiwi = (Kiwi*)handle;
+		auto cong = dynamic_cast<const lm::CoNgramModelBase*>(kiwi->getLangModel());
+		if (!cong) throw invalid_argument{ "The given kiwi object does not have CoNgram language model." };
+		vector<size_t> sizes(size);
+		cong->predictWordsFromContextBatch(context_ids, size, top_n, (pair<uint32_t, float>*)output, sizes.data());
+		copy(sizes.begin(), sizes.end(), output_sizes);
+		return 0;
+	}
+	catch (...)
+	{
+		currentError = current_exception();
+		return KIWIERR_FAIL;
+	}
+}
+
 int kiwi_cong_predict_words_from_context_diff(kiwi_h handle, unsigned int context_id, unsigned int bg_context_id, float weight, kiwi_similarity_pair_t* output, int top_n)
 {
 	if (!handle) return KIWIERR_INVALID_HANDLE;
@@ -1776,6 +2181,94 @@ int kiwi_joiner_close(kiwi_joiner_h handle)
 	}
 }
 
+int kiwi_joined_size(kiwi_joined_h handle)
+{
+	if (!handle) return KIWIERR_INVALID_HANDLE;
+	try
+	{
+		return handle->size();
+	}
+	catch (...)
+	{
+		currentError = current_exception();
+		return KIWIERR_FAIL;
+	}
+}
+
+const kchar16_t* kiwi_joined_text_w(kiwi_joined_h handle, int* text_size)
+{
+	if (!handle) return nullptr;
+	try
+	{
+		if (text_size) *text_size = handle->text.size();
+		return (const kchar16_t*)handle->text.c_str();
+	}
+	catch (...)
+	{
+		currentError = current_exception();
+		return nullptr;
+	}
+}
+
+const uint32_t* kiwi_joined_offsets(kiwi_joined_h handle)
+{
+	if (!handle) return nullptr;
+	try
+	{
+		return handle->textOffsets.data();
+	}
+	catch (...)
+	{
+		currentError = current_exception();
+		return nullptr;
+	}
+}
+
+const uint32_t* kiwi_joined_ranges(kiwi_joined_h handle, int* num_ranges)
+{
+	if (!handle) return nullptr;
+	try
+	{
+		static_assert(sizeof(pair<uint32_t, uint32_t>) == sizeof(uint32_t) * 2, "pair<uint32_t, uint32_t> should be packed.");
+		if (num_ranges) *num_ranges = handle->ranges.size();
+		return (const uint32_t*)handle->ranges.data();
+	}
+	catch (...)
+	{
+		currentError = current_exception();
+		return nullptr;
+	}
+}
+
+const uint32_t* kiwi_joined_range_offsets(kiwi_joined_h handle)
+{
+	if (!handle) return nullptr;
+	try
+	{
+		return handle->rangeOffsets.data();
+	}
+	catch (...)
+	{
+		currentError = current_exception();
+		return nullptr;
+	}
+}
+
+int kiwi_joined_close(kiwi_joined_h handle)
+{
+	if (!handle) return KIWIERR_INVALID_HANDLE;
+	try
+	{
+		delete handle;
+		return 0;
+	}
+	catch (...)
+	{
+		currentError = current_exception();
+		return KIWIERR_FAIL;
+	}
+}
+
 int kiwi_morphset_add(kiwi_morphset_h handle, const char* form, const char* tag)
 {
 	if (!handle) return KIWIERR_INVALID_HANDLE;
@@ -1831,7 +2324,13 @@ kiwi_swtokenizer_h kiwi_swt_init(const char* path, kiwi_h kiwi)
 	try
 	{
 		std::ifstream ifs;
-		return new kiwi_swtokenizer{ SwTokenizer::load(*(Kiwi*)kiwi, openFile(ifs, path)) };
+		auto& istr = openFile(ifs, path, ios_base::binary);
+		if (SwTokenizer::isBinaryFormat(istr))
+		{
+			ifs.close();
+			return new kiwi_swtokenizer{ SwTokenizer::loadBinary(*(Kiwi*)kiwi, std::string{ path }) };
+		}
+		return new kiwi_swtokenizer{ SwTokenizer::load(*(Kiwi*)kiwi, istr) };
 	}
 	catch (...)
 	{
@@ -1840,6 +2339,22 @@ kiwi_swtokenizer_h kiwi_swt_init(const char* path, kiwi_h kiwi)
 	}
 }
 
+int kiwi_swt_save_binary(kiwi_swtokenizer_h handle, const char* path)
+{
+	if (!handle || !path) return KIWIERR_INVALID_HANDLE;
+	try
+	{
+		std::ofstream ofs;
+		handle->tokenizer.saveBinary(openFile(ofs, path, ios_base::binary));
+		return 0;
+	}
+	catch (...)
+	{
+		currentError = current_exception();
+		return KIWIERR_FAIL;
+	}
+}
+
 int kiwi_swt_encode(kiwi_swtokenizer_h handle, const char* text, int text_size, int* token_ids, int token_ids_buf_size, int* offsets, int offset_buf_size)
 {
 	if (!handle || !text) return KIWIERR_INVALID_HANDLE;
@@ -1926,6 +2441,39 @@ int kiwi_swt_decode(kiwi_swtokenizer_h handle, const int* token_ids, int token_s
 	}
 }
 
+template<class IntTy>
+inline int swtEncodeBatch(kiwi_swtokenizer_h handle, const char** texts, const int* text_sizes, int batch_size, kiwi_swt_batch_option_t option, IntTy* token_ids, IntTy* attention_mask, IntTy* offsets, IntTy* lengths)
+{
+	if (!handle || !texts || !token_ids) return KIWIERR_INVALID_HANDLE;
+	if (batch_size < 0 || option.max_length <= 0) return KIWIERR_INVALID_INDEX;
+	try
+	{
+		vector<string> strs(batch_size);
+		for (int i = 0; i < batch_size; ++i)
+		{
+			strs[i] = (text_sizes && text_sizes[i] >= 0) ? string{ texts[i], texts[i] + text_sizes[i] } : string{ texts[i] };
+		}
+		SwBatchEncodeOption batchOption{ (size_t)option.max_length, !!option.truncation, !!option.pad_left, (int64_t)option.pad_id };
+		batchOption.offsetInChrLevel = !!option.offset_in_chr_level;
+		return (int)handle->tokenizer.encodeBatch(strs.data(), strs.size(), batchOption, token_ids, attention_mask, offsets, lengths);
+	}
+	catch (...)
+	{
+		currentError = current_exception();
+		return KIWIERR_FAIL;
+	}
+}
+
+int kiwi_swt_encode_batch(kiwi_swtokenizer_h handle, const char** texts, const int* text_sizes, int batch_size, kiwi_swt_batch_option_t option, int32_t* token_ids, int32_t* attention_mask, int32_t* offsets, int32_t* lengths)
+{
+	return swtEncodeBatch(handle, texts, text_sizes, batch_size, option, token_ids, attention_mask, offsets, lengths);
+}
+
+int kiwi_swt_encode_batch64(kiwi_swtokenizer_h handle, const char** texts, const int* text_sizes, int batch_size, kiwi_swt_batch_option_t option, int64_t* token_ids, int64_t* attention_mask, int64_t* offsets, int64_t* lengths)
+{
+	return swtEncodeBatch(handle, texts, text_sizes, batch_size, option, token_ids, attention_mask, offsets, lengths);
+}
+
 int kiwi_swt_close(kiwi_swtokenizer_h handle)
 {
 	if (!handle) return KIWIERR_INVALID_HANDLE;
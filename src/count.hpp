@@ -4,6 +4,11 @@
 #include <map>
 #include <unordered_set>
 #include <unordered_map>
+#include <queue>
+#include <string>
+#include <fstream>
+#include <random>
+#include <cstdio>
 
 #include <kiwi/Trie.hpp>
 #include <kiwi/ThreadPool.h>
@@ -303,24 +308,21 @@ namespace kiwi
 			return std::move(data[0]);
 		}
 
-		template<typename _DocIter, typename VocabTy, typename _HistoryTx = std::vector<VocabTy>>
-		ContinuousTrie<CTrieNode<VocabTy>> count(_DocIter docBegin, _DocIter docEnd,
-			size_t minCf, size_t minDf, size_t maxNgrams,
-			ThreadPool* pool = nullptr, std::vector<std::pair<VocabTy, VocabTy>>* bigramList = nullptr,
-			const _HistoryTx* historyTransformer = nullptr
+		template<typename VocabTy, typename _DocIter>
+		void countUnigrams(std::vector<size_t>& unigramCf, std::vector<size_t>& unigramDf,
+			_DocIter docBegin, _DocIter docEnd,
+			ThreadPool* pool
 		)
 		{
-			// counting unigrams & bigrams
-			std::vector<size_t> unigramCf, unigramDf;
-			map<std::pair<VocabTy, VocabTy>, size_t> bigramCf, bigramDf;
-
 			if (pool && pool->size() > 1)
 			{
 				using LocalCfDf = std::pair<
-					decltype(unigramCf),
-					decltype(unigramDf)
+					std::vector<size_t>,
+					std::vector<size_t>
 				>;
 				std::vector<LocalCfDf> localdata(pool->size());
+				localdata[0].first = std::move(unigramCf);
+				localdata[0].second = std::move(unigramDf);
 				std::vector<std::future<void>> futures;
 				const size_t stride = pool->size() * 8;
 				auto docIt = docBegin;
@@ -356,14 +358,27 @@ namespace kiwi
 			{
 				countUnigrams<VocabTy>(unigramCf, unigramDf, docBegin, docEnd);
 			}
+		}
 
+		template<typename _DocIter, typename VocabTy, typename _HistoryTx = std::vector<VocabTy>>
+		void countBigrams(map<std::pair<VocabTy, VocabTy>, size_t>& bigramCf,
+			map<std::pair<VocabTy, VocabTy>, size_t>& bigramDf,
+			_DocIter docBegin, _DocIter docEnd,
+			const std::vector<size_t>& unigramCf, const std::vector<size_t>& unigramDf,
+			size_t minCf, size_t minDf,
+			ThreadPool* pool,
+			const _HistoryTx* historyTransformer = nullptr
+		)
+		{
 			if (pool && pool->size() > 1)
 			{
 				using LocalCfDf = std::pair<
-					decltype(bigramCf),
-					decltype(bigramDf)
+					map<std::pair<VocabTy, VocabTy>, size_t>,
+					map<std::pair<VocabTy, VocabTy>, size_t>
 				>;
 				std::vector<LocalCfDf> localdata(pool->size());
+				localdata[0].first = std::move(bigramCf);
+				localdata[0].second = std::move(bigramDf);
 				std::vector<std::future<void>> futures;
 				const size_t stride = pool->size() * 8;
 				auto docIt = docBegin;
@@ -396,6 +411,122 @@ namespace kiwi
 			{
 				countBigrams(bigramCf, bigramDf, docBegin, docEnd, unigramCf, unigramDf, minCf, minDf, historyTransformer);
 			}
+		}
+
+		template<typename _DocIter, typename _BigramPairs, typename VocabTy, typename _HistoryTx = std::vector<VocabTy>>
+		void countNgrams(ContinuousTrie<CTrieNode<VocabTy>>& dest,
+			_DocIter docBegin, _DocIter docEnd,
+			const std::vector<size_t>& unigramCf, const std::vector<size_t>& unigramDf, _BigramPairs&& validPairs,
+			size_t minCf, size_t minDf, size_t maxNgrams,
+			ThreadPool* pool,
+			const _HistoryTx* historyTransformer = nullptr
+		)
+		{
+			if (pool && pool->size() > 1)
+			{
+				using LocalFw = ContinuousTrie<CTrieNode<VocabTy>>;
+				std::vector<LocalFw> localdata(pool->size());
+				std::vector<std::future<void>> futures;
+				const size_t stride = pool->size() * 8;
+				auto docIt = docBegin;
+				for (size_t i = 0; i < stride && docIt != docEnd; ++i, ++docIt)
+				{
+					futures.emplace_back(pool->enqueue([&, docIt, stride](size_t tid)
+					{
+						countNgrams<false>(localdata[tid],
+							makeStrideIter(docIt, stride, docEnd),
+							makeStrideIter(docEnd, stride, docEnd),
+							unigramCf, unigramDf, validPairs, minCf, minDf, maxNgrams,
+							historyTransformer
+						);
+					}));
+				}
+
+				for (auto& f : futures) f.get();
+
+				auto r = parallelReduce(std::move(localdata), [&](LocalFw& dest, LocalFw&& src)
+				{
+					mergeNgramCounts(dest, std::move(src));
+				}, pool);
+
+				if (dest.empty()) dest = std::move(r);
+				else mergeNgramCounts(dest, std::move(r));
+			}
+			else
+			{
+				countNgrams<false>(dest,
+					docBegin, docEnd,
+					unigramCf, unigramDf, validPairs, minCf, minDf, maxNgrams,
+					historyTransformer
+				);
+			}
+		}
+
+		template<typename VocabTy>
+		std::unordered_set<std::pair<VocabTy, VocabTy>, detail::vvhash> filterBigrams(
+			const map<std::pair<VocabTy, VocabTy>, size_t>& bigramCf,
+			const map<std::pair<VocabTy, VocabTy>, size_t>& bigramDf,
+			size_t minCf, size_t minDf
+		)
+		{
+			std::unordered_set<std::pair<VocabTy, VocabTy>, detail::vvhash> validPairs;
+			for (auto& p : bigramCf)
+			{
+				if (p.second >= minCf && bigramDf.find(p.first)->second >= minDf) validPairs.emplace(p.first);
+			}
+			return validPairs;
+		}
+
+		template<typename VocabTy, typename _HistoryTx = std::vector<VocabTy>>
+		ContinuousTrie<CTrieNode<VocabTy>> makeBigramTrie(
+			const std::vector<size_t>& unigramCf, const std::vector<size_t>& unigramDf,
+			const map<std::pair<VocabTy, VocabTy>, size_t>& bigramCf,
+			size_t minCf, size_t minDf,
+			const _HistoryTx* historyTransformer = nullptr
+		)
+		{
+			ContinuousTrie<CTrieNode<VocabTy>> trieNodes{ 1 };
+			if (historyTransformer)
+			{
+				for (size_t i = 0; i < unigramCf.size(); ++i)
+				{
+					trieNodes.reserveMore(1);
+					trieNodes.root().makeNext((*historyTransformer)[i], [&]() { return trieNodes.newNode(); });
+				}
+			}
+
+			trieNodes.reserveMore(unigramCf.size() + bigramCf.size() * (historyTransformer ? 2 : 1) + 1);
+			const auto& allocNode = [&]() { return trieNodes.newNode(); };
+
+			for (size_t i = 0; i < unigramCf.size(); ++i)
+			{
+				if (unigramCf[i] && unigramCf[i] >= minCf && unigramDf[i] >= minDf)
+				{
+					trieNodes[0].makeNext(i, allocNode)->val = unigramCf[i];
+				}
+			}
+
+			for (auto& p : bigramCf)
+			{
+				trieNodes[0].makeNext(p.first.first, allocNode)->val += p.second;
+				trieNodes[0].getNext(p.first.first)->makeNext(p.first.second, allocNode)->val = p.second;
+			}
+			return trieNodes;
+		}
+
+		template<typename _DocIter, typename VocabTy, typename _HistoryTx = std::vector<VocabTy>>
+		ContinuousTrie<CTrieNode<VocabTy>> count(_DocIter docBegin, _DocIter docEnd,
+			size_t minCf, size_t minDf, size_t maxNgrams,
+			ThreadPool* pool = nullptr, std::vector<std::pair<VocabTy, VocabTy>>* bigramList = nullptr,
+			const _HistoryTx* historyTransformer = nullptr
+		)
+		{
+			// counting unigrams & bigrams
+			std::vector<size_t> unigramCf, unigramDf;
+			map<std::pair<VocabTy, VocabTy>, size_t> bigramCf, bigramDf;
+
+			countUnigrams<VocabTy>(unigramCf, unigramDf, docBegin, docEnd, pool);
+			countBigrams(bigramCf, bigramDf, docBegin, docEnd, unigramCf, unigramDf, minCf, minDf, pool, historyTransformer);
 
 			if (bigramList)
 			{
@@ -405,6 +536,12 @@ namespace kiwi
 				}
 			}
 
+			if (maxNgrams <= 2)
+			{
+				return makeBigramTrie(unigramCf, unigramDf, bigramCf, minCf, minDf, historyTransformer);
+			}
+
+			// counting ngrams
 			ContinuousTrie<CTrieNode<VocabTy>> trieNodes{ 1 };
 			if (historyTransformer)
 			{
@@ -415,74 +552,265 @@ namespace kiwi
 				}
 			}
 
-			if (maxNgrams <= 2)
+			const auto validPairs = filterBigrams(bigramCf, bigramDf, minCf, minDf);
+			if (pool && pool->size() > 1)
 			{
-				trieNodes.reserveMore(unigramCf.size() + bigramCf.size() * (historyTransformer ? 2 : 1) + 1);
-				const auto& allocNode = [&]() { return trieNodes.newNode(); };
+				// 병렬로 센 결과는 빈 트라이에서 시작하여 병합된다.
+				trieNodes = {};
+			}
+			countNgrams(trieNodes, docBegin, docEnd, unigramCf, unigramDf, validPairs, minCf, minDf, maxNgrams, pool, historyTransformer);
+			return trieNodes;
+		}
 
-				for (size_t i = 0; i < unigramCf.size(); ++i)
+		inline std::string makeTempPrefix(const std::string& tempDir, const char* name)
+		{
+			std::random_device rd;
+			char buf[64];
+			snprintf(buf, sizeof(buf), "%s_%08x%08x_", name, rd(), rd());
+			return tempDir.empty() ? std::string{ buf } : (tempDir + "/" + buf);
+		}
+
+		/**
+		 * @brief 임시 파일들의 경로를 발급하고, 소멸 시 발급한 파일들을 모두 삭제한다.
+		 */
+		class TempFileSet
+		{
+			std::string prefix;
+			std::vector<std::string> paths;
+		public:
+			TempFileSet(const std::string& tempDir, const char* name)
+				: prefix{ makeTempPrefix(tempDir, name) }
+			{
+			}
+
+			TempFileSet(const TempFileSet&) = delete;
+			TempFileSet& operator=(const TempFileSet&) = delete;
+
+			~TempFileSet()
+			{
+				for (auto& path : paths) std::remove(path.c_str());
+			}
+
+			const std::string& newPath()
+			{
+				paths.emplace_back(prefix + std::to_string(paths.size()));
+				return paths.back();
+			}
+
+			size_t size() const { return paths.size(); }
+			const std::string& operator[](size_t i) const { return paths[i]; }
+		};
+
+		/**
+		 * @brief 말뭉치를 조각 단위로 센 n-gram 빈도를 디스크에 정렬된 run으로 기록해두고, 이를 k-way 병합하며 순회하는 클래스.
+		 * 
+		 * traverse()는 ContinuousTrie::traverse와 같은 순서와 형식으로 (빈도, 키 목록)을 전달하므로,
+		 * 모든 n-gram을 메모리에 올리지 않고도 KnLangModelBase::build에 바로 넘길 수 있다.
+		 * 각 run은 트라이의 전위 순회 순서로 (깊이, 마지막 키, 빈도)만을 기록한다. 
+		 * 부모 노드가 항상 자식보다 먼저 기록되므로 나머지 키는 직전 레코드로부터 복원할 수 있다.
+		 */
+		template<class VocabTy>
+		class ExternalNgramCounts
+		{
+		public:
+			using Node = CTrieNode<VocabTy>;
+
+		private:
+			class RunReader
+			{
+				std::ifstream ifs;
+				std::vector<VocabTy> key;
+				uint64_t cnt = 0;
+				bool valid = false;
+			public:
+				RunReader(const std::string& path)
+					: ifs{ path, std::ios_base::binary }
 				{
-					if (unigramCf[i] && unigramCf[i] >= minCf && unigramDf[i] >= minDf)
-					{
-						trieNodes[0].makeNext(i, allocNode)->val = unigramCf[i];
-					}
+					if (!ifs) throw std::ios_base::failure{ "Cannot open '" + path + "'" };
+					next();
 				}
 
-				for (auto& p : bigramCf)
+				bool next()
+				{
+					uint32_t depth = 0;
+					VocabTy k = 0;
+					if (!ifs.read((char*)&depth, sizeof(depth))) return valid = false;
+					if (depth) ifs.read((char*)&k, sizeof(VocabTy));
+					ifs.read((char*)&cnt, sizeof(cnt));
+					if (!ifs || depth > key.size() + 1) throw std::runtime_error{ "Broken n-gram run file" };
+					key.resize(depth ? depth - 1 : 0);
+					if (depth) key.emplace_back(k);
+					return valid = true;
+				}
+
+				bool isValid() const { return valid; }
+				const std::vector<VocabTy>& getKey() const { return key; }
+				uint64_t getCount() const { return cnt; }
+			};
+
+			class RunWriter
+			{
+				std::ofstream ofs;
+			public:
+				RunWriter(const std::string& path)
+					: ofs{ path, std::ios_base::binary }
+				{
+					if (!ofs) throw std::ios_base::failure{ "Cannot open '" + path + "'" };
+				}
+
+				void write(const std::vector<VocabTy>& key, uint64_t cnt)
 				{
-					trieNodes[0].makeNext(p.first.first, allocNode)->val += p.second;
-					trieNodes[0].getNext(p.first.first)->makeNext(p.first.second, allocNode)->val = p.second;
+					const uint32_t depth = key.size();
+					ofs.write((const char*)&depth, sizeof(depth));
+					if (depth) ofs.write((const char*)&key.back(), sizeof(VocabTy));
+					ofs.write((const char*)&cnt, sizeof(cnt));
 				}
+
+				void close()
+				{
+					ofs.close();
+					if (!ofs) throw std::ios_base::failure{ "Failed to write n-gram run file" };
+				}
+			};
+
+			std::string prefix;
+			std::vector<std::string> runs;
+			std::vector<std::pair<std::vector<VocabTy>, size_t>> divisors;
+			size_t maxFanIn = 64;
+			size_t numCreatedRuns = 0;
+
+			std::string newRunPath()
+			{
+				return prefix + std::to_string(numCreatedRuns++) + ".run";
 			}
-			// counting ngrams
-			else
+
+			template<class Fn>
+			static void merge(const std::vector<std::string>& paths, Fn&& fn)
 			{
-				std::unordered_set<std::pair<VocabTy, VocabTy>, detail::vvhash> validPairs;
-				for (auto& p : bigramCf)
+				std::vector<std::unique_ptr<RunReader>> readers;
+				for (auto& path : paths)
 				{
-					if (p.second >= minCf && bigramDf[p.first] >= minDf) validPairs.emplace(p.first);
+					readers.emplace_back(new RunReader{ path });
 				}
 
-				if (pool && pool->size() > 1)
+				const auto cmp = [&](size_t a, size_t b)
 				{
-					using LocalFw = ContinuousTrie<CTrieNode<VocabTy>>;
-					std::vector<LocalFw> localdata(pool->size());
-					std::vector<std::future<void>> futures;
-					const size_t stride = pool->size() * 8;
-					auto docIt = docBegin;
-					for (size_t i = 0; i < stride && docIt != docEnd; ++i, ++docIt)
+					return readers[b]->getKey() < readers[a]->getKey();
+				};
+				std::priority_queue<size_t, std::vector<size_t>, decltype(cmp)> heap{ cmp };
+				for (size_t i = 0; i < readers.size(); ++i)
+				{
+					if (readers[i]->isValid()) heap.emplace(i);
+				}
+
+				std::vector<VocabTy> key;
+				while (!heap.empty())
+				{
+					size_t r = heap.top();
+					heap.pop();
+					key = readers[r]->getKey();
+					uint64_t cnt = readers[r]->getCount();
+					if (readers[r]->next()) heap.emplace(r);
+
+					while (!heap.empty() && readers[heap.top()]->getKey() == key)
 					{
-						futures.emplace_back(pool->enqueue([&, docIt, stride](size_t tid)
-						{
-							countNgrams<false>(localdata[tid],
-								makeStrideIter(docIt, stride, docEnd),
-								makeStrideIter(docEnd, stride, docEnd),
-								unigramCf, unigramDf, validPairs, minCf, minDf, maxNgrams,
-								historyTransformer
-							);
-						}));
+						r = heap.top();
+						heap.pop();
+						cnt += readers[r]->getCount();
+						if (readers[r]->next()) heap.emplace(r);
 					}
+					fn(cnt, key);
+				}
+			}
 
-					for (auto& f : futures) f.get();
+		public:
+			/**
+			 * @param tempDir run 파일을 기록할 디렉토리. 비어 있으면 현재 디렉토리를 사용한다.
+			 * @param _maxFanIn 한 번에 병합할 run의 최대 개수. 이보다 많은 run이 있으면 중간 병합을 거친다.
+			 */
+			ExternalNgramCounts(const std::string& tempDir = {}, size_t _maxFanIn = 64)
+				: prefix{ makeTempPrefix(tempDir, "kiwi_ngram") }, maxFanIn{ std::max(_maxFanIn, (size_t)2) }
+			{
+			}
+
+			ExternalNgramCounts(const ExternalNgramCounts&) = delete;
+			ExternalNgramCounts& operator=(const ExternalNgramCounts&) = delete;
+
+			ExternalNgramCounts(ExternalNgramCounts&& o) noexcept
+				: prefix{ std::move(o.prefix) }, runs{ std::move(o.runs) }, divisors{ std::move(o.divisors) },
+				maxFanIn{ o.maxFanIn }, numCreatedRuns{ o.numCreatedRuns }
+			{
+				o.runs.clear();
+			}
 
-					auto r = parallelReduce(std::move(localdata), [&](LocalFw& dest, LocalFw&& src)
+			~ExternalNgramCounts()
+			{
+				for (auto& path : runs) std::remove(path.c_str());
+			}
+
+			size_t numRuns() const { return runs.size(); }
+			const std::string& getRunPath(size_t i) const { return runs[i]; }
+
+			/**
+			 * @brief 트라이에 센 빈도를 새 run으로 기록한다. 기록이 끝난 트라이는 해제해도 된다.
+			 */
+			void addRun(const ContinuousTrie<Node>& trie)
+			{
+				if (trie.empty()) return;
+				runs.emplace_back(newRunPath());
+				RunWriter writer{ runs.back() };
+				trie.traverse([&](size_t cnt, const std::vector<VocabTy>& rkeys)
+				{
+					writer.write(rkeys, cnt);
+				});
+				writer.close();
+			}
+
+			/**
+			 * @brief 순회 시 key의 빈도를 divisor로 나눈 값으로 전달한다.
+			 */
+			void divideCount(const std::vector<VocabTy>& key, size_t divisor)
+			{
+				divisors.emplace_back(key, divisor);
+			}
+
+			template<class Fn>
+			void traverse(Fn&& fn)
+			{
+				while (runs.size() > maxFanIn)
+				{
+					std::vector<std::string> merged;
+					for (size_t i = 0; i < runs.size(); i += maxFanIn)
 					{
-						mergeNgramCounts(dest, std::move(src));
-					}, pool);
+						std::vector<std::string> group{ runs.begin() + i, runs.begin() + std::min(i + maxFanIn, runs.size()) };
+						if (group.size() == 1)
+						{
+							merged.emplace_back(group[0]);
+							continue;
+						}
 
-					trieNodes = std::move(r);
+						merged.emplace_back(newRunPath());
+						RunWriter writer{ merged.back() };
+						merge(group, [&](uint64_t cnt, const std::vector<VocabTy>& key)
+						{
+							writer.write(key, cnt);
+						});
+						writer.close();
+						for (auto& path : group) std::remove(path.c_str());
+					}
+					runs = std::move(merged);
 				}
-				else
+
+				merge(runs, [&](uint64_t cnt, const std::vector<VocabTy>& key)
 				{
-					countNgrams<false>(trieNodes,
-						docBegin, docEnd,
-						unigramCf, unigramDf, validPairs, minCf, minDf, maxNgrams,
-						historyTransformer
-					);
-				}
+					for (auto& d : divisors)
+					{
+						if (d.first == key) cnt /= d.second;
+					}
+					fn(cnt, key);
+				});
 			}
-			return trieNodes;
-		}
+		};
 
 	}
 }
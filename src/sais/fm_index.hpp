@@ -15,6 +15,52 @@ namespace sais
 		std::unique_ptr<size_t[]> cValues;
 		size_t length = 0, vocabSize = 0;
 		WaveletTree<ChrTy> waveletTree;
+
+		void buildFromBwt(const ChrTy* data, mp::ThreadPool* pool)
+		{
+			waveletTree = WaveletTree<ChrTy>{ bwtData.get(), length };
+
+			std::map<ChrTy, size_t> chrFreqs;
+			if (std::is_unsigned<ChrTy>::value && sizeof(ChrTy) <= 2)
+			{
+				// 문자 종류가 많지 않으므로 작업자별로 빈도 배열을 만들어 센 뒤 합친다.
+				const size_t alphabetSize = (size_t)1 << (sizeof(ChrTy) * 8);
+				auto localFreqs = mp::runParallel(pool, [&](const size_t i, const size_t numWorkers, mp::Barrier*)
+				{
+					std::vector<size_t> freqs(alphabetSize);
+					const size_t first = length * i / numWorkers, last = length * (i + 1) / numWorkers;
+					for (size_t j = first; j < last; ++j)
+					{
+						freqs[(size_t)data[j]]++;
+					}
+					return freqs;
+				});
+				for (size_t c = 0; c < alphabetSize; ++c)
+				{
+					size_t f = 0;
+					for (auto& l : localFreqs) f += l[c];
+					if (f) chrFreqs.emplace_hint(chrFreqs.end(), (ChrTy)c, f);
+				}
+			}
+			else
+			{
+				for (size_t i = 0; i < length; ++i)
+				{
+					chrFreqs[data[i]]++;
+				}
+			}
+			vocabSize = chrFreqs.size();
+			cKeys = std::unique_ptr<ChrTy[]>(new ChrTy[vocabSize]);
+			cValues = std::unique_ptr<size_t[]>(new size_t[vocabSize]);
+			size_t idx = 0, acc = 0;
+			for (auto& p : chrFreqs)
+			{
+				cKeys[idx] = p.first;
+				cValues[idx] = acc;
+				acc += p.second;
+				++idx;
+			}
+		}
 	public:
 		FmIndex() = default;
 
@@ -32,31 +78,34 @@ namespace sais
 				auto ibuf = std::unique_ptr<int64_t[]>(new int64_t[length + 1]);
 				bwt<ChrTy, int64_t>(data, bwtData.get(), ibuf.get(), length, 0, nullptr, pool);
 			}
-			waveletTree = WaveletTree<ChrTy>{ bwtData.get(), length };
-
-			/*freqs = std::unique_ptr<size_t[]>(new size_t[(size_t)1 << (sizeof(ChrTy) * 8)]);
-			std::fill(freqs.get(), freqs.get() + ((size_t)1 << (sizeof(ChrTy) * 8)), 0);
-			for (size_t i = 0; i < length; ++i)
-			{
-				freqs[data[i]]++;
-			}*/
+			buildFromBwt(data, pool);
+		}
 
-			std::map<ChrTy, size_t> chrFreqs;
-			for (size_t i = 0; i < length; ++i)
-			{
-				chrFreqs[data[i]]++;
-			}
-			vocabSize = chrFreqs.size();
-			cKeys = std::unique_ptr<ChrTy[]>(new ChrTy[vocabSize]);
-			cValues = std::unique_ptr<size_t[]>(new size_t[vocabSize]);
-			size_t idx = 0, acc = 0;
-			for (auto& p : chrFreqs)
+		/**
+		 * @brief data에 대해 이미 계산해둔 접미사 배열 sa를 재사용하여 인덱스를 생성한다.
+		 * 결과는 `FmIndex(data, length, pool)`과 동일하지만 접미사 배열을 다시 계산하지 않는다.
+		 */
+		template<class SaTy>
+		FmIndex(const ChrTy* data, const SaTy* sa, size_t _length, mp::ThreadPool* pool = nullptr)
+			: length{ _length }
+		{
+			bwtData = std::unique_ptr<ChrTy[]>(new ChrTy[length]);
+			if (length)
 			{
-				cKeys[idx] = p.first;
-				cValues[idx] = acc;
-				acc += p.second;
-				++idx;
+				// bwt()와 마찬가지로 맨 앞에는 마지막 문자가 오고, 문자열 전체에 해당하는 접미사(sa[i] == 0)는 건너뛴다.
+				const size_t primary = std::find(sa, sa + length, 0) - sa;
+				mp::runParallel(pool, [&](const size_t i, const size_t numWorkers, mp::Barrier*)
+				{
+					const size_t first = length * i / numWorkers, last = length * (i + 1) / numWorkers;
+					for (size_t j = first; j < last; ++j)
+					{
+						if (j == primary) continue;
+						bwtData[j < primary ? j + 1 : j] = data[sa[j] - 1];
+					}
+				});
+				bwtData[0] = data[length - 1];
 			}
+			buildFromBwt(data, pool);
 		}
 
 		size_t size() const
@@ -12,141 +12,18 @@
 #include <functional>
 #include <stdexcept>
 
+#include <kiwi/ThreadPool.h>
+
 namespace mp
 {
-	class Barrier {
-	public:
-		explicit Barrier(std::mutex* _mutex, std::condition_variable* _cond, size_t _count) :
-			mutex(_mutex),
-			cond(_cond),
-			threshold(_count),
-			count(_count),
-			generation(0) 
-		{
-		}
-
-		void wait()
-		{
-			std::unique_lock<std::mutex> lLock{ *mutex };
-			auto gen = generation;
-			if (!--count) 
-			{
-				generation++;
-				count = threshold;
-				cond->notify_all();
-			}
-			else 
-			{
-				cond->wait(lLock, [this, gen] { return gen != generation; });
-			}
-		}
-
-	private:
-		std::mutex* mutex;
-		std::condition_variable* cond;
-		std::size_t threshold;
-		std::size_t count;
-		std::size_t generation;
-	};
-
-	class OverrideLimitedSize;
-
-	class ThreadPool
-	{
-		friend class OverrideLimitedSize;
-	public:
-		ThreadPool(size_t threads = 0);
-		template<class F, class... Args>
-		auto runParallel(size_t workers, F&& f, Args&&... args)
-			-> std::vector<std::future<typename std::invoke_result<F, size_t, size_t, Barrier*, Args...>::type>>;
-		~ThreadPool();
-		size_t size() const { return workers.size(); }
-		size_t limitedSize() const { return std::min(size(), _limitedSize); };
-		void joinAll();
-		
-		Barrier getBarrier(size_t count = -1)
-		{
-			return Barrier{ &barrier_mutex, &barrier_condition, std::min(count, tasks.size()) };
-		}
-
-	private:
-		std::vector<std::thread> workers;
-		std::vector<std::queue<std::function<void(size_t)>>> tasks;
-
-		std::mutex queue_mutex, barrier_mutex;
-		std::condition_variable condition, barrier_condition;
-		size_t _limitedSize = -1;
-		bool stop;
-	};
-
-	inline ThreadPool::ThreadPool(size_t threads)
-		: stop(false)
-	{
-		tasks.resize(threads);
-		for (size_t i = 0; i < threads; ++i)
-		{
-			workers.emplace_back([this, i, threads]
-			{
-				for (;;)
-				{
-					std::function<void(size_t)> task;
-					{
-						std::unique_lock<std::mutex> lock(this->queue_mutex);
-						this->condition.wait(lock,
-							[this, i] { return this->stop || !this->tasks[i].empty(); });
-						if (this->stop && this->tasks[i].empty()) return;
-						task = std::move(this->tasks[i].front());
-						this->tasks[i].pop();
-					}
-					task(i);
-				}
-			});
-		}
-	}
-
-	template<class F, class... Args>
-	auto ThreadPool::runParallel(size_t workers, F&& f, Args&&... args)
-		-> std::vector<std::future<typename std::invoke_result<F, size_t, size_t, Barrier*, Args...>::type>>
-	{
-		using return_type = typename std::invoke_result<F, size_t, size_t, Barrier*, Args...>::type;
-		std::vector<std::future<return_type>> ret;
-		{
-			auto b = std::make_shared<Barrier>(getBarrier(workers));
-			std::unique_lock<std::mutex> lock(queue_mutex);
-			for (size_t i = 0; i < workers && i < tasks.size(); ++i)
-			{
-				auto task = std::make_shared< std::packaged_task<return_type(size_t, size_t, Barrier*)> >(
-					std::bind(std::forward<F>(f), std::placeholders::_1, std::placeholders::_2, std::placeholders::_3, std::forward<Args>(args)...));
-				if (stop) throw std::runtime_error("enqueue on stopped ThreadPool");
-				ret.emplace_back(task->get_future());
-				tasks[i].emplace([&, task, workers, b](size_t id) { (*task)(id, std::min(workers, tasks.size()), b.get()); });
-			}
-		}
-		condition.notify_all();
-		return ret;
-	}
-
-	inline void ThreadPool::joinAll()
-	{
-		if (stop) return;
-
-		{
-			std::unique_lock<std::mutex> lock(queue_mutex);
-			stop = true;
-		}
-		condition.notify_all();
-		for (std::thread& worker : workers)
-			worker.join();
-	}
-
-	inline ThreadPool::~ThreadPool()
-	{
-		joinAll();
-	}
+	// sais와 FmIndex도 라이브러리의 다른 부분과 같은 스레드풀을 공유할 수 있도록 kiwi::utils의 구현을 그대로 사용한다.
+	using Barrier = kiwi::utils::Barrier;
+	using ThreadPool = kiwi::utils::ThreadPool;
 
 	inline size_t getPoolSize(ThreadPool* pool)
 	{
-		if (!pool) return 1;
+		// 작업 스레드 안에서는 runParallel이 단일 작업으로 실행되므로 스레드가 하나인 것처럼 처리한다.
+		if (!pool || pool->isWorkerThread()) return 1;
 		return pool->size();
 	}
 
@@ -321,7 +198,7 @@ namespace mp
 		}
 		else
 		{
-			for (auto& f : pool->runParallel(std::min(maximumWorkers, pool->limitedSize()), func))
+			for (auto& f : pool->runParallel(maximumWorkers, func))
 			{
 				ret.emplace_back(f.get());
 			}
@@ -346,7 +223,7 @@ namespace mp
 		}
 		else
 		{
-			for (auto& f : pool->runParallel(std::min(maximumWorkers, pool->limitedSize()), func))
+			for (auto& f : pool->runParallel(maximumWorkers, func))
 			{
 				f.get();
 			}
@@ -375,7 +252,7 @@ namespace mp
 		}
 		else
 		{
-			for (auto& f : pool->runParallel(std::min(maximumWorkers, pool->limitedSize()), [&](ptrdiff_t tid, ptrdiff_t numThreads, Barrier* barrier)
+			for (auto& f : pool->runParallel(maximumWorkers, [&](ptrdiff_t tid, ptrdiff_t numThreads, Barrier* barrier)
 				{
 					ptrdiff_t pstart = start + ((stop - start) * tid / numThreads) / step * step;
 					ptrdiff_t pstop = start + ((stop - start) * (tid + 1) / numThreads) / step * step;
@@ -390,23 +267,6 @@ namespace mp
 		}
 	}
 
-	class OverrideLimitedSize
-	{
-		size_t prevSize;
-		ThreadPool* pool;
-	public:
-		OverrideLimitedSize(ThreadPool* _pool, size_t newSize)
-			: pool{ _pool }, prevSize{ _pool ? _pool->limitedSize() : -1 }
-		{
-			if (pool) pool->_limitedSize = newSize;
-		}
-
-		~OverrideLimitedSize()
-		{
-			if (pool) pool->_limitedSize = prevSize;
-		}
-	};
-
 	template<class Mutex>
 	class OptionalLockGuard
 	{
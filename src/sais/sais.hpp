@@ -883,7 +883,7 @@ class SaisImpl
         return bucket_size;
     }
 
-    static SaTy count_and_gather_lms_suffixes_32s_4k_fs_omp(const SaTy* RESTRICT T, SaTy* RESTRICT SA, SaTy n, SaTy k, SaTy* RESTRICT buckets, mp::ThreadPool* pool, ThreadState* RESTRICT thread_state)
+    static SaTy count_and_gather_lms_suffixes_32s_4k_fs_omp(const SaTy* RESTRICT T, SaTy* RESTRICT SA, SaTy n, SaTy k, SaTy* RESTRICT buckets, mp::ThreadPool* pool, ThreadState* RESTRICT thread_state, SaTy max_threads)
     {
         SaTy m = 0;
         mp::runParallel(pool, [&](std::ptrdiff_t id, std::ptrdiff_t num_threads, mp::Barrier* barrier)
@@ -931,12 +931,12 @@ class SaisImpl
                     accumulate_counts_s32(buckets + omp_block_start, omp_block_size, bucket_stride, num_threads + 1);
                 }
             }
-        }, mp::ParallelCond{n >= 65536});
+        }, mp::MaximumWorkers{ (size_t)max_threads }, mp::ParallelCond{n >= 65536});
 
         return m;
     }
 
-    static SaTy count_and_gather_lms_suffixes_32s_2k_fs_omp(const SaTy* RESTRICT T, SaTy* RESTRICT SA, SaTy n, SaTy k, SaTy* RESTRICT buckets, mp::ThreadPool* pool, ThreadState* RESTRICT thread_state)
+    static SaTy count_and_gather_lms_suffixes_32s_2k_fs_omp(const SaTy* RESTRICT T, SaTy* RESTRICT SA, SaTy n, SaTy k, SaTy* RESTRICT buckets, mp::ThreadPool* pool, ThreadState* RESTRICT thread_state, SaTy max_threads)
     {
         SaTy m = 0;
         mp::runParallel(pool, [&](std::ptrdiff_t id, std::ptrdiff_t num_threads, mp::Barrier* barrier)
@@ -984,12 +984,12 @@ class SaisImpl
                     accumulate_counts_s32(buckets + omp_block_start, omp_block_size, bucket_stride, num_threads + 1);
                 }
             }
-        }, mp::ParallelCond{n >= 65536});
+        }, mp::MaximumWorkers{ (size_t)max_threads }, mp::ParallelCond{n >= 65536});
 
         return m;
     }
 
-    static void count_and_gather_compacted_lms_suffixes_32s_2k_fs_omp(const SaTy* RESTRICT T, SaTy* RESTRICT SA, SaTy n, SaTy k, SaTy* RESTRICT buckets, mp::ThreadPool* pool, ThreadState* RESTRICT thread_state)
+    static void count_and_gather_compacted_lms_suffixes_32s_2k_fs_omp(const SaTy* RESTRICT T, SaTy* RESTRICT SA, SaTy n, SaTy k, SaTy* RESTRICT buckets, mp::ThreadPool* pool, ThreadState* RESTRICT thread_state, SaTy max_threads)
     {
         mp::runParallel(pool, [&](std::ptrdiff_t id, std::ptrdiff_t num_threads, mp::Barrier* barrier)
         {
@@ -1023,7 +1023,7 @@ class SaisImpl
 
                 accumulate_counts_s32(buckets + omp_block_start, omp_block_size, bucket_stride, num_threads);
             }
-        }, mp::ParallelCond{n >= 65536});
+        }, mp::MaximumWorkers{ (size_t)max_threads }, mp::ParallelCond{n >= 65536});
     }
 
     static SaTy count_and_gather_lms_suffixes_32s_4k_nofs_omp(const SaTy* RESTRICT T, SaTy* RESTRICT SA, SaTy n, SaTy k, SaTy* RESTRICT buckets, mp::ThreadPool* pool)
@@ -1097,8 +1097,7 @@ class SaisImpl
         if (max_threads > 1 && n >= 65536 && n / k >= 2 && pool)
         {
             if (max_threads > n / 16 / k) { max_threads = n / 16 / k; }
-            auto ls = mp::OverrideLimitedSize(pool, std::max(max_threads, (SaTy)2));
-            return count_and_gather_lms_suffixes_32s_4k_fs_omp(T, SA, n, k, buckets, pool, thread_state);
+            return count_and_gather_lms_suffixes_32s_4k_fs_omp(T, SA, n, k, buckets, pool, thread_state, std::max(max_threads, (SaTy)2));
         }
         else
         {
@@ -1112,8 +1111,7 @@ class SaisImpl
         if (max_threads > 1 && n >= 65536 && n / k >= 2 && pool)
         {
             if (max_threads > n / 8 / k) { max_threads = n / 8 / k; }
-            auto ls = mp::OverrideLimitedSize(pool, std::max(max_threads, (SaTy)2));
-            return count_and_gather_lms_suffixes_32s_2k_fs_omp(T, SA, n, k, buckets, pool, thread_state);
+            return count_and_gather_lms_suffixes_32s_2k_fs_omp(T, SA, n, k, buckets, pool, thread_state, std::max(max_threads, (SaTy)2));
         }
         else
         {
@@ -1128,8 +1126,7 @@ class SaisImpl
         if (max_threads > 1 && n >= 65536 && n / k >= 2 && pool)
         {
             if (max_threads > n / 8 / k) { max_threads = n / 8 / k; }
-            auto ls = mp::OverrideLimitedSize(pool, std::max(max_threads, (SaTy)2));
-            count_and_gather_compacted_lms_suffixes_32s_2k_fs_omp(T, SA, n, k, buckets, pool, thread_state);
+            count_and_gather_compacted_lms_suffixes_32s_2k_fs_omp(T, SA, n, k, buckets, pool, thread_state, std::max(max_threads, (SaTy)2));
         }
         else
         {
@@ -1,5 +1,8 @@
 ﻿#include "gtest/gtest.h"
 #include <cstring>
+#include <algorithm>
+#include <mutex>
+#include <condition_variable>
 #include <kiwi/capi.h>
 #include "common.h"
 
@@ -70,6 +73,119 @@ TEST(KiwiC, AnalyzeMultithread)
 	EXPECT_EQ(kiwi_close(kw), 0);
 }
 
+struct BulkReceived
+{
+	std::vector<std::string>* data = nullptr;
+	std::vector<int> indices;
+};
+
+int bulk_reader(int idx, char* buf, void* user)
+{
+	return mt_reader(idx, buf, ((BulkReceived*)user)->data);
+}
+
+int bulk_receiver(int idx, kiwi_res_h res, void* user)
+{
+	((BulkReceived*)user)->indices.emplace_back(idx);
+	kiwi_res_close(res);
+	return 0;
+}
+
+TEST(KiwiC, AnalyzeBulk)
+{
+	auto data = loadTestCorpus();
+	kiwi_h kw = kiwi_init(MODEL_PATH, 2, KIWI_BUILD_DEFAULT, 0);
+	EXPECT_NE(kw, nullptr);
+	kiwi_analyze_option_t option = { KIWI_MATCH_ALL, };
+	kiwi_bulk_option_t bulk_option = { 8, 4, 256, 0 };
+	BulkReceived received{ &data, {} };
+	EXPECT_EQ(kiwi_analyze_bulk(kw, bulk_reader, bulk_receiver, &received, 1, option, bulk_option), data.size());
+	EXPECT_EQ(received.indices.size(), data.size());
+	std::sort(received.indices.begin(), received.indices.end());
+	for (size_t i = 0; i < received.indices.size(); ++i)
+	{
+		EXPECT_EQ(received.indices[i], i);
+	}
+	EXPECT_EQ(kiwi_close(kw), 0);
+}
+
+TEST(KiwiC, AnalyzeAsync)
+{
+	kiwi_h kw = reuse_kiwi_instance();
+	kiwi_analyze_option_t option = { KIWI_MATCH_ALL_WITH_NORMALIZING, };
+
+	struct State
+	{
+		std::mutex mtx;
+		std::condition_variable cv;
+		int numDone = 0, numSucceeded = 0, numCancelled = 0;
+	} state;
+
+	// 콜백이 kiwi_analyze_async가 반환되기 전에 호출될 수도 있으므로, 전달받은 ticket을 요청별로 기록해 두었다가 나중에 비교한다.
+	struct Request
+	{
+		State* state = nullptr;
+		kiwi_ticket_h received = nullptr;
+	};
+
+	const auto callback = [](kiwi_ticket_h ticket, kiwi_res_h res, int status, void* userData)
+	{
+		auto& req = *(Request*)userData;
+		auto& st = *req.state;
+		if (status == 0)
+		{
+			EXPECT_NE(res, nullptr);
+			EXPECT_GT(kiwi_res_word_num(res, 0), 0);
+			kiwi_res_close(res);
+		}
+		else
+		{
+			EXPECT_EQ(res, nullptr);
+			EXPECT_EQ(status, KIWIERR_CANCELLED);
+		}
+		std::lock_guard<std::mutex> lock{ st.mtx };
+		req.received = ticket;
+		(status == 0 ? st.numSucceeded : st.numCancelled)++;
+		st.numDone++;
+		st.cv.notify_all();
+	};
+
+	const int numRequests = 64;
+	std::vector<kiwi_ticket_h> tickets;
+	std::vector<Request> requests(numRequests, Request{ &state, nullptr });
+	for (int i = 0; i < numRequests; ++i)
+	{
+		tickets.emplace_back(kiwi_analyze_async(kw, u8"비동기로 분석을 요청하고 결과는 콜백으로 받습니다.", 1, option, nullptr, callback, &requests[i]));
+		ASSERT_NE(tickets.back(), nullptr);
+	}
+
+	// 뒤쪽 절반을 취소한다. 취소에 성공한 요청만 KIWIERR_CANCELLED로 끝나야 한다.
+	int numCancelRequested = 0;
+	for (int i = numRequests / 2; i < numRequests; ++i)
+	{
+		const int r = kiwi_cancel(tickets[i]);
+		EXPECT_GE(r, 0);
+		if (r == 0) numCancelRequested++;
+	}
+
+	{
+		std::unique_lock<std::mutex> lock{ state.mtx };
+		state.cv.wait(lock, [&]() { return state.numDone == numRequests; });
+	}
+	EXPECT_EQ(state.numCancelled, numCancelRequested);
+	EXPECT_EQ(state.numSucceeded, numRequests - numCancelRequested);
+	for (int i = 0; i < numRequests; ++i)
+	{
+		EXPECT_EQ(requests[i].received, tickets[i]);
+		// 이미 끝난 요청은 취소할 수 없다.
+		if (i < numRequests / 2)
+		{
+			EXPECT_EQ(kiwi_cancel(tickets[i]), 1);
+		}
+		EXPECT_EQ(kiwi_ticket_close(tickets[i]), 0);
+	}
+}
+
 TEST(KiwiC, Issue71_SentenceSplit_u16)
 {
 	kiwi_h kw = reuse_kiwi_instance();
@@ -207,6 +323,48 @@ TEST(KiwiC, AddPreAnalyzedWord)
 	kiwi_builder_close(kb);
 }
 
+TEST(KiwiC, ResExport)
+{
+	kiwi_h kw = reuse_kiwi_instance();
+	kiwi_analyze_option_t option = { KIWI_MATCH_ALL_WITH_NORMALIZING, };
+	kiwi_res_h res = kiwi_analyze(kw, u8"키위는 😀 맛있는 과일입니다.", 1, option, nullptr);
+	const int n = kiwi_res_word_num(res, 0);
+	ASSERT_GT(n, 0);
+
+	std::vector<uint32_t> positions(n), morph_ids(n), offsets(n + 1);
+	std::vector<uint16_t> lengths(n);
+	std::vector<uint8_t> tags(n);
+	kiwi_token_flat_t flat = { positions.data(), lengths.data(), nullptr, nullptr, tags.data(), morph_ids.data(), nullptr, nullptr, offsets.data() };
+	const int required = kiwi_res_export(res, 0, &flat, nullptr, 0, kw);
+	ASSERT_GT(required, 0);
+	std::vector<char> strbuf(required);
+	EXPECT_EQ(kiwi_res_export(res, 0, &flat, strbuf.data(), required, kw), required);
+	EXPECT_EQ(strbuf.back(), 0);
+	EXPECT_EQ(offsets[n] + 1, required);
+
+	kiwi_token_flat_t view;
+	const char* viewStr = nullptr;
+	EXPECT_EQ(kiwi_res_export_view(res, 0, &view, &viewStr, nullptr), n);
+	EXPECT_EQ(view.morph_ids, nullptr);
+	EXPECT_STREQ(viewStr, strbuf.data());
+	EXPECT_EQ(kiwi_res_export_view(res, 0, &view, &viewStr, kw), n);
+
+	for (int i = 0; i < n; ++i)
+	{
+		EXPECT_EQ(positions[i], kiwi_res_position(res, 0, i));
+		EXPECT_EQ(lengths[i], kiwi_res_length(res, 0, i));
+		EXPECT_EQ(tags[i], kiwi_res_token_info(res, 0, i)->tag);
+		EXPECT_EQ(morph_ids[i], kiwi_res_morpheme_id(res, 0, i, kw));
+		EXPECT_EQ(std::string(strbuf.data() + offsets[i], offsets[i + 1] - offsets[i]), kiwi_res_form(res, 0, i));
+		EXPECT_EQ(view.chr_positions[i], positions[i]);
+		EXPECT_EQ(view.morph_ids[i], morph_ids[i]);
+		EXPECT_EQ(view.form_offsets[i], offsets[i]);
+	}
+	EXPECT_EQ(kiwi_res_export(res, 1, &flat, nullptr, 0, kw), KIWIERR_INVALID_INDEX);
+	EXPECT_EQ(kiwi_res_export(res, 0, &flat, strbuf.data(), -1, kw), KIWIERR_INVALID_INDEX);
+	kiwi_res_close(res);
+}
+
 TEST(KiwiC, Joiner)
 {
 	kiwi_h okw = reuse_kiwi_instance();
@@ -241,6 +399,45 @@ TEST(KiwiC, Joiner)
 	EXPECT_EQ(kiwi_joiner_close(joiner), 0);
 }
 
+TEST(KiwiC, JoinBatch)
+{
+	kiwi_h okw = reuse_kiwi_instance();
+	kiwi_analyze_option_t option = { KIWI_MATCH_ALL_WITH_NORMALIZING, };
+	const char* texts[] = { u8"길을 걸어요", u8"시동을 걸었다", u8"좋은 태도입니다" };
+
+	std::vector<int> morph_ids, seq_sizes;
+	for (auto text : texts)
+	{
+		kiwi_res_h res = kiwi_analyze(okw, text, 1, option, nullptr);
+		const int size = kiwi_res_word_num(res, 0);
+		for (int i = 0; i < size; ++i)
+		{
+			morph_ids.emplace_back(kiwi_res_morpheme_id(res, 0, i, okw));
+		}
+		seq_sizes.emplace_back(size);
+		kiwi_res_close(res);
+	}
+
+	kiwi_joined_h joined = kiwi_join_batch(okw, morph_ids.data(), seq_sizes.data(), (int)seq_sizes.size(), 1);
+	ASSERT_NE(joined, nullptr);
+	EXPECT_EQ(kiwi_joined_size(joined), 3);
+
+	int text_size = 0, num_ranges = 0;
+	auto text = kiwi_joined_text_w(joined, &text_size);
+	auto offsets = kiwi_joined_offsets(joined);
+	kiwi_joined_ranges(joined, &num_ranges);
+	auto range_offsets = kiwi_joined_range_offsets(joined);
+	EXPECT_EQ(offsets[3], text_size);
+	EXPECT_EQ(range_offsets[3], num_ranges);
+	EXPECT_EQ(num_ranges, (int)morph_ids.size());
+	EXPECT_EQ(std::u16string((const char16_t*)text + offsets[0], (const char16_t*)text + offsets[1]), u"길을 걸어요");
+	EXPECT_EQ(kiwi_joined_close(joined), 0);
+
+	morph_ids[0] = -1;
+	EXPECT_EQ(kiwi_join_batch(okw, morph_ids.data(), seq_sizes.data(), (int)seq_sizes.size(), 1), nullptr);
+	kiwi_clear_error();
+}
+
 TEST(KiwiC, Regularity)
 {
 	kiwi_h okw = reuse_kiwi_instance();
@@ -350,8 +547,51 @@ TEST(KiwiC, Tokenizer)
 		free(char_buf);
 		free(token_ids_buf);
 	}
-	
 
+	EXPECT_EQ(kiwi_swt_save_binary(swt, "test_tokenizer.bin"), 0);
+	kiwi_swtokenizer_h bin_swt = kiwi_swt_init("test_tokenizer.bin", okw);
+	EXPECT_NE(bin_swt, nullptr);
+	{
+		auto c = u8"한국어에 특화된 토크나이저입니다.";
+		int token_size = kiwi_swt_encode(swt, c, -1, nullptr, 0, nullptr, 0);
+		EXPECT_EQ(kiwi_swt_encode(bin_swt, c, -1, nullptr, 0, nullptr, 0), token_size);
+		std::vector<int> expected(token_size), token_ids(token_size);
+		EXPECT_GE(kiwi_swt_encode(swt, c, -1, expected.data(), token_size, nullptr, 0), 0);
+		EXPECT_GE(kiwi_swt_encode(bin_swt, c, -1, token_ids.data(), token_size, nullptr, 0), 0);
+		EXPECT_EQ(token_ids, expected);
+	}
+	EXPECT_EQ(kiwi_swt_close(bin_swt), 0);
+
+	EXPECT_EQ(kiwi_swt_close(swt), 0);
+}
+
+TEST(KiwiC, TokenizerBatch)
+{
+	kiwi_h okw = reuse_kiwi_instance();
+	kiwi_swtokenizer_h swt = kiwi_swt_init("test/written.tokenizer.json", okw);
+	EXPECT_NE(swt, nullptr);
+	const char* texts[] = {
+		u8"한국어에 특화된 토크나이저입니다.",
+		u8"감사히 먹겠습니당!",
+		u8"",
+	};
+	const int batch_size = 3, max_length = 32;
+	kiwi_swt_batch_option_t option = { max_length, -1, 1, 0, 0 };
+	std::vector<int32_t> token_ids(batch_size * max_length), mask(batch_size * max_length), lengths(batch_size);
+	EXPECT_GE(kiwi_swt_encode_batch(swt, texts, nullptr, batch_size, option, token_ids.data(), mask.data(), nullptr, lengths.data()), 0);
+	for (int i = 0; i < batch_size; ++i)
+	{
+		int token_size = kiwi_swt_encode(swt, texts[i], -1, nullptr, 0, nullptr, 0);
+		EXPECT_EQ(lengths[i], token_size);
+		std::vector<int> single(token_size);
+		kiwi_swt_encode(swt, texts[i], -1, single.data(), token_size, nullptr, 0);
+		for (int j = 0; j < token_size; ++j)
+		{
+			EXPECT_EQ(token_ids[i * max_length + j], single[j]);
+			EXPECT_EQ(mask[i * max_length + j], 1);
+		}
+		for (int j = token_size; j < max_length; ++j) EXPECT_EQ(mask[i * max_length + j], 0);
+	}
 	EXPECT_EQ(kiwi_swt_close(swt), 0);
 }
 
@@ -0,0 +1,112 @@
+#include "gtest/gtest.h"
+#include <vector>
+#include <random>
+#include <cstdio>
+#include "../src/count.hpp"
+
+using namespace kiwi;
+
+namespace
+{
+	using Doc = std::vector<uint16_t>;
+	using Record = std::pair<size_t, std::vector<uint16_t>>;
+
+	std::vector<Doc> makeCorpus(size_t numDocs, size_t vocabSize, uint64_t seed)
+	{
+		std::mt19937_64 rng{ seed };
+		std::uniform_int_distribution<size_t> lenDist{ 2, 24 };
+		// 앞쪽 어휘가 더 자주 나오도록 하여 긴 n-gram도 반복되게 한다.
+		std::geometric_distribution<size_t> wordDist{ 0.3 };
+		std::vector<Doc> docs(numDocs);
+		for (auto& doc : docs)
+		{
+			doc.resize(lenDist(rng));
+			for (auto& w : doc) w = (uint16_t)std::min(wordDist(rng), vocabSize - 1);
+		}
+		return docs;
+	}
+
+	bool fileExists(const std::string& path)
+	{
+		auto* f = std::fopen(path.c_str(), "rb");
+		if (!f) return false;
+		std::fclose(f);
+		return true;
+	}
+}
+
+TEST(NgramCount, ExternalMatchesInMemory)
+{
+	const size_t minCnt = 2, order = 4;
+	const auto docs = makeCorpus(600, 12, 42);
+
+	std::vector<Record> expected;
+	{
+		std::vector<std::pair<uint16_t, uint16_t>> bigramList;
+		auto trie = utils::count(docs.begin(), docs.end(), minCnt, 1, order, nullptr, &bigramList);
+		trie.traverse([&](size_t cnt, const std::vector<uint16_t>& keys)
+		{
+			expected.emplace_back(cnt, keys);
+		});
+	}
+	ASSERT_GT(expected.size(), 12u);
+
+	// KiwiBuilder::buildKnLM의 lmCountChunkSize 경로와 같은 순서로, 말뭉치 전체의 유니그램/바이그램을 센 뒤 n-gram은 조각별로 센다.
+	std::vector<size_t> unigramCf, unigramDf;
+	utils::countUnigrams<uint16_t>(unigramCf, unigramDf, docs.begin(), docs.end(), nullptr);
+	utils::map<std::pair<uint16_t, uint16_t>, size_t> bigramCf, bigramDf;
+	utils::countBigrams(bigramCf, bigramDf, docs.begin(), docs.end(), unigramCf, unigramDf, minCnt, 1, nullptr);
+	const auto validPairs = utils::filterBigrams(bigramCf, bigramDf, minCnt, 1);
+
+	const size_t chunkSize = 37;
+	std::vector<std::string> runPaths;
+	std::vector<Record> merged;
+	{
+		// 최대 fan-in을 2로 두어 run이 여러 단계에 걸쳐 병합되도록 한다.
+		utils::ExternalNgramCounts<uint16_t> runs{ {}, 2 };
+		for (size_t i = 0; i < docs.size(); i += chunkSize)
+		{
+			auto last = docs.begin() + std::min(i + chunkSize, docs.size());
+			utils::ContinuousTrie<utils::CTrieNode<uint16_t>> trie;
+			utils::countNgrams(trie, docs.begin() + i, last, unigramCf, unigramDf, validPairs, minCnt, 1, order, nullptr);
+			runs.addRun(trie);
+		}
+		EXPECT_GT(runs.numRuns(), 4u);
+
+		runs.traverse([&](size_t cnt, const std::vector<uint16_t>& keys)
+		{
+			merged.emplace_back(cnt, keys);
+		});
+		EXPECT_LE(runs.numRuns(), 2u);
+		for (size_t i = 0; i < runs.numRuns(); ++i)
+		{
+			runPaths.emplace_back(runs.getRunPath(i));
+			EXPECT_TRUE(fileExists(runPaths.back()));
+		}
+	}
+
+	EXPECT_EQ(merged, expected);
+	for (auto& path : runPaths)
+	{
+		EXPECT_FALSE(fileExists(path));
+	}
+}
+
+TEST(NgramCount, TempFileSetRemovesFiles)
+{
+	std::vector<std::string> paths;
+	{
+		utils::TempFileSet files{ {}, "kiwi_test" };
+		for (size_t i = 0; i < 3; ++i)
+		{
+			paths.emplace_back(files.newPath());
+			std::FILE* f = std::fopen(paths.back().c_str(), "wb");
+			ASSERT_NE(f, nullptr);
+			std::fputs("test", f);
+			std::fclose(f);
+		}
+		EXPECT_EQ(files.size(), 3u);
+		for (auto& path : paths) EXPECT_TRUE(fileExists(path));
+	}
+	for (auto& path : paths) EXPECT_FALSE(fileExists(path));
+}
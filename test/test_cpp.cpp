@@ -2,6 +2,7 @@
 #include <kiwi/Kiwi.h>
 #include <kiwi/Dataset.h>
 #include <kiwi/SubstringExtractor.h>
+#include <set>
 #include <unordered_map>
 #include <vector>
 #include <sstream>
@@ -202,6 +203,131 @@ TEST(KiwiCpp, ExtractSubstrings)
 	EXPECT_EQ(substrings.size(), 3);
 }
 
+TEST(KiwiCpp, NgramExtractorParallel)
+{
+	const std::u16string sents[] = {
+		u"새로 나온 스마트폰 신제품이 출시되었다.",
+		u"스마트폰 신제품의 가격이 공개되었다.",
+		u"이번 스마트폰 신제품은 카메라 성능이 좋아졌다.",
+		u"많은 사람들이 스마트폰 신제품을 기다리고 있다.",
+		u"오늘 날씨가 맑고 바람이 분다.",
+	};
+	Kiwi kiwiSingle = KiwiBuilder{ MODEL_PATH, 1 }.build();
+	Kiwi kiwiMulti = KiwiBuilder{ MODEL_PATH, 4 }.build();
+
+	const auto makeReader = [&]()
+	{
+		return [&, i = (size_t)0]() mutable -> std::u16string
+		{
+			if (i >= 200) return {};
+			// 문서의 순서가 결과에 드러나도록 문서마다 서로 다른 번호를 붙인다.
+			auto ret = sents[i % 5] + u" " + utf8To16(std::to_string(i));
+			++i;
+			return ret;
+		};
+	};
+
+	NgramExtractor single{ kiwiSingle }, multi{ kiwiMulti };
+	const size_t numTokens = single.addTexts(makeReader());
+	EXPECT_EQ(multi.addTexts(makeReader()), numTokens);
+
+	const auto toSet = [](const std::vector<NgramExtractor::Candidate>& cands)
+	{
+		std::set<std::pair<std::vector<std::u16string>, size_t>> ret;
+		for (auto& c : cands) ret.emplace(c.tokens, c.cnt);
+		return ret;
+	};
+	auto singleCands = single.extract(10000, 10, 5, -1, 1);
+	auto multiCands = multi.extract(10000, 10, 5, -1);
+	EXPECT_GT(singleCands.size(), 0);
+	EXPECT_EQ(toSet(singleCands), toSet(multiCands));
+	for (auto& c : multiCands)
+	{
+		EXPECT_LE(c.df, c.cnt);
+	}
+
+	// 병렬로 추가하더라도 문서와 형태소 번호가 입력 순서대로 매겨지므로, 같은 조건에서 추출한 결과는 순서까지 같아야 한다.
+	const auto toList = [](const std::vector<NgramExtractor::Candidate>& cands)
+	{
+		std::vector<std::tuple<std::u16string, std::vector<std::u16string>, size_t, size_t, float>> ret;
+		for (auto& c : cands) ret.emplace_back(c.text, c.tokens, c.cnt, c.df, c.score);
+		return ret;
+	};
+	EXPECT_EQ(toList(singleCands), toList(multi.extract(10000, 10, 5, -1, 1)));
+}
+
+TEST(KiwiCpp, SharedThreadPool)
+{
+	auto pool = std::make_shared<utils::ThreadPool>(4);
+	KiwiBuilder builder{ MODEL_PATH, 1 };
+	builder.setThreadPool(pool);
+	Kiwi kiwi = builder.build();
+	EXPECT_EQ(kiwi.getThreadPool(), pool.get());
+	EXPECT_EQ(kiwi.getNumThreads(), 4);
+
+	std::atomic<size_t> numArrived{ 0 }, numMismatched{ 0 };
+	utils::runParallel(pool.get(), [&](size_t, size_t numWorkers, utils::Barrier* barrier)
+	{
+		numArrived++;
+		barrier->wait();
+		if (numArrived != numWorkers) numMismatched++;
+	});
+	EXPECT_EQ(numArrived, 4);
+	EXPECT_EQ(numMismatched, 0);
+
+	// 스레드풀의 작업 안에서 같은 스레드풀을 사용하는 분석을 호출해도 교착되지 않아야 한다.
+	auto res = pool->enqueue([&](size_t)
+	{
+		NgramExtractor extractor{ kiwi };
+		size_t i = 0;
+		extractor.addTexts([&]() -> std::u16string
+		{
+			if (i >= 100) return {};
+			return (i++ % 2) ? u"스마트폰 신제품이 출시되었다." : u"스마트폰 신제품의 가격이 공개되었다.";
+		});
+		return extractor.extract(100, 10, 5, -1);
+	});
+	EXPECT_GT(res.get().size(), 0);
+}
+
+TEST(KiwiCpp, BuildThreadInvariance)
+{
+	const std::u16string sents[] = {
+		u"자연 언어 처리와 자연언어처리는 같은 말이다.",
+		u"서울 특별시 강남구에 있는 대한 민국 국립 중앙 박물관",
+		u"감사히 먹겠습니당! 오늘 날씨가 맑고 바람이 분다.",
+		u"새로 나온 스마트폰 신제품이 출시되었다.",
+	};
+
+	// 병렬로 생성한 형태 trie는 스레드 개수와 관계없이 단일 스레드로 생성한 것과 같은 분석 결과를 내야 한다.
+	for (auto typos : { DefaultTypoSet::withoutTypo, DefaultTypoSet::basicTypoSet })
+	{
+		Kiwi single = KiwiBuilder{ MODEL_PATH, 1 }.build(typos);
+		Kiwi multi = KiwiBuilder{ MODEL_PATH, 4 }.build(typos);
+		for (auto& sent : sents)
+		{
+			auto expected = single.analyze(sent, 3, Match::allWithNormalizing);
+			auto res = multi.analyze(sent, 3, Match::allWithNormalizing);
+			ASSERT_EQ(res.size(), expected.size());
+			for (size_t i = 0; i < res.size(); ++i)
+			{
+				ASSERT_EQ(res[i].first.size(), expected[i].first.size());
+				EXPECT_FLOAT_EQ(res[i].second, expected[i].second);
+				for (size_t j = 0; j < res[i].first.size(); ++j)
+				{
+					auto& a = res[i].first[j];
+					auto& b = expected[i].first[j];
+					EXPECT_EQ(a.str, b.str);
+					EXPECT_EQ(a.tag, b.tag);
+					EXPECT_EQ(a.position, b.position);
+					EXPECT_EQ(a.length, b.length);
+					EXPECT_EQ(multi.morphToId(a.morph), single.morphToId(b.morph));
+				}
+			}
+		}
+	}
+}
+
 TEST(KiwiCpp, InitClose)
 {
 	Kiwi& kiwi = reuseKiwiInstance();
@@ -718,6 +844,129 @@ TEST(KiwiCpp, HSDataset)
 	}
 }
 
+TEST(KiwiCpp, HSDatasetPrefetch)
+{
+	KiwiBuilder kw{ MODEL_PATH, 0, BuildOption::default_, };
+	std::vector<std::string> data;
+	data.emplace_back("./ModelGenerator/testHSDataset.txt");
+
+	static constexpr size_t batchSize = 32, windowSize = 8, depth = 3;
+
+	std::array<std::array<int32_t, batchSize* windowSize>, depth> in;
+	std::array<std::array<int32_t, batchSize>, depth> out;
+	std::array<std::array<float, batchSize>, depth> lmLProbs;
+	std::array<std::array<uint32_t, batchSize>, depth> outNgramBase;
+	std::vector<HSBatchBuffer<int32_t, uint32_t>> buffers(depth);
+	for (size_t i = 0; i < depth; ++i)
+	{
+		buffers[i].in = in[i].data();
+		buffers[i].out = out[i].data();
+		buffers[i].lmLProbs = lmLProbs[i].data();
+		buffers[i].outNgramNode = outNgramBase[i].data();
+	}
+
+	for (size_t w : {0, 2})
+	{
+		auto dataset = kw.makeHSDataset(data, batchSize, 0, windowSize, w);
+		dataset.setPrefetchBuffers(buffers);
+		EXPECT_EQ(dataset.getPrefetchDepth(), depth);
+		for (size_t i = 0; i < 2; ++i)
+		{
+			size_t totalTokenCnt = 0;
+			dataset.reset();
+			while (1)
+			{
+				auto batch = dataset.acquireBatch();
+				if (batch.slot >= depth) break;
+				EXPECT_LE(batch.size, batchSize);
+				totalTokenCnt += batch.size;
+				dataset.releaseBatch(batch.slot);
+			}
+			EXPECT_EQ(dataset.numTokens(), totalTokenCnt);
+		}
+		dataset.stopPrefetch();
+		EXPECT_EQ(dataset.getPrefetchDepth(), 0);
+	}
+
+	{
+		auto dataset = kw.makeHSDataset(data, batchSize, 0, windowSize, 2);
+		dataset.setPrefetchBuffers(buffers);
+		dataset.reset();
+		EXPECT_THROW(dataset.releaseBatch(0), std::invalid_argument);
+
+		auto batch = dataset.acquireBatch();
+		ASSERT_LT(batch.slot, depth);
+		size_t totalTokenCnt = batch.size;
+
+		// 진행 중인 prefetch가 있는 상태에서 이동해도 이동된 객체에서 이어서 순회할 수 있어야 한다.
+		auto moved = std::move(dataset);
+		EXPECT_EQ(moved.getPrefetchDepth(), depth);
+		moved.releaseBatch(batch.slot);
+		EXPECT_THROW(moved.releaseBatch(batch.slot), std::invalid_argument);
+		while (1)
+		{
+			batch = moved.acquireBatch();
+			if (batch.slot >= depth) break;
+			totalTokenCnt += batch.size;
+			moved.releaseBatch(batch.slot);
+		}
+		EXPECT_EQ(moved.numTokens(), totalTokenCnt);
+	}
+}
+
+TEST(KiwiCpp, HSDatasetMapped)
+{
+	KiwiBuilder kw{ MODEL_PATH, 0, BuildOption::default_, };
+	std::vector<std::string> data;
+	data.emplace_back("./ModelGenerator/testHSDataset.txt");
+	kw.convertHSData(data, "testHSDataset.bin");
+	// 매핑된 데이터셋이 먼저 해제되도록 데이터셋보다 앞에 선언한다.
+	struct RemoveOnExit
+	{
+		const char* path;
+		~RemoveOnExit() { std::remove(path); }
+	} removeOnExit{ "testHSDataset.bin" };
+
+	static constexpr size_t batchSize = 32, windowSize = 8;
+
+	std::array<int32_t, batchSize* windowSize> in;
+	std::array<int32_t, batchSize> out;
+	std::array<float, batchSize> lmLProbs;
+	std::array<uint32_t, batchSize> outNgramBase;
+	float restLm;
+	uint32_t restLmCnt;
+
+	auto memDataset = kw.makeHSDataset(data, batchSize, 0, windowSize, 1);
+	auto dataset = kw.makeMappedHSDataset({ "testHSDataset.bin" }, batchSize, 0, windowSize, 2);
+	ASSERT_EQ(dataset.numSents(), memDataset.numSents());
+	EXPECT_EQ(dataset.numTokens(), memDataset.numTokens());
+	EXPECT_EQ(dataset.vocabSize(), memDataset.vocabSize());
+	for (size_t i = 0; i < dataset.numSents(); ++i)
+	{
+		auto a = dataset.getSent(i), b = memDataset.getSent(i);
+		EXPECT_TRUE(std::equal(a.begin(), a.end(), b.begin(), b.end()));
+	}
+
+	static constexpr size_t worldSize = 3;
+	for (size_t epoch = 0; epoch < 2; ++epoch)
+	{
+		size_t totalTokenCnt = 0, s;
+		for (size_t rank = 0; rank < worldSize; ++rank)
+		{
+			dataset.seed(42 + epoch);
+			dataset.setShard(rank, worldSize);
+			dataset.reset();
+			while ((s = dataset.next(in.data(), out.data(), lmLProbs.data(), outNgramBase.data(), restLm, restLmCnt)))
+			{
+				EXPECT_LE(s, batchSize);
+				totalTokenCnt += s;
+			}
+		}
+		EXPECT_EQ(dataset.numTokens(), totalTokenCnt);
+	}
+	EXPECT_THROW(dataset.setShard(worldSize, worldSize), std::invalid_argument);
+}
+
 TEST(KiwiCpp, HSDatasetUnlikelihoods)
 {
 	KiwiBuilder kw{ MODEL_PATH, 0, BuildOption::default_, ModelType::cong };
@@ -1217,6 +1466,45 @@ TEST(KiwiCpp, AnalyzeSBG)
 	EXPECT_EQ(resSbg[0].first[8].str, u"걸");
 }
 
+TEST(KiwiCpp, KnLMEvaluateBatch)
+{
+	Kiwi kiwi = KiwiBuilder{ MODEL_PATH, 0, BuildOption::none, ModelType::knlm }.build();
+	auto lm = dynamic_cast<const lm::KnLangModelBase*>(kiwi.getLangModel());
+	ASSERT_NE(lm, nullptr);
+
+	const char16_t* sents[] = {
+		u"이 번호로 전화를 이따가 꼭 반드시 걸어.",
+		u"",
+		u"오늘 점심은 뭐 먹을까?",
+		u"키위는 형태소 분석기입니다.",
+	};
+	std::vector<uint32_t> tokens;
+	std::vector<size_t> offsets = { 0 };
+	for (size_t r = 0; r < 8; ++r)
+	{
+		for (auto sent : sents)
+		{
+			tokens.emplace_back(lm->getHeader().bos_id);
+			for (auto& t : kiwi.analyze(sent, Match::all).first)
+			{
+				tokens.emplace_back(t.morph ? t.morph->lmMorphemeId : lm->getHeader().unk_id);
+			}
+			offsets.emplace_back(tokens.size());
+		}
+	}
+
+	std::vector<float> sentLL(offsets.size() - 1), tokenLL(tokens.size());
+	lm->evaluateBatch(tokens.data(), offsets.data(), offsets.size() - 1, sentLL.data(), tokenLL.data());
+
+	std::vector<float> expected(tokens.size());
+	for (size_t i = 0; i + 1 < offsets.size(); ++i)
+	{
+		lm->evaluate(tokens.begin() + offsets[i], tokens.begin() + offsets[i + 1], expected.begin() + offsets[i]);
+		EXPECT_FLOAT_EQ(sentLL[i], lm->sum(tokens.begin() + offsets[i], tokens.begin() + offsets[i + 1]));
+	}
+	EXPECT_EQ(tokenLL, expected);
+}
+
 TEST(KiwiCpp, AnalyzeCong)
 {
 	Kiwi kiwi = KiwiBuilder{ MODEL_PATH, 0, BuildOption::none, ModelType::congGlobal }.build();
@@ -1227,6 +1515,39 @@ TEST(KiwiCpp, AnalyzeCong)
 	EXPECT_EQ(res[0].first[8].str, u"걸");
 }
 
+TEST(KiwiCpp, AnalyzeCongQ4)
+{
+	Kiwi kiwi = KiwiBuilder{ MODEL_PATH, 0, BuildOption::none, ModelType::congGlobal }.build();
+	Kiwi kiwiQ4 = KiwiBuilder{ MODEL_PATH, 0, BuildOption::none, ModelType::congGlobalQ4 }.build();
+	auto lmQ = dynamic_cast<const lm::CoNgramModelBase*>(kiwi.getLangModel());
+	auto lmQ4 = dynamic_cast<const lm::CoNgramModelBase*>(kiwiQ4.getLangModel());
+	ASSERT_NE(lmQ4, nullptr);
+	if (!lmQ4->hasCompactEmbedding())
+	{
+		// 모델이 4bit로 양자화되어 있지 않으면 8bit 임베딩으로 대체되므로 비교할 대상이 없다.
+		EXPECT_EQ(kiwiQ4.getLangModel()->getType(), ModelType::congGlobal);
+		GTEST_SKIP() << "The model is not 4-bit quantized, so compact embedding is not available";
+	}
+	EXPECT_FALSE(lmQ->hasCompactEmbedding());
+	EXPECT_EQ(kiwiQ4.getLangModel()->getType(), ModelType::congGlobalQ4);
+
+	// 4bit 압축 모드는 필요한 행만 풀어서 기존과 동일한 커널로 계산하므로 결과가 정확히 일치해야 한다.
+	auto res = kiwi.analyze(TEST_SENT, 3, Match::all);
+	auto resQ4 = kiwiQ4.analyze(TEST_SENT, 3, Match::all);
+	ASSERT_EQ(res.size(), resQ4.size());
+	for (size_t i = 0; i < res.size(); ++i)
+	{
+		EXPECT_EQ(res[i].second, resQ4[i].second);
+		EXPECT_EQ(res[i].first, resQ4[i].first);
+	}
+
+	const size_t vocabId = kiwi.findMorphemeId(u"언어", POSTag::nng);
+	std::array<std::pair<uint32_t, float>, 10> result, resultQ4;
+	EXPECT_EQ(lmQ->mostSimilarWords(vocabId, result.size(), result.data()), result.size());
+	EXPECT_EQ(lmQ4->mostSimilarWords(vocabId, resultQ4.size(), resultQ4.data()), resultQ4.size());
+	EXPECT_EQ(result, resultQ4);
+}
+
 TEST(KiwiCpp, CoNgramFunctions)
 {
 	if (sizeof(void*) != 8)
@@ -1276,6 +1597,217 @@ TEST(KiwiCpp, CoNgramFunctions)
 	EXPECT_EQ(lmQ->predictWordsFromContext(contextId, resultQ.size(), resultQ.data()), resultQ.size());
 }
 
+TEST(KiwiCpp, CoNgramBatchFunctions)
+{
+	if (sizeof(void*) != 8)
+	{
+		std::cerr << "This test is only available in 64-bit mode" << std::endl;
+		return;
+	}
+
+	for (auto modelType : { ModelType::congGlobal, ModelType::congGlobalFp32 })
+	{
+		Kiwi kiwi = KiwiBuilder{ MODEL_PATH, 0, BuildOption::default_, modelType }.build();
+		auto lm = dynamic_cast<const lm::CoNgramModelBase*>(kiwi.getLangModel());
+
+		const uint32_t vocabs[4] = {
+			(uint32_t)kiwi.findMorphemeId(u"언어", POSTag::nng),
+			(uint32_t)kiwi.findMorphemeId(u"오늘", POSTag::mag),
+			(uint32_t)-1,
+			(uint32_t)kiwi.findMorphemeId(u"점심", POSTag::nng),
+		};
+		const uint32_t contexts[3] = {
+			lm->toContextId(&vocabs[1], 1),
+			lm->toContextId(&vocabs[3], 1),
+			lm->toContextId(&vocabs[0], 2),
+		};
+		constexpr size_t topN = 10;
+		std::array<std::pair<uint32_t, float>, topN> single;
+		std::array<std::pair<uint32_t, float>, topN * 4> batch;
+		std::array<size_t, 4> batchSizes;
+
+		lm->mostSimilarWordsBatch(vocabs, 4, topN, batch.data(), batchSizes.data());
+		for (size_t i = 0; i < 4; ++i)
+		{
+			EXPECT_EQ(batchSizes[i], lm->mostSimilarWords(vocabs[i], topN, single.data()));
+			for (size_t j = 0; j < batchSizes[i]; ++j)
+			{
+				EXPECT_NEAR(batch[i * topN + j].second, single[j].second, 1e-4f);
+			}
+		}
+
+		lm->predictWordsFromContextBatch(contexts, 3, topN, batch.data(), batchSizes.data());
+		for (size_t i = 0; i < 3; ++i)
+		{
+			EXPECT_EQ(batchSizes[i], lm->predictWordsFromContext(contexts[i], topN, single.data()));
+			for (size_t j = 0; j < batchSizes[i]; ++j)
+			{
+				EXPECT_NEAR(batch[i * topN + j].second, single[j].second, 1e-4f);
+			}
+		}
+
+		std::array<float, 4> sims;
+		lm->wordSimilarityBatch(vocabs[0], vocabs, 4, sims.data());
+		for (size_t i = 0; i < 4; ++i)
+		{
+			if (i == 2) EXPECT_TRUE(std::isnan(sims[i]));
+			else EXPECT_FLOAT_EQ(sims[i], lm->wordSimilarity(vocabs[0], vocabs[i]));
+		}
+	}
+}
+
+TEST(KiwiCpp, WordDetectorThreadInvariance)
+{
+	std::vector<std::u16string> lines;
+	for (auto path : { "eval_data/written.txt", "eval_data/web.txt" })
+	{
+		std::ifstream ifs{ path };
+		std::string line;
+		while (std::getline(ifs, line))
+		{
+			lines.emplace_back(utf8To16(line.substr(0, line.find('\t'))));
+		}
+	}
+	ASSERT_FALSE(lines.empty());
+
+	const auto reader = [&]() -> U16Reader
+	{
+		return [&, i = (size_t)0]() mutable -> std::u16string
+		{
+			return i < lines.size() ? lines[i++] : std::u16string{};
+		};
+	};
+
+	// 샤드 개수와 병합 순서가 달라도 같은 단어가 같은 순서로 추출되어야 한다.
+	auto expected = WordDetector{ MODEL_PATH, 1 }.extractWords(reader, 3, 10, 0.05f);
+	ASSERT_GT(expected.size(), 0);
+	for (size_t numThreads : { 2, 4 })
+	{
+		auto words = WordDetector{ MODEL_PATH, numThreads }.extractWords(reader, 3, 10, 0.05f);
+		ASSERT_EQ(words.size(), expected.size());
+		for (size_t i = 0; i < words.size(); ++i)
+		{
+			EXPECT_EQ(words[i].form, expected[i].form);
+			EXPECT_EQ(words[i].freq, expected[i].freq);
+			EXPECT_FLOAT_EQ(words[i].score, expected[i].score);
+		}
+	}
+}
+
+TEST(KiwiCpp, StreamingWordDetector)
+{
+	KiwiBuilder builder{ MODEL_PATH, 0, BuildOption::default_, ModelType::none };
+	const size_t budget = 4 * 1024 * 1024;
+	StreamingWordDetector detector{ builder.getWordDetector(), budget, 10 };
+	EXPECT_LE(detector.memoryUsage(), budget);
+
+	const std::u16string heads[] = { u"오늘", u"어제", u"친구가", u"매장에서", u"드디어" };
+	const std::u16string lefts[] = { u"", u"새", u"신형", u"중고", u"그", u"저" };
+	// 드물게 쓰이는 조사들이 먼저 나와 분기 슬롯을 차지하더라도, 뒤에 자주 나오는 조사들이 슬롯을 대신해야 한다.
+	const std::u16string rareRights[] = { u"만", u"부터", u"까지", u"처럼", u"보다", u"조차", u"마저", u"이랑" };
+	const std::u16string rights[] = { u"이", u"을", u"은", u"에", u"도", u"의", u"으로", u"과" };
+	const std::u16string tails[] = { u"샀다", u"봤어요", u"좋네요", u"비싸다", u"나왔다" };
+	std::vector<std::u16string> lines;
+	for (size_t i = 0; i < 16; ++i)
+	{
+		lines.emplace_back(heads[i % 5] + u" " + lefts[i % 6] + u"쿠루쿠루폰" + rareRights[i % 8] + u" " + tails[(i / 7) % 5]);
+	}
+	for (size_t i = 0; i < 600; ++i)
+	{
+		lines.emplace_back(heads[i % 5] + u" " + lefts[i % 6] + u"쿠루쿠루폰" + rights[(i / 6) % 8] + u" " + tails[(i / 7) % 5]);
+	}
+
+	std::vector<WordInfo> emitted;
+	detector.setEmitter(2000, 10, 0.1f, [&](std::vector<WordInfo>&& words)
+	{
+		emitted.insert(emitted.end(), words.begin(), words.end());
+	});
+	for (auto& line : lines)
+	{
+		detector.add(line);
+	}
+	EXPECT_GT(detector.numProcessedChars(), 0);
+
+	auto words = detector.extractWords(10, 0.1f, false);
+	ASSERT_GT(words.size(), 0);
+	EXPECT_EQ(words[0].form, u"쿠루쿠루폰");
+	EXPECT_GE(words[0].freq, 600);
+
+	// 분기 엔트로피는 전체 분포를 사용하는 batch 모드의 값과 거의 같아야 한다.
+	auto batchWords = builder.getWordDetector().extractWords([&]() -> U16Reader
+	{
+		return [&, i = (size_t)0]() mutable -> std::u16string
+		{
+			return i < lines.size() ? lines[i++] : std::u16string{};
+		};
+	}, 10, 10, 0.1f);
+	auto batchIt = std::find_if(batchWords.begin(), batchWords.end(), [](const WordInfo& w) { return w.form == u"쿠루쿠루폰"; });
+	ASSERT_NE(batchIt, batchWords.end());
+	EXPECT_NEAR(words[0].rBranch, batchIt->rBranch, 0.1f);
+	EXPECT_NEAR(words[0].lBranch, batchIt->lBranch, 0.1f);
+	EXPECT_TRUE(std::any_of(emitted.begin(), emitted.end(), [](const WordInfo& w) { return w.form == u"쿠루쿠루폰"; }));
+
+	// 이미 추출된 단어는 다시 추출되지 않는다.
+	auto newWords = detector.extractWords(10, 0.1f);
+	EXPECT_TRUE(std::none_of(newWords.begin(), newWords.end(), [](const WordInfo& w) { return w.form == u"쿠루쿠루폰"; }));
+
+	EXPECT_TRUE(builder.addWord(words[0].form).second);
+
+	detector.decay(0.5f);
+	auto decayed = detector.extractWords(10, 0.1f, false);
+	ASSERT_FALSE(decayed.empty());
+	EXPECT_LE(decayed[0].freq, words[0].freq / 2);
+}
+
+TEST(KiwiCpp, CoNgramSimilarityIndex)
+{
+	if (sizeof(void*) != 8)
+	{
+		std::cerr << "This test is only available in 64-bit mode" << std::endl;
+		return;
+	}
+
+	Kiwi kiwi = KiwiBuilder{ MODEL_PATH, 0, BuildOption::default_, ModelType::congGlobal }.build();
+	auto lm = dynamic_cast<const lm::CoNgramModelBase*>(kiwi.getLangModel());
+
+	const size_t vocabId = kiwi.findMorphemeId(u"언어", POSTag::nng);
+	const uint32_t vocabs[3] = {
+		(uint32_t)kiwi.findMorphemeId(u"오늘", POSTag::mag),
+		(uint32_t)kiwi.findMorphemeId(u"점심", POSTag::nng),
+		(uint32_t)kiwi.findMorphemeId(u"은", POSTag::jx),
+	};
+	const uint32_t contextId = lm->toContextId(&vocabs[0], 3);
+	std::array<std::pair<uint32_t, float>, 10> exact, approx;
+
+	EXPECT_EQ(lm->mostSimilarWords(vocabId, exact.size(), exact.data()), exact.size());
+
+	// 모든 클러스터를 탐색하면 전체 탐색과 결과가 같아야 한다.
+	lm->setSimilarityIndex(64, 64);
+	EXPECT_EQ(lm->mostSimilarWords(vocabId, approx.size(), approx.data()), approx.size());
+	for (size_t i = 0; i < exact.size(); ++i)
+	{
+		EXPECT_FLOAT_EQ(exact[i].second, approx[i].second);
+	}
+
+	lm->setSimilarityIndex(8, 64);
+	EXPECT_EQ(lm->mostSimilarWords(vocabId, approx.size(), approx.data()), approx.size());
+	for (auto& p : approx)
+	{
+		EXPECT_NE(p.first, vocabId);
+		EXPECT_FLOAT_EQ(lm->wordSimilarity(vocabId, p.first), p.second);
+	}
+
+	lm->setSimilarityIndex(0);
+	EXPECT_EQ(lm->mostSimilarContexts(contextId, exact.size(), exact.data()), exact.size());
+	lm->setSimilarityIndex(64, 64);
+	EXPECT_EQ(lm->mostSimilarContexts(contextId, approx.size(), approx.data()), approx.size());
+	for (size_t i = 0; i < exact.size(); ++i)
+	{
+		EXPECT_FLOAT_EQ(exact[i].second, approx[i].second);
+	}
+	lm->setSimilarityIndex(0);
+}
+
 TEST(KiwiCpp, AnalyzeMultithread)
 {
 	auto data = loadTestCorpus();
@@ -1293,6 +1825,81 @@ TEST(KiwiCpp, AnalyzeMultithread)
 	EXPECT_EQ(data.size(), results.size());
 }
 
+TEST(KiwiCpp, AnalyzeBulk)
+{
+	auto data = loadTestCorpus();
+	Kiwi kiwi = KiwiBuilder{ MODEL_PATH, 4 }.build();
+	for (bool ordered : { true, false })
+	{
+		std::vector<TokenResult> results(data.size());
+		std::vector<size_t> received;
+		size_t idx = 0;
+		size_t numRead = kiwi.analyzeBulk(1, [&]() -> std::u16string
+		{
+			if (idx >= data.size()) return {};
+			return utf8To16(data[idx++]);
+		}, [&](size_t i, std::vector<TokenResult>&& res)
+		{
+			received.emplace_back(i);
+			results[i] = std::move(res[0]);
+		}, Match::all, BulkAnalyzeOption{ 16, 8, 256, ordered });
+		EXPECT_EQ(numRead, data.size());
+		ASSERT_EQ(received.size(), data.size());
+		if (ordered)
+		{
+			for (size_t i = 0; i < received.size(); ++i) EXPECT_EQ(received[i], i);
+		}
+		std::sort(received.begin(), received.end());
+		EXPECT_EQ(std::unique(received.begin(), received.end()), received.end());
+
+		for (size_t i = 0; i < data.size(); i += 97)
+		{
+			auto expected = kiwi.analyze(data[i], Match::all);
+			ASSERT_EQ(results[i].first.size(), expected.first.size());
+			for (size_t j = 0; j < expected.first.size(); ++j)
+			{
+				EXPECT_EQ(results[i].first[j].str, expected.first[j].str);
+				EXPECT_EQ(results[i].first[j].tag, expected.first[j].tag);
+			}
+		}
+	}
+}
+
+TEST(KiwiCpp, TrimScratch)
+{
+	Kiwi kiwi = KiwiBuilder{ MODEL_PATH, 2 }.build();
+	std::u16string longText;
+	for (size_t i = 0; i < 200; ++i) longText += u"아버지가 방에 들어가신다. 오늘은 날씨가 맑고 바람이 분다. ";
+	auto expected = kiwi.analyze(longText, Match::allWithNormalizing);
+	kiwi.asyncAnalyze(longText, Match::allWithNormalizing).get();
+	
+	auto stats = Kiwi::getScratchStats();
+	EXPECT_GT(stats.retainedBytes, 0);
+	EXPECT_GT(stats.peakBytes, 0);
+	EXPECT_GT(utils::ScratchRegistry::local().bytes(), 0);
+
+	EXPECT_GT(kiwi.trimScratch(), 0);
+	auto trimmedStats = Kiwi::getScratchStats();
+	EXPECT_LT(trimmedStats.retainedBytes, stats.retainedBytes);
+	EXPECT_GT(trimmedStats.numTrims, stats.numTrims);
+	EXPECT_EQ(utils::ScratchRegistry::local().bytes(), 0);
+
+	// 해제 이후에도 분석 결과는 동일해야 한다
+	auto res = kiwi.analyze(longText, Match::allWithNormalizing);
+	ASSERT_EQ(res.first.size(), expected.first.size());
+	for (size_t i = 0; i < res.first.size(); ++i)
+	{
+		EXPECT_EQ(res.first[i].str, expected.first[i].str);
+		EXPECT_EQ(res.first[i].tag, expected.first[i].tag);
+	}
+
+	const size_t prevLimit = utils::getScratchRetainLimit();
+	Kiwi::setScratchRetainLimit(0);
+	kiwi.analyze(longText, Match::allWithNormalizing);
+	Kiwi::setScratchRetainLimit(prevLimit);
+	EXPECT_EQ(utils::ScratchRegistry::local().bytes(), 0);
+}
+
 TEST(KiwiCpp, AnalyzeError01)
 {
 	Kiwi& kiwi = reuseKiwiInstance();
@@ -1972,6 +2579,128 @@ TEST(KiwiCpp, JoinRestore)
 	}
 }
 
+TEST(KiwiCpp, JoinCache)
+{
+	Kiwi& kiwi = reuseKiwiInstance();
+	const size_t origCacheSize = kiwi.getJoinerCacheSize();
+	auto joinAll = [&](const std::vector<std::pair<std::u16string, POSTag>>& morphs)
+	{
+		auto joiner = kiwi.newJoiner(false);
+		for (auto& m : morphs) joiner.add(m.first, m.second);
+		return joiner.getU16();
+	};
+	const std::vector<std::vector<std::pair<std::u16string, POSTag>>> samples = {
+		{ { u"먹", POSTag::vv }, { u"었", POSTag::ep }, { u"다", POSTag::ef } },
+		{ { u"듣", POSTag::vvi }, { u"어요", POSTag::ef } },
+		{ { u"하", POSTag::vv }, { u"았", POSTag::ep }, { u"다", POSTag::ef } },
+		{ { u"사랑", POSTag::nng }, { u"이", POSTag::vcp }, { u"다", POSTag::ef } },
+		{ { u"나", POSTag::np }, { u"이", POSTag::vcp }, { u"에요", POSTag::ef } },
+	};
+
+	kiwi.setJoinerCacheSize(0);
+	std::vector<std::u16string> expected;
+	for (auto& s : samples) expected.emplace_back(joinAll(s));
+
+	kiwi.setJoinerCacheSize(1024);
+	for (size_t i = 0; i < 2; ++i)
+	{
+		for (size_t j = 0; j < samples.size(); ++j)
+		{
+			EXPECT_EQ(joinAll(samples[j]), expected[j]);
+		}
+	}
+	auto stats = kiwi.getJoinerCacheStats();
+	EXPECT_GT(stats.size, 0);
+	EXPECT_GT(stats.hits, 0);
+
+	kiwi.clearJoinerCache();
+	EXPECT_GT(kiwi.warmUpJoinerCache(256), 0);
+	EXPECT_LE(kiwi.getJoinerCacheStats().size, 256);
+	EXPECT_EQ(joinAll(samples[0]), expected[0]);
+
+	kiwi.setJoinerCacheSize(origCacheSize);
+}
+
+TEST(KiwiCpp, JoinLongText)
+{
+	Kiwi& kiwi = reuseKiwiInstance();
+	const char16_t* sample = u"오늘은 비가 와서 집에서 책을 읽었는데, 생각보다 재미있어서 끝까지 다 읽어 버렸다.";
+	auto tokens = kiwi.analyze(sample, Match::allWithNormalizing).first;
+
+	for (bool lmSearch : { true, false })
+	{
+		auto joiner = kiwi.newJoiner(lmSearch);
+		std::u16string flushed;
+		for (size_t r = 0; r < 20; ++r)
+		{
+			for (auto& t : tokens)
+			{
+				joiner.add(t.str, t.tag, false);
+				flushed += joiner.flushU16();
+			}
+		}
+
+		auto copied = joiner;
+		std::vector<std::pair<uint32_t, uint32_t>> ranges, copiedRanges;
+		auto joined = joiner.getU16(&ranges);
+		EXPECT_EQ(copied.getU16(&copiedRanges), joined);
+		EXPECT_EQ(copiedRanges, ranges);
+		EXPECT_EQ(ranges.size(), tokens.size() * 20);
+		// 같은 내용을 확정한 후보끼리 노드를 공유하고 버려진 노드는 정리되므로, 저장소는 결합 결과에 비례하는 크기로 유지된다.
+		EXPECT_LE(joiner.getArenaSize(), joined.size() * 2);
+		EXPECT_LE(copied.getArenaSize(), joined.size() * 2);
+
+		flushed += joiner.flushU16(true);
+		EXPECT_EQ(flushed, joined);
+
+		auto single = kiwi.newJoiner(lmSearch);
+		for (auto& t : tokens) single.add(t.str, t.tag, false);
+		std::u16string expected;
+		for (size_t r = 0; r < 20; ++r)
+		{
+			if (r) expected += u' ';
+			expected += single.getU16();
+		}
+		EXPECT_EQ(joined, expected);
+	}
+}
+
+TEST(KiwiCpp, JoinBatch)
+{
+	Kiwi& kiwi = reuseKiwiInstance();
+	std::vector<std::vector<std::pair<std::u16string, POSTag>>> morphSeqs;
+	std::vector<std::vector<size_t>> morphIdSeqs;
+	std::vector<std::u16string> expected;
+	for (auto c : { u"길을 걸어요", u"시동을 걸었다", u"좋은 태도입니다", u"", u"음악용 CD를 들을 수 있다" })
+	{
+		auto tokens = kiwi.analyze(c, Match::allWithNormalizing).first;
+		morphSeqs.emplace_back();
+		morphIdSeqs.emplace_back();
+		auto joiner = kiwi.newJoiner();
+		for (auto& t : tokens)
+		{
+			morphSeqs.back().emplace_back(t.str, t.tag);
+			morphIdSeqs.back().emplace_back(kiwi.morphToId(t.morph));
+			joiner.add(t.str, t.tag);
+		}
+		expected.emplace_back(joiner.getU16());
+	}
+
+	auto res = kiwi.joinBatch(morphSeqs);
+	auto resById = kiwi.joinBatch(morphIdSeqs);
+	ASSERT_EQ(res.size(), expected.size());
+	ASSERT_EQ(resById.size(), expected.size());
+	for (size_t i = 0; i < expected.size(); ++i)
+	{
+		EXPECT_EQ(std::u16string{ res.get(i) }, expected[i]);
+		EXPECT_EQ(std::u16string{ resById.get(i) }, expected[i]);
+		EXPECT_EQ(res.rangeOffsets[i + 1] - res.rangeOffsets[i], morphSeqs[i].size());
+	}
+	EXPECT_EQ(res.textOffsets.back(), res.text.size());
+
+	EXPECT_THROW(kiwi.joinBatch(std::vector<std::vector<size_t>>{ { (size_t)-1 } }), std::invalid_argument);
+}
+
 TEST(KiwiCpp, JoinZSiot)
 {
 	Kiwi& kiwi = reuseKiwiInstance();
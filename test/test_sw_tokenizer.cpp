@@ -1,5 +1,6 @@
 ﻿#include "gtest/gtest.h"
 #include <fstream>
+#include <sstream>
 #include <kiwi/Kiwi.h>
 #include <kiwi/SwTokenizer.h>
 #include "common.h"
@@ -34,6 +35,27 @@ constexpr std::vector<std::pair<Ty, Ty>> toPair(const ATy(&init)[n])
 }
 #endif
 
+namespace
+{
+	// 되감기를 지원하지 않는 스트림. 파이프나 압축 해제 스트림을 흉내낸다.
+	class ForwardOnlyStream : public std::istream
+	{
+		struct Buf : public std::streambuf
+		{
+			std::string data;
+			Buf(std::string _data) : data{ std::move(_data) }
+			{
+				setg(&data[0], &data[0], &data[0] + data.size());
+			}
+		} buf;
+	public:
+		ForwardOnlyStream(std::string data) : std::istream{ nullptr }, buf{ std::move(data) }
+		{
+			rdbuf(&buf);
+		}
+	};
+}
+
 TEST(KiwiSwTokenizer, Builder)
 {
 	using VocabTy = std::tuple<std::string, POSTag, SwTokenFlag, float>;
@@ -208,6 +230,340 @@ TEST(KiwiSwTokenizer, BasicEncodeAndDecode)
 	}
 }
 
+TEST(KiwiSwTokenizer, EncodeBatch)
+{
+	SwTokenizer tokenizer;
+	{
+		std::ifstream ifs{ "test/written.tokenizer.json" };
+		tokenizer = SwTokenizer::load(reuseKiwiInstance(), ifs);
+	}
+
+	const std::vector<std::string> strs = {
+		u8"한국어에 특화된 토크나이저입니다.",
+		u8"",
+		u8"감사히 먹겠습니당!",
+		u8"노래진 손톱을 봤던걸요.",
+		u8"제임스웹우주천체망원경",
+	};
+	const size_t maxLength = 8, padId = 3;
+	std::vector<int64_t> ids(strs.size() * maxLength), mask(strs.size() * maxLength), offsets(strs.size() * maxLength * 2), lengths(strs.size());
+	SwBatchEncodeOption option{ maxLength, true, false, padId };
+	const size_t longest = tokenizer.encodeBatch(strs.data(), strs.size(), option, ids.data(), mask.data(), offsets.data(), lengths.data());
+
+	size_t expectedLongest = 0;
+	for (size_t i = 0; i < strs.size(); ++i)
+	{
+		std::vector<std::pair<uint32_t, uint32_t>> offset;
+		auto encoded = tokenizer.encode(strs[i], &offset);
+		expectedLongest = std::max(expectedLongest, encoded.size());
+		const size_t len = std::min(encoded.size(), maxLength);
+		EXPECT_EQ(lengths[i], len);
+		for (size_t j = 0; j < maxLength; ++j)
+		{
+			if (j < len)
+			{
+				EXPECT_EQ(ids[i * maxLength + j], encoded[j]);
+				EXPECT_EQ(mask[i * maxLength + j], 1);
+				EXPECT_EQ(offsets[(i * maxLength + j) * 2], offset[j].first);
+				EXPECT_EQ(offsets[(i * maxLength + j) * 2 + 1], offset[j].second);
+			}
+			else
+			{
+				EXPECT_EQ(ids[i * maxLength + j], padId);
+				EXPECT_EQ(mask[i * maxLength + j], 0);
+			}
+		}
+	}
+	EXPECT_EQ(longest, expectedLongest);
+
+	std::vector<int32_t> ids32(strs.size() * maxLength), mask32(strs.size() * maxLength);
+	option.padLeft = true;
+	tokenizer.encodeBatch(strs.data(), strs.size(), option, ids32.data(), mask32.data());
+	for (size_t i = 0; i < strs.size(); ++i)
+	{
+		const size_t padSize = maxLength - lengths[i];
+		for (size_t j = 0; j < maxLength; ++j)
+		{
+			if (j < padSize) EXPECT_EQ(mask32[i * maxLength + j], 0);
+			else EXPECT_EQ(ids32[i * maxLength + j], ids[i * maxLength + j - padSize]);
+		}
+	}
+
+	option.truncation = false;
+	EXPECT_THROW(tokenizer.encodeBatch(strs.data(), strs.size(), option, ids32.data()), SwTokenizerException);
+}
+
+TEST(KiwiSwTokenizer, SharedThreadPool)
+{
+	auto pool = std::make_shared<utils::ThreadPool>(4);
+	KiwiBuilder builder{ MODEL_PATH, 1 };
+	builder.setThreadPool(pool);
+	Kiwi kiwi = builder.build();
+
+	SwTokenizer tokenizer;
+	{
+		std::ifstream ifs{ "test/written.tokenizer.json" };
+		tokenizer = SwTokenizer::load(kiwi, ifs);
+	}
+
+	std::vector<std::string> strs;
+	for (size_t i = 0; i < 64; ++i)
+	{
+		strs.emplace_back(i % 2 ? u8"한국어에 특화된 토크나이저입니다." : u8"노래진 손톱을 봤던걸요.");
+	}
+	const size_t maxLength = 16;
+	const SwBatchEncodeOption option{ maxLength };
+	std::vector<int32_t> expected(strs.size() * maxLength);
+	tokenizer.encodeBatch(strs.data(), strs.size(), option, expected.data());
+
+	// 모든 작업 스레드가 동시에 같은 스레드풀을 사용하는 encodeBatch를 호출해도 교착되지 않아야 한다.
+	std::vector<std::future<std::vector<int32_t>>> futures;
+	for (size_t i = 0; i < pool->size(); ++i)
+	{
+		futures.emplace_back(pool->enqueue([&](size_t)
+		{
+			std::vector<int32_t> ids(strs.size() * maxLength);
+			tokenizer.encodeBatch(strs.data(), strs.size(), option, ids.data());
+			return ids;
+		}));
+	}
+	for (auto& f : futures)
+	{
+		EXPECT_EQ(f.get(), expected);
+	}
+}
+
+TEST(KiwiSwTokenizer, SubwordCache)
+{
+	SwTokenizer tokenizer;
+	{
+		std::ifstream ifs{ "test/written.tokenizer.json" };
+		tokenizer = SwTokenizer::load(reuseKiwiInstance(), ifs);
+	}
+
+	const std::vector<std::string> strs = {
+		u8"한국어에 특화된 토크나이저입니다.",
+		u8"감사히 먹겠습니당!",
+		u8"노래진 손톱을 봤던걸요.",
+		u8"제임스웹우주천체망원경",
+		u8"그만해여~",
+	};
+
+	tokenizer.setSubwordCacheSize(0);
+	std::vector<std::vector<uint32_t>> expectedIds;
+	std::vector<std::vector<std::pair<uint32_t, uint32_t>>> expectedOffsets;
+	for (auto& s : strs)
+	{
+		expectedOffsets.emplace_back();
+		expectedIds.emplace_back(tokenizer.encode(s, &expectedOffsets.back()));
+	}
+	EXPECT_EQ(tokenizer.getSubwordCacheStats().size, 0);
+
+	tokenizer.setSubwordCacheSize(1024);
+	EXPECT_EQ(tokenizer.getSubwordCacheSize(), 1024);
+	for (size_t iter = 0; iter < 2; ++iter)
+	{
+		for (size_t i = 0; i < strs.size(); ++i)
+		{
+			std::vector<std::pair<uint32_t, uint32_t>> offsets;
+			EXPECT_EQ(tokenizer.encode(strs[i], &offsets), expectedIds[i]);
+			EXPECT_EQ(offsets, expectedOffsets[i]);
+			EXPECT_EQ(tokenizer.encode(strs[i]), expectedIds[i]);
+		}
+	}
+	auto stats = tokenizer.getSubwordCacheStats();
+	EXPECT_GT(stats.size, 0);
+	EXPECT_GT(stats.hits, 0);
+	EXPECT_LE(stats.size, stats.capacity);
+
+	// 샤드 개수보다 작은 용량에서도 전체 항목 수는 용량을 넘지 않아야 한다.
+	for (size_t capacity : { 1, 3, 20 })
+	{
+		tokenizer.setSubwordCacheSize(capacity);
+		for (size_t i = 0; i < strs.size(); ++i)
+		{
+			EXPECT_EQ(tokenizer.encode(strs[i]), expectedIds[i]);
+			EXPECT_LE(tokenizer.getSubwordCacheStats().size, capacity);
+		}
+	}
+	tokenizer.setSubwordCacheSize(1024);
+
+	tokenizer.clearSubwordCache();
+	EXPECT_EQ(tokenizer.getSubwordCacheStats().size, 0);
+	EXPECT_GT(tokenizer.warmUpSubwordCache({ { u8"제임스웹우주천체망원경", 10 }, { u8"손톱", 3 } }), 0);
+	EXPECT_EQ(tokenizer.encode(strs[0]), expectedIds[0]);
+}
+
+TEST(KiwiSwTokenizer, TrainerMaxWordMapSize)
+{
+	std::vector<std::string> lines;
+	for (auto path : { "eval_data/written.txt", "eval_data/web.txt" })
+	{
+		std::ifstream ifs{ path };
+		std::string line;
+		while (std::getline(ifs, line))
+		{
+			lines.emplace_back(line.substr(0, line.find('\t')));
+		}
+	}
+	ASSERT_FALSE(lines.empty());
+
+	const auto train = [&](UnigramSwTrainer& trainer)
+	{
+		// 앞쪽 문장을 더 자주 넣어 빈도 차이가 생기게 한다.
+		for (size_t rep = 1; rep <= 4; ++rep)
+		{
+			size_t i = 0;
+			const size_t numLines = lines.size() * rep / 4;
+			trainer.addSentences([&]() -> std::string
+			{
+				return i < numLines ? lines[i++] : std::string{};
+			});
+		}
+	};
+
+	SwTokenizerConfig config;
+	UnigramSwTrainerConfig trainConfig;
+	UnigramSwTrainer unbounded{ reuseKiwiInstance(), config, trainConfig };
+	train(unbounded);
+	const size_t numWords = unbounded.getNumWords();
+	ASSERT_GT(numWords, 100);
+
+	trainConfig.maxWordMapSize = numWords * 3 / 4;
+	UnigramSwTrainer bounded{ reuseKiwiInstance(), config, trainConfig };
+	train(bounded);
+	EXPECT_LE(bounded.getNumWords(), trainConfig.maxWordMapSize);
+	EXPECT_GT(bounded.getNumWords(), 0);
+
+	unbounded.buildSubwordVocabs(2);
+	bounded.buildSubwordVocabs(2);
+	const size_t unboundedVocabSize = unbounded.getCurrentVocabSize();
+	const size_t boundedVocabSize = bounded.getCurrentVocabSize();
+	EXPECT_GE(boundedVocabSize, unboundedVocabSize * 8 / 10);
+	EXPECT_LE(boundedVocabSize, unboundedVocabSize * 12 / 10);
+}
+
+TEST(KiwiSwTokenizer, BinaryFormat)
+{
+	const std::vector<std::string> strs = {
+		u8"한국어에 특화된 토크나이저입니다.",
+		u8"감사히 먹겠습니당!",
+		u8"노래진 손톱을 봤던걸요.",
+		u8"분석이 어려운 유니코드에는 💯η💢💥 등이 있다.",
+		u8"[CLS] 제임스웹우주천체망원경 [SEP]",
+	};
+
+	for (auto path : { "test/written.tokenizer.json", "test/written.fallback_byte.tokenizer.json" })
+	{
+		SwTokenizer tokenizer;
+		{
+			std::ifstream ifs{ path };
+			EXPECT_FALSE(SwTokenizer::isBinaryFormat(ifs));
+			tokenizer = SwTokenizer::load(reuseKiwiInstance(), ifs);
+		}
+
+		std::stringstream ss;
+		tokenizer.saveBinary(ss);
+		EXPECT_TRUE(SwTokenizer::isBinaryFormat(ss));
+		auto loaded = SwTokenizer::loadBinary(reuseKiwiInstance(), ss);
+
+		{
+			ForwardOnlyStream fs{ ss.str() };
+			EXPECT_TRUE(SwTokenizer::isBinaryFormat(fs));
+			EXPECT_EQ(SwTokenizer::loadBinary(reuseKiwiInstance(), fs).size(), tokenizer.size());
+		}
+
+		{
+			const std::string binPath = "test_binary_tokenizer.bin";
+			{
+				std::ofstream ofs{ binPath, std::ios_base::binary };
+				tokenizer.saveBinary(ofs);
+			}
+			auto mapped = SwTokenizer::loadBinary(reuseKiwiInstance(), binPath);
+			std::remove(binPath.c_str());
+			EXPECT_EQ(mapped.size(), tokenizer.size());
+			for (auto& s : strs)
+			{
+				EXPECT_EQ(mapped.encode(s), tokenizer.encode(s));
+			}
+		}
+
+		EXPECT_EQ(loaded.size(), tokenizer.size());
+		for (size_t i = 0; i < tokenizer.size(); ++i)
+		{
+			auto& a = tokenizer.getVocab(i);
+			auto& b = loaded.getVocab(i);
+			EXPECT_EQ(std::u16string(a.form, a.length), std::u16string(b.form, b.length));
+			EXPECT_EQ(a.pos, b.pos);
+			EXPECT_EQ(a.flags, b.flags);
+		}
+		for (size_t i = 0; i <= SwTokenizerConfig::glue; ++i)
+		{
+			auto t = (SwTokenizerConfig::SpecialToken)i;
+			EXPECT_EQ(loaded.getSpecialTokenId(t), tokenizer.getSpecialTokenId(t));
+		}
+
+		for (auto& s : strs)
+		{
+			std::vector<std::pair<uint32_t, uint32_t>> expectedOffsets, offsets;
+			auto expected = tokenizer.encode(s, &expectedOffsets);
+			EXPECT_EQ(loaded.encode(s, &offsets), expected);
+			EXPECT_EQ(offsets, expectedOffsets);
+			EXPECT_EQ(loaded.decode(expected), tokenizer.decode(expected));
+		}
+	}
+
+	{
+		std::ifstream ifs{ "test/written.tokenizer.json" };
+		EXPECT_THROW(SwTokenizer::loadBinary(reuseKiwiInstance(), ifs), SwTokenizerException);
+	}
+
+	{
+		std::ifstream ifs{ "test/written.tokenizer.json" };
+		std::string json{ std::istreambuf_iterator<char>{ ifs }, std::istreambuf_iterator<char>{} };
+		ForwardOnlyStream fs{ json };
+		std::istringstream iss{ json };
+		EXPECT_FALSE(SwTokenizer::isBinaryFormat(fs));
+		EXPECT_EQ(SwTokenizer::load(reuseKiwiInstance(), fs).size(), SwTokenizer::load(reuseKiwiInstance(), iss).size());
+	}
+}
+
+TEST(KiwiSwTokenizer, StreamingDecoder)
+{
+	const std::vector<std::string> strs = {
+		u8"한국어에 특화된 토크나이저입니다.",
+		u8"감사히 먹겠습니당!",
+		u8"노래진 손톱을 봤던걸요.",
+		u8"말한 옛사람을 생각했어..",
+		u8"분석이 어려운 유니코드에는 💯η💢💥 등이 있다.",
+	};
+
+	for (auto path : { "test/written.tokenizer.json", "test/written.fallback_byte.tokenizer.json" })
+	{
+		SwTokenizer tokenizer;
+		{
+			std::ifstream ifs{ path };
+			tokenizer = SwTokenizer::load(reuseKiwiInstance(), ifs);
+		}
+
+		auto decoder = tokenizer.newDecoder();
+		for (auto& s : strs)
+		{
+			auto ids = tokenizer.encode(s);
+			auto expected = tokenizer.decode(ids);
+			std::string streamed;
+			for (auto id : ids)
+			{
+				streamed += decoder.add(id);
+				// 한 번 반환된 부분은 이후에 바뀌지 않아야 한다.
+				EXPECT_EQ(streamed, expected.substr(0, streamed.size()));
+			}
+			streamed += decoder.finish();
+			EXPECT_EQ(streamed, expected);
+		}
+	}
+}
+
 TEST(KiwiSwTokenizer, EncodeFromAlreadyTokenized)
 {
 	SwTokenizer tokenizer;
@@ -2,6 +2,7 @@
 #include "common.h"
 #include <kiwi/Kiwi.h>
 #include <kiwi/TypoTransformer.h>
+#include <map>
 
 using namespace kiwi;
 
@@ -26,6 +27,34 @@ TEST(KiwiTypo, GenerateGraph)
 	EXPECT_GT(size, 0);
 }
 
+TEST(KiwiTypo, GenerateGraphCostThreshold)
+{
+	auto ptt = getDefaultTypoSet(DefaultTypoSet::basicTypoSet).prepare(true);
+	std::u16string nstr;
+	normalizeHangul(nstr, std::u16string_view{ u"외않됀데? 나 죰 도와죠. 맗은 믈을 마셧다! " });
+
+	std::vector<TypoGraphNode> graph, prunedGraph;
+	ptt.generateGraph(nstr, graph);
+	ptt.generateGraph(nstr, prunedGraph, Dialect::standard, nullptr, nullptr, nullptr, 1.f);
+	EXPECT_LT(prunedGraph.size(), graph.size());
+	size_t numOrig = 0, numPrunedOrig = 0;
+	for (auto& n : graph) numOrig += n.typoCost == 0;
+	for (auto& n : prunedGraph)
+	{
+		EXPECT_LE(n.typoCost, 1.f);
+		numPrunedOrig += n.typoCost == 0;
+	}
+	// 오타가 없는 원래 경로는 임계값과 상관없이 항상 유지되어야 한다.
+	EXPECT_EQ(numPrunedOrig, numOrig);
+
+	// 그래프의 크기는 입력의 길이에 비례해야 한다.
+	std::u16string longStr;
+	for (size_t i = 0; i < 100; ++i) longStr += nstr;
+	std::vector<TypoGraphNode> longGraph;
+	ptt.generateGraph(longStr, longGraph, Dialect::standard, nullptr, nullptr, nullptr, 2.5f);
+	EXPECT_LE(longGraph.size(), graph.size() * 100);
+}
+
 TEST(KiwiTypo, Generate)
 {
 	TypoTransformer tt;
@@ -74,6 +103,41 @@ TEST(KiwiTypo, Generate)
 	EXPECT_EQ(typos.find(u"사애")->second, 1);
 }
 
+TEST(KiwiTypo, GenerateCostPruning)
+{
+	TypoTransformer tt;
+	tt.addTypo(u"ㅐ", u"ㅔ");
+	tt.addTypo(u"ㅔ", u"ㅐ", 1.5f);
+	auto ptt = tt.prepare();
+
+	// 임계값 안쪽의 결과는 임계값 없이 생성한 뒤 걸러낸 결과와 같아야 한다.
+	std::u16string str;
+	for (size_t i = 0; i < 10; ++i) str += (i % 3) ? u"개 " : u"네 ";
+	std::map<std::u16string, float> expected, typos;
+	for (auto e : ptt.generate(str, 100))
+	{
+		if (e.cost <= 2.5f) expected.emplace(e.str, e.cost);
+	}
+	for (auto e : ptt.generate(str, 2.5f))
+	{
+		typos.emplace(e.str, e.cost);
+	}
+	EXPECT_EQ(typos, expected);
+
+	// 후보 조합은 2^40개이지만, 누적 비용이 임계값을 넘는 조합은 건너뛰므로 유효한 것만 빠르게 순회한다.
+	str.clear();
+	for (size_t i = 0; i < 40; ++i) str += u"개 ";
+	auto cands = ptt.generate(str, 2);
+	EXPECT_EQ(cands.size(), (size_t)1 << 40);
+	size_t n = 0;
+	for (auto e : cands)
+	{
+		EXPECT_LE(e.cost, 2);
+		++n;
+	}
+	EXPECT_EQ(n, 1 + 40 + 40 * 39 / 2);
+}
+
 TEST(KiwiTypo, BasicTypoSet)
 {
 	auto ptt = getDefaultTypoSet(DefaultTypoSet::basicTypoSet).prepare();
@@ -164,6 +228,43 @@ TEST(KiwiTypo, AnalyzeBasicTypoSet)
 		option);
 }
 
+TEST(KiwiTypo, AnalyzeLongTextWithTypoThreshold)
+{
+	KiwiBuilder builder{ MODEL_PATH, 0, BuildOption::default_, };
+	Kiwi kiwi = builder.build();
+
+	auto ptt = getDefaultTypoSet(DefaultTypoSet::basicTypoSet).prepare(true);
+	auto config = kiwi.getGlobalConfig();
+	config.typoCostWeight = 5;
+	kiwi.setGlobalConfig(config);
+
+	// 오타가 여러 곳에 반복되는 긴 입력에서도 탐색 중 누적된 오타 비용이 임계값을 넘는 경로는 버려져야 한다.
+	static constexpr size_t numRepeats = 30;
+	std::u16string text;
+	for (size_t i = 0; i < numRepeats; ++i) text += u"외않됀데? 나 죰 도와죠. ";
+
+	for (float threshold : { 0.f, 1.f, 2.5f })
+	{
+		AnalyzeOption option;
+		option.match = Match::allWithNormalizing;
+		option.typoTransformer = &ptt;
+		option.typoThreshold = threshold;
+		auto res = kiwi.analyze(text, option);
+		ASSERT_FALSE(res.first.empty());
+
+		size_t numCorrected = 0;
+		for (auto& t : res.first)
+		{
+			// 덧붙은 받침과 사이시옷은 오타가 아니어도 자체 비용을 typoCost로 가지므로 제외한다.
+			if (t.tag == POSTag::z_coda || t.tag == POSTag::z_siot) continue;
+			EXPECT_LE(t.typoCost, threshold);
+			numCorrected += t.typoCost > 0;
+		}
+		if (threshold == 0) EXPECT_EQ(numCorrected, 0);
+		else EXPECT_GE(numCorrected, numRepeats);
+	}
+}
+
 TEST(KiwiTypo, ContinualTypoSet)
 {
 	KiwiBuilder builder{ MODEL_PATH, 0, BuildOption::default_, };
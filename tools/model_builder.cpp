@@ -78,6 +78,8 @@ int main(int argc, const char* argv[])
 	ValueArg<size_t> sbgEvalSetRatio{ "", "sbg_eval_ratio", "", false, 20, "int" };
 	ValueArg<size_t> sbgMinCnt{ "", "sbg_min_cnt", "", false, 150, "int" };
 	ValueArg<size_t> sbgMinCoCnt{ "", "sbg_min_co_cnt", "", false, 20, "int" };
+	ValueArg<size_t> countChunk{ "", "count_chunk", "count LM n-grams by chunks of this many tokens on disk (0 for in-memory)", false, 0, "int" };
+	ValueArg<string> tmpDir{ "", "tmp_dir", "directory for temporary files of chunked counting", false, "", "string" };
 	UnlabeledMultiArg<string> inputs{ "inputs", "input copora", true, "string" };
 
 	cmd.add(output);
@@ -97,6 +99,8 @@ int main(int argc, const char* argv[])
 	cmd.add(sbgEvalSetRatio);
 	cmd.add(sbgMinCnt);
 	cmd.add(sbgMinCoCnt);
+	cmd.add(countChunk);
+	cmd.add(tmpDir);
 
 	try
 	{
@@ -121,6 +125,8 @@ int main(int argc, const char* argv[])
 	args.sbgEvalSetRatio = sbgEvalSetRatio;
 	args.sbgMinCount = sbgMinCnt;
 	args.sbgMinCoCount = sbgMinCoCnt;
+	args.lmCountChunkSize = countChunk;
+	args.lmCountTempDir = tmpDir;
 
 	auto v = splitMultipleInts(lmMinCnt.getValue());
 	
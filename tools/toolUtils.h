@@ -144,6 +144,14 @@ namespace tutils
 		{
 			return kiwi::ModelType::congGlobalFp32;
 		}
+		else if (v == "cong-q4")
+		{
+			return kiwi::ModelType::congQ4;
+		}
+		else if (v == "cong-global-q4")
+		{
+			return kiwi::ModelType::congGlobalQ4;
+		}
 		else
 		{
 			throw std::invalid_argument{ "Invalid model type" };